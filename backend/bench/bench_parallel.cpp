@@ -0,0 +1,128 @@
+// Micro-benchmark for the work-stealing pool: task overhead, loop scaling,
+// reduction determinism, nested loops and cancellation.
+//
+//   cmake -DBUILD_BENCHMARKS=ON ... && ./bench_parallel [max_threads]
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "parallel/Parallel.hpp"
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    double msSince(Clock::time_point t0) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    }
+
+    // Enough arithmetic per element that the loop is compute-bound
+    double kernel(std::size_t i) {
+        double x = static_cast<double>(i % 1000) * 0.001;
+        for (int k = 0; k < 16; ++k) x = std::sin(x) + std::sqrt(x + 1.0);
+        return x;
+    }
+
+    void benchTaskOverhead(ThreadPool& pool) {
+        const std::size_t N = 200000;
+        std::atomic<std::size_t> ran{ 0 };
+        auto t0 = Clock::now();
+        {
+            TaskGroup group(pool);
+            for (std::size_t i = 0; i < N; ++i) group.run([&ran] { ran.fetch_add(1, std::memory_order_relaxed); });
+            group.wait();
+        }
+        double ms = msSince(t0);
+        std::printf("  spawn+run %zu empty tasks: %.1f ms (%.0f ns/task)\n", ran.load(), ms, ms * 1e6 / N);
+    }
+
+    double benchFor(ThreadPool& pool, std::vector<double>& out) {
+        auto t0 = Clock::now();
+        parallelFor(pool, 0, out.size(), 0, [&](std::size_t lo, std::size_t hi) {
+            for (std::size_t i = lo; i < hi; ++i) out[i] = kernel(i);
+        });
+        return msSince(t0);
+    }
+
+    double benchReduce(ThreadPool& pool, const std::vector<double>& in, double& sum) {
+        auto t0 = Clock::now();
+        // Fixed grain: the same chunks, and so the same sum, at every thread count
+        sum = parallelReduce(pool, 0, in.size(), 4096, 0.0,
+            [&](std::size_t lo, std::size_t hi) {
+                double s = 0.0;
+                for (std::size_t i = lo; i < hi; ++i) s += in[i];
+                return s;
+            },
+            [](double a, double b) { return a + b; });
+        return msSince(t0);
+    }
+
+    double benchNested(ThreadPool& pool) {
+        std::atomic<std::size_t> cells{ 0 };
+        auto t0 = Clock::now();
+        parallelFor(pool, 0, 64, 1, [&](std::size_t lo, std::size_t hi) {
+            for (std::size_t r = lo; r < hi; ++r)
+                parallelFor(pool, 0, 4096, 256, [&](std::size_t a, std::size_t b) {
+                    double s = 0.0;
+                    for (std::size_t i = a; i < b; ++i) s += kernel(i + r);
+                    if (s > 0.0) cells.fetch_add(b - a, std::memory_order_relaxed);
+                });
+        });
+        return msSince(t0);
+    }
+
+    double benchCancel(ThreadPool& pool, std::size_t& visited) {
+        const std::size_t N = 1 << 24, target = N / 10;
+        std::atomic<std::size_t> seen{ 0 };
+        auto t0 = Clock::now();
+        TaskGroup group(pool);
+        parallelFor(group, 0, N, 1 << 14, [&](std::size_t lo, std::size_t hi) {
+            for (std::size_t i = lo; i < hi && !group.isCancelled(); ++i) {
+                seen.fetch_add(1, std::memory_order_relaxed);
+                if (i == target) group.cancel();
+            }
+        });
+        visited = seen.load();
+        return msSince(t0);
+    }
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::size_t maxThreads = ThreadPool::defaultThreadCount();
+    if (argc > 1) maxThreads = std::max<long>(1, std::atol(argv[1]));
+    std::printf("hardware threads: %zu\n", ThreadPool::defaultThreadCount());
+
+    std::vector<double> data(1 << 21);
+    double baseline = 0.0;
+
+    for (std::size_t threads = 1; threads <= maxThreads; threads *= 2) {
+        ThreadPool pool(threads);
+        std::printf("\n%zu worker(s)\n", threads);
+
+        benchTaskOverhead(pool);
+
+        double forMs = benchFor(pool, data);
+        if (threads == 1) baseline = forMs;
+        std::printf("  parallelFor %zu elements: %.1f ms (speedup %.2fx)\n", data.size(), forMs, baseline / forMs);
+
+        double sum = 0.0;
+        double reduceMs = benchReduce(pool, data, sum);
+        std::printf("  parallelReduce: %.2f ms, sum %.17g\n", reduceMs, sum);
+
+        std::printf("  nested 64 x 4096: %.1f ms\n", benchNested(pool));
+
+        std::size_t visited = 0;
+        double cancelMs = benchCancel(pool, visited);
+        std::printf("  cancelled search: %.1f ms, visited %zu of %d\n", cancelMs, visited, 1 << 24);
+
+        auto m = pool.metrics();
+        std::printf("  tasks executed %llu, stolen %llu\n",
+            static_cast<unsigned long long>(m.executed), static_cast<unsigned long long>(m.stolen));
+
+        if (threads < maxThreads && threads * 2 > maxThreads) threads = maxThreads / 2;
+    }
+    return 0;
+}
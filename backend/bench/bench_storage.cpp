@@ -0,0 +1,202 @@
+// Micro-benchmark for deck encryption: raw seal/open throughput of every
+// cipher suite this CPU supports. Then the shared page store the app keeps
+// decks in: saving, opening and fully decrypting one large deck, with the
+// tracked memory peak while loading, and many users' decks in one file,
+// opening one of them and saving it after a single review.
+//
+//   cmake -DBUILD_BENCHMARKS=ON ... && ./bench_storage [items] [users]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sodium.h>
+#include <spdlog/spdlog.h>
+#include "core/MemoryAccount.hpp"
+#include "core/PersistentDeck.hpp"
+#include "storage/PagedDeck.hpp"
+#include "storage/SealedSection.hpp"
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    double secondsSince(Clock::time_point t0) {
+        return std::chrono::duration<double>(Clock::now() - t0).count();
+    }
+
+    const CipherSuite SUITES[] = { CipherSuite::XSalsa20Poly1305, CipherSuite::XChaCha20Poly1305, CipherSuite::Aes256Gcm };
+
+    // Seal then open `rounds` sections of `size` bytes; prints GB/s each way
+    void benchSections(CipherSuite suite, const std::vector<unsigned char>& key, std::size_t size, int rounds) {
+        std::string plain(size, 'x');
+        std::vector<std::string> frames(rounds);
+
+        auto t0 = Clock::now();
+        for (int r = 0; r < rounds; ++r) sealSection(plain, key, frames[r], suite);
+        double sealS = secondsSince(t0);
+
+        SecureString out(secureResource());
+        bool ok = true;
+        t0 = Clock::now();
+        for (int r = 0; r < rounds; ++r) {
+            std::istringstream in(frames[r]);
+            ok = openSection(in, key, out, suite) && ok;
+        }
+        double openS = secondsSince(t0);
+
+        double gb = static_cast<double>(size) * rounds / 1e9;
+        std::printf("  %7zu B sections: seal %6.2f GB/s, open %6.2f GB/s%s\n", size, gb / sealS, gb / openS,
+            ok ? "" : "  (OPEN FAILED)");
+    }
+
+    std::vector<Item> makeDeck(std::size_t n) {
+        std::vector<Item> items;
+        items.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            Item it("item " + std::to_string(i), std::string(1024, static_cast<char>('a' + i % 26)));
+            it.setTags({ "lang::es", "bench" });
+            for (int r = 0; r < 8; ++r) it.history.push_back({ static_cast<std::time_t>(1700000000 + r * 86400), 4, r + 1 });
+            items.push_back(std::move(it));
+        }
+        return items;
+    }
+
+    void removeStore(const std::string& path) {
+        std::remove(path.c_str());
+        std::remove((path + ".key").c_str());
+        std::remove((path + "-lock").c_str());
+    }
+
+    // One user's deck in a fresh store: the first save writes every record;
+    // the store is then reopened so opening and decrypting start from disk
+    void benchDeck(const std::vector<unsigned char>& key, const std::vector<Item>& items) {
+        const std::string path = "bench_storage_deck.db";
+        removeStore(path);
+
+        PagedStore store;
+        bool ok = store.open(path);
+        double writeS = 0.0;
+        {
+            PagedDeck deck(store);
+            std::vector<Item> none;
+            auto t0 = Clock::now();
+            ok = ok && deck.open(none, "user", key) && deck.save(items);
+            writeS = secondsSince(t0);
+        }
+        std::size_t pages = store.stats().pages;
+        store.close();
+
+        MemoryAccount& memory = *MemoryAccount::process();
+        memory.resetPeaks();
+
+        ok = store.open(path) && ok;
+        PagedDeck deck(store);
+        std::vector<Item> loaded;
+        auto t0 = Clock::now();
+        ok = deck.open(loaded, "user", key) && ok;
+        double openS = secondsSince(t0);
+
+        t0 = Clock::now();
+        ok = deck.loadAll(loaded) && ok;
+        double loadS = secondsSince(t0);
+
+        double bytes = static_cast<double>(pages * PageFile::PAGE_SIZE);
+        std::printf("  deck of %zu items (%.1f MB): save %.1f ms, open index %.1f ms, decrypt all %.1f ms (%.2f GB/s)%s\n",
+            items.size(), bytes / 1e6, writeS * 1e3, openS * 1e3, loadS * 1e3, bytes / 1e9 / loadS,
+            ok && loaded.size() == items.size() ? "" : "  (FAILED)");
+        // What the loaded items cost once they are in a deck
+        std::size_t before = memory.total().current;
+        PersistentDeck inDeck = PersistentDeck::fromVector(std::move(loaded));
+        std::printf("  memory: decrypt buffers peak %.1f MB, page cache peak %.1f MB, deck resident %.1f MB\n",
+            memory.usage(MemoryCategory::Crypto).peak / 1e6, memory.usage(MemoryCategory::PageCache).peak / 1e6,
+            (memory.total().current - before) / 1e6);
+
+        deck.close();
+        store.close();
+        removeStore(path);
+    }
+
+    void benchPagedStore(const std::vector<unsigned char>& key, std::size_t users, std::size_t perUser) {
+        const std::string path = "bench_storage_pages.db";
+        removeStore(path);
+
+        PagedStore store;
+        if (!store.open(path)) {
+            std::printf("  could not create %s\n", path.c_str());
+            return;
+        }
+
+        std::vector<Item> deck = makeDeck(perUser);
+        auto t0 = Clock::now();
+        bool ok = true;
+        for (std::size_t u = 0; u < users && ok; ++u) {
+            PagedDeck user(store);
+            std::vector<Item> none;
+            ok = user.open(none, "user" + std::to_string(u), key) && user.save(deck);
+        }
+        double fillS = secondsSince(t0);
+        PagedStore::Stats filled = store.stats();
+
+        // One user in the middle: index scan, one payload, one review saved
+        PagedDeck one(store);
+        std::vector<Item> loaded;
+        t0 = Clock::now();
+        ok = one.open(loaded, "user" + std::to_string(users / 2), key) && ok;
+        double openS = secondsSince(t0);
+
+        t0 = Clock::now();
+        ok = !loaded.empty() && one.ensureLoaded(loaded[loaded.size() / 2]) && ok;
+        double itemS = secondsSince(t0);
+
+        std::size_t pagesBefore = store.stats().pages;
+        if (!loaded.empty()) loaded[loaded.size() / 2].history.push_back({ 1800000000, 4, 9 });
+        t0 = Clock::now();
+        ok = one.save(loaded) && ok;
+        double saveS = secondsSince(t0);
+
+        std::printf("  %zu users x %zu items: fill %.1f s, %zu pages (%.1f MB), tree height %d\n",
+            users, perUser, fillS, filled.pages, filled.pages * PageFile::PAGE_SIZE / 1e6, filled.height);
+        std::printf("  one user: open %.2f ms, load one item %.3f ms, save one review %.2f ms (%zu records, %zu new pages)%s\n",
+            openS * 1e3, itemS * 1e3, saveS * 1e3, one.lastSaveWrites(), store.stats().pages - pagesBefore,
+            ok && loaded.size() == perUser ? "" : "  (FAILED)");
+        std::printf("  page cache: %zu hits, %zu misses, %zu evictions\n",
+            store.stats().cache.hits, store.stats().cache.misses, store.stats().cache.evictions);
+
+        store.close();
+        removeStore(path);
+    }
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (sodium_init() < 0) return 1;
+    spdlog::set_level(spdlog::level::warn);
+
+    std::size_t deckSize = 50000;
+    if (argc > 1) deckSize = std::max<long>(1, std::atol(argv[1]));
+    std::size_t users = 2000;
+    if (argc > 2) users = std::max<long>(1, std::atol(argv[2]));
+
+    std::vector<unsigned char> key(cipherKeyBytes());
+    randombytes_buf(key.data(), key.size());
+    std::vector<Item> items = makeDeck(deckSize);
+
+    std::printf("preferred suite: %s\n", cipherSuiteName(preferredCipherSuite()));
+    for (CipherSuite suite : SUITES) {
+        std::printf("\n%s\n", cipherSuiteName(suite));
+        if (!cipherSuiteAvailable(suite)) {
+            std::printf("  not supported on this CPU\n");
+            continue;
+        }
+        benchSections(suite, key, 4 * 1024, 20000);
+        benchSections(suite, key, 64 * 1024, 4000);
+        benchSections(suite, key, 1024 * 1024, 256);
+    }
+
+    std::printf("\npage store\n");
+    benchDeck(key, items);
+    benchPagedStore(key, users, 50);
+    return 0;
+}
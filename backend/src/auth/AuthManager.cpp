@@ -5,16 +5,18 @@
 #include <vector>
 #include <string>
 #include <sstream>
+#include <algorithm>
 #include <spdlog/spdlog.h>
 
 // constants for key derivation / pwhash
 static constexpr std::size_t ENC_KEY_BYTES = crypto_secretbox_KEYBYTES; // 32
 static constexpr std::size_t SALT_BYTES = crypto_pwhash_SALTBYTES;      // recommended salt size
 
-AuthManager::AuthManager(const std::string& userFile)
-    : userFilePath(userFile), logged_in_user(nullptr)
+AuthManager::AuthManager(const std::string& userFile, const std::string& policyFile)
+    : userFilePath(userFile), policyFilePath(policyFile), logged_in_user(nullptr)
 {
     spdlog::info("AuthManager initialized with user file '{}'", userFilePath);
+    PasswordPolicy::load(policy, policyFilePath);
     loadUsers();
 }
 
@@ -28,10 +30,11 @@ void AuthManager::loadUsers() {
     users = std::move(loaded);
 }
 
-void AuthManager::saveUsers() {
+bool AuthManager::saveUsers() {
     spdlog::debug("Saving {} user entries to '{}'", users.size(), userFilePath);
-    Storage::saveUsers(users, userFilePath);
+    if (!Storage::saveUsers(users, userFilePath)) return false;
     spdlog::info("User data saved successfully");
+    return true;
 }
 
 void AuthManager::save() {
@@ -39,6 +42,17 @@ void AuthManager::save() {
     saveUsers();
 }
 
+const PasswordPolicy& AuthManager::getPolicy() const {
+    return policy;
+}
+
+bool AuthManager::setPolicy(const PasswordPolicy& p) {
+    if (!PasswordPolicy::save(p, policyFilePath)) return false;
+    policy = p;
+    spdlog::info("Password policy set to ops={} mem={} bytes", policy.opslimit, policy.memlimit);
+    return true;
+}
+
 std::string AuthManager::hashPassword(const std::string& password) {
     spdlog::debug("Hashing password (not logging the password)");
 
@@ -48,8 +62,8 @@ std::string AuthManager::hashPassword(const std::string& password) {
         out,
         password.c_str(),
         static_cast<unsigned long long>(password.size()),
-        crypto_pwhash_OPSLIMIT_INTERACTIVE,
-        crypto_pwhash_MEMLIMIT_INTERACTIVE) != 0)
+        policy.opslimit,
+        policy.memlimit) != 0)
     {
         spdlog::error("crypto_pwhash_str failed (likely out of memory)");
         throw std::runtime_error("crypto_pwhash_str failed (out of memory)");
@@ -109,7 +123,8 @@ static bool hexToSalt(const std::string& hex, std::vector<unsigned char>& out) {
     return true;
 }
 
-bool AuthManager::deriveSessionKey(const std::string& password, const std::string& salt_hex) {
+bool AuthManager::deriveKey(const std::string& password, const std::string& salt_hex, const PasswordPolicy& cost,
+    std::vector<unsigned char>& key) {
     spdlog::debug("Deriving session key (not logging password or salt)");
 
     if (salt_hex.empty()) {
@@ -123,19 +138,19 @@ bool AuthManager::deriveSessionKey(const std::string& password, const std::strin
         return false;
     }
 
-    session_key.assign(ENC_KEY_BYTES, 0);
+    key.assign(ENC_KEY_BYTES, 0);
 
-    if (crypto_pwhash(session_key.data(),
+    if (crypto_pwhash(key.data(),
         ENC_KEY_BYTES,
         password.c_str(),
         static_cast<unsigned long long>(password.size()),
         salt.data(),
-        crypto_pwhash_OPSLIMIT_INTERACTIVE,
-        crypto_pwhash_MEMLIMIT_INTERACTIVE,
+        cost.opslimit,
+        cost.memlimit,
         crypto_pwhash_ALG_DEFAULT) != 0)
     {
         spdlog::error("crypto_pwhash failed during session key derivation");
-        session_key.clear();
+        key.clear();
         return false;
     }
 
@@ -143,6 +158,88 @@ bool AuthManager::deriveSessionKey(const std::string& password, const std::strin
     return true;
 }
 
+bool AuthManager::deriveSessionKey(const std::string& password, const std::string& salt_hex, const PasswordPolicy& cost) {
+    return deriveKey(password, salt_hex, cost, session_key);
+}
+
+AuthManager::KeyChange::~KeyChange() {
+    if (!oldKey.empty()) sodium_memzero(oldKey.data(), oldKey.size());
+    if (!newKey.empty()) sodium_memzero(newKey.data(), newKey.size());
+}
+
+bool AuthManager::beginKeyChange(const std::string& username, const std::string& oldPassword,
+    const std::string& newPassword, KeyChange& change) {
+    spdlog::info("Key change requested for '{}'", username);
+
+    if (newPassword.empty()) {
+        spdlog::warn("Key change failed: empty password");
+        return false;
+    }
+
+    User u;
+    {
+        std::lock_guard<std::mutex> guard(usersLock);
+        auto it = std::find_if(users.begin(), users.end(), [&](const User& x) { return x.username == username; });
+        if (it == users.end()) {
+            spdlog::warn("Key change failed: username '{}' not found", username);
+            return false;
+        }
+        u = *it;
+    }
+
+    // Argon2 runs outside the lock so several users can be prepared at once
+    if (!verifyPassword(oldPassword, u.password_hash)) {
+        spdlog::warn("Key change failed: incorrect password for '{}'", username);
+        return false;
+    }
+
+    unsigned char salt[SALT_BYTES];
+    randombytes_buf(salt, SALT_BYTES);
+
+    change.username = username;
+    change.oldGeneration = u.key_generation;
+    change.newGeneration = u.key_generation + 1;
+    change.newSalt = saltToHex(salt, SALT_BYTES);
+    change.newCost = policy;
+    if (!deriveKey(oldPassword, u.enc_salt, u.key_cost, change.oldKey)
+        || !deriveKey(newPassword, change.newSalt, change.newCost, change.newKey)) {
+        spdlog::error("Failed to derive keys for '{}'", username);
+        return false;
+    }
+
+    try {
+        change.newHash = hashPassword(newPassword);
+    }
+    catch (const std::exception& e) {
+        spdlog::error("Key change failed for '{}': {}", username, e.what());
+        return false;
+    }
+    return true;
+}
+
+bool AuthManager::commitKeyChange(const KeyChange& change) {
+    std::lock_guard<std::mutex> guard(usersLock);
+    auto it = std::find_if(users.begin(), users.end(), [&](const User& x) { return x.username == change.username; });
+    if (it == users.end() || it->key_generation != change.oldGeneration) {
+        spdlog::error("Key change for '{}' is stale", change.username);
+        return false;
+    }
+
+    User before = *it;
+    it->password_hash = change.newHash;
+    it->enc_salt = change.newSalt;
+    it->key_cost = change.newCost;
+    it->key_generation = change.newGeneration;
+    if (!saveUsers()) {
+        *it = before;
+        return false;
+    }
+
+    if (logged_in_user == &*it) session_key = change.newKey;
+    spdlog::info("Key change committed for '{}' (generation {})", change.username, change.newGeneration);
+    return true;
+}
+
 bool AuthManager::signup(const std::string& username, const std::string& password) {
     spdlog::info("Attempting signup for username '{}'", username);
 
@@ -166,6 +263,7 @@ bool AuthManager::signup(const std::string& username, const std::string& passwor
     std::string salt_hex = saltToHex(salt, SALT_BYTES);
 
     users.emplace_back(username, hashed, salt_hex);
+    users.back().key_cost = policy;
     saveUsers();
 
     spdlog::info("Signup successful for username '{}'", username);
@@ -181,11 +279,27 @@ bool AuthManager::login(const std::string& username, const std::string& password
             if (verifyPassword(password, u.password_hash)) {
                 spdlog::debug("Password verification successful for '{}'", username);
 
-                if (!deriveSessionKey(password, u.enc_salt)) {
+                if (!deriveSessionKey(password, u.enc_salt, u.key_cost)) {
                     spdlog::error("Failed to derive session key for '{}'", username);
                     return false;
                 }
 
+                // The password is at hand only now, so this is when a hash
+                // weaker than the policy can be replaced; a stronger one is
+                // kept even if the policy was lowered. The session key
+                // cannot follow: data is sealed with it, so its cost changes
+                // only when the key itself does.
+                if (policy.needsRehash(u.password_hash)) {
+                    try {
+                        u.password_hash = hashPassword(password);
+                        saveUsers();
+                        spdlog::info("Rehashed password for '{}' under the current policy", username);
+                    }
+                    catch (const std::exception& e) {
+                        spdlog::warn("Keeping the old password hash for '{}': {}", username, e.what());
+                    }
+                }
+
                 logged_in_user = &u;
                 spdlog::info("User '{}' logged in successfully", username);
                 return true;
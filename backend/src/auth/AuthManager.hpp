@@ -1,13 +1,17 @@
 #pragma once
 
+#include <cstdint>
+#include <mutex>
 #include <string>
 #include <vector>
+#include "PasswordPolicy.hpp"
 #include "User.hpp"
 
 // Forward-declare libsodium types not required
 class AuthManager {
 public:
-    explicit AuthManager(const std::string& userFile = "users.txt");
+    explicit AuthManager(const std::string& userFile = "users.txt",
+        const std::string& policyFile = "auth_policy.txt");
 
     bool signup(const std::string& username, const std::string& password);
     bool login(const std::string& username, const std::string& password);
@@ -18,26 +22,61 @@ public:
     // Persist users to disk
     void save();
 
+    // Cost for new password hashes and session keys. Passwords hashed at
+    // another cost are rehashed at their owner's next login.
+    const PasswordPolicy& getPolicy() const;
+    bool setPolicy(const PasswordPolicy& policy);
+
+    // A new session key for a user, derived but not yet in effect. The caller
+    // re-encrypts the user's data from oldKey to newKey under the new
+    // generation, then commits; until then the old password and key stay valid.
+    struct KeyChange {
+        std::string username;
+        std::vector<unsigned char> oldKey;
+        std::vector<unsigned char> newKey;
+        std::uint32_t oldGeneration = 0;
+        std::uint32_t newGeneration = 0;
+        std::string newHash;
+        std::string newSalt;
+        PasswordPolicy newCost;
+
+        ~KeyChange();
+    };
+
+    // Checks oldPassword and derives both keys. newPassword may be the same
+    // password, which only rotates the key (fresh salt, current policy cost).
+    // Safe to call for several users at once.
+    bool beginKeyChange(const std::string& username, const std::string& oldPassword, const std::string& newPassword,
+        KeyChange& change);
+    // Make the new password and key current and save the user file. Updates
+    // the session key if the user is logged in.
+    bool commitKeyChange(const KeyChange& change);
+
     // Return the in-memory session key (derived from password) for the currently logged-in user.
     // If no user is logged in, returns an empty vector.
     const std::vector<unsigned char>& getSessionKey() const;
 
 private:
     std::vector<User> users;         // private user list
+    mutable std::mutex usersLock;    // held by key changes, which may run on several threads
     User* logged_in_user = nullptr;
     std::string userFilePath;
+    std::string policyFilePath;
+    PasswordPolicy policy;
 
     std::vector<unsigned char> session_key; // holds derived key for current session
 
     // Storage helpers
     void loadUsers();
-    void saveUsers();
+    bool saveUsers();
 
     // Password hashing / verification (libsodium)
     std::string hashPassword(const std::string& password);
     bool verifyPassword(const std::string& password, const std::string& hash);
 
-    // Key derivation: derive session_key from password + user's salt (stored as hex)
-    // returns true on success, false on failure
-    bool deriveSessionKey(const std::string& password, const std::string& salt_hex);
+    // Key derivation: derive a key from password + user's salt (stored as hex)
+    // at the user's key cost; returns true on success, false on failure
+    static bool deriveKey(const std::string& password, const std::string& salt_hex, const PasswordPolicy& cost,
+        std::vector<unsigned char>& key);
+    bool deriveSessionKey(const std::string& password, const std::string& salt_hex, const PasswordPolicy& cost);
 };
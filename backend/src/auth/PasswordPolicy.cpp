@@ -0,0 +1,169 @@
+#include "PasswordPolicy.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <sodium.h>
+#include <spdlog/spdlog.h>
+
+static_assert(PasswordPolicy::MIN_OPSLIMIT == crypto_pwhash_OPSLIMIT_INTERACTIVE &&
+    PasswordPolicy::MIN_MEMLIMIT == crypto_pwhash_MEMLIMIT_INTERACTIVE,
+    "PasswordPolicy minimums must match libsodium's interactive limits");
+
+static constexpr std::size_t MIB = 1024 * 1024;
+static constexpr unsigned long long MAX_OPS = 32;
+
+// Wall time for `concurrency` threads each deriving one key at the given
+// cost; negative if any of them failed (usually out of memory)
+static double measure(unsigned long long ops, std::size_t mem, int concurrency) {
+    static const char password[] = "calibration password";
+    unsigned char salt[crypto_pwhash_SALTBYTES];
+    randombytes_buf(salt, sizeof(salt));
+
+    std::atomic<bool> failed{ false };
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    threads.reserve(static_cast<std::size_t>(concurrency));
+    for (int t = 0; t < concurrency; ++t) {
+        threads.emplace_back([&]() {
+            unsigned char out[crypto_secretbox_KEYBYTES];
+            if (crypto_pwhash(out, sizeof(out), password, sizeof(password) - 1, salt, ops, mem,
+                crypto_pwhash_ALG_DEFAULT) != 0)
+                failed = true;
+        });
+    }
+    for (auto& t : threads) t.join();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    spdlog::debug("Argon2id ops={} mem={} MiB x{}: {:.1f} ms{}", ops, mem / MIB, concurrency, ms,
+        failed ? " (failed)" : "");
+    return failed ? -1.0 : ms;
+}
+
+// Memory is what makes Argon2 costly to attack, so take as much of the budget
+// as the target allows with the fewest passes, then spend what time is left on
+// extra passes
+PasswordPolicy PasswordPolicy::calibrate(const Options& options, Report* report) {
+    const int concurrency = std::max(1, options.concurrency);
+    const double target = options.targetMs > 0.0 ? options.targetMs : Options().targetMs;
+    Report r;
+
+    std::size_t mem = std::max(MIN_MEMLIMIT, options.memoryBudget / static_cast<std::size_t>(concurrency) / MIB * MIB);
+    double ms = measure(MIN_OPSLIMIT, mem, concurrency);
+    ++r.trials;
+    while ((ms < 0.0 || ms > target) && mem / 2 >= MIN_MEMLIMIT) {
+        mem /= 2;
+        ms = measure(MIN_OPSLIMIT, mem, concurrency);
+        ++r.trials;
+    }
+
+    unsigned long long ops = MIN_OPSLIMIT;
+    if (ms > 0.0 && ms <= target) {
+        // Time grows about linearly with passes; step down until a guess fits
+        unsigned long long guess = std::min(MAX_OPS, static_cast<unsigned long long>(ops * target / ms));
+        while (guess > MIN_OPSLIMIT) {
+            double t = measure(guess, mem, concurrency);
+            ++r.trials;
+            if (t > 0.0 && t <= target) {
+                ops = guess;
+                ms = t;
+                break;
+            }
+            unsigned long long scaled = t > 0.0 ? static_cast<unsigned long long>(guess * target / t) : guess / 2;
+            guess = std::min(guess - 1, scaled);
+        }
+    }
+
+    PasswordPolicy policy;
+    policy.opslimit = ops;
+    policy.memlimit = mem;
+    r.measuredMs = ms;
+    r.metTarget = ms > 0.0 && ms <= target;
+    if (!r.metTarget)
+        spdlog::warn("Argon2id cannot meet {:.0f} ms for {} concurrent logins here; using the minimum cost",
+            target, concurrency);
+    spdlog::info("Calibrated Argon2id: ops={} mem={} MiB ({:.1f} ms for {} concurrent logins, {} trials)",
+        policy.opslimit, policy.memlimit / MIB, ms, concurrency, r.trials);
+
+    if (report) *report = r;
+    return policy;
+}
+
+bool PasswordPolicy::needsRehash(const std::string& hash) const {
+    // 0 means the same cost and algorithm; -1, a hash it cannot parse, which is worth replacing
+    int differs = crypto_pwhash_str_needs_rehash(hash.c_str(), opslimit, memlimit);
+    if (differs <= 0) return differs != 0;
+
+    // Argon2 strings carry their cost as "$m=<KiB>,t=<passes>"; an older
+    // algorithm at the same cost is still replaced
+    unsigned long long kib = 0, ops = 0;
+    auto pos = hash.find("$m=");
+    if (pos == std::string::npos || std::sscanf(hash.c_str() + pos, "$m=%llu,t=%llu", &kib, &ops) != 2)
+        return true;
+    return ops <= opslimit && kib * 1024 <= memlimit;
+}
+
+std::string PasswordPolicy::serialize() const {
+    std::ostringstream oss;
+    oss << "opslimit:" << opslimit << "\n";
+    oss << "memlimit:" << memlimit << "\n";
+    return oss.str();
+}
+
+void PasswordPolicy::deserialize(const std::string& data) {
+    *this = PasswordPolicy();
+    std::istringstream iss(data);
+    std::string line;
+
+    while (std::getline(iss, line)) {
+        auto pos = line.find(':');
+        if (pos == std::string::npos) continue;
+
+        std::string key = line.substr(0, pos);
+        std::string val = line.substr(pos + 1);
+
+        try {
+            if (key == "opslimit") {
+                unsigned long long v = std::stoull(val);
+                if (v >= MIN_OPSLIMIT) opslimit = v;
+            }
+            else if (key == "memlimit") {
+                unsigned long long v = std::stoull(val);
+                if (v >= MIN_MEMLIMIT) memlimit = static_cast<std::size_t>(v);
+            }
+        }
+        catch (...) {
+            continue;
+        }
+    }
+}
+
+bool PasswordPolicy::load(PasswordPolicy& policy, const std::string& filename) {
+    policy = PasswordPolicy();
+    std::ifstream in(filename);
+    if (!in) return true;
+
+    std::stringstream ss;
+    ss << in.rdbuf();
+    policy.deserialize(ss.str());
+    spdlog::info("Password policy from '{}': ops={} mem={} MiB", filename, policy.opslimit, policy.memlimit / MIB);
+    return true;
+}
+
+bool PasswordPolicy::save(const PasswordPolicy& policy, const std::string& filename) {
+    if (!policy.meetsMinimum()) {
+        spdlog::error("Refusing to save password policy ops={} mem={} MiB: the minimum is ops={} mem={} MiB",
+            policy.opslimit, policy.memlimit / MIB, MIN_OPSLIMIT, MIN_MEMLIMIT / MIB);
+        return false;
+    }
+    std::ofstream out(filename, std::ios::trunc);
+    if (!(out << policy.serialize())) {
+        spdlog::error("Failed to write password policy '{}'", filename);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// Argon2id cost used for password hashes and session keys. The defaults are
+// libsodium's "interactive" limits, which every account created before
+// calibration existed was hashed with.
+//
+// calibrate() measures Argon2id on this host and picks the largest cost that
+// keeps a login under a latency target while `concurrency` logins run at
+// once, but never goes below the interactive limits (MIN_OPSLIMIT and
+// MIN_MEMLIMIT): a host too slow for those gets them anyway. The result is
+// kept in a small text file next to the user file; a hash records its own
+// cost, so changing the policy never locks anyone out, and AuthManager
+// rehashes a weaker password hash the next time its owner logs in.
+class PasswordPolicy {
+public:
+    struct Options {
+        double targetMs = 500.0;                   // wall time of one login under load
+        int concurrency = 1;                       // logins hashed at the same time
+        std::size_t memoryBudget = std::size_t(1) << 30; // shared by the concurrent logins
+    };
+
+    struct Report {
+        double measuredMs = 0.0; // for the chosen cost, all logins running together
+        int trials = 0;
+        bool metTarget = false;  // false if even the minimum cost was too slow
+    };
+
+    // The cheapest cost accepted for a policy
+    static constexpr unsigned long long MIN_OPSLIMIT = 2;         // crypto_pwhash_OPSLIMIT_INTERACTIVE
+    static constexpr std::size_t MIN_MEMLIMIT = 64 * 1024 * 1024; // crypto_pwhash_MEMLIMIT_INTERACTIVE
+
+    unsigned long long opslimit = MIN_OPSLIMIT;
+    std::size_t memlimit = MIN_MEMLIMIT;
+
+    static PasswordPolicy calibrate(const Options& options, Report* report = nullptr);
+
+    bool meetsMinimum() const { return opslimit >= MIN_OPSLIMIT && memlimit >= MIN_MEMLIMIT; }
+
+    // Whether a crypto_pwhash_str hash is weaker than this policy: no more
+    // passes and no more memory, and less of one. A hash that is stronger in
+    // either respect is kept, so lowering the policy never downgrades it.
+    bool needsRehash(const std::string& hash) const;
+
+    std::string serialize() const;
+    void deserialize(const std::string& data);
+
+    // A missing file leaves the defaults and is not an error; values below
+    // the minimum are ignored. save() refuses a policy below the minimum.
+    static bool load(PasswordPolicy& policy, const std::string& filename);
+    static bool save(const PasswordPolicy& policy, const std::string& filename);
+
+    bool operator==(const PasswordPolicy& o) const { return opslimit == o.opslimit && memlimit == o.memlimit; }
+    bool operator!=(const PasswordPolicy& o) const { return !(*this == o); }
+};
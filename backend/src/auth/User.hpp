@@ -1,6 +1,8 @@
 #pragma once
+#include <cstdint>
 #include <string>
 #include <ctime>
+#include "PasswordPolicy.hpp"
 
 class User {
 public:
@@ -11,4 +13,6 @@ public:
     std::string password_hash; // Argon2id hash (crypto_pwhash_str)
     std::string enc_salt;      // hex-encoded salt for key derivation
     std::time_t created_at = 0;
+    PasswordPolicy key_cost;   // Argon2id cost of the session key; changes only with the key
+    std::uint32_t key_generation = 0; // bumped with each new session key; names where the data lives
 };
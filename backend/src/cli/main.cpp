@@ -5,13 +5,39 @@
 #include <algorithm>
 #include <limits>
 #include <sstream>
+#include <ctime>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
 
 #include "../utils/logging.hpp"
 #include "../auth/AuthManager.hpp"
-#include "../storage/Storage.hpp"
+#include "../storage/PagedDeck.hpp"
+#include "../storage/BlobStore.hpp"
+#include "../storage/ReviewJournal.hpp"
+#include "../storage/KeyRotation.hpp"
+#include "../storage/DeckSync.hpp"
 #include "../core/Scheduler.hpp"
 #include "../core/TagManager.hpp"
+#include "../core/SchedulerConfig.hpp"
+#include "../core/FSRSOptimizer.hpp"
+#include "../core/ReviewForecast.hpp"
+#include "../core/DeckStats.hpp"
+#include "../core/DuplicateIndex.hpp"
+#include "../core/DeckQuery.hpp"
+#include "../core/DeckHistory.hpp"
+#include "../core/ReviewPipeline.hpp"
+#include "../core/RetentionSimulator.hpp"
+#include "../core/ReviewSession.hpp"
 
+// Every user's deck, tag weights and scheduler settings
+static const char STORE_FILE[] = "decks.db";
+
+// Per-user files from before the shared store, read once to import them
 std::string itemFileFor(const std::string& username) {
     return "data_" + username + ".dat";
 }
@@ -20,61 +46,246 @@ std::string tagFileFor(const std::string& username) {
     return "tagdata_" + username + ".dat";
 }
 
-void listAllItems(const std::vector<Item>& items) {
-    std::cout << "\n===== ALL ITEMS =====\n";
+std::string schedFileFor(const std::string& username) {
+    return "scheddata_" + username + ".dat";
+}
 
-    if (items.empty()) {
-        std::cout << "No items stored.\n";
-        return;
+// Blobs and the journal are sealed with the session key, so each key generation has its own
+std::string blobDirFor(const std::string& username, std::uint32_t generation) {
+    if (generation == 0) return "blobs_" + username;
+    return "blobs_" + username + "." + std::to_string(generation);
+}
+
+std::string journalFileFor(const std::string& username, std::uint32_t generation) {
+    if (generation == 0) return "journal_" + username + ".dat";
+    return "journal_" + username + "." + std::to_string(generation) + ".dat";
+}
+
+KeyRotation::Location locationFor(const std::string& username, std::uint32_t generation) {
+    KeyRotation::Location loc{ blobDirFor(username, generation), journalFileFor(username, generation), {} };
+    if (generation == 0) loc.legacy = { itemFileFor(username), tagFileFor(username), schedFileFor(username) };
+    return loc;
+}
+
+// One item in full, review history included (if decrypted)
+void printItem(std::size_t index, const Item& it) {
+    std::cout << index + 1 << ". " << it.title << "\n";
+
+    std::cout << "   Tags: ";
+    if (it.tags.empty()) std::cout << "(none)";
+    else {
+        for (size_t j = 0; j < it.tags.size(); ++j) {
+            if (j) std::cout << ", ";
+            std::cout << it.tags[j];
+        }
     }
+    std::cout << "\n";
 
-    for (size_t i = 0; i < items.size(); i++) {
-        const Item& it = items[i];
-        std::cout << i + 1 << ". " << it.title << "\n";
+    std::cout << "   Interval: " << it.interval << " days\n";
+    std::cout << "   Ease: " << it.ease_factor << "\n";
+    std::cout << "   Lapses: " << it.lapses << "\n";
+    std::cout << "   Streak: " << it.streak << "\n";
+    std::cout << "   Next review: " << it.next_review << " (UNIX)\n";
 
-        std::cout << "   Tags: ";
-        if (it.tags.empty()) std::cout << "(none)";
-        else {
-            for (size_t j = 0; j < it.tags.size(); ++j) {
-                if (j) std::cout << ", ";
-                std::cout << it.tags[j];
-            }
+    std::cout << "   Review History:\n";
+    if (it.cold) {
+        std::cout << "      (not loaded)\n";
+    }
+    else if (it.history.empty()) {
+        std::cout << "      (no history)\n";
+    }
+    else {
+        for (const auto& r : it.history) {
+            std::cout << "      - " << r.timestamp
+                << " | quality=" << r.quality
+                << " | interval_after=" << r.interval_after
+                << "\n";
         }
-        std::cout << "\n";
+    }
+
+    std::cout << "-----------------------------\n";
+}
+
+// One line per item in browsed pages
+void printRow(std::size_t index, const Item& it) {
+    char date[16];
+    std::strftime(date, sizeof(date), "%Y-%m-%d", std::gmtime(&it.next_review));
+    std::cout << index + 1 << ". " << it.title;
+    if (!it.tags.empty()) std::cout << "  [" << it.tagsAsLine() << "]";
+    std::cout << "  due " << date << "  ease " << it.ease_factor << "  lapses " << it.lapses << "\n";
+}
 
-        std::cout << "   Interval: " << it.interval << " days\n";
-        std::cout << "   Ease: " << it.ease_factor << "\n";
-        std::cout << "   Lapses: " << it.lapses << "\n";
-        std::cout << "   Streak: " << it.streak << "\n";
-        std::cout << "   Next review: " << it.next_review << " (UNIX)\n";
+static const std::size_t PAGE_SIZE = 20;
 
-        std::cout << "   Review History:\n";
-        if (it.history.empty()) {
-            std::cout << "      (no history)\n";
+// Shows a query PAGE_SIZE rows at a time. A number picks that item (its
+// position in the deck); pick() returns true to stop browsing. Returns the
+// last item picked, or -1.
+int browse(const DeckQuery& query, const char* heading, const std::function<bool(std::size_t)>& pick) {
+    std::cout << "\n===== " << heading << " =====\n";
+    DeckQuery::Cursor cursor;
+    int picked = -1;
+    bool shown = false;
+    while (true) {
+        DeckQuery::Page page = query.page(cursor, PAGE_SIZE);
+        for (const auto& row : page.rows) printRow(row.index, *row.item);
+        if (!shown && page.rows.empty()) {
+            std::cout << "No items.\n";
+            return -1;
         }
-        else {
-            for (const auto& r : it.history) {
-                std::cout << "      - " << r.timestamp
-                    << " | quality=" << r.quality
-                    << " | interval_after=" << r.interval_after
-                    << "\n";
+        shown = true;
+        if (!page.next.end) cursor = page.next;
+
+        std::cout << (page.next.end ? "-- end -- " : "-- more -- ") << "Item number"
+            << (page.next.end ? "" : ", Enter for more") << ", 0 to stop: ";
+        std::string line;
+        if (!std::getline(std::cin, line)) return picked;
+        if (line.empty()) {
+            if (page.next.end) return picked;
+            continue;
+        }
+
+        int sel;
+        try { sel = std::stoi(line); }
+        catch (...) { sel = -1; }
+        if (sel == 0) return picked;
+        if (sel < 0 || static_cast<std::size_t>(sel) > query.deck().size()) {
+            std::cout << "Invalid selection.\n";
+            return -1;
+        }
+        picked = sel - 1;
+        if (pick(picked)) return picked;
+    }
+}
+
+// "tag:geo due:7 ease:1.3-2 lapses:2- text:paris sort:due desc"; a bare word is a tag.
+// Ranges are "a-b", "a-", "-b" or one value; due counts days from now.
+bool parseQuery(const std::string& spec, DeckQuery::Filter& filter, DeckQuery::Order& order, bool& descending) {
+    auto range = [](const std::string& v, double& lo, double& hi) {
+        try {
+            auto dash = v.find('-');
+            if (dash == std::string::npos) {
+                lo = hi = std::stod(v);
+                return true;
             }
+            if (dash > 0) lo = std::stod(v.substr(0, dash));
+            if (dash + 1 < v.size()) hi = std::stod(v.substr(dash + 1));
+            return dash > 0 || dash + 1 < v.size();
         }
+        catch (...) { return false; }
+    };
 
-        std::cout << "-----------------------------\n";
+    std::istringstream iss(spec);
+    std::string term;
+    while (iss >> term) {
+        // "lang::es" is a bare tag, not a "lang" term
+        auto colon = term.find(':');
+        if (colon != std::string::npos && term.compare(colon, 2, "::") == 0) colon = std::string::npos;
+        std::string name = colon == std::string::npos ? "" : term.substr(0, colon);
+        std::string value = colon == std::string::npos ? term : term.substr(colon + 1);
+        if (term == "desc") descending = true;
+        else if (name.empty() || name == "tag") filter.tag = value;
+        else if (name == "text") filter.text = value;
+        else if (name == "due") {
+            double lo = 0.0, hi = 1e9;
+            if (!range(value, lo, hi)) return false;
+            std::time_t now = std::time(nullptr);
+            if (value.find('-') != std::string::npos && value[0] != '-')
+                filter.dueFrom = now + static_cast<std::time_t>(lo * 86400);
+            filter.dueUntil = now + static_cast<std::time_t>(hi * 86400);
+        }
+        else if (name == "ease") {
+            if (!range(value, filter.minEase, filter.maxEase)) return false;
+        }
+        else if (name == "lapses") {
+            double lo = filter.minLapses, hi = filter.maxLapses;
+            if (!range(value, lo, hi)) return false;
+            filter.minLapses = static_cast<int>(lo);
+            filter.maxLapses = static_cast<int>(hi);
+        }
+        else if (name == "sort") {
+            if (value == "due") order = DeckQuery::Order::Due;
+            else if (value == "ease") order = DeckQuery::Order::Ease;
+            else if (value == "lapses") order = DeckQuery::Order::Lapses;
+            else if (value == "title") order = DeckQuery::Order::Title;
+            else if (value == "position") order = DeckQuery::Order::Position;
+            else return false;
+        }
+        else return false;
     }
+    return true;
 }
 
 
+void printForecast(const std::vector<int>& counts) {
+    std::cout << "\n===== REVIEW FORECAST =====\n";
+
+    std::time_t today = std::time(nullptr);
+    int total = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        std::time_t day = today + static_cast<std::time_t>(i) * ReviewForecast::DAY_SECONDS;
+        char date[16];
+        std::strftime(date, sizeof(date), "%Y-%m-%d", std::gmtime(&day));
+
+        std::cout << "   " << date << (i == 0 ? " (today)" : "        ") << " : " << counts[i] << "\n";
+        total += counts[i];
+    }
+    std::cout << "Total over " << counts.size() << " day(s): " << total << "\n";
+}
+
+
+void printStats(const DeckStats& stats) {
+    std::cout << "\n===== STATISTICS =====\n";
+    std::cout << "Items: " << stats.itemCount() << "\n";
+    std::cout << "Reviews: " << stats.reviewCount() << "\n";
+    std::cout << "Retention: " << static_cast<int>(std::round(stats.retention() * 1000.0)) / 10.0 << "%\n";
+    std::cout << "Lapses: " << stats.totalLapses() << "\n";
+    std::cout << "Leeches: " << stats.leechCount() << "\n";
+
+    std::cout << "\nEase distribution:\n";
+    const auto& hist = stats.easeHistogram();
+    for (size_t b = 0; b < hist.size(); ++b) {
+        if (!hist[b]) continue;
+        double lo = DeckStats::EASE_MIN + DeckStats::EASE_BIN_WIDTH * static_cast<double>(b);
+        std::cout << "   " << lo << (b + 1 == hist.size() ? "+" : "") << " : " << hist[b] << "\n";
+    }
+
+    std::cout << "\nPer-tag performance:\n";
+    if (stats.tagStats().empty()) std::cout << "   (no tags)\n";
+    std::vector<std::pair<std::string, TagStats>> tags(stats.tagStats().begin(), stats.tagStats().end());
+    std::sort(tags.begin(), tags.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    for (const auto& t : tags) {
+        std::cout << "   " << t.first
+            << " | items=" << t.second.items
+            << " | reviews=" << t.second.reviews
+            << " | retention=" << static_cast<int>(std::round(t.second.retention() * 1000.0)) / 10.0 << "%"
+            << " | lapses=" << t.second.lapses << "\n";
+    }
+
+    constexpr int DAYS = 30;
+    std::time_t now = std::time(nullptr);
+    auto perDay = stats.reviewsPerDay(now - (DAYS - 1) * ReviewForecast::DAY_SECONDS, DAYS);
+    std::cout << "\nReviews per day (last " << DAYS << " days):\n";
+    for (size_t i = 0; i < perDay.size(); ++i) {
+        if (!perDay[i]) continue;
+        std::time_t day = now - static_cast<std::time_t>(DAYS - 1 - i) * ReviewForecast::DAY_SECONDS;
+        char date[16];
+        std::strftime(date, sizeof(date), "%Y-%m-%d", std::gmtime(&day));
+        std::cout << "   " << date << " : " << perDay[i] << "\n";
+    }
+}
+
+
+// 1..4, or 0 to stop reviewing
 int askQuality() {
     while (true) {
         std::cout << "\nChoose difficulty:\n"
             " 1 = AGAIN (Failed)\n"
             " 2 = HARD\n"
             " 3 = GOOD\n"
-            " 4 = EASY\n> ";
+            " 4 = EASY\n"
+            " 0 = End session\n> ";
         int q;
-        if (std::cin >> q && q >= 1 && q <= 4) {
+        if (std::cin >> q && q >= 0 && q <= 4) {
             std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
             return q;
         }
@@ -91,113 +302,303 @@ std::vector<std::string> splitTagsLine(const std::string& line) {
     while (std::getline(iss, t, ',')) {
         while (!t.empty() && std::isspace((unsigned char)t.front())) t.erase(t.begin());
         while (!t.empty() && std::isspace((unsigned char)t.back())) t.pop_back();
+        t = TagTrie::normalize(t);
         if (!t.empty()) out.push_back(t);
     }
     return out;
 }
 
-std::vector<std::string> gatherAllTags(const std::vector<Item>& items) {
+std::string readTag(const char* prompt) {
+    std::cout << prompt;
+    std::string tag; std::getline(std::cin, tag);
+    return TagTrie::normalize(tag);
+}
+
+std::vector<std::string> gatherAllTags(const PersistentDeck& items) {
     std::vector<std::string> all;
-    for (const auto& it : items) {
+    items.forEach([&](const Item& it) {
         for (const auto& t : it.tags)
             if (std::find(all.begin(), all.end(), t) == all.end())
                 all.push_back(t);
-    }
+    });
     return all;
 }
 
-int chooseItemIndex(const std::vector<Item>& items) {
+int chooseItemIndex(const PersistentDeck& items) {
     if (items.empty()) {
         std::cout << "No items available.\n";
         return -1;
     }
-    listAllItems(items);
-    std::cout << "Choose item number: ";
+    return browse(DeckQuery(items), "CHOOSE ITEM", [](std::size_t) { return true; });
+}
 
-    int sel;
-    if (!(std::cin >> sel)) {
-        std::cin.clear();
-        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-        return -1;
+// The chosen item by handle, so edits reach it however the deck shifts meanwhile
+DeckHistory::Handle chooseItem(const DeckHistory& items) {
+    int idx = chooseItemIndex(items.snapshot());
+    return idx < 0 ? DeckHistory::Handle() : items.handleAt(static_cast<std::size_t>(idx));
+}
+
+// Decrypt a cold item and publish the full copy (not an undoable change).
+// Retries if a review replaced the item meanwhile; that copy is already warm.
+bool warmItem(DeckHistory& items, PagedDeck& storedDeck, std::size_t i) {
+    while (true) {
+        auto cur = items.snapshot().ptr(i);
+        if (!cur->cold) return true;
+
+        Item full = *cur;
+        if (!storedDeck.ensureLoaded(full)) return false;
+        if (items.load(i, cur, std::move(full))) return true;
     }
-    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+}
 
-    if (sel < 1 || (size_t)sel > items.size()) {
-        std::cout << "Invalid selection.\n";
-        return -1;
+// As above, for the item h names; false also once it is gone
+bool warmItem(DeckHistory& items, PagedDeck& storedDeck, DeckHistory::Handle h) {
+    while (true) {
+        auto cur = items.get(h);
+        if (!cur) return false;
+        if (!cur->cold) return true;
+
+        Item full = *cur;
+        std::size_t i = 0;
+        if (!storedDeck.ensureLoaded(full)) return false;
+        if (items.indexOf(h, i) && items.load(i, cur, std::move(full))) return true;
     }
-    return sel - 1;
 }
 
-int main() {
-    if (sodium_init() < 0) {
-        std::cerr << "Failed to initialize libsodium\n";
-        return 1;
+bool warmAll(DeckHistory& items, PagedDeck& storedDeck) {
+    while (true) {
+        PersistentDeck snap = items.snapshot();
+        bool anyCold = false;
+        snap.forEach([&](const Item& it) { anyCold = anyCold || it.cold; });
+        if (!anyCold) return true;
+
+        std::vector<Item> all = snap.toVector();
+        if (!storedDeck.loadAll(all)) return false;
+        if (items.load(snap, PersistentDeck::fromVector(std::move(all), items.memory()))) return true;
     }
+}
 
-    Log::init();
+// Per-login state shared by the menus
+struct Session {
+    AuthManager& auth;
+    User* current;
+    DeckHistory& items;
+    PagedStore& store;
+    PagedDeck& storedDeck;
+    BlobStore& blobs;
+    ReviewJournal& journal;
+    TagManager& tagManager;
+    SchedulerConfig& schedConfig;
+    ReviewForecast& forecast;
+    DeckStats& stats;
+    DuplicateIndex& duplicates;
+    std::future<bool> pendingSave{};
+    bool journalReplayed = false;
+};
 
-    AuthManager auth;
-    std::vector<Item> items;
-    TagManager tagManager;
-    User* current = nullptr;
+// Load the logged-in user's deck, settings and journal under the current session key
+void openDeck(Session& session) {
+    const User& user = *session.current;
+    const auto& key = session.auth.getSessionKey();
+    const std::uint32_t generation = user.key_generation;
 
-    // LOGIN / SIGNUP
-    while (!current) {
-        std::cout << "\n===== LOGIN MENU =====\n"
-            "1. Login\n"
-            "2. Signup\n"
-            "3. Exit\n> ";
-        int choice;
-        if (!(std::cin >> choice)) {
-            std::cin.clear();
-            std::string dummy; std::getline(std::cin, dummy);
-            continue;
-        }
-        std::cin.ignore();
+    // A key change interrupted after its commit leaves the previous generation behind
+    if (generation > 0)
+        KeyRotation::cleanup(session.store, user.username, generation - 1, locationFor(user.username, generation - 1));
 
-        if (choice == 1) {
-            std::string username, password;
-            std::cout << "Username: "; std::getline(std::cin, username);
-            std::cout << "Password: "; std::getline(std::cin, password);
+    session.blobs.open(blobDirFor(user.username, generation), key);
+    std::vector<Item> loaded;
+    session.storedDeck.open(loaded, user.username, key, &session.blobs, generation);
+    // Decks saved before the shared store are copied in on first login
+    if (generation == 0 && !session.storedDeck.exists()
+        && session.storedDeck.importFiles(itemFileFor(user.username), tagFileFor(user.username),
+            schedFileFor(user.username))) {
+        session.storedDeck.open(loaded, user.username, key, &session.blobs, generation);
+    }
+    session.storedDeck.loadTagWeights(session.tagManager);
+    session.storedDeck.loadSchedulerConfig(session.schedConfig);
+    session.journal.open(journalFileFor(user.username, generation), key);
+    session.journalReplayed = false;
+    session.forecast.rebuild(loaded);
+    session.tagManager.rebuild(loaded);
+    session.duplicates = DuplicateIndex(); // rebuilt when first asked for
+    session.items.reset(PersistentDeck::fromVector(std::move(loaded), session.items.memory()));
+}
 
-            if (auth.login(username, password)) {
-                current = auth.getCurrentUser();
-                const auto& key = auth.getSessionKey();
+// A key rotation for one user. Keys are derived on the rotation's worker
+// (prepare) and the new key is committed through auth.
+KeyRotation::Job keyChangeJob(AuthManager& auth, const std::string& username, const std::string& oldPassword,
+    const std::string& newPassword) {
+    KeyRotation::Job job;
+    job.username = username;
+    auto change = std::make_shared<AuthManager::KeyChange>();
+    job.prepare = [&auth, change, oldPassword, newPassword](KeyRotation::Job& j) {
+        if (!auth.beginKeyChange(j.username, oldPassword, newPassword, *change)) return false;
+        j.fromGeneration = change->oldGeneration;
+        j.toGeneration = change->newGeneration;
+        j.fromKey = change->oldKey;
+        j.toKey = change->newKey;
+        j.from = locationFor(j.username, j.fromGeneration);
+        j.to = locationFor(j.username, j.toGeneration);
+        return true;
+    };
+    job.commit = [&auth, change](const KeyRotation::Job&) { return auth.commitKeyChange(*change); };
+    return job;
+}
 
-                Storage::loadItems(items, itemFileFor(current->username), key);
-                Storage::loadTagWeights(tagManager, tagFileFor(current->username), key);
+void printRotation(const KeyRotation::Progress& p) {
+    std::cout << "   " << p.username << ": " << KeyRotation::stageName(p.stage);
+    if (p.stage == KeyRotation::Stage::Deck) std::cout << " " << p.done << "/" << p.total << " records";
+    std::cout << "\n";
+}
 
-                std::cout << "Login successful.\n";
-            }
-            else {
-                std::cout << "Invalid username/password.\n";
-            }
-        }
-        else if (choice == 2) {
-            std::string username, password;
-            std::cout << "Choose username: "; std::getline(std::cin, username);
-            std::cout << "Choose password: "; std::getline(std::cin, password);
-            if (username.empty() || password.empty()) { std::cout << "Empty fields.\n"; continue; }
-            if (auth.signup(username, password)) std::cout << "Signup complete.\n";
-            else std::cout << "Signup failed.\n";
-        }
-        else if (choice == 3)
-            return 0;
+// Save the current deck on a worker thread while the menu keeps editing the
+// live deck. The snapshot is taken together with a journal checkpoint, so
+// reviews applied during the save stay journaled. Only records that changed
+// are rewritten, so cold items stay cold.
+std::future<bool> saveDeck(Session& session) {
+    if (session.pendingSave.valid()) session.pendingSave.wait();
+
+    PersistentDeck snapshot;
+    {
+        auto lock = session.items.writeLock();
+        snapshot = session.items.snapshot();
+        session.journal.beginCheckpoint();
+    }
+
+    PagedDeck& storedDeck = session.storedDeck;
+    BlobStore& blobs = session.blobs;
+    ReviewJournal& journal = session.journal;
+
+    return std::async(std::launch::async, [snapshot, &storedDeck, &blobs, &journal]() {
+        std::vector<Item> all = snapshot.toVector();
+        bool ok = blobs.externalize(all) && storedDeck.save(all);
+        if (ok) blobs.collect(all);
+        journal.endCheckpoint(ok);
+        return ok;
+    });
+}
+
+void printSimulation(const RetentionSimulator::Report& r, const RetentionSimulator::Options& opts) {
+    auto pct = [](double v) { return static_cast<int>(std::round(v * 1000.0)) / 10.0; };
+    std::cout << "\n===== SIMULATION =====\n"
+        << r.seeds << " learners x " << opts.days << " days, " << opts.deckSize << " cards, "
+        << opts.newPerDay << " new/day\n"
+        << "Retention: " << pct(r.retention) << "% (learners " << pct(r.retentionMin) << "% - "
+        << pct(r.retentionMax) << "%)\n"
+        << "Recall on the last day: " << pct(r.finalRecall) << "%\n"
+        << "Workload: " << std::round(r.reviewsPerDay * 10.0) / 10.0 << " reviews/day (peak "
+        << r.peakReviewsPerDay << ")\n"
+        << "Simulated " << r.reviews << " reviews in " << std::round(r.wallSeconds * 100.0) / 100.0 << " s ("
+        << static_cast<long>(r.nsPerReview) << " ns/review)\n";
+}
+
+std::string formatBytes(std::size_t bytes) {
+    std::ostringstream oss;
+    if (bytes < 1024) oss << bytes << " B";
+    else if (bytes < 1024 * 1024) oss << std::round(bytes / 102.4) / 10.0 << " KiB";
+    else oss << std::round(bytes / (1024.0 * 102.4)) / 10.0 << " MiB";
+    return oss.str();
+}
+
+// Current / peak bytes per category for the deck and the whole process
+void printMemory(const MemoryAccount& deck) {
+    const MemoryAccount& process = *MemoryAccount::process();
+    auto row = [](const std::string& name, MemoryAccount::Usage d, MemoryAccount::Usage p) {
+        std::cout << "   " << name << ": deck " << formatBytes(d.current) << " (peak " << formatBytes(d.peak)
+            << ") | process " << formatBytes(p.current) << " (peak " << formatBytes(p.peak) << ")\n";
+    };
+
+    std::cout << "\nMemory:\n";
+    for (int c = 0; c < static_cast<int>(MemoryCategory::Count); ++c) {
+        auto cat = static_cast<MemoryCategory>(c);
+        row(MemoryAccount::categoryName(cat), deck.usage(cat), process.usage(cat));
     }
+    row("total", deck.total(), process.total());
+}
 
-    // Scheduler (requires tagManager)
-    Scheduler scheduler(&tagManager);
+void printPipelineMetrics(const ReviewPipeline::Metrics& m) {
+    std::cout << "\nReview pipeline:\n"
+        << "   Submitted: " << m.submitted << " | applied: " << m.applied << " | rejected: " << m.rejected << "\n"
+        << "   Batches: " << m.batches << " | largest: " << m.largestBatch << " | queue depth: " << m.depth << "\n"
+        << "   Throughput: " << static_cast<long>(m.appliedPerSecond) << " reviews/s\n";
+}
+
+// Reviews made after the last save, applied without journaling them again;
+// once per login
+void replayJournal(Session& session, const ReviewPipeline::ApplyFn& apply, const ReviewPipeline::LoadFn& load,
+    std::ostream& out) {
+    if (session.journalReplayed) return;
+    std::vector<ReviewEvent> events;
+    if (session.journal.readAll(events) && !events.empty()) {
+        ReviewPipeline replay(session.items, apply, load);
+        for (auto& ev : events) replay.submit(std::move(ev));
+        replay.stop();
+        out << "Restored " << replay.metrics().applied << " unsaved review(s).\n";
+    }
+    session.journalReplayed = true;
+}
+
+enum class MenuExit {
+    Quit,
+    SwitchScheduler,
+    Restart // the deck was reopened; run the menu again with a fresh pipeline
+};
+
+// Main menu for one scheduler instantiation. Changing the algorithm returns
+// SwitchScheduler so main() can re-dispatch to the other instantiation.
+template <class Policy>
+MenuExit runMainMenu(Session& session) {
+    auto& auth = session.auth;
+    auto& items = session.items;
+    auto& storedDeck = session.storedDeck;
+    auto& journal = session.journal;
+    auto& tagManager = session.tagManager;
+    auto& schedConfig = session.schedConfig;
+    auto& forecast = session.forecast;
+    auto& stats = session.stats;
+    auto& duplicates = session.duplicates;
+    User* current = session.current;
+
+    // Scheduler (requires tagManager and the user's scheduler config)
+    BasicScheduler<Policy> scheduler(&tagManager, &schedConfig, &forecast, &stats);
+    const SchedulerAlgorithm running = schedConfig.algorithm;
+
+    auto applyReview = [&](Item& it, ReviewQuality q, std::time_t t) { scheduler.review(it, q, t); };
+    auto loadItem = [&](Item& it) { return storedDeck.ensureLoaded(it); };
+
+    replayJournal(session, applyReview, loadItem, std::cout);
+
+    // Every review goes through the applier thread and is journaled before its future completes
+    ReviewPipeline pipeline(items, applyReview, loadItem,
+        [&](const std::vector<ReviewEvent>& batch) { return journal.append(batch); });
+
+    // Today's bounded session; picks a batch at a time instead of sorting the whole backlog
+    ReviewSession reviewSession(scheduler);
 
     // MAIN LOOP
     while (true) {
+        if (session.pendingSave.valid()
+            && session.pendingSave.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+            std::cout << (session.pendingSave.get() ? "Background save finished.\n" : "Background save FAILED.\n");
+
         std::cout << "\n===== MAIN MENU =====\n"
             "User: " << current->username << "\n"
             "1. Add Item\n"
             "2. Review Due Items\n"
             "3. List All Items\n"
             "4. Tag Management\n"
-            "5. Save & Exit\n> ";
+            "5. Scheduler Settings\n"
+            "6. Delete Item\n"
+            "7. Review Forecast\n"
+            "8. Statistics\n"
+            "9. Save & Exit\n"
+            "10. Undo Last Change\n"
+            "11. Save (keep working)\n"
+            "12. Memory usage\n"
+            "13. Change password\n"
+            "14. Sync with another copy\n"
+            "15. Find duplicates\n> ";
 
         int choice;
         if (!(std::cin >> choice)) {
@@ -216,39 +617,69 @@ int main() {
 
             Item it(title, content);
             it.setTags(splitTagsLine(tags_line));
-            items.push_back(it);
+            auto tx = items.edit("Add '" + title + "'");
+            forecast.add(it.next_review);
+            stats.addItem(it);
+            tagManager.addItem(it);
+            duplicates.addItem(it);
+            tx.add(std::move(it));
 
             std::cout << "Item added.\n";
         }
 
         else if (choice == 2) {
-            auto due = scheduler.getDueItems(items);
-            if (due.empty()) { std::cout << "No items due.\n"; continue; }
+            ReviewSession::Card card;
+            int reviewed = 0;
+            while (reviewSession.next(items, card)) {
+                // The card may have moved since it was queued; skip it only if it is gone
+                auto queued = items.get(card.handle);
+                if (!queued) continue;
 
-            for (auto* item : due) {
-                std::cout << "\nReviewing: " << item->title << "\nContent: " << item->content << "\nTags: ";
+                if (!warmItem(items, storedDeck, card.handle)) { std::cout << "Could not decrypt '" << queued->title << "'.\n"; continue; }
+                Item item = *items.get(card.handle);
+                if (card.isNew) std::cout << "\n[new]";
+                std::cout << "\nReviewing: " << item.title << "\nContent: " << item.content << "\nTags: ";
 
-                if (item->tags.empty()) std::cout << "(none)";
+                if (item.tags.empty()) std::cout << "(none)";
                 else {
-                    for (size_t j = 0; j < item->tags.size(); ++j) {
+                    for (size_t j = 0; j < item.tags.size(); ++j) {
                         if (j) std::cout << ", ";
-                        std::cout << item->tags[j];
+                        std::cout << item.tags[j];
                     }
                 }
                 std::cout << "\n";
 
                 int q = askQuality();
-                scheduler.review(*item, static_cast<ReviewQuality>(q - 1));
-
-                if (q == 1) item->streak = 0;
-                else { item->review_count++; item->streak++; }
+                if (q == 0) { reviewSession.putBack(card); break; }
+                ++reviewed;
+                ReviewOutcome done = pipeline.submit({ item.id, static_cast<ReviewQuality>(q - 1), std::time(nullptr) }).get();
 
-                std::cout << "Updated.\n";
+                if (!done.applied) std::cout << "Review was not applied.\n";
+                else if (!done.persisted) std::cout << "Updated, but the review could not be journaled.\n";
+                else std::cout << "Updated.\n";
             }
+
+            if (reviewed == 0 && reviewSession.queued() == 0) std::cout << "No items due.\n";
+            std::cout << "Left today: " << reviewSession.reviewsLeft() << " reviews, "
+                << reviewSession.newLeft() << " new.\n";
         }
 
         else if (choice == 3) {
-            listAllItems(items);
+            DeckQuery::Filter filter;
+            DeckQuery::Order order = DeckQuery::Order::Position;
+            bool descending = false;
+            std::cout << "Filter (Enter for all; e.g. tag:geo due:7 ease:1.3-2 lapses:2- text:paris sort:due desc): ";
+            std::string spec; std::getline(std::cin, spec);
+            if (!parseQuery(spec, filter, order, descending)) { std::cout << "Invalid filter.\n"; continue; }
+            // Content is only searched once decrypted
+            if (!filter.text.empty()) warmAll(items, storedDeck);
+
+            DeckQuery query(items.snapshot(), filter, order, descending);
+            std::cout << query.count() << " matching item(s).";
+            browse(query, "ITEMS", [&](std::size_t idx) {
+                if (warmItem(items, storedDeck, idx)) printItem(idx, items.snapshot()[idx]);
+                return false;
+            });
         }
 
         else if (choice == 4) {
@@ -263,7 +694,8 @@ int main() {
                     "6. Set tag weight\n"
                     "7. Remove tag weight\n"
                     "8. List tag weights\n"
-                    "9. Back\n> ";
+                    "9. Rename/move tag subtree\n"
+                    "10. Back\n> ";
 
                 int t;
                 if (!(std::cin >> t)) {
@@ -273,61 +705,113 @@ int main() {
                 std::cin.ignore();
 
                 if (t == 1) {
-                    int idx = chooseItemIndex(items); if (idx < 0) continue;
+                    auto h = chooseItem(items); if (!h.valid()) continue;
                     std::cout << "Enter new tags: ";
                     std::string line; std::getline(std::cin, line);
-                    items[idx].setTags(splitTagsLine(line));
+                    if (!warmItem(items, storedDeck, h)) continue;
+                    auto tx = items.edit("");
+                    Item it = *items.get(h);
+                    tx.describe("Set tags on '" + it.title + "'");
+                    stats.removeItem(it);
+                    tagManager.removeItem(it);
+                    it.setTags(splitTagsLine(line));
+                    stats.addItem(it);
+                    tagManager.addItem(it);
+                    tx.set(h, std::move(it));
                 }
 
                 else if (t == 2) {
-                    int idx = chooseItemIndex(items); if (idx < 0) continue;
-                    std::cout << "Enter tag to remove: ";
-                    std::string tag; std::getline(std::cin, tag);
-                    if (!items[idx].removeTag(tag)) std::cout << "Not found.\n";
+                    auto h = chooseItem(items); if (!h.valid()) continue;
+                    std::string tag = readTag("Enter tag to remove: ");
+                    if (!warmItem(items, storedDeck, h)) continue;
+                    auto tx = items.edit("");
+                    Item it = *items.get(h);
+                    if (!it.hasTag(tag)) { std::cout << "Not found.\n"; continue; }
+                    tx.describe("Remove tag '" + tag + "' from '" + it.title + "'");
+                    stats.removeItem(it);
+                    tagManager.removeItem(it);
+                    it.removeTag(tag);
+                    stats.addItem(it);
+                    tagManager.addItem(it);
+                    tx.set(h, std::move(it));
                 }
 
                 else if (t == 3) {
-                    auto all = gatherAllTags(items);
+                    auto all = gatherAllTags(items.snapshot());
                     if (all.empty()) { std::cout << "No tags.\n"; continue; }
-                    std::cout << "Enter tag to remove globally: ";
-                    std::string tg; std::getline(std::cin, tg);
+                    std::string tg = readTag("Enter tag to remove globally: ");
                     int cnt = 0;
-                    for (auto& it : items) if (it.removeTag(tg)) cnt++;
+                    auto tx = items.edit("Delete tag '" + tg + "'");
+                    std::vector<DeckHistory::Handle> tagged;
+                    items.forEachHandle([&](DeckHistory::Handle h, const PersistentDeck::ItemPtr& it) {
+                        if (it->hasTag(tg)) tagged.push_back(h);
+                    });
+                    for (auto h : tagged) {
+                        if (!warmItem(items, storedDeck, h)) continue;
+                        Item it = *items.get(h);
+                        stats.removeItem(it);
+                        tagManager.removeItem(it);
+                        it.removeTag(tg);
+                        stats.addItem(it);
+                        tagManager.addItem(it);
+                        tx.set(h, std::move(it));
+                        cnt++;
+                    }
                     std::cout << "Removed from " << cnt << " item(s).\n";
                 }
 
                 else if (t == 4) {
-                    auto all = gatherAllTags(items);
+                    auto all = gatherAllTags(items.snapshot());
                     if (all.empty()) { std::cout << "No tags.\n"; continue; }
-                    std::cout << "Enter tag: ";
-                    std::string tag; std::getline(std::cin, tag);
-
-                    std::vector<Item> filtered;
-                    for (auto& it : items) if (it.hasTag(tag)) filtered.push_back(it);
-
-                    listAllItems(filtered);
+                    DeckQuery::Filter filter;
+                    filter.tag = readTag("Enter tag (includes tags below it): ");
+                    if (filter.tag.empty()) { std::cout << "Invalid tag.\n"; continue; }
+                    browse(DeckQuery(items.snapshot(), filter), ("TAG " + filter.tag).c_str(), [&](std::size_t idx) {
+                        if (warmItem(items, storedDeck, idx)) printItem(idx, items.snapshot()[idx]);
+                        return false;
+                    });
                 }
 
                 else if (t == 5) {
-                    auto all = gatherAllTags(items);
-                    if (all.empty()) std::cout << "No tags.\n";
-                    else {
-                        for (auto& t : all) std::cout << "- " << t << "\n";
+                    std::vector<TagTrie::Entry> tree;
+                    {
+                        auto lock = items.writeLock();
+                        tree = tagManager.tagsUnder();
+                    }
+                    if (tree.empty()) std::cout << "No tags.\n";
+                    for (const auto& e : tree) {
+                        std::cout << std::string(2 * e.depth, ' ') << "- " << TagTrie::split(e.tag).back()
+                            << " (" << e.items;
+                        if (e.subtree != e.items) std::cout << ", " << e.subtree << " in subtree";
+                        std::cout << ")";
+                        if (e.resolved != 1) std::cout << " weight " << e.resolved << (e.weight ? "" : " (inherited)");
+                        std::cout << "\n";
                     }
                 }
 
                 else if (t == 6) { // set tag weight
-                    std::cout << "Enter tag: ";
-                    std::string tag; std::getline(std::cin, tag);
+                    std::string tag = readTag("Enter tag: ");
                     std::cout << "Enter weight (>=1): ";
-                    int w; std::cin >> w; std::cin.ignore();
-                    tagManager.setWeight(tag, w);
+                    int w;
+                    if (!(std::cin >> w) || w < 1) {
+                        std::cin.clear();
+                        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+                        std::cout << "Invalid weight.\n";
+                    }
+                    else {
+                        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+                        // Reviews read the weights on the applier thread
+                        auto lock = items.writeLock();
+                        tagManager.setWeight(tag, w);
+                        std::cout << "Re-scheduled " << scheduler.rescheduleTag(items, tag) << " item(s).\n";
+                    }
                 }
 
                 else if (t == 7) {
-                    std::cout << "Enter tag: ";
-                    std::string tag; std::getline(std::cin, tag);
+                    std::string tag = readTag("Enter tag: ");
+                    auto lock = items.writeLock();
                     tagManager.removeWeight(tag);
+                    std::cout << "Re-scheduled " << scheduler.rescheduleTag(items, tag) << " item(s).\n";
                 }
 
                 else if (t == 8) {
@@ -336,7 +820,61 @@ int main() {
                         std::cout << p.first << " : " << p.second << "\n";
                 }
 
-                else if (t == 9)
+                else if (t == 9) {
+                    std::string from = readTag("Move tag (with everything below it): ");
+                    std::string to = readTag("To: ");
+
+                    auto tx = items.edit("Move tag '" + from + "' to '" + to + "'");
+
+                    // Every item carrying a moved tag must be readable before anything moves
+                    std::vector<DeckHistory::Handle> affected;
+                    bool loaded = true;
+                    for (const auto& id : tagManager.itemsUnder(from)) {
+                        auto h = items.handleOf(id);
+                        auto cur = items.get(h);
+                        if (!cur) continue;
+                        if (!warmItem(items, storedDeck, h)) {
+                            std::cout << "Could not decrypt '" << cur->title << "'; nothing moved.\n";
+                            loaded = false;
+                            break;
+                        }
+                        affected.push_back(h);
+                    }
+                    if (!loaded) continue;
+
+                    // Weights and the trie move first, then the items follow. Undo
+                    // restores the items (and so the trie) and, through the hook,
+                    // the weights on both sides of the move.
+                    auto weightsFrom = tagManager.weightsUnder(from);
+                    auto weightsTo = tagManager.weightsUnder(to);
+                    std::vector<std::pair<std::string, std::string>> renamed;
+                    if (!tagManager.renameSubtree(from, to, renamed)) {
+                        std::cout << "Cannot move '" << from << "' to '" << to << "'.\n";
+                        continue;
+                    }
+                    tx.onUndo([&tagManager, from, to, weightsFrom, weightsTo] {
+                        tagManager.restoreWeightsUnder(to, weightsTo);
+                        tagManager.restoreWeightsUnder(from, weightsFrom);
+                    });
+
+                    int cnt = 0;
+                    for (auto h : affected) {
+                        Item it = *items.get(h);
+                        std::vector<std::string> tags;
+                        for (const auto& tg : it.tags)
+                            tags.push_back(TagTrie::isUnder(tg, from) ? TagTrie::rebase(tg, from, to) : tg);
+
+                        // The trie already holds the new names, so only the stats follow the item
+                        stats.removeItem(it);
+                        it.setTags(tags);
+                        stats.addItem(it);
+                        tx.set(h, std::move(it));
+                        cnt++;
+                    }
+                    std::cout << "Moved " << renamed.size() << " tag(s) on " << cnt << " item(s).\n";
+                }
+
+                else if (t == 10)
                     break;
 
                 else std::cout << "Invalid.\n";
@@ -344,20 +882,841 @@ int main() {
         }
 
         else if (choice == 5) {
-            const auto& key = auth.getSessionKey();
+            // SCHEDULER SETTINGS SUBMENU
+            while (true) {
+                std::cout << "\n=== SCHEDULER SETTINGS ===\n"
+                    "Algorithm: " << SchedulerConfig::algorithmName(schedConfig.algorithm) << "\n"
+                    "Daily limits: " << schedConfig.newPerDay << " new, " << schedConfig.reviewsPerDay << " reviews"
+                    << (schedConfig.interleave ? ", interleaved" : "") << "\n"
+                    "1. Use SM-2\n"
+                    "2. Use FSRS\n"
+                    "3. Set FSRS desired retention\n"
+                    "4. Optimize FSRS parameters from history\n"
+                    "5. Reset FSRS parameters to defaults\n"
+                    "6. Set daily limits\n"
+                    "7. Set tag quota\n"
+                    "8. Toggle interleaving\n"
+                    "9. Simulate retention with these settings\n"
+                    "10. Back\n> ";
+
+                int t;
+                if (!(std::cin >> t)) {
+                    std::cin.clear(); std::string dummy; std::getline(std::cin, dummy);
+                    continue;
+                }
+                std::cin.ignore();
+
+                if (t == 1) schedConfig.algorithm = SchedulerAlgorithm::SM2;
+
+                else if (t == 2) schedConfig.algorithm = SchedulerAlgorithm::FSRS;
+
+                else if (t == 3) {
+                    std::cout << "Enter desired retention (0.70 - 0.97): ";
+                    double r;
+                    if (!(std::cin >> r) || r < 0.7 || r > 0.97) {
+                        std::cin.clear();
+                        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+                        std::cout << "Invalid retention.\n";
+                        continue;
+                    }
+                    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+                    schedConfig.desiredRetention = r;
+                }
+
+                else if (t == 4) {
+                    warmAll(items, storedDeck);
+                    auto data = FSRSOptimizer::buildTrainingSet(items.snapshot().toVector());
+                    if (data.cardCount() == 0) {
+                        std::cout << "Not enough review history (need items with 2+ reviews).\n";
+                        continue;
+                    }
+                    std::cout << "Fitting on " << data.reviewCount() << " reviews from "
+                        << data.cardCount() << " items...\n";
+
+                    auto res = FSRSOptimizer::fit(data, schedConfig.fsrsWeights);
+                    schedConfig.fsrsWeights = res.weights;
+
+                    std::cout << "Log loss: " << res.initialLoss << " -> " << res.finalLoss
+                        << " (" << res.iterations << " iterations)\n";
+                }
+
+                else if (t == 5) schedConfig.fsrsWeights = fsrs::DEFAULT_WEIGHTS;
+
+                else if (t == 6) {
+                    int n, r;
+                    std::cout << "New cards per day: ";
+                    bool ok = static_cast<bool>(std::cin >> n);
+                    if (ok) { std::cout << "Reviews per day: "; ok = static_cast<bool>(std::cin >> r); }
+                    if (!ok || n < 0 || r < 0) {
+                        std::cin.clear();
+                        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+                        std::cout << "Invalid limits.\n";
+                        continue;
+                    }
+                    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+                    schedConfig.newPerDay = n;
+                    schedConfig.reviewsPerDay = r;
+                }
+
+                else if (t == 7) {
+                    std::string tag;
+                    std::cout << "Tag: "; std::getline(std::cin, tag);
+                    if (tag.empty()) { std::cout << "Invalid.\n"; continue; }
+                    std::cout << "Most cards per day with this tag (0 = no quota): ";
+                    int n;
+                    if (!(std::cin >> n) || n < 0) {
+                        std::cin.clear();
+                        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+                        std::cout << "Invalid number.\n";
+                        continue;
+                    }
+                    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+                    if (n == 0) schedConfig.tagQuotas.erase(tag);
+                    else schedConfig.tagQuotas[tag] = n;
+                }
+
+                else if (t == 8) schedConfig.interleave = !schedConfig.interleave;
+
+                else if (t == 9) {
+                    RetentionSimulator::Options opts;
+                    std::cout << "Days to simulate (e.g. 365): ";
+                    if (!(std::cin >> opts.days) || opts.days < 1) {
+                        std::cin.clear();
+                        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+                        std::cout << "Invalid number of days.\n";
+                        continue;
+                    }
+                    std::cout << "Simulated learners (e.g. 16): ";
+                    if (!(std::cin >> opts.seeds) || opts.seeds < 1) {
+                        std::cin.clear();
+                        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+                        std::cout << "Invalid number of learners.\n";
+                        continue;
+                    }
+                    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+
+                    printSimulation(RetentionSimulator::run(schedConfig, opts), opts);
+                }
+
+                else if (t == 10)
+                    break;
+
+                else std::cout << "Invalid.\n";
+            }
+
+            if (schedConfig.algorithm != running) {
+                std::cout << "Switched to " << SchedulerConfig::algorithmName(schedConfig.algorithm) << ".\n";
+                return MenuExit::SwitchScheduler;
+            }
+        }
+
+        else if (choice == 6) {
+            auto h = chooseItem(items); if (!h.valid()) continue;
+            if (!warmItem(items, storedDeck, h)) continue;
+            auto tx = items.edit("");
+            auto it = items.get(h);
+            tx.describe("Delete '" + it->title + "'");
+            forecast.remove(it->next_review);
+            stats.removeItem(*it);
+            tagManager.removeItem(*it);
+            duplicates.removeItem(*it);
+            std::cout << "Deleted '" << it->title << "'.\n";
+            tx.erase(h);
+        }
 
-            if (!Storage::saveItems(items, itemFileFor(current->username), key))
+        else if (choice == 7) {
+            std::cout << "Days to forecast (e.g. 30): ";
+            int days;
+            if (!(std::cin >> days) || days < 1) {
+                std::cin.clear();
+                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+                std::cout << "Invalid number of days.\n";
+                continue;
+            }
+            std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            auto lock = items.writeLock(); // the applier updates the forecast
+            printForecast(forecast.dueCounts(std::time(nullptr), days));
+        }
+
+        else if (choice == 8) {
+            // Stats need every review, so they are the first thing to force the whole deck
+            if (!stats.isReady()) warmAll(items, storedDeck);
+            {
+                auto lock = items.writeLock();
+                if (!stats.isReady()) stats.rebuild(items.snapshot());
+                printStats(stats);
+            }
+            printPipelineMetrics(pipeline.metrics());
+            printMemory(*items.memory());
+        }
+
+        else if (choice == 9) {
+            // Everything queued is applied and journaled before the final save
+            pipeline.stop();
+            if (!saveDeck(session).get())
                 std::cout << "Error saving items.\n";
 
-            if (!Storage::saveTagWeights(tagManager, tagFileFor(current->username), key))
+            if (!storedDeck.saveTagWeights(tagManager))
                 std::cout << "Error saving tag weights.\n";
 
+            if (!storedDeck.saveSchedulerConfig(schedConfig))
+                std::cout << "Error saving scheduler settings.\n";
+
             auth.save();
             auth.logout();
             std::cout << "Goodbye!\n";
-            break;
+            return MenuExit::Quit;
+        }
+
+        else if (choice == 10) {
+            std::string label;
+            std::vector<DeckHistory::Edit> reverted;
+            {
+                auto lock = items.writeLock();
+                if (!items.undo(label, reverted)) { std::cout << "Nothing to undo.\n"; continue; }
+
+                // Move derived state from the undone items back to the restored ones
+                for (const auto& e : reverted) {
+                    if (e.after) {
+                        forecast.remove(e.after->next_review);
+                        stats.removeItem(*e.after);
+                        tagManager.removeItem(*e.after);
+                        duplicates.removeItem(*e.after);
+                    }
+                    if (e.before) {
+                        forecast.add(e.before->next_review);
+                        stats.addItem(*e.before);
+                        tagManager.addItem(*e.before);
+                        duplicates.addItem(*e.before);
+                    }
+                }
+            }
+            std::cout << "Undid: " << label << "\n";
+
+            // An undone review is still in the journal; saving now retires it so it is never replayed
+            session.pendingSave = saveDeck(session);
+        }
+
+        else if (choice == 11) {
+            session.pendingSave = saveDeck(session);
+            if (!storedDeck.saveTagWeights(tagManager))
+                std::cout << "Error saving tag weights.\n";
+            if (!storedDeck.saveSchedulerConfig(schedConfig))
+                std::cout << "Error saving scheduler settings.\n";
+            std::cout << "Saving in the background.\n";
+        }
+
+        else if (choice == 12) {
+            printMemory(*items.memory());
+        }
+
+        else if (choice == 13) {
+            std::string oldPassword, newPassword, repeat;
+            std::cout << "Current password: "; std::getline(std::cin, oldPassword);
+            std::cout << "New password: "; std::getline(std::cin, newPassword);
+            std::cout << "Repeat new password: "; std::getline(std::cin, repeat);
+            if (newPassword.empty() || newPassword != repeat) {
+                std::cout << "Passwords do not match.\n";
+                continue;
+            }
+
+            // The store is what gets re-encrypted, so everything goes into it under the old key first
+            pipeline.stop();
+            if (!saveDeck(session).get() || !storedDeck.saveTagWeights(tagManager)
+                || !storedDeck.saveSchedulerConfig(schedConfig)) {
+                std::cout << "Could not save the deck; password unchanged.\n";
+                return MenuExit::Restart;
+            }
+
+            KeyRotation::Job job = keyChangeJob(auth, current->username, oldPassword, newPassword);
+            if (!KeyRotation::rotate(session.store, job, printRotation)) {
+                std::cout << "Password unchanged.\n";
+                return MenuExit::Restart;
+            }
+
+            openDeck(session);
+            std::cout << "Password changed.\n";
+            return MenuExit::Restart;
+        }
+
+        else if (choice == 14) {
+            std::string folder, passphrase;
+            std::cout << "Sync folder (shared by every copy of this deck): "; std::getline(std::cin, folder);
+            std::cout << "Sync passphrase (the same on every copy): "; std::getline(std::cin, passphrase);
+            std::vector<unsigned char> folderKey;
+            if (folder.empty() || passphrase.empty() || !DeckSync::folderKey(folder, passphrase, folderKey)) {
+                std::cout << "Cannot use that sync folder.\n";
+                continue;
+            }
+
+            // The sync reads and merges what is in the store
+            pipeline.stop();
+            if (!saveDeck(session).get() || !storedDeck.saveTagWeights(tagManager)
+                || !storedDeck.saveSchedulerConfig(schedConfig)) {
+                std::cout << "Could not save the deck; nothing synced.\n";
+                return MenuExit::Restart;
+            }
+
+            DeckSync::Result result;
+            bool ok = DeckSync::sync(session.store, current->username, current->key_generation, auth.getSessionKey(),
+                &session.blobs, schedConfig, folder, folderKey, result);
+            sodium_memzero(folderKey.data(), folderKey.size());
+            openDeck(session);
+            if (ok) {
+                std::cout << "Merged " << result.received << " changes from " << result.peers << " other copies ("
+                    << result.changed << " items updated); sent " << result.sent << " ("
+                    << formatBytes(result.deltaBytes) << ").\n";
+            }
+            else {
+                std::cout << "Sync failed; see the log.\n";
+            }
+            return MenuExit::Restart;
+        }
+
+        else if (choice == 15) {
+            // Signatures need content, so like stats the index forces the whole deck once
+            if (!duplicates.isReady()) {
+                warmAll(items, storedDeck);
+                auto lock = items.writeLock();
+                if (!duplicates.isReady()) duplicates.rebuild(items.snapshot());
+            }
+
+            std::cout << "\n=== DUPLICATES ===\n"
+                "1. Cards similar to one card\n"
+                "2. Duplicate report\n"
+                "3. Merge all duplicates\n"
+                "4. Back\n> ";
+            int sub;
+            if (!(std::cin >> sub)) {
+                std::cin.clear(); std::string dummy; std::getline(std::cin, dummy);
+                continue;
+            }
+            std::cin.ignore();
+            if (sub < 1 || sub > 3) continue;
+
+            double threshold = DuplicateIndex::DEFAULT_THRESHOLD;
+            std::string line;
+            std::cout << "Similarity threshold in % [" << static_cast<int>(threshold * 100) << "]: ";
+            std::getline(std::cin, line);
+            if (!line.empty()) {
+                try { threshold = std::clamp(std::stod(line) / 100.0, 0.0, 1.0); }
+                catch (...) { std::cout << "Invalid threshold.\n"; continue; }
+            }
+
+            if (sub == 1) {
+                int idx = chooseItemIndex(items.snapshot()); if (idx < 0) continue;
+                if (!warmItem(items, storedDeck, idx)) continue;
+                std::vector<DuplicateIndex::Match> matches;
+                {
+                    auto lock = items.writeLock();
+                    matches = duplicates.similarTo(items.snapshot()[idx], threshold);
+                }
+                if (matches.empty()) std::cout << "No similar cards.\n";
+                for (const auto& m : matches) {
+                    std::size_t i = 0;
+                    if (!items.indexOf(m.id, i)) continue;
+                    std::cout << "   " << static_cast<int>(std::round(m.similarity * 100)) << "%  " << (i + 1)
+                        << ". " << items.snapshot()[i].title << "\n";
+                }
+                continue;
+            }
+
+            std::vector<std::vector<std::string>> groups;
+            {
+                auto lock = items.writeLock();
+                groups = duplicates.duplicateGroups(threshold);
+            }
+            if (groups.empty()) { std::cout << "No duplicates found.\n"; continue; }
+
+            if (sub == 2) {
+                std::size_t cards = 0;
+                for (std::size_t g = 0; g < groups.size(); ++g) {
+                    std::cout << "Group " << (g + 1) << ":\n";
+                    for (const auto& id : groups[g]) {
+                        std::size_t i = 0;
+                        if (!items.indexOf(id, i)) continue;
+                        std::cout << "   " << (i + 1) << ". " << items.snapshot()[i].title << "\n";
+                    }
+                    cards += groups[g].size();
+                }
+                std::cout << groups.size() << " groups, " << cards << " cards.\n";
+                continue;
+            }
+
+            std::cout << "Merge " << groups.size() << " groups into their oldest card, combining tags and review "
+                "histories? (y/n): ";
+            std::getline(std::cin, line);
+            if (line != "y" && line != "Y") continue;
+
+            // The oldest card of each group stays; one undo step reverts the lot
+            auto tx = items.edit("Merge " + std::to_string(groups.size()) + " duplicate groups");
+            std::size_t merged = 0;
+            for (const auto& group : groups) {
+                std::vector<Item> cards;
+                std::vector<DeckHistory::Handle> handles;
+                bool loaded = true;
+                for (const auto& id : group) {
+                    auto h = items.handleOf(id);
+                    if (auto cur = items.get(h)) {
+                        cards.push_back(*cur);
+                        handles.push_back(h);
+                        loaded = loaded && storedDeck.ensureLoaded(cards.back());
+                    }
+                }
+                if (cards.size() < 2) continue;
+                if (!loaded) { std::cout << "Could not decrypt a card; group skipped.\n"; continue; }
+
+                Item survivor = DuplicateIndex::merge(cards, schedConfig);
+                for (const auto& c : cards) {
+                    forecast.remove(c.next_review);
+                    stats.removeItem(c);
+                    tagManager.removeItem(c);
+                    duplicates.removeItem(c);
+                }
+                forecast.add(survivor.next_review);
+                stats.addItem(survivor);
+                tagManager.addItem(survivor);
+                duplicates.addItem(survivor);
+                tx.set(handles[0], std::move(survivor));
+                for (std::size_t c = 1; c < handles.size(); ++c) tx.erase(handles[c]);
+                merged += cards.size() - 1;
+            }
+            std::cout << "Merged " << merged << " duplicate cards.\n";
         }
     }
 
+}
+
+// "--calibrate [target-ms] [concurrent-logins]": size Argon2id for this host
+// and make it the policy for new passwords
+int calibratePasswords(AuthManager& auth, int argc, char* argv[]) {
+    PasswordPolicy::Options options;
+    try {
+        if (argc > 2) options.targetMs = std::stod(argv[2]);
+        if (argc > 3) options.concurrency = std::stoi(argv[3]);
+    }
+    catch (...) {
+        std::cerr << "Usage: cli --calibrate [target-ms] [concurrent-logins]\n";
+        return 1;
+    }
+    if (options.targetMs <= 0.0 || options.concurrency < 1) {
+        std::cerr << "The target and the number of logins must be positive.\n";
+        return 1;
+    }
+
+    std::cout << "Measuring Argon2id for " << options.targetMs << " ms with " << options.concurrency
+        << " concurrent login(s)...\n";
+    PasswordPolicy::Report report;
+    PasswordPolicy policy = PasswordPolicy::calibrate(options, &report);
+
+    std::cout << "Chosen cost: " << policy.opslimit << " pass(es) over " << policy.memlimit / (1024 * 1024)
+        << " MiB, " << report.measuredMs << " ms measured";
+    if (!report.metTarget) std::cout << " (over target: this is the minimum cost allowed)";
+    std::cout << "\n";
+
+    if (policy == auth.getPolicy()) {
+        std::cout << "Policy unchanged.\n";
+        return 0;
+    }
+    if (!auth.setPolicy(policy)) {
+        std::cerr << "Failed to save the password policy.\n";
+        return 1;
+    }
+    std::cout << "Policy saved; existing passwords are rehashed at their next login.\n";
+    return 0;
+}
+
+// "--rotate-keys <file> [threads]": re-encrypt many users' data under new keys
+// in parallel. Each line of the file is "username<TAB>password", which keeps
+// the password and rotates only the key, or "username<TAB>password<TAB>new password".
+int rotateKeys(AuthManager& auth, PagedStore& store, int argc, char* argv[]) {
+    std::size_t threads = 0;
+    try {
+        if (argc > 3) threads = static_cast<std::size_t>(std::stoul(argv[3]));
+    }
+    catch (...) {
+        argc = 0;
+    }
+    std::ifstream in(argc > 2 ? argv[2] : "");
+    if (!in) {
+        std::cerr << "Usage: cli --rotate-keys <file> [threads]\n";
+        return 1;
+    }
+
+    std::vector<KeyRotation::Job> jobs;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        std::vector<std::string> fields;
+        std::istringstream fss(line);
+        std::string field;
+        while (std::getline(fss, field, '\t')) fields.push_back(field);
+        if (fields.size() < 2 || fields[0].empty()) continue;
+        jobs.push_back(keyChangeJob(auth, fields[0], fields[1], fields.size() > 2 ? fields[2] : fields[1]));
+    }
+    sodium_memzero(&line[0], line.size());
+
+    std::cout << "Rotating keys of " << jobs.size() << " user(s)...\n";
+    std::mutex printLock;
+    auto result = KeyRotation::rotateAll(store, jobs, threads, [&](const KeyRotation::Progress& p) {
+        std::lock_guard<std::mutex> guard(printLock);
+        printRotation(p);
+    });
+
+    std::cout << "Rotated " << result.rotated << " of " << jobs.size() << " in "
+        << std::round(result.seconds * 100.0) / 100.0 << " s\n";
+    for (const auto& name : result.failed) std::cout << "   FAILED: " << name << "\n";
+    return result.failed.empty() ? 0 : 1;
+}
+
+// Items named in batch commands. IDs go straight to the deck's index;
+// titles map to the handle of the first item with that title.
+struct BatchNames {
+    std::unordered_map<std::string, DeckHistory::Handle> byTitle;
+    bool built = false;
+
+    void rebuild(const DeckHistory& items) {
+        byTitle.clear();
+        items.snapshot().forEach([&](const Item& it) { byTitle.emplace(it.title, items.handleOf(it.id)); });
+        built = true;
+    }
+
+    void added(const DeckHistory& items, const std::string& title, const std::string& id) {
+        if (built) byTitle.emplace(title, items.handleOf(id));
+    }
+
+    // The item given by ID, or by title if no ID matches; invalid if there is none
+    DeckHistory::Handle find(const DeckHistory& items, const std::string& ref) {
+        DeckHistory::Handle h = items.handleOf(ref);
+        if (h.valid()) return h;
+        if (!built) rebuild(items);
+        auto t = byTitle.find(ref);
+        // The first item with the title may have been deleted since
+        if (t != byTitle.end() && !items.get(t->second)) {
+            rebuild(items);
+            t = byTitle.find(ref);
+        }
+        return t != byTitle.end() && items.get(t->second) ? t->second : DeckHistory::Handle();
+    }
+};
+
+// "again", "hard", "good", "easy" or 1..4 as in the review menu
+bool parseQuality(const std::string& text, ReviewQuality& q) {
+    static const char* const NAMES[REVIEW_QUALITY_COUNT] = { "again", "hard", "good", "easy" };
+    for (std::size_t i = 0; i < REVIEW_QUALITY_COUNT; ++i) {
+        if (text == NAMES[i] || text == std::to_string(i + 1)) {
+            q = static_cast<ReviewQuality>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+static const std::size_t BATCH_PAGE_SIZE = 1000;
+
+void printBatchRow(std::ostream& out, const Item& it) {
+    out << it.id << '\t' << it.title << '\t' << it.next_review << '\t' << it.tagsAsLine() << '\n';
+}
+
+// Runs one script for the logged-in user. Errors go to stderr with their
+// line number and do not stop the script.
+template <class Policy>
+int runScript(Session& session, std::istream& in) {
+    auto& items = session.items;
+    auto& storedDeck = session.storedDeck;
+    auto& tagManager = session.tagManager;
+    auto& forecast = session.forecast;
+    auto& stats = session.stats;
+    auto& duplicates = session.duplicates;
+
+    BasicScheduler<Policy> scheduler(&tagManager, &session.schedConfig, &forecast, &stats);
+    auto applyReview = [&](Item& it, ReviewQuality q, std::time_t t) { scheduler.review(it, q, t); };
+    auto loadItem = [&](Item& it) { return storedDeck.ensureLoaded(it); };
+    replayJournal(session, applyReview, loadItem, std::cerr);
+
+    // Reviews are not journaled: the script's changes reach disk in one save
+    // at the end, and a script that dies before it leaves the saved deck as it was
+    ReviewPipeline pipeline(items, applyReview, loadItem);
+    std::vector<std::pair<std::size_t, std::future<ReviewOutcome>>> inFlight;
+
+    std::size_t lineNo = 0, commands = 0, errors = 0;
+    bool dirty = false;
+    BatchNames names;
+    auto fail = [&](const std::string& message) {
+        std::cerr << "line " << lineNo << ": " << message << "\n";
+        ++errors;
+    };
+    // Reviews are applied on the pipeline's thread; every command but add
+    // and review waits for them, so the script's order holds
+    auto settle = [&]() {
+        for (auto& f : inFlight)
+            if (!f.second.get().applied) {
+                std::cerr << "line " << f.first << ": review not applied\n";
+                ++errors;
+            }
+        inFlight.clear();
+    };
+    auto save = [&]() {
+        settle();
+        if (!saveDeck(session).get()) {
+            fail("save failed; see the log");
+            return false;
+        }
+        dirty = false;
+        return true;
+    };
+
+    std::string line;
+    while (std::getline(in, line)) {
+        ++lineNo;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+
+        std::vector<std::string> f;
+        std::istringstream fss(line);
+        std::string field;
+        while (std::getline(fss, field, '\t')) f.push_back(field);
+        const std::string& cmd = f[0];
+        ++commands;
+
+        if (cmd == "add") {
+            if (f.size() < 2 || f[1].empty()) { fail("usage: add <title> [content] [tags]"); continue; }
+            Item it(f[1], f.size() > 2 ? f[2] : "");
+            if (f.size() > 3) it.setTags(splitTagsLine(f[3]));
+            auto tx = items.edit("Add '" + it.title + "'");
+            forecast.add(it.next_review);
+            stats.addItem(it);
+            tagManager.addItem(it);
+            duplicates.addItem(it);
+            std::cout << "added\t" << it.id << '\n';
+            std::string title = it.title, id = it.id;
+            tx.add(std::move(it));
+            names.added(items, title, id);
+            dirty = true;
+        }
+
+        else if (cmd == "tag" || cmd == "untag") {
+            if (f.size() < 3) { fail("usage: " + cmd + " <item> <tags>"); continue; }
+            // Tag weights shape the intervals of earlier reviews, so those land first
+            settle();
+            auto h = names.find(items, f[1]);
+            if (!h.valid()) { fail("no item '" + f[1] + "'"); continue; }
+            if (!warmItem(items, storedDeck, h)) { fail("could not decrypt '" + f[1] + "'"); continue; }
+            auto tx = items.edit("");
+            Item it = *items.get(h);
+            tx.describe((cmd == "tag" ? "Tag '" : "Untag '") + it.title + "'");
+            stats.removeItem(it);
+            tagManager.removeItem(it);
+            for (const auto& t : splitTagsLine(f[2])) {
+                if (cmd == "tag") it.addTag(t);
+                else it.removeTag(t);
+            }
+            stats.addItem(it);
+            tagManager.addItem(it);
+            tx.set(h, std::move(it));
+            dirty = true;
+        }
+
+        else if (cmd == "delete") {
+            if (f.size() < 2) { fail("usage: delete <item>"); continue; }
+            settle();
+            auto h = names.find(items, f[1]);
+            if (!h.valid()) { fail("no item '" + f[1] + "'"); continue; }
+            auto tx = items.edit("");
+            auto it = items.get(h);
+            tx.describe("Delete '" + it->title + "'");
+            forecast.remove(it->next_review);
+            stats.removeItem(*it);
+            tagManager.removeItem(*it);
+            duplicates.removeItem(*it);
+            tx.erase(h);
+            dirty = true;
+        }
+
+        else if (cmd == "review") {
+            ReviewQuality q;
+            if (f.size() < 3 || !parseQuality(f[2], q)) { fail("usage: review <item> <again|hard|good|easy>"); continue; }
+            auto it = items.get(names.find(items, f[1]));
+            if (!it) { fail("no item '" + f[1] + "'"); continue; }
+            inFlight.emplace_back(lineNo, pipeline.submit({ it->id, q, std::time(nullptr) }));
+            dirty = true;
+        }
+
+        else if (cmd == "due") {
+            std::size_t limit = std::numeric_limits<std::size_t>::max();
+            if (f.size() > 1) {
+                try { limit = std::stoul(f[1]); }
+                catch (...) { fail("usage: due [limit]"); continue; }
+            }
+
+            settle();
+            // In the order a review session takes them
+            for (auto h : scheduler.getDueItems(items)) {
+                if (limit-- == 0) break;
+                if (auto it = items.get(h)) printBatchRow(std::cout, *it);
+            }
+            std::cout << "end\n";
+        }
+
+        else if (cmd == "query") {
+            DeckQuery::Filter filter;
+            DeckQuery::Order order = DeckQuery::Order::Position;
+            bool descending = false;
+            if (f.size() > 1 && !parseQuery(f[1], filter, order, descending)) {
+                fail("usage: query [tag:<tag>] [due:<days>] [ease:<a-b>] [lapses:<a-b>] [text:<word>] [sort:<key>] [desc]");
+                continue;
+            }
+
+            settle();
+            // Streamed a page at a time, so a huge result is never held whole
+            DeckQuery query(items.snapshot(), filter, order, descending);
+            DeckQuery::Cursor cursor;
+            while (!cursor.end) {
+                DeckQuery::Page page = query.page(cursor, BATCH_PAGE_SIZE);
+                for (const auto& row : page.rows) printBatchRow(std::cout, *row.item);
+                cursor = page.next;
+            }
+            std::cout << "end\n";
+        }
+
+        else if (cmd == "save") {
+            if (save()) std::cout << "saved\n";
+        }
+
+        else {
+            fail("unknown command '" + cmd + "'");
+        }
+    }
+
+    settle();
+    pipeline.stop();
+    bool saved = !dirty || save();
+    session.auth.save();
+    session.auth.logout();
+    std::cout.flush();
+    std::cerr << commands << " command(s), " << errors << " error(s)" << (saved ? "" : ", NOT SAVED") << "\n";
+    return errors == 0 && saved ? 0 : 1;
+}
+
+// "--batch <username> [script]": run commands for one user without menus,
+// after a single login. The first line of stdin is the password; commands
+// come from the script, or from the rest of stdin. One command per line,
+// fields separated by tabs, items given by ID or title:
+//   add <title> [content] [tags]      tag|untag <item> <tags>
+//   review <item> <again|hard|good|easy>   delete <item>
+//   query [filter]   due [limit]   save
+// A query filter is written as in the item list ("tag:geo sort:due desc");
+// due lists due items in review order (heavier tags first, then longest
+// overdue). Both print "id, title, next review, tags" rows followed by "end".
+int runBatch(Session& session, int argc, char* argv[]) {
+    // Nothing has been read or written yet, so the streams may stop syncing with stdio
+    std::ios::sync_with_stdio(false);
+    std::cin.tie(nullptr);
+
+    std::ifstream script;
+    if (argc > 3) script.open(argv[3]);
+    if (argc < 3 || (argc > 3 && !script)) {
+        std::cerr << "Usage: cli --batch <username> [script] (password on the first line of stdin)\n";
+        return 1;
+    }
+
+    std::string password;
+    std::getline(std::cin, password);
+    if (!password.empty() && password.back() == '\r') password.pop_back();
+    bool ok = session.auth.login(argv[2], password);
+    if (!password.empty()) sodium_memzero(&password[0], password.size());
+    if (!ok) {
+        std::cerr << "Invalid username/password.\n";
+        return 1;
+    }
+    session.current = session.auth.getCurrentUser();
+    openDeck(session);
+
+    std::istream& in = argc > 3 ? static_cast<std::istream&>(script) : std::cin;
+    return session.schedConfig.algorithm == SchedulerAlgorithm::FSRS
+        ? runScript<FSRSPolicy>(session, in)
+        : runScript<SM2Policy>(session, in);
+}
+
+int main(int argc, char* argv[]) {
+    if (sodium_init() < 0) {
+        std::cerr << "Failed to initialize libsodium\n";
+        return 1;
+    }
+
+    Log::init();
+
+    AuthManager auth;
+    if (argc > 1 && std::string(argv[1]) == "--calibrate") return calibratePasswords(auth, argc, argv);
+
+    DeckHistory items;
+    PagedStore store;
+    if (!store.open(STORE_FILE)) {
+        std::cerr << "Failed to open the deck store '" << STORE_FILE << "'\n";
+        return 1;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--rotate-keys") return rotateKeys(auth, store, argc, argv);
+    PagedDeck storedDeck(store);
+    BlobStore blobs;
+    ReviewJournal journal;
+    TagManager tagManager;
+    SchedulerConfig schedConfig;
+    ReviewForecast forecast;
+    DeckStats stats;
+    DuplicateIndex duplicates;
+    User* current = nullptr;
+    Session session{ auth, current, items, store, storedDeck, blobs, journal, tagManager, schedConfig, forecast, stats,
+        duplicates };
+    if (argc > 1 && std::string(argv[1]) == "--batch") return runBatch(session, argc, argv);
+
+    // LOGIN / SIGNUP
+    while (!current) {
+        std::cout << "\n===== LOGIN MENU =====\n"
+            "1. Login\n"
+            "2. Signup\n"
+            "3. Exit\n> ";
+        int choice;
+        if (!(std::cin >> choice)) {
+            std::cin.clear();
+            std::string dummy; std::getline(std::cin, dummy);
+            continue;
+        }
+        std::cin.ignore();
+
+        if (choice == 1) {
+            std::string username, password;
+            std::cout << "Username: "; std::getline(std::cin, username);
+            std::cout << "Password: "; std::getline(std::cin, password);
+
+            if (auth.login(username, password)) {
+                current = auth.getCurrentUser();
+                session.current = current;
+                openDeck(session);
+                std::cout << "Login successful.\n";
+            }
+            else {
+                std::cout << "Invalid username/password.\n";
+            }
+        }
+        else if (choice == 2) {
+            std::string username, password;
+            std::cout << "Choose username: "; std::getline(std::cin, username);
+            std::cout << "Choose password: "; std::getline(std::cin, password);
+            if (username.empty() || password.empty()) { std::cout << "Empty fields.\n"; continue; }
+            if (auth.signup(username, password)) std::cout << "Signup complete.\n";
+            else std::cout << "Signup failed.\n";
+        }
+        else if (choice == 3)
+            return 0;
+    }
+
+    // Pick the scheduler instantiation once per algorithm; reviews never branch on it
+    while (true) {
+        MenuExit exit = (schedConfig.algorithm == SchedulerAlgorithm::FSRS)
+            ? runMainMenu<FSRSPolicy>(session)
+            : runMainMenu<SM2Policy>(session);
+        if (exit == MenuExit::Quit) break;
+    }
+
     return 0;
 }
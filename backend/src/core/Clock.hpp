@@ -0,0 +1,39 @@
+#pragma once
+#include <atomic>
+#include <ctime>
+
+// Source of "now" for scheduling. Core classes take an optional Clock pointer
+// (nullptr = system time) so reviews can be replayed or fast-forwarded.
+class Clock {
+public:
+    virtual ~Clock() = default;
+    virtual std::time_t now() const = 0;
+
+    // Wall-clock time; the default everywhere
+    static const Clock& system();
+};
+
+class SystemClock : public Clock {
+public:
+    std::time_t now() const override { return std::time(nullptr); }
+};
+
+inline const Clock& Clock::system() {
+    static const SystemClock clock;
+    return clock;
+}
+
+// Clock that only moves when told to. Safe to read from several threads.
+class VirtualClock : public Clock {
+public:
+    explicit VirtualClock(std::time_t start = 0) : current(start) {}
+
+    std::time_t now() const override { return current.load(std::memory_order_acquire); }
+
+    void set(std::time_t t) { current.store(t, std::memory_order_release); }
+    void advance(std::time_t seconds) { current.fetch_add(seconds, std::memory_order_acq_rel); }
+    void advanceDays(int days) { advance(static_cast<std::time_t>(days) * 24 * 60 * 60); }
+
+private:
+    std::atomic<std::time_t> current;
+};
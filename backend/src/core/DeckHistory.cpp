@@ -0,0 +1,275 @@
+#include "DeckHistory.hpp"
+#include <spdlog/spdlog.h>
+
+DeckHistory::DeckHistory()
+    : head(std::make_shared<const PersistentDeck>()) {
+}
+
+PersistentDeck DeckHistory::snapshot() const {
+    return *std::atomic_load(&head);
+}
+
+void DeckHistory::publish(PersistentDeck deck) {
+    std::atomic_store(&head, std::shared_ptr<const PersistentDeck>(std::make_shared<const PersistentDeck>(std::move(deck))));
+}
+
+void DeckHistory::reset(PersistentDeck deck) {
+    std::lock_guard<std::recursive_mutex> lock(writer);
+    steps.clear();
+    slots.clear();
+    byId.clear();
+    repeated.clear();
+    slots.reserve(deck.size());
+    byId.reserve(deck.size());
+    nextOrder = 0;
+    ++layout;
+    deck.forEachPtr([&](const PersistentDeck::ItemPtr& item) { track(item, ++nextOrder); });
+    publish(std::move(deck));
+}
+
+DeckHistory::Handle DeckHistory::slotOf(const Item& item) const {
+    auto first = byId.find(item.id);
+    if (first == byId.end()) return Handle();
+    const Slot* slot = slots.get(first->second);
+    if (slot && slot->item.get() == &item) return first->second;
+
+    auto others = repeated.equal_range(item.id);
+    for (auto it = others.first; it != others.second; ++it)
+        if (slots.get(it->second)->item.get() == &item) return it->second;
+    return Handle();
+}
+
+void DeckHistory::track(PersistentDeck::ItemPtr item, std::uint64_t order) {
+    const std::string& id = item->id;
+    Handle h = slots.insert({ std::move(item), order });
+    if (!byId.emplace(id, h).second) {
+        spdlog::warn("Item ID '{}' appears more than once in the deck", id);
+        repeated.emplace(id, h);
+    }
+}
+
+void DeckHistory::untrack(const Item& item) {
+    Handle h = slotOf(item);
+    if (!h.valid()) return;
+
+    // The ID passes to the next item repeating it, if any
+    auto first = byId.find(item.id);
+    if (first->second == h) {
+        auto next = repeated.find(item.id);
+        if (next != repeated.end()) {
+            first->second = next->second;
+            repeated.erase(next);
+        }
+        else {
+            byId.erase(first);
+        }
+    }
+    else {
+        auto others = repeated.equal_range(item.id);
+        for (auto it = others.first; it != others.second; ++it)
+            if (it->second == h) {
+                repeated.erase(it);
+                break;
+            }
+    }
+    slots.erase(h);
+}
+
+void DeckHistory::retrack(const Item& old, PersistentDeck::ItemPtr now) {
+    Slot* slot = slots.get(slotOf(old));
+    if (!slot) return;
+    if (old.id == now->id) {
+        slot->item = std::move(now);
+        return;
+    }
+    std::uint64_t order = slot->order;
+    untrack(old);
+    track(std::move(now), order);
+}
+
+std::uint64_t DeckHistory::orderOf(const Item& item) const {
+    const Slot* slot = slots.get(slotOf(item));
+    return slot ? slot->order : 0;
+}
+
+DeckHistory::Handle DeckHistory::handleOf(const std::string& id) const {
+    std::lock_guard<std::recursive_mutex> lock(writer);
+    auto it = byId.find(id);
+    return it == byId.end() ? Handle() : it->second;
+}
+
+DeckHistory::Handle DeckHistory::handleAt(std::size_t i) const {
+    std::lock_guard<std::recursive_mutex> lock(writer);
+    PersistentDeck cur = snapshot();
+    return i < cur.size() ? slotOf(*cur.ptr(i)) : Handle();
+}
+
+PersistentDeck::ItemPtr DeckHistory::get(Handle h) const {
+    std::lock_guard<std::recursive_mutex> lock(writer);
+    const Slot* slot = slots.get(h);
+    return slot ? slot->item : nullptr;
+}
+
+bool DeckHistory::indexOf(Handle h, std::size_t& index) const {
+    std::lock_guard<std::recursive_mutex> lock(writer);
+    const Slot* slot = slots.get(h);
+    if (!slot) return false;
+    if (slot->seen == layout) {
+        index = slot->index;
+        return true;
+    }
+
+    // Order keys rise with position, so the item is where they reach its own
+    PersistentDeck cur = snapshot();
+    const std::uint64_t target = slot->order;
+    std::size_t i = cur.partitionPoint([&](const Item& it) { return orderOf(it) < target; });
+    if (i >= cur.size() || cur.ptr(i) != slot->item) {
+        spdlog::error("Deck slots out of step with the deck at '{}'", slot->item->id);
+        return false;
+    }
+    slot->index = index = i;
+    slot->seen = layout;
+    return true;
+}
+
+bool DeckHistory::indexOf(const std::string& id, std::size_t& index) const {
+    std::lock_guard<std::recursive_mutex> lock(writer);
+    return indexOf(handleOf(id), index);
+}
+
+DeckHistory::Transaction::Transaction(DeckHistory& h, std::string l)
+    : history(&h), lock(h.writer), label(std::move(l)) {
+}
+
+// The step is opened by the first edit, so read-only transactions leave no trace
+void DeckHistory::Transaction::open() {
+    if (recorded) return;
+    auto& steps = history->steps;
+    steps.push_back({ label, {}, {}, {} });
+    if (steps.size() > MAX_UNDO) steps.pop_front();
+    recorded = true;
+}
+
+void DeckHistory::Transaction::record(Edit edit, std::uint64_t order) {
+    open();
+    history->steps.back().edits.push_back(std::move(edit));
+    history->steps.back().orders.push_back(order);
+}
+
+void DeckHistory::Transaction::onUndo(std::function<void()> fn) {
+    open();
+    history->steps.back().undoHooks.push_back(std::move(fn));
+}
+
+bool DeckHistory::Transaction::set(Handle h, Item item) {
+    std::size_t i = 0;
+    if (!history->indexOf(h, i)) return false;
+    setAt(i, std::move(item));
+    return true;
+}
+
+bool DeckHistory::Transaction::erase(Handle h) {
+    std::size_t i = 0;
+    if (!history->indexOf(h, i)) return false;
+    eraseAt(i);
+    return true;
+}
+
+void DeckHistory::Transaction::setAt(std::size_t i, Item item) {
+    PersistentDeck cur = snapshot();
+    auto before = cur.ptr(i);
+    auto after = PersistentDeck::share(std::move(item), history->account);
+    record({ i, before, after }, history->orderOf(*before));
+    history->retrack(*before, after);
+    history->publish(cur.set(i, after));
+}
+
+void DeckHistory::Transaction::add(Item item) {
+    PersistentDeck cur = snapshot();
+    auto after = PersistentDeck::share(std::move(item), history->account);
+    std::uint64_t order = ++history->nextOrder;
+    record({ cur.size(), nullptr, after }, order);
+    history->track(after, order);
+    ++history->layout;
+    history->publish(cur.insert(cur.size(), after));
+}
+
+void DeckHistory::Transaction::eraseAt(std::size_t i) {
+    PersistentDeck cur = snapshot();
+    auto before = cur.ptr(i);
+    record({ i, before, nullptr }, history->orderOf(*before));
+    history->untrack(*before);
+    ++history->layout;
+    history->publish(cur.erase(i));
+}
+
+bool DeckHistory::load(std::size_t i, const PersistentDeck::ItemPtr& from, Item item) {
+    std::lock_guard<std::recursive_mutex> lock(writer);
+    PersistentDeck cur = snapshot();
+    if (i >= cur.size() || cur.ptr(i) != from) return false;
+    auto now = PersistentDeck::share(std::move(item), account);
+    retrack(*from, now);
+    publish(cur.set(i, std::move(now)));
+    return true;
+}
+
+bool DeckHistory::load(const PersistentDeck& from, PersistentDeck deck) {
+    std::lock_guard<std::recursive_mutex> lock(writer);
+    if (!snapshot().sameVersion(from) || deck.size() != from.size()) return false;
+    // The same items in the same places, so only the slots' versions change
+    std::vector<PersistentDeck::ItemPtr> old;
+    old.reserve(from.size());
+    from.forEachPtr([&](const PersistentDeck::ItemPtr& item) { old.push_back(item); });
+    std::size_t i = 0;
+    deck.forEachPtr([&](const PersistentDeck::ItemPtr& item) {
+        if (Slot* slot = slots.get(slotOf(*old[i++]))) slot->item = item;
+    });
+    publish(std::move(deck));
+    return true;
+}
+
+std::size_t DeckHistory::undoDepth() const {
+    std::lock_guard<std::recursive_mutex> lock(writer);
+    return steps.size();
+}
+
+bool DeckHistory::undo(std::string& label, std::vector<Edit>& reverted) {
+    std::lock_guard<std::recursive_mutex> lock(writer);
+    reverted.clear();
+    if (steps.empty()) return false;
+
+    Step step = std::move(steps.back());
+    steps.pop_back();
+
+    // Later edits may have shifted indices, so unwind in reverse order. A
+    // deletion goes back between the same neighbours, so its old order key
+    // still fits there.
+    PersistentDeck cur = snapshot();
+    for (std::size_t k = step.edits.size(); k-- > 0;) {
+        const Edit* e = &step.edits[k];
+        // Report what is actually being replaced, which may be a decrypted copy of e->after
+        Edit undone{ e->index, e->before, e->after ? cur.ptr(e->index) : nullptr };
+
+        if (!e->before) {
+            untrack(*undone.after);
+            cur = cur.erase(e->index);
+        }
+        else if (!e->after) {
+            track(e->before, step.orders[k]);
+            cur = cur.insert(e->index, e->before);
+        }
+        else {
+            retrack(*undone.after, e->before);
+            cur = cur.set(e->index, e->before);
+        }
+
+        reverted.push_back(std::move(undone));
+    }
+
+    ++layout;
+    publish(std::move(cur));
+    for (auto k = step.undoHooks.rbegin(); k != step.undoHooks.rend(); ++k) (*k)();
+    label = std::move(step.label);
+    spdlog::info("Undid '{}' ({} edits)", label, reverted.size());
+    return true;
+}
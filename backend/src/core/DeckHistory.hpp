@@ -0,0 +1,171 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "PersistentDeck.hpp"
+#include "SlotMap.hpp"
+
+// Published deck versions plus an undo log. snapshot() may be called from any
+// thread without locking and returns an immutable version that stays valid
+// however the deck changes afterwards. Writers are serialized: edits go
+// through a Transaction, which holds the writer lock and forms one undo step.
+// The lock is recursive, so a writer holding writeLock() may open transactions.
+//
+// Each step records the items it replaced, so undo() costs O(edits * log n)
+// and never rewinds past items decrypted in the meantime (load() changes are
+// not undoable).
+//
+// Live items also sit in a generational slot map, found by handle or by ID
+// in O(1). A handle stays valid until its item is deleted, however the deck
+// shifts around it, so queues and indexes can hold handles instead of
+// positions. Each slot carries an order key rising with deck position, which
+// turns a handle back into its current position by binary search; the
+// position is then cached until the next insertion or deletion, so repeated
+// lookups between them (a run of reviews) cost O(1). Every item has its own
+// slot even if its ID repeats; the ID then finds the first of them. Edits
+// name their item by handle, so one chosen before the deck shifted (a browse
+// page, a queued card) still changes that item and no other.
+class DeckHistory {
+public:
+    static constexpr std::size_t MAX_UNDO = 100;
+
+    using Handle = SlotHandle;
+
+    // One item change; a null before is an insertion, a null after a deletion
+    struct Edit {
+        std::size_t index = 0;
+        PersistentDeck::ItemPtr before;
+        PersistentDeck::ItemPtr after;
+    };
+
+    // Holds the writer lock; its edits are undone together
+    class Transaction {
+    public:
+        Transaction(Transaction&&) = default;
+
+        // The current version, including this transaction's edits so far
+        PersistentDeck snapshot() const { return history->snapshot(); }
+
+        // Undo label, if it was not known when the transaction was opened
+        void describe(std::string text) { label = std::move(text); }
+
+        // Replace or delete the item h names, wherever it now sits; false
+        // (and nothing changes) once it is gone. A replacement keeping the ID
+        // keeps the handle.
+        bool set(Handle h, Item item);
+        void add(Item item);
+        bool erase(Handle h);
+
+        // Runs (under the writer lock) when this step is undone, for state kept
+        // beside the deck such as tag weights. Opens the step if no edit has.
+        void onUndo(std::function<void()> fn);
+
+    private:
+        friend class DeckHistory;
+        Transaction(DeckHistory& h, std::string label);
+
+        DeckHistory* history;
+        std::unique_lock<std::recursive_mutex> lock;
+        bool recorded = false;
+        std::string label;
+
+        void open();
+        void record(Edit edit, std::uint64_t order);
+        void setAt(std::size_t i, Item item);
+        void eraseAt(std::size_t i);
+    };
+
+    DeckHistory();
+
+    PersistentDeck snapshot() const;
+    std::size_t size() const { return snapshot().size(); }
+
+    Transaction edit(std::string label) { return Transaction(*this, std::move(label)); }
+
+    // Lock out writers, e.g. to read indexes that writers keep in step with the deck
+    std::unique_lock<std::recursive_mutex> writeLock() { return std::unique_lock<std::recursive_mutex>(writer); }
+
+    // Replace the whole deck and forget the undo log (e.g. after login).
+    // Every handle becomes stale.
+    void reset(PersistentDeck deck);
+
+    // The live item with this ID; an invalid handle if there is none
+    Handle handleOf(const std::string& id) const;
+    // The item at position i of the current version; invalid if out of range
+    Handle handleAt(std::size_t i) const;
+    // Current version of the item; null once it is deleted (undoing the
+    // deletion gives the item a new handle)
+    PersistentDeck::ItemPtr get(Handle h) const;
+    // Position in the current version; false once the item is gone
+    bool indexOf(Handle h, std::size_t& index) const;
+    bool indexOf(const std::string& id, std::size_t& index) const;
+
+    // fn(Handle, const PersistentDeck::ItemPtr&) for every live item, in no
+    // particular order, under the writer lock
+    template <class Fn>
+    void forEachHandle(Fn&& fn) const {
+        std::lock_guard<std::recursive_mutex> lock(writer);
+        slots.forEach([&](Handle h, const Slot& slot) { fn(h, slot.item); });
+    }
+
+    // Swap in fuller copies of the same items (decrypted content) or fields
+    // derived from settings (tag re-scheduling), outside undo. Fails if the
+    // item or deck is no longer the version the copy was made from; re-read
+    // and retry.
+    bool load(std::size_t i, const PersistentDeck::ItemPtr& from, Item item);
+    bool load(const PersistentDeck& from, PersistentDeck deck);
+
+    // Revert the latest step. `reverted` receives its edits, latest first, so
+    // callers can adjust derived state (forecast, statistics).
+    bool undo(std::string& label, std::vector<Edit>& reverted);
+    std::size_t undoDepth() const;
+
+    // Items of this deck (every live version and the undo log) are charged here
+    const std::shared_ptr<MemoryAccount>& memory() const { return account; }
+
+private:
+    struct Step {
+        std::string label;
+        std::vector<Edit> edits;
+        std::vector<std::uint64_t> orders; // order key of each edit's item, to reinsert deletions
+        std::vector<std::function<void()>> undoHooks;
+    };
+
+    struct Slot {
+        PersistentDeck::ItemPtr item;
+        std::uint64_t order = 0;
+        // Position as of layout `seen`
+        mutable std::size_t index = 0;
+        mutable std::uint64_t seen = 0;
+    };
+
+    std::shared_ptr<const PersistentDeck> head;
+    std::deque<Step> steps;
+    mutable std::recursive_mutex writer;
+    std::shared_ptr<MemoryAccount> account = std::make_shared<MemoryAccount>("deck");
+
+    // Writer-owned, describing the published head
+    SlotMap<Slot> slots{ MemoryAccount::resource(MemoryCategory::DeckIndex) };
+    // First item with each ID; later items repeating an ID go to `repeated`
+    std::pmr::unordered_map<std::string, Handle> byId{ MemoryAccount::resource(MemoryCategory::DeckIndex) };
+    std::pmr::unordered_multimap<std::string, Handle> repeated{ MemoryAccount::resource(MemoryCategory::DeckIndex) };
+    std::uint64_t nextOrder = 0;
+    std::uint64_t layout = 1; // bumped whenever positions shift
+
+    void publish(PersistentDeck deck);
+
+    // Slot of this very item (not merely one with its ID)
+    Handle slotOf(const Item& item) const;
+    void track(PersistentDeck::ItemPtr item, std::uint64_t order);
+    void untrack(const Item& item);
+    // `now` takes the place (and order key) of `old`
+    void retrack(const Item& old, PersistentDeck::ItemPtr now);
+    std::uint64_t orderOf(const Item& item) const;
+};
@@ -0,0 +1,166 @@
+#include "DeckQuery.hpp"
+#include "TagTrie.hpp"
+#include "../parallel/Parallel.hpp"
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+
+namespace {
+
+char lower(char c) {
+    return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+}
+
+// needle is already lower case
+bool containsFolded(const std::string& haystack, const std::string& needle) {
+    return std::search(haystack.begin(), haystack.end(), needle.begin(), needle.end(),
+        [](char a, char b) { return lower(a) == b; }) != haystack.end();
+}
+
+} // namespace
+
+DeckQuery::DeckQuery(PersistentDeck deck) : DeckQuery(std::move(deck), Filter()) {
+}
+
+DeckQuery::DeckQuery(PersistentDeck deck, Filter f, Order o, bool desc)
+    : items(std::move(deck)), filter(std::move(f)), order(o), descending(desc) {
+    needle.reserve(filter.text.size());
+    for (char c : filter.text) needle.push_back(lower(c));
+    if (!filter.tag.empty()) tag = TagTrie::normalize(filter.tag);
+}
+
+bool DeckQuery::matches(const Item& it) const {
+    if (it.next_review < filter.dueFrom || it.next_review > filter.dueUntil) return false;
+    if (it.ease_factor < filter.minEase || it.ease_factor > filter.maxEase) return false;
+    if (it.lapses < filter.minLapses || it.lapses > filter.maxLapses) return false;
+    if (!tag.empty() && std::none_of(it.tags.begin(), it.tags.end(),
+            [&](const std::string& t) { return TagTrie::isUnder(t, tag); }))
+        return false;
+    if (!needle.empty() && !containsFolded(it.title, needle) && (it.cold || !containsFolded(it.content, needle)))
+        return false;
+    return true;
+}
+
+DeckQuery::Key DeckQuery::keyOf(const Item& it, std::size_t index) const {
+    Key k;
+    switch (order) {
+    case Order::Due:    k.number = static_cast<double>(it.next_review); break;
+    case Order::Ease:   k.number = it.ease_factor; break;
+    case Order::Lapses: k.number = it.lapses; break;
+    default:            break;
+    }
+    k.title = &it.title;
+    k.id = &it.id;
+    k.index = index;
+    return k;
+}
+
+bool DeckQuery::before(const Key& a, const Key& b) const {
+    int c = 0;
+    if (order == Order::Title) c = a.title->compare(*b.title);
+    else if (a.number != b.number) c = a.number < b.number ? -1 : 1;
+    if (c == 0) c = a.id->compare(*b.id);
+    if (c == 0 && a.index != b.index) c = a.index < b.index ? -1 : 1;
+    return descending ? c > 0 : c < 0;
+}
+
+DeckQuery::Page DeckQuery::page(const Cursor& after, std::size_t limit) const {
+    if (after.end || limit == 0) {
+        Page empty;
+        empty.next = after;
+        return empty;
+    }
+    return order == Order::Position ? positionPage(after, limit) : sortedPage(after, limit);
+}
+
+// One match beyond the page is looked for, so the cursor knows whether more follow
+DeckQuery::Page DeckQuery::positionPage(const Cursor& after, std::size_t limit) const {
+    Page page;
+    const std::size_t n = items.size();
+    std::size_t pos = after.started ? after.index : 0;
+    // Windows double, so a sparse filter is not paid for in O(log n) descents
+    std::size_t window = limit + 1;
+    while (pos < n && page.rows.size() <= limit) {
+        std::size_t hi = std::min(n, pos + window);
+        items.forEachIn(pos, hi, [&](std::size_t i, const Item& it) {
+            if (page.rows.size() <= limit && matches(it)) page.rows.push_back({ i, nullptr });
+        });
+        pos = hi;
+        window *= 2;
+    }
+
+    if (page.rows.size() > limit) {
+        page.next.index = page.rows.back().index;
+        page.next.started = true;
+        page.rows.pop_back();
+    }
+    else {
+        page.next.end = true;
+    }
+    for (auto& row : page.rows) row.item = items.ptr(row.index);
+    return page;
+}
+
+DeckQuery::Page DeckQuery::sortedPage(const Cursor& after, std::size_t limit) const {
+    const Key from{ after.key, &after.title, &after.id, after.index };
+    const std::size_t keep = limit + 1;
+    auto worse = [this](const Key& a, const Key& b) { return before(a, b); };
+
+    // Each chunk keeps its best `keep` rows in a heap (worst on top), returned in order
+    using Best = std::vector<Key>;
+    Best best = parallelReduce(0, items.size(), 0, Best(),
+        [&](std::size_t lo, std::size_t hi) {
+            Best heap;
+            items.forEachIn(lo, hi, [&](std::size_t i, const Item& it) {
+                if (!matches(it)) return;
+                Key k = keyOf(it, i);
+                if (after.started && !before(from, k)) return;
+                if (heap.size() < keep) {
+                    heap.push_back(k);
+                    std::push_heap(heap.begin(), heap.end(), worse);
+                }
+                else if (before(k, heap.front())) {
+                    std::pop_heap(heap.begin(), heap.end(), worse);
+                    heap.back() = k;
+                    std::push_heap(heap.begin(), heap.end(), worse);
+                }
+            });
+            std::sort_heap(heap.begin(), heap.end(), worse);
+            return heap;
+        },
+        [&](Best a, Best b) {
+            Best merged;
+            merged.reserve(std::min(keep, a.size() + b.size()));
+            std::merge(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(merged), worse);
+            if (merged.size() > keep) merged.resize(keep);
+            return merged;
+        });
+
+    Page page;
+    std::size_t rows = std::min(limit, best.size());
+    page.rows.reserve(rows);
+    for (std::size_t i = 0; i < rows; ++i) page.rows.push_back({ best[i].index, items.ptr(best[i].index) });
+
+    if (best.size() > limit) {
+        const Key& last = best[limit - 1];
+        page.next.key = last.number;
+        page.next.title = *last.title;
+        page.next.id = *last.id;
+        page.next.index = last.index;
+        page.next.started = true;
+    }
+    else {
+        page.next.end = true;
+    }
+    return page;
+}
+
+std::size_t DeckQuery::count() const {
+    return parallelReduce(0, items.size(), 0, std::size_t(0),
+        [&](std::size_t lo, std::size_t hi) {
+            std::size_t n = 0;
+            items.forEachIn(lo, hi, [&](std::size_t, const Item& it) { n += matches(it); });
+            return n;
+        },
+        [](std::size_t a, std::size_t b) { return a + b; });
+}
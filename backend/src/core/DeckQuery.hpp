@@ -0,0 +1,96 @@
+#pragma once
+#include <cstddef>
+#include <ctime>
+#include <limits>
+#include <string>
+#include <vector>
+#include "PersistentDeck.hpp"
+
+// Filtered, sorted pages of one deck version, handed out without copying
+// items: a page is positions plus shared pointers into the (immutable) deck,
+// so the query stays consistent however the live deck changes meanwhile.
+//
+// Pages are cursor-based. In position order a page walks the tree from the
+// cursor and stops as soon as it is full, so the first page of a huge deck
+// costs about `limit` items. Sorted orders resume after the cursor's (key,
+// ID, position): each page scans the deck once in parallel, keeping only the
+// best `limit` candidates per chunk, and nothing is sorted as a whole.
+class DeckQuery {
+public:
+    enum class Order {
+        Position, // deck order
+        Due,
+        Ease,
+        Lapses,
+        Title
+    };
+
+    struct Filter {
+        std::string tag; // this tag or anything below it
+        std::time_t dueFrom = std::numeric_limits<std::time_t>::min();
+        std::time_t dueUntil = std::numeric_limits<std::time_t>::max();
+        double minEase = std::numeric_limits<double>::lowest();
+        double maxEase = std::numeric_limits<double>::max();
+        int minLapses = std::numeric_limits<int>::min();
+        int maxLapses = std::numeric_limits<int>::max();
+        // Case-insensitive (ASCII) substring of the title, or of the content
+        // of items already decrypted
+        std::string text;
+    };
+
+    struct Row {
+        std::size_t index = 0;
+        PersistentDeck::ItemPtr item;
+    };
+
+    // Where the next page starts; default-constructed for the first page
+    struct Cursor {
+        std::size_t index = 0; // position order: the first position not yet visited
+        // Sorted orders: the last row's sort key
+        double key = 0.0;
+        std::string title;
+        std::string id;
+        bool started = false;
+        bool end = false;
+    };
+
+    struct Page {
+        std::vector<Row> rows;
+        Cursor next; // next.end when nothing follows
+    };
+
+    // Every item, in deck order
+    explicit DeckQuery(PersistentDeck deck);
+    DeckQuery(PersistentDeck deck, Filter filter, Order order = Order::Position, bool descending = false);
+
+    Page page(const Cursor& after, std::size_t limit) const;
+
+    // Matching items in the whole deck (one parallel scan)
+    std::size_t count() const;
+
+    bool matches(const Item& item) const;
+
+    const PersistentDeck& deck() const { return items; }
+
+private:
+    struct Key {
+        double number = 0.0;
+        const std::string* title = nullptr;
+        const std::string* id = nullptr;
+        std::size_t index = 0;
+    };
+
+    PersistentDeck items;
+    Filter filter;
+    Order order;
+    bool descending;
+    std::string needle; // filter.text in lower case
+    std::string tag;    // filter.tag normalized
+
+    Key keyOf(const Item& item, std::size_t index) const;
+    // Strict weak order of rows in this query's order (descending included)
+    bool before(const Key& a, const Key& b) const;
+
+    Page positionPage(const Cursor& after, std::size_t limit) const;
+    Page sortedPage(const Cursor& after, std::size_t limit) const;
+};
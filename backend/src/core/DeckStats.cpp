@@ -0,0 +1,269 @@
+#include "DeckStats.hpp"
+#include "../parallel/Parallel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <spdlog/spdlog.h>
+
+namespace {
+
+unsigned resolveThreads(unsigned requested, std::size_t work) {
+    std::size_t n = requested ? requested : ThreadPool::shared().size();
+    return static_cast<unsigned>(std::min<std::size_t>(n, std::max<std::size_t>(1, work)));
+}
+
+// Run fn(begin, end, part) over `parts` contiguous slices of [0, count) on the shared pool
+template <class Fn>
+void forEachSlice(std::size_t count, unsigned parts, const Fn& fn) {
+    parallelFor(0, parts, 1, [&](std::size_t lo, std::size_t hi) {
+        for (std::size_t p = lo; p < hi; ++p)
+            fn(count * p / parts, count * (p + 1) / parts, static_cast<unsigned>(p));
+    });
+}
+
+inline void bump(std::size_t& v, long delta) {
+    v = static_cast<std::size_t>(static_cast<long>(v) + delta);
+}
+
+inline bool passedQuality(int q) { return q >= 3; }
+
+struct Partial {
+    std::size_t reviews = 0;
+    std::size_t passed = 0;
+    long lapses = 0;
+    std::size_t leeches = 0;
+    std::vector<std::size_t> easeHist = std::vector<std::size_t>(DeckStats::EASE_BINS, 0);
+    std::unordered_map<std::string, TagStats> tags;
+    std::vector<std::size_t> perDay;
+};
+
+} // namespace
+
+DeckColumns DeckColumns::project(const PersistentDeck& items, unsigned threads) {
+    DeckColumns cols;
+
+    cols.historyOffset.resize(items.size() + 1);
+    cols.historyOffset[0] = 0;
+    std::size_t n = 0;
+    items.forEach([&](const Item& it) {
+        cols.historyOffset[n + 1] = cols.historyOffset[n] + static_cast<std::uint32_t>(it.history.size());
+        ++n;
+    });
+
+    std::size_t total = cols.historyOffset.back();
+    cols.reviewTime.resize(total);
+    cols.reviewQuality.resize(total);
+    cols.ease.resize(items.size());
+    cols.lapses.resize(items.size());
+    cols.leech.resize(items.size());
+
+    // Every item writes to its own slice of each column, so slices fill independently
+    forEachSlice(items.size(), resolveThreads(threads, items.size()),
+        [&](std::size_t begin, std::size_t end, unsigned) {
+            items.forEachIn(begin, end, [&](std::size_t i, const Item& it) {
+                std::uint32_t o = cols.historyOffset[i];
+                for (std::size_t k = 0; k < it.history.size(); ++k) {
+                    cols.reviewTime[o + k] = static_cast<std::int64_t>(it.history[k].timestamp);
+                    cols.reviewQuality[o + k] = static_cast<std::uint8_t>(std::clamp(it.history[k].quality, 0, 255));
+                }
+                cols.ease[i] = static_cast<float>(it.ease_factor);
+                cols.lapses[i] = it.lapses;
+                cols.leech[i] = it.is_leech ? 1 : 0;
+            });
+        });
+
+    return cols;
+}
+
+std::size_t DeckStats::easeBin(double ease) {
+    if (ease <= EASE_MIN) return 0;
+    auto bin = static_cast<std::size_t>((ease - EASE_MIN) / EASE_BIN_WIDTH + 1e-9);
+    return std::min(bin, EASE_BINS - 1);
+}
+
+long DeckStats::dayOf(std::time_t t) {
+    constexpr std::time_t DAY = 24 * 60 * 60;
+    long q = static_cast<long>(t / DAY);
+    if (t % DAY < 0) --q;
+    return q;
+}
+
+void DeckStats::rebuild(const PersistentDeck& deck, unsigned threads) {
+    DeckColumns cols = DeckColumns::project(deck, threads);
+    unsigned parts = resolveThreads(threads, deck.size());
+
+    // Day range of the whole log, so every slice can use a dense day histogram
+    std::int64_t minTime = std::numeric_limits<std::int64_t>::max();
+    std::int64_t maxTime = std::numeric_limits<std::int64_t>::min();
+    for (std::int64_t t : cols.reviewTime) {
+        minTime = std::min(minTime, t);
+        maxTime = std::max(maxTime, t);
+    }
+    bool anyReviews = !cols.reviewTime.empty();
+    long dayLo = anyReviews ? dayOf(static_cast<std::time_t>(minTime)) : 0;
+    long dayHi = anyReviews ? dayOf(static_cast<std::time_t>(maxTime)) : -1;
+    std::size_t daySpan = static_cast<std::size_t>(dayHi - dayLo + 1);
+
+    std::vector<Partial> partials(parts);
+    forEachSlice(deck.size(), parts, [&](std::size_t begin, std::size_t end, unsigned p) {
+        Partial& part = partials[p];
+        part.perDay.assign(daySpan, 0);
+
+        std::uint32_t rBegin = cols.historyOffset[begin];
+        std::uint32_t rEnd = cols.historyOffset[end];
+        const std::uint8_t* q = cols.reviewQuality.data();
+        const std::int64_t* ts = cols.reviewTime.data();
+
+        // Column scans over this slice's reviews
+        std::size_t passedCount = 0;
+        for (std::uint32_t r = rBegin; r < rEnd; ++r) passedCount += q[r] >= 3;
+        part.reviews = rEnd - rBegin;
+        part.passed = passedCount;
+
+        for (std::uint32_t r = rBegin; r < rEnd; ++r)
+            part.perDay[static_cast<std::size_t>(dayOf(static_cast<std::time_t>(ts[r])) - dayLo)]++;
+
+        for (std::size_t i = begin; i < end; ++i) {
+            part.lapses += cols.lapses[i];
+            part.leeches += cols.leech[i];
+            part.easeHist[easeBin(cols.ease[i])]++;
+        }
+
+        // Per-tag rollup from per-item review segments
+        deck.forEachIn(begin, end, [&](std::size_t i, const Item& it) {
+            if (it.tags.empty()) return;
+
+            std::uint32_t a = cols.historyOffset[i];
+            std::uint32_t b = cols.historyOffset[i + 1];
+            std::size_t itemPassed = 0;
+            for (std::uint32_t r = a; r < b; ++r) itemPassed += q[r] >= 3;
+
+            for (const auto& tag : it.tags) {
+                TagStats& ts = part.tags[tag];
+                ts.items++;
+                ts.reviews += b - a;
+                ts.passed += itemPassed;
+                ts.lapses += cols.lapses[i];
+            }
+        });
+    });
+
+    ready = true;
+    items = deck.size();
+    reviews = passed = leeches = 0;
+    lapses = 0;
+    easeHist.assign(EASE_BINS, 0);
+    tags.clear();
+    firstDay = dayLo;
+    perDay.assign(daySpan, 0);
+
+    for (auto& part : partials) {
+        reviews += part.reviews;
+        passed += part.passed;
+        lapses += part.lapses;
+        leeches += part.leeches;
+        for (std::size_t b = 0; b < EASE_BINS; ++b) easeHist[b] += part.easeHist[b];
+        for (std::size_t d = 0; d < daySpan; ++d) perDay[d] += part.perDay[d];
+        for (auto& kv : part.tags) {
+            TagStats& ts = tags[kv.first];
+            ts.items += kv.second.items;
+            ts.reviews += kv.second.reviews;
+            ts.passed += kv.second.passed;
+            ts.lapses += kv.second.lapses;
+        }
+    }
+
+    spdlog::info("Deck stats rebuilt: {} items, {} reviews, {} tags ({} slices)",
+        items, reviews, tags.size(), parts);
+}
+
+void DeckStats::countReviewDay(std::time_t t, long delta) {
+    long day = dayOf(t);
+
+    if (perDay.empty()) {
+        firstDay = day;
+        perDay.assign(1, 0);
+    }
+    else if (day < firstDay) {
+        perDay.insert(perDay.begin(), static_cast<std::size_t>(firstDay - day), 0);
+        firstDay = day;
+    }
+
+    std::size_t idx = static_cast<std::size_t>(day - firstDay);
+    if (idx >= perDay.size()) perDay.resize(idx + 1, 0);
+    bump(perDay[idx], delta);
+}
+
+void DeckStats::applyItem(const Item& item, int sign) {
+    std::size_t itemPassed = 0;
+    for (const auto& r : item.history) {
+        if (passedQuality(r.quality)) ++itemPassed;
+        countReviewDay(r.timestamp, sign);
+    }
+
+    bump(items, sign);
+    bump(reviews, sign * static_cast<long>(item.history.size()));
+    bump(passed, sign * static_cast<long>(itemPassed));
+    lapses += sign * item.lapses;
+    if (item.is_leech) bump(leeches, sign);
+    bump(easeHist[easeBin(item.ease_factor)], sign);
+
+    for (const auto& tag : item.tags) {
+        TagStats& ts = tags[tag];
+        bump(ts.items, sign);
+        bump(ts.reviews, sign * static_cast<long>(item.history.size()));
+        bump(ts.passed, sign * static_cast<long>(itemPassed));
+        ts.lapses += sign * item.lapses;
+        if (ts.items == 0) tags.erase(tag);
+    }
+}
+
+void DeckStats::addItem(const Item& item) {
+    if (!ready) return;
+    applyItem(item, +1);
+}
+
+void DeckStats::removeItem(const Item& item) {
+    if (!ready) return;
+    applyItem(item, -1);
+}
+
+void DeckStats::onReview(const Item& item, const ItemState& before) {
+    if (!ready || item.history.empty()) return;
+    const ReviewRecord& rec = item.history.back();
+    bool ok = passedQuality(rec.quality);
+    long lapseDelta = item.lapses - before.lapses;
+
+    reviews++;
+    if (ok) passed++;
+    lapses += lapseDelta;
+    if (item.is_leech != before.leech) bump(leeches, item.is_leech ? 1 : -1);
+
+    std::size_t oldBin = easeBin(before.ease);
+    std::size_t newBin = easeBin(item.ease_factor);
+    if (oldBin != newBin) {
+        easeHist[oldBin]--;
+        easeHist[newBin]++;
+    }
+
+    countReviewDay(rec.timestamp, 1);
+
+    for (const auto& tag : item.tags) {
+        TagStats& ts = tags[tag];
+        ts.reviews++;
+        if (ok) ts.passed++;
+        ts.lapses += lapseDelta;
+    }
+}
+
+std::vector<std::size_t> DeckStats::reviewsPerDay(std::time_t from, int days) const {
+    std::vector<std::size_t> out(static_cast<std::size_t>(std::max(0, days)), 0);
+    long start = dayOf(from);
+
+    for (std::size_t i = 0; i < out.size(); ++i) {
+        long idx = start + static_cast<long>(i) - firstDay;
+        if (idx >= 0 && static_cast<std::size_t>(idx) < perDay.size())
+            out[i] = perDay[static_cast<std::size_t>(idx)];
+    }
+    return out;
+}
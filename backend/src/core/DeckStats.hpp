@@ -0,0 +1,99 @@
+#pragma once
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Item.hpp"
+#include "PersistentDeck.hpp"
+
+struct TagStats {
+    std::size_t items = 0;
+    std::size_t reviews = 0;
+    std::size_t passed = 0;
+    long lapses = 0;
+
+    double retention() const {
+        return reviews ? static_cast<double>(passed) / static_cast<double>(reviews) : 0.0;
+    }
+};
+
+// Column-per-field copy of the review log and scheduling fields. Scans over a
+// single column are contiguous and vectorize; items own the half-open range
+// [historyOffset[i], historyOffset[i + 1]) of the review columns.
+struct DeckColumns {
+    std::vector<std::int64_t> reviewTime;
+    std::vector<std::uint8_t> reviewQuality;
+    std::vector<std::uint32_t> historyOffset; // size = items + 1
+
+    std::vector<float> ease;
+    std::vector<std::int32_t> lapses;
+    std::vector<std::uint8_t> leech;
+
+    // Read straight from the deck's shared items, so no copy of them is made
+    static DeckColumns project(const PersistentDeck& items, unsigned threads = 0);
+};
+
+// Deck analytics: retention, ease distribution, lapses, per-tag performance and
+// reviews per day. rebuild() scans a columnar projection in parallel once;
+// afterwards the cached aggregates are adjusted per review and per item edit,
+// so every query is answered without touching the items. Until the first
+// rebuild() the per-item updates are ignored, so a deck whose history is still
+// encrypted on disk pays nothing for stats it has not asked for.
+class DeckStats {
+public:
+    static constexpr double EASE_MIN = 1.3;
+    static constexpr double EASE_BIN_WIDTH = 0.1;
+    static constexpr std::size_t EASE_BINS = 23; // 1.3 .. 3.5, last bin open-ended
+
+    // Scalar fields a review may change, captured before the review
+    struct ItemState {
+        double ease = 2.5;
+        int lapses = 0;
+        bool leech = false;
+    };
+
+    static ItemState stateOf(const Item& item) { return { item.ease_factor, item.lapses, item.is_leech }; }
+    static std::size_t easeBin(double ease);
+    static long dayOf(std::time_t t);
+
+    void rebuild(const PersistentDeck& items, unsigned threads = 0);
+    bool isReady() const { return ready; }
+
+    void addItem(const Item& item);
+    void removeItem(const Item& item);
+    // item.history.back() is the review just recorded
+    void onReview(const Item& item, const ItemState& before);
+
+    std::size_t itemCount() const { return items; }
+    std::size_t reviewCount() const { return reviews; }
+    std::size_t passedCount() const { return passed; }
+    double retention() const {
+        return reviews ? static_cast<double>(passed) / static_cast<double>(reviews) : 0.0;
+    }
+    long totalLapses() const { return lapses; }
+    std::size_t leechCount() const { return leeches; }
+
+    const std::vector<std::size_t>& easeHistogram() const { return easeHist; }
+    const std::unordered_map<std::string, TagStats>& tagStats() const { return tags; }
+
+    // Reviews logged on each of `days` UTC days starting at `from`
+    std::vector<std::size_t> reviewsPerDay(std::time_t from, int days) const;
+
+private:
+    bool ready = false;
+    std::size_t items = 0;
+    std::size_t reviews = 0;
+    std::size_t passed = 0;
+    long lapses = 0;
+    std::size_t leeches = 0;
+
+    std::vector<std::size_t> easeHist = std::vector<std::size_t>(EASE_BINS, 0);
+    std::unordered_map<std::string, TagStats> tags;
+
+    long firstDay = 0;               // day index of perDay[0]
+    std::vector<std::size_t> perDay; // dense reviews-per-day series
+
+    void countReviewDay(std::time_t t, long delta);
+    void applyItem(const Item& item, int sign);
+};
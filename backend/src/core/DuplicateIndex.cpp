@@ -0,0 +1,259 @@
+#include "DuplicateIndex.hpp"
+#include "SchedulingPolicy.hpp"
+#include "../parallel/Parallel.hpp"
+#include <algorithm>
+#include <cctype>
+#include <numeric>
+#include <unordered_set>
+#include <spdlog/spdlog.h>
+
+namespace {
+
+constexpr std::uint64_t splitmix64(std::uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// Multipliers (odd) and offsets of the HASHES hash functions h(x) = (a * x + b) >> 32
+struct HashFamily {
+    std::array<std::uint64_t, DuplicateIndex::HASHES> a{};
+    std::array<std::uint64_t, DuplicateIndex::HASHES> b{};
+};
+
+constexpr HashFamily makeHashFamily() {
+    HashFamily f{};
+    for (std::size_t i = 0; i < DuplicateIndex::HASHES; ++i) {
+        f.a[i] = splitmix64(2 * i) | 1;
+        f.b[i] = splitmix64(2 * i + 1);
+    }
+    return f;
+}
+
+constexpr HashFamily HASH_FAMILY = makeHashFamily();
+
+constexpr std::uint64_t FNV_OFFSET = 0xcbf29ce484222325ULL;
+constexpr std::uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+std::uint64_t fnv1a(const char* p, std::size_t n, std::uint64_t h = FNV_OFFSET) {
+    for (std::size_t i = 0; i < n; ++i) {
+        h ^= static_cast<unsigned char>(p[i]);
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+// Lower-case letters and digits; every other ASCII run becomes one space.
+// Bytes of multi-byte UTF-8 characters are kept as they are.
+void normalizeInto(const std::string& text, std::string& out) {
+    for (char ch : text) {
+        unsigned char c = static_cast<unsigned char>(ch);
+        if (c >= 0x80 || std::isalnum(c)) {
+            out.push_back(static_cast<char>(std::tolower(c)));
+        }
+        else if (!out.empty() && out.back() != ' ') {
+            out.push_back(' ');
+        }
+    }
+}
+
+// Union-find over slots, for grouping
+struct Components {
+    std::vector<std::uint32_t> parent;
+
+    explicit Components(std::size_t n) : parent(n) { std::iota(parent.begin(), parent.end(), 0u); }
+
+    std::uint32_t find(std::uint32_t x) {
+        while (parent[x] != x) x = parent[x] = parent[parent[x]];
+        return x;
+    }
+    void join(std::uint32_t a, std::uint32_t b) {
+        a = find(a);
+        b = find(b);
+        if (a != b) parent[std::max(a, b)] = std::min(a, b);
+    }
+};
+
+} // namespace
+
+DuplicateIndex::DuplicateIndex()
+    : entries(MemoryAccount::resource(MemoryCategory::Duplicates)),
+      freeSlots(MemoryAccount::resource(MemoryCategory::Duplicates)),
+      slotOf(MemoryAccount::resource(MemoryCategory::Duplicates)),
+      buckets(MemoryAccount::resource(MemoryCategory::Duplicates)) {
+}
+
+bool DuplicateIndex::signatureOf(const Item& item, Signature& sig) {
+    std::string text;
+    text.reserve(item.title.size() + item.content.size() + 1);
+    normalizeInto(item.title, text);
+    if (!text.empty() && text.back() != ' ') text.push_back(' ');
+    normalizeInto(item.content, text);
+    while (!text.empty() && text.back() == ' ') text.pop_back();
+    if (text.empty()) return false;
+
+    sig.fill(UINT32_MAX);
+    // Texts shorter than a shingle are one shingle
+    std::size_t count = text.size() < SHINGLE ? 1 : text.size() - SHINGLE + 1;
+    std::size_t width = std::min(SHINGLE, text.size());
+    for (std::size_t s = 0; s < count; ++s) {
+        std::uint64_t x = fnv1a(text.data() + s, width);
+        for (std::size_t i = 0; i < HASHES; ++i) {
+            auto h = static_cast<std::uint32_t>((HASH_FAMILY.a[i] * x + HASH_FAMILY.b[i]) >> 32);
+            if (h < sig[i]) sig[i] = h;
+        }
+    }
+    return true;
+}
+
+std::uint64_t DuplicateIndex::bandKey(const Signature& sig, std::size_t band) {
+    std::uint64_t h = splitmix64(band);
+    return fnv1a(reinterpret_cast<const char*>(sig.data() + band * ROWS), ROWS * sizeof(std::uint32_t), h);
+}
+
+double DuplicateIndex::similarity(const Signature& a, const Signature& b) {
+    std::size_t same = 0;
+    for (std::size_t i = 0; i < HASHES; ++i) same += a[i] == b[i];
+    return static_cast<double>(same) / static_cast<double>(HASHES);
+}
+
+void DuplicateIndex::insert(const std::string& id, const Signature& sig) {
+    std::uint32_t slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else {
+        slot = static_cast<std::uint32_t>(entries.size());
+        entries.emplace_back();
+    }
+    entries[slot] = Entry{ id, sig, true };
+    slotOf[id] = slot;
+    for (std::size_t band = 0; band < BANDS; ++band) buckets[bandKey(sig, band)].push_back(slot);
+}
+
+void DuplicateIndex::rebuild(const PersistentDeck& items) {
+    entries.clear();
+    freeSlots.clear();
+    slotOf.clear();
+    buckets.clear();
+
+    std::vector<Signature> sigs(items.size());
+    std::vector<char> hasText(items.size(), 0);
+    parallelFor(0, items.size(), 0, [&](std::size_t lo, std::size_t hi) {
+        items.forEachIn(lo, hi, [&](std::size_t i, const Item& it) { hasText[i] = signatureOf(it, sigs[i]); });
+    });
+
+    entries.reserve(items.size());
+    slotOf.reserve(items.size());
+    std::size_t i = 0;
+    items.forEach([&](const Item& it) {
+        if (hasText[i] && !slotOf.count(it.id)) insert(it.id, sigs[i]);
+        ++i;
+    });
+
+    ready = true;
+    spdlog::info("Duplicate index rebuilt: {} items, {} buckets", slotOf.size(), buckets.size());
+}
+
+void DuplicateIndex::addItem(const Item& item) {
+    if (!ready || slotOf.count(item.id)) return;
+    Signature sig;
+    if (signatureOf(item, sig)) insert(item.id, sig);
+}
+
+void DuplicateIndex::removeItem(const Item& item) {
+    if (!ready) return;
+    auto it = slotOf.find(item.id);
+    if (it == slotOf.end()) return;
+    std::uint32_t slot = it->second;
+    slotOf.erase(it);
+
+    Entry& e = entries[slot];
+    for (std::size_t band = 0; band < BANDS; ++band) {
+        auto b = buckets.find(bandKey(e.signature, band));
+        if (b == buckets.end()) continue;
+        auto& members = b->second;
+        members.erase(std::remove(members.begin(), members.end(), slot), members.end());
+        if (members.empty()) buckets.erase(b);
+    }
+    e.live = false;
+    e.id.clear();
+    freeSlots.push_back(slot);
+}
+
+std::vector<DuplicateIndex::Match> DuplicateIndex::similarTo(const Item& item, double threshold) const {
+    std::vector<Match> matches;
+    Signature sig;
+    auto self = slotOf.find(item.id);
+    if (self != slotOf.end()) sig = entries[self->second].signature;
+    else if (!signatureOf(item, sig)) return matches;
+
+    std::unordered_set<std::uint32_t> seen;
+    for (std::size_t band = 0; band < BANDS; ++band) {
+        auto b = buckets.find(bandKey(sig, band));
+        if (b == buckets.end()) continue;
+        for (std::uint32_t slot : b->second) {
+            if ((self != slotOf.end() && slot == self->second) || !seen.insert(slot).second) continue;
+            double s = similarity(sig, entries[slot].signature);
+            if (s >= threshold) matches.push_back({ entries[slot].id, s });
+        }
+    }
+
+    std::sort(matches.begin(), matches.end(), [](const Match& a, const Match& b) {
+        return a.similarity != b.similarity ? a.similarity > b.similarity : a.id < b.id;
+    });
+    return matches;
+}
+
+std::vector<std::vector<std::string>> DuplicateIndex::duplicateGroups(double threshold) const {
+    Components groups(entries.size());
+    auto link = [&](std::uint32_t a, std::uint32_t b) {
+        if (groups.find(a) != groups.find(b) && similarity(entries[a].signature, entries[b].signature) >= threshold)
+            groups.join(a, b);
+    };
+
+    for (const auto& b : buckets) {
+        const auto& members = b.second;
+        if (members.size() < 2) continue;
+        if (members.size() <= MAX_PAIRWISE_BUCKET) {
+            for (std::size_t i = 0; i < members.size(); ++i)
+                for (std::size_t j = i + 1; j < members.size(); ++j) link(members[i], members[j]);
+        }
+        else {
+            for (std::size_t j = 1; j < members.size(); ++j) link(members[0], members[j]);
+        }
+    }
+
+    std::unordered_map<std::uint32_t, std::vector<std::string>> byRoot;
+    for (std::uint32_t slot = 0; slot < entries.size(); ++slot)
+        if (entries[slot].live) byRoot[groups.find(slot)].push_back(entries[slot].id);
+
+    std::vector<std::vector<std::string>> result;
+    for (auto& g : byRoot) {
+        if (g.second.size() < 2) continue;
+        // IDs begin with the creation time in hex
+        std::sort(g.second.begin(), g.second.end());
+        result.push_back(std::move(g.second));
+    }
+    std::sort(result.begin(), result.end(), [](const auto& a, const auto& b) {
+        return a.size() != b.size() ? a.size() > b.size() : a.front() < b.front();
+    });
+    return result;
+}
+
+Item DuplicateIndex::merge(const std::vector<Item>& group, const SchedulerConfig& cfg) {
+    if (group.empty()) return Item();
+    Item merged = group.front();
+    bool reviewed = false;
+    for (std::size_t i = 1; i < group.size(); ++i) {
+        for (const auto& t : group[i].tags) merged.addTag(t);
+        if (merged.mergeHistory(group[i].history)) reviewed = true;
+        merged.is_leech = merged.is_leech || group[i].is_leech;
+    }
+    if (reviewed) replaySchedule(merged, cfg);
+
+    spdlog::info("Merged {} duplicates into '{}'", group.size() - 1, merged.title);
+    return merged;
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Item.hpp"
+#include "MemoryAccount.hpp"
+#include "PersistentDeck.hpp"
+#include "SchedulerConfig.hpp"
+
+// Near-duplicate cards, found without comparing every pair.
+//
+// An item's title and content are normalized (lower case, anything but
+// letters and digits folded to single spaces) and cut into overlapping
+// SHINGLE-character shingles. A MinHash signature of HASHES minima estimates
+// the Jaccard similarity of two items' shingle sets as the share of positions
+// where their signatures agree. LSH banding files each item under one bucket
+// per band of ROWS values, so only items agreeing on a whole band are ever
+// compared: a query is BANDS bucket lookups and the whole-deck report visits
+// each bucket once. With 16 bands of 4 rows a pair at 0.7 similarity shares a
+// bucket with probability about 0.99 (at 0.5: 0.64); candidates are kept only if
+// their estimated similarity reaches the threshold asked for.
+//
+// Like DeckStats, the index is built on demand (it needs content, so the deck
+// warm) and kept in step with addItem/removeItem afterwards; until the first
+// rebuild() those calls are ignored.
+class DuplicateIndex {
+public:
+    static constexpr std::size_t SHINGLE = 4;
+    static constexpr std::size_t BANDS = 16;
+    static constexpr std::size_t ROWS = 4;
+    static constexpr std::size_t HASHES = BANDS * ROWS;
+    static constexpr double DEFAULT_THRESHOLD = 0.7;
+    // Members of larger buckets (many near-identical cards) are compared with
+    // the bucket's first member only, keeping the report near-linear
+    static constexpr std::size_t MAX_PAIRWISE_BUCKET = 32;
+
+    struct Match {
+        std::string id;
+        double similarity = 0.0; // estimated Jaccard similarity of the shingle sets
+    };
+
+    DuplicateIndex();
+
+    // Signatures are computed in parallel on the shared thread pool, reading
+    // the deck's own items
+    void rebuild(const PersistentDeck& items);
+    bool isReady() const { return ready; }
+
+    // Call again (remove, then add) when an item's title or content changes
+    void addItem(const Item& item);
+    void removeItem(const Item& item);
+    std::size_t size() const { return slotOf.size(); }
+
+    // Indexed items similar to `item` (which need not be indexed itself),
+    // most similar first
+    std::vector<Match> similarTo(const Item& item, double threshold = DEFAULT_THRESHOLD) const;
+
+    // Groups of two or more items, each linked to another in its group by at
+    // least `threshold` similarity; largest groups first, IDs in creation order
+    std::vector<std::vector<std::string>> duplicateGroups(double threshold = DEFAULT_THRESHOLD) const;
+
+    // One item standing for a group of duplicates: group[0] with the tags of
+    // all of them and their review histories combined, its scheduling state
+    // replayed from that history
+    static Item merge(const std::vector<Item>& group, const SchedulerConfig& cfg);
+
+private:
+    using Signature = std::array<std::uint32_t, HASHES>;
+
+    struct Entry {
+        std::string id;
+        Signature signature{};
+        bool live = false;
+    };
+
+    bool ready = false;
+    std::pmr::vector<Entry> entries;
+    std::pmr::vector<std::uint32_t> freeSlots;
+    std::pmr::unordered_map<std::string, std::uint32_t> slotOf;
+    std::pmr::unordered_map<std::uint64_t, std::pmr::vector<std::uint32_t>> buckets; // band key -> slots
+
+    // False for an item with no text to compare
+    static bool signatureOf(const Item& item, Signature& sig);
+    static std::uint64_t bandKey(const Signature& sig, std::size_t band);
+    static double similarity(const Signature& a, const Signature& b);
+
+    void insert(const std::string& id, const Signature& sig);
+};
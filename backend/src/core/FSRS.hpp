@@ -0,0 +1,123 @@
+#pragma once
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+// FSRS-4.5 memory model (Free Spaced Repetition Scheduler).
+//
+// The formulas are templates over the scalar type so that the scheduler can
+// run them on plain doubles while the optimizer runs the very same code on
+// dual numbers to get the loss gradient in one forward pass.
+namespace fsrs {
+
+constexpr std::size_t PARAM_COUNT = 17;
+
+// Forgetting curve R(t, S) = (1 + FACTOR * t / S) ^ DECAY, chosen so R(S, S) = 0.9
+constexpr double DECAY = -0.5;
+constexpr double FACTOR = 19.0 / 81.0;
+
+constexpr double MIN_DIFFICULTY = 1.0;
+constexpr double MAX_DIFFICULTY = 10.0;
+constexpr double MIN_STABILITY = 0.01;
+constexpr int MAX_INTERVAL = 36500;
+
+// Published FSRS-4.5 defaults, used until a user has enough history to fit their own
+constexpr std::array<double, PARAM_COUNT> DEFAULT_WEIGHTS = {
+    0.4872, 1.4003, 3.7145, 13.8206, 5.1618, 1.2298, 0.8975, 0.031,
+    1.6474, 0.1367, 1.0461, 2.1072, 0.0793, 0.3246, 1.587, 0.2272, 2.8755
+};
+
+// Clipping ranges kept during optimization so the model stays well-formed
+constexpr std::array<double, PARAM_COUNT> WEIGHT_MIN = {
+    0.1, 0.1, 0.1, 0.1, 1.0, 0.1, 0.1, 0.0,
+    0.0, 0.0, 0.01, 0.1, 0.01, 0.01, 0.01, 0.0, 1.0
+};
+constexpr std::array<double, PARAM_COUNT> WEIGHT_MAX = {
+    100.0, 100.0, 100.0, 100.0, 10.0, 5.0, 5.0, 0.75,
+    4.5, 0.8, 3.5, 5.0, 0.2, 0.9, 2.0, 1.0, 6.0
+};
+
+template <class T>
+using Weights = std::array<T, PARAM_COUNT>;
+
+// FSRS rating (1 = Again .. 4 = Easy) from the SM-2 quality stored in ReviewRecord (1..5)
+inline int ratingFromSM2Quality(int smq) {
+    if (smq <= 2) return 1;
+    if (smq == 3) return 2;
+    if (smq == 4) return 3;
+    return 4;
+}
+
+template <class T>
+T clampValue(const T& v, double lo, double hi) {
+    if (v < lo) return T(lo);
+    if (v > hi) return T(hi);
+    return v;
+}
+
+template <class T>
+T retrievability(double elapsedDays, const T& stability) {
+    using std::pow;
+    return pow(1.0 + FACTOR * elapsedDays / stability, DECAY);
+}
+
+template <class T>
+T initStability(const Weights<T>& w, int rating) {
+    T s = w[rating - 1];
+    if (s < MIN_STABILITY) return T(MIN_STABILITY);
+    return s;
+}
+
+template <class T>
+T initDifficultyRaw(const Weights<T>& w, int rating) {
+    return w[4] - w[5] * static_cast<double>(rating - 3);
+}
+
+template <class T>
+T initDifficulty(const Weights<T>& w, int rating) {
+    return clampValue(initDifficultyRaw(w, rating), MIN_DIFFICULTY, MAX_DIFFICULTY);
+}
+
+template <class T>
+T nextDifficulty(const Weights<T>& w, const T& d, int rating) {
+    T next = d - w[6] * static_cast<double>(rating - 3);
+    // Mean reversion towards the difficulty of an "Easy" first review
+    next = w[7] * initDifficultyRaw(w, 4) + (1.0 - w[7]) * next;
+    return clampValue(next, MIN_DIFFICULTY, MAX_DIFFICULTY);
+}
+
+template <class T>
+T recallStability(const Weights<T>& w, const T& d, const T& s, const T& r, int rating) {
+    using std::exp;
+    using std::pow;
+    T growth = exp(w[8]) * (11.0 - d) * pow(s, -w[9]) * (exp((1.0 - r) * w[10]) - 1.0);
+    if (rating == 2) growth = growth * w[15];
+    else if (rating == 4) growth = growth * w[16];
+    return s * (growth + 1.0);
+}
+
+template <class T>
+T forgetStability(const Weights<T>& w, const T& d, const T& s, const T& r) {
+    using std::exp;
+    using std::pow;
+    T next = w[11] * pow(d, -w[12]) * (pow(s + 1.0, w[13]) - 1.0) * exp((1.0 - r) * w[14]);
+    if (next > s) next = s;
+    if (next < MIN_STABILITY) return T(MIN_STABILITY);
+    return next;
+}
+
+template <class T>
+T nextStability(const Weights<T>& w, const T& d, const T& s, const T& r, int rating) {
+    return rating == 1 ? forgetStability(w, d, s, r) : recallStability(w, d, s, r, rating);
+}
+
+// Days until recall probability drops to desiredRetention
+inline int nextInterval(double stability, double desiredRetention) {
+    double days = stability / FACTOR * (std::pow(desiredRetention, 1.0 / DECAY) - 1.0);
+    int rounded = static_cast<int>(std::round(days));
+    if (rounded < 1) return 1;
+    if (rounded > MAX_INTERVAL) return MAX_INTERVAL;
+    return rounded;
+}
+
+} // namespace fsrs
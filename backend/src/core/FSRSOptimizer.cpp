@@ -0,0 +1,305 @@
+#include "FSRSOptimizer.hpp"
+#include "../parallel/Parallel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <spdlog/spdlog.h>
+
+namespace {
+
+constexpr std::size_t N = fsrs::PARAM_COUNT;
+
+// Forward-mode dual number carrying d/dw for every FSRS weight.
+// The partials are a fixed-size array so the compiler can vectorize every op.
+struct Dual {
+    double v = 0.0;
+    std::array<double, N> d{};
+
+    Dual() = default;
+    Dual(double x) : v(x) {}
+};
+
+inline Dual operator+(const Dual& a, const Dual& b) {
+    Dual r(a.v + b.v);
+    for (std::size_t i = 0; i < N; ++i) r.d[i] = a.d[i] + b.d[i];
+    return r;
+}
+inline Dual operator+(const Dual& a, double b) { Dual r = a; r.v += b; return r; }
+inline Dual operator+(double a, const Dual& b) { return b + a; }
+
+inline Dual operator-(const Dual& a) {
+    Dual r(-a.v);
+    for (std::size_t i = 0; i < N; ++i) r.d[i] = -a.d[i];
+    return r;
+}
+inline Dual operator-(const Dual& a, const Dual& b) {
+    Dual r(a.v - b.v);
+    for (std::size_t i = 0; i < N; ++i) r.d[i] = a.d[i] - b.d[i];
+    return r;
+}
+inline Dual operator-(const Dual& a, double b) { Dual r = a; r.v -= b; return r; }
+inline Dual operator-(double a, const Dual& b) { Dual r = -b; r.v += a; return r; }
+
+inline Dual operator*(const Dual& a, const Dual& b) {
+    Dual r(a.v * b.v);
+    for (std::size_t i = 0; i < N; ++i) r.d[i] = a.d[i] * b.v + b.d[i] * a.v;
+    return r;
+}
+inline Dual operator*(const Dual& a, double b) {
+    Dual r(a.v * b);
+    for (std::size_t i = 0; i < N; ++i) r.d[i] = a.d[i] * b;
+    return r;
+}
+inline Dual operator*(double a, const Dual& b) { return b * a; }
+
+inline Dual operator/(const Dual& a, const Dual& b) {
+    Dual r(a.v / b.v);
+    for (std::size_t i = 0; i < N; ++i) r.d[i] = (a.d[i] - r.v * b.d[i]) / b.v;
+    return r;
+}
+inline Dual operator/(const Dual& a, double b) { return a * (1.0 / b); }
+inline Dual operator/(double a, const Dual& b) {
+    Dual r(a / b.v);
+    double k = -r.v / b.v;
+    for (std::size_t i = 0; i < N; ++i) r.d[i] = k * b.d[i];
+    return r;
+}
+
+inline bool operator<(const Dual& a, double b) { return a.v < b; }
+inline bool operator>(const Dual& a, double b) { return a.v > b; }
+inline bool operator>(const Dual& a, const Dual& b) { return a.v > b.v; }
+
+inline Dual exp(const Dual& a) {
+    Dual r(std::exp(a.v));
+    for (std::size_t i = 0; i < N; ++i) r.d[i] = a.d[i] * r.v;
+    return r;
+}
+inline Dual log(const Dual& a) {
+    Dual r(std::log(a.v));
+    double k = 1.0 / a.v;
+    for (std::size_t i = 0; i < N; ++i) r.d[i] = a.d[i] * k;
+    return r;
+}
+inline Dual pow(const Dual& a, double p) {
+    Dual r(std::pow(a.v, p));
+    double k = p * r.v / a.v;
+    for (std::size_t i = 0; i < N; ++i) r.d[i] = a.d[i] * k;
+    return r;
+}
+inline Dual pow(const Dual& a, const Dual& p) {
+    return exp(p * log(a));
+}
+
+constexpr double P_EPS = 1e-6;
+
+// Replay the given cards through the model and sum the log loss of every
+// prediction (all reviews except each card's first)
+template <class T>
+void accumulateLoss(const FSRSTrainingSet& data, const fsrs::Weights<T>& w,
+    const std::uint32_t* cards, std::size_t cardCount, T& lossSum, std::size_t& count)
+{
+    using std::log;
+
+    for (std::size_t k = 0; k < cardCount; ++k) {
+        std::uint32_t c = cards[k];
+        std::uint32_t begin = data.cardOffsets[c];
+        std::uint32_t end = data.cardOffsets[c + 1];
+        if (end - begin < 2) continue;
+
+        int g = data.ratings[begin];
+        T s = fsrs::initStability(w, g);
+        T d = fsrs::initDifficulty(w, g);
+
+        for (std::uint32_t i = begin + 1; i < end; ++i) {
+            g = data.ratings[i];
+            T r = fsrs::retrievability(static_cast<double>(data.elapsedDays[i]), s);
+
+            T p = fsrs::clampValue(r, P_EPS, 1.0 - P_EPS);
+            lossSum = lossSum - (g > 1 ? log(p) : log(1.0 - p));
+            ++count;
+
+            T nd = fsrs::nextDifficulty(w, d, g);
+            s = fsrs::nextStability(w, d, s, r, g);
+            d = nd;
+        }
+    }
+}
+
+unsigned resolveThreads(unsigned requested) {
+    return requested ? requested : static_cast<unsigned>(ThreadPool::shared().size());
+}
+
+// Mean log loss (and optionally its gradient) over a list of cards, split
+// evenly into `threads` parts run on the shared pool; each part reduces
+// privately and the parts are summed in order, so the result does not depend
+// on which worker ran what
+double evaluateCards(const FSRSTrainingSet& data, const std::uint32_t* cards, std::size_t cardCount,
+    const FSRSOptimizer::WeightArray& w, FSRSOptimizer::WeightArray* gradient, unsigned threads)
+{
+    if (gradient) gradient->fill(0.0);
+    if (cardCount == 0) return 0.0;
+
+    std::size_t parts = std::min<std::size_t>(threads, cardCount);
+    std::vector<Dual> partialLoss(parts);
+    std::vector<std::size_t> partialCount(parts, 0);
+
+    fsrs::Weights<Dual> wd;
+    fsrs::Weights<double> wv;
+    for (std::size_t i = 0; i < N; ++i) {
+        wd[i] = Dual(w[i]);
+        wd[i].d[i] = 1.0;
+        wv[i] = w[i];
+    }
+
+    auto work = [&](std::size_t p) {
+        std::size_t begin = cardCount * p / parts;
+        std::size_t end = cardCount * (p + 1) / parts;
+        if (gradient) {
+            accumulateLoss(data, wd, cards + begin, end - begin, partialLoss[p], partialCount[p]);
+        }
+        else {
+            double loss = 0.0;
+            accumulateLoss(data, wv, cards + begin, end - begin, loss, partialCount[p]);
+            partialLoss[p] = Dual(loss);
+        }
+    };
+
+    parallelFor(0, parts, 1, [&](std::size_t lo, std::size_t hi) {
+        for (std::size_t p = lo; p < hi; ++p) work(p);
+    });
+
+    Dual loss;
+    std::size_t count = 0;
+    for (std::size_t p = 0; p < parts; ++p) {
+        loss = loss + partialLoss[p];
+        count += partialCount[p];
+    }
+    if (count == 0) return 0.0;
+
+    double inv = 1.0 / static_cast<double>(count);
+    if (gradient)
+        for (std::size_t i = 0; i < N; ++i) (*gradient)[i] = loss.d[i] * inv;
+    return loss.v * inv;
+}
+
+std::vector<std::uint32_t> allCards(const FSRSTrainingSet& data) {
+    std::vector<std::uint32_t> cards(data.cardCount());
+    for (std::size_t c = 0; c < cards.size(); ++c) cards[c] = static_cast<std::uint32_t>(c);
+    return cards;
+}
+
+} // namespace
+
+FSRSTrainingSet FSRSOptimizer::buildTrainingSet(const std::vector<Item>& items) {
+    FSRSTrainingSet data;
+
+    std::size_t total = 0;
+    for (const auto& it : items)
+        if (it.history.size() >= 2) total += it.history.size();
+
+    data.elapsedDays.reserve(total);
+    data.ratings.reserve(total);
+    data.cardOffsets.push_back(0);
+
+    for (const auto& it : items) {
+        // A single review gives nothing to predict
+        if (it.history.size() < 2) continue;
+
+        for (std::size_t i = 0; i < it.history.size(); ++i) {
+            double elapsed = 0.0;
+            if (i > 0)
+                elapsed = std::max(0.0,
+                    std::difftime(it.history[i].timestamp, it.history[i - 1].timestamp) / 86400.0);
+
+            data.elapsedDays.push_back(static_cast<float>(elapsed));
+            data.ratings.push_back(static_cast<std::uint8_t>(fsrs::ratingFromSM2Quality(it.history[i].quality)));
+        }
+        data.cardOffsets.push_back(static_cast<std::uint32_t>(data.ratings.size()));
+    }
+
+    spdlog::debug("FSRS training set: {} cards, {} reviews", data.cardCount(), data.reviewCount());
+    return data;
+}
+
+double FSRSOptimizer::evaluate(const FSRSTrainingSet& data, const WeightArray& w,
+    WeightArray* gradient, unsigned threads)
+{
+    auto cards = allCards(data);
+    return evaluateCards(data, cards.data(), cards.size(), w, gradient, resolveThreads(threads));
+}
+
+FSRSOptimizer::Result FSRSOptimizer::fit(const FSRSTrainingSet& data, const WeightArray& start,
+    const Options& opts)
+{
+    Result res;
+    res.weights = start;
+    res.reviews = data.reviewCount() - data.cardCount();
+    if (data.cardCount() == 0) {
+        spdlog::warn("FSRS optimizer: no cards with at least two reviews; keeping weights");
+        return res;
+    }
+
+    unsigned threads = resolveThreads(opts.threads);
+
+    WeightArray w = start;
+    for (std::size_t i = 0; i < N; ++i)
+        w[i] = std::clamp(w[i], fsrs::WEIGHT_MIN[i], fsrs::WEIGHT_MAX[i]);
+
+    auto order = allCards(data);
+    res.initialLoss = evaluateCards(data, order.data(), order.size(), w, nullptr, threads);
+    res.finalLoss = res.initialLoss;
+    res.weights = w;
+
+    // Mini-batches of whole cards holding roughly batchReviews reviews each
+    double avgReviews = static_cast<double>(data.reviewCount()) / static_cast<double>(data.cardCount());
+    std::size_t batchCards = std::max<std::size_t>(1,
+        static_cast<std::size_t>(static_cast<double>(opts.batchReviews) / avgReviews));
+    std::size_t batchesPerEpoch = (order.size() + batchCards - 1) / batchCards;
+    std::size_t totalSteps = batchesPerEpoch * static_cast<std::size_t>(std::max(1, opts.epochs));
+
+    constexpr double beta1 = 0.9;
+    constexpr double beta2 = 0.999;
+    constexpr double eps = 1e-8;
+    constexpr double pi = 3.14159265358979323846;
+
+    WeightArray grad{}, m{}, v{};
+    double b1t = 1.0, b2t = 1.0;
+    std::size_t step = 0;
+    std::mt19937 rng(opts.seed);
+
+    for (int epoch = 0; epoch < opts.epochs; ++epoch) {
+        std::shuffle(order.begin(), order.end(), rng);
+
+        for (std::size_t b = 0; b < order.size(); b += batchCards) {
+            std::size_t n = std::min(batchCards, order.size() - b);
+            evaluateCards(data, order.data() + b, n, w, &grad, threads);
+
+            // Adam with cosine-annealed learning rate
+            double lr = opts.learningRate * 0.5 *
+                (1.0 + std::cos(pi * static_cast<double>(step) / static_cast<double>(totalSteps)));
+            ++step;
+            b1t *= beta1;
+            b2t *= beta2;
+
+            for (std::size_t i = 0; i < N; ++i) {
+                m[i] = beta1 * m[i] + (1.0 - beta1) * grad[i];
+                v[i] = beta2 * v[i] + (1.0 - beta2) * grad[i] * grad[i];
+                double mhat = m[i] / (1.0 - b1t);
+                double vhat = v[i] / (1.0 - b2t);
+                w[i] -= lr * mhat / (std::sqrt(vhat) + eps);
+                w[i] = std::clamp(w[i], fsrs::WEIGHT_MIN[i], fsrs::WEIGHT_MAX[i]);
+            }
+        }
+
+        double loss = evaluateCards(data, order.data(), order.size(), w, nullptr, threads);
+        res.iterations = epoch + 1;
+        if (loss < res.finalLoss) {
+            res.finalLoss = loss;
+            res.weights = w;
+        }
+    }
+
+    spdlog::info("FSRS optimizer: {} reviews, loss {:.5f} -> {:.5f} in {} epochs / {} steps ({} parts)",
+        res.reviews, res.initialLoss, res.finalLoss, res.iterations, step, threads);
+    return res;
+}
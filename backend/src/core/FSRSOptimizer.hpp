@@ -0,0 +1,54 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "FSRS.hpp"
+#include "Item.hpp"
+
+// Review log flattened into parallel arrays, one run of entries per card.
+// Entry i of a card holds the rating and the days elapsed since entry i-1.
+struct FSRSTrainingSet {
+    std::vector<float> elapsedDays;
+    std::vector<std::uint8_t> ratings;
+    std::vector<std::uint32_t> cardOffsets; // size = cards + 1
+
+    std::size_t cardCount() const { return cardOffsets.empty() ? 0 : cardOffsets.size() - 1; }
+    std::size_t reviewCount() const { return ratings.size(); }
+};
+
+// Fits FSRS weights to a user's review history by minimizing the log loss of
+// predicted recall against actual outcomes. Mini-batch Adam; every batch's loss
+// and gradient is evaluated in a single forward pass split across the shared
+// thread pool.
+class FSRSOptimizer {
+public:
+    using WeightArray = std::array<double, fsrs::PARAM_COUNT>;
+
+    struct Options {
+        int epochs = 5;
+        std::size_t batchReviews = 65536; // approximate reviews per mini-batch
+        double learningRate = 0.04;
+        unsigned seed = 42;               // shuffling is deterministic for a given seed
+        unsigned threads = 0;             // parts per pass on the shared pool; 0 = one per worker
+    };
+
+    struct Result {
+        WeightArray weights{};
+        double initialLoss = 0.0;
+        double finalLoss = 0.0;
+        std::size_t reviews = 0;   // reviews that contributed to the loss
+        int iterations = 0;        // epochs run
+    };
+
+    static FSRSTrainingSet buildTrainingSet(const std::vector<Item>& items);
+
+    // Mean log loss and its gradient w.r.t. every weight
+    static double evaluate(const FSRSTrainingSet& data, const WeightArray& w,
+        WeightArray* gradient, unsigned threads = 0);
+
+    static Result fit(const FSRSTrainingSet& data, const WeightArray& start,
+        const Options& opts);
+    static Result fit(const FSRSTrainingSet& data, const WeightArray& start) {
+        return fit(data, start, Options());
+    }
+};
@@ -4,12 +4,13 @@
 #include <iomanip>
 #include <algorithm>
 #include <cctype>
+#include <tuple>
 
-Item::Item(const std::string& t, const std::string& c)
+Item::Item(const std::string& t, const std::string& c, const Clock* clock)
     : title(t), content(c)
 {
     id = generateID();
-    last_review = std::time(nullptr);
+    last_review = (clock ? *clock : Clock::system()).now();
     next_review = last_review + 24 * 60 * 60;
     spdlog::info("Created Item: ID={}, Title={}", id, title);
 }
@@ -20,17 +21,40 @@ static inline void trim(std::string& s) {
 }
 
 void Item::scheduleNext(int days) {
-    using namespace std::chrono;
+    scheduleNext(days, Clock::system().now());
+}
 
+void Item::scheduleNext(int days, std::time_t now) {
     interval = days;
-    last_review = std::time(nullptr);
-
-    next_review = system_clock::to_time_t(system_clock::now() + hours(24 * days));
+    last_review = now;
+    next_review = now + static_cast<std::time_t>(days) * 24 * 60 * 60;
 
     spdlog::info("Item ID={} scheduled: interval={} days, next_review={}",
         id, interval, next_review);
 }
 
+bool Item::mergeHistory(const std::vector<ReviewRecord>& other) {
+    auto key = [](const ReviewRecord& r) { return std::make_tuple(r.timestamp, r.quality, r.interval_after); };
+    std::vector<decltype(key(ReviewRecord{}))> have;
+    have.reserve(history.size());
+    for (const auto& r : history) have.push_back(key(r));
+    std::sort(have.begin(), have.end());
+
+    bool added = false;
+    for (const auto& r : other) {
+        if (std::binary_search(have.begin(), have.end(), key(r))) continue;
+        history.push_back(r);
+        added = true;
+    }
+    if (!added) return false;
+
+    // Whole records break timestamp ties, so every merge order gives the same history
+    std::sort(history.begin(), history.end(), [&](const ReviewRecord& a, const ReviewRecord& b) { return key(a) < key(b); });
+    history.erase(std::unique(history.begin(), history.end(),
+        [&](const ReviewRecord& a, const ReviewRecord& b) { return key(a) == key(b); }), history.end());
+    return true;
+}
+
 void Item::addTag(const std::string& tag) {
     if (tag.empty()) return;
     std::string t = tag;
@@ -3,6 +3,7 @@
 #include <ctime>
 #include <vector>
 #include <spdlog/spdlog.h>
+#include "Clock.hpp"
 
 struct ReviewRecord {
     std::time_t timestamp;
@@ -13,11 +14,14 @@ struct ReviewRecord {
 class Item {
 public:
     Item() = default;
-    Item(const std::string& title, const std::string& content = "");
+    // Created (and first due) relative to clock, or system time when null
+    Item(const std::string& title, const std::string& content = "", const Clock* clock = nullptr);
 
     std::string id;
     std::string title;
     std::string content;
+    // Set when content is stored out of line in the BlobStore; refreshed before each save
+    std::string content_ref;
 
     int interval = 1;
     double ease_factor = 2.5;
@@ -29,11 +33,25 @@ public:
     int review_count = 0;
     int streak = 0;
 
+    // Scheduling algorithm state, persisted with the item
+    int reps = 0;              // SM-2: successful repetitions in a row
+    int base_interval = 1;     // SM-2: interval before tag priority shortening
+    double stability = 0.0;    // FSRS: memory stability in days (0 = not yet known)
+    double difficulty = 0.0;   // FSRS: difficulty 1..10
+
     std::vector<std::string> tags;
 
     std::vector<ReviewRecord> history;
 
+    // Content and history not yet decrypted (see DeckFile::ensureLoaded)
+    bool cold = false;
+
+    // Add the reviews of other not already in history, keeping history in
+    // time order; false if there were none
+    bool mergeHistory(const std::vector<ReviewRecord>& other);
+
     void scheduleNext(int days);
+    void scheduleNext(int days, std::time_t now);
 
     void addTag(const std::string& tag);
     bool removeTag(const std::string& tag);
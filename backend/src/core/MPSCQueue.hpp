@@ -0,0 +1,85 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+// Bounded lock-free queue for many producers and one consumer (Vyukov's
+// sequence-numbered ring). Each cell carries a sequence number that tells
+// producers and the consumer whose turn it is, so a push or pop is one CAS
+// (producers) or none (consumer) plus a release store, and never blocks.
+template <class T>
+class MPSCQueue {
+public:
+    // capacity is rounded up to a power of two
+    explicit MPSCQueue(std::size_t capacity) {
+        std::size_t cap = 2;
+        while (cap < capacity) cap <<= 1;
+        mask = cap - 1;
+        cells.reset(new Cell[cap]);
+        for (std::size_t i = 0; i < cap; ++i) cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    MPSCQueue(const MPSCQueue&) = delete;
+    MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+    // False if the queue is full; value is left untouched in that case
+    bool tryPush(T& value) {
+        std::size_t pos = tail.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells[pos & mask];
+            std::size_t seq = cell.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = std::move(value);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0) {
+                return false;
+            }
+            else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Consumer only
+    bool tryPop(T& out) {
+        Cell& cell = cells[head & mask];
+        std::size_t seq = cell.sequence.load(std::memory_order_acquire);
+        if (static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(head + 1) < 0) return false;
+
+        out = std::move(cell.value);
+        cell.value = T();
+        cell.sequence.store(head + mask + 1, std::memory_order_release);
+        ++head;
+        popped.store(head, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Approximate number of queued elements, safe to call from any thread
+    std::size_t depth() const {
+        std::size_t t = tail.load(std::memory_order_relaxed);
+        std::size_t h = popped.load(std::memory_order_relaxed);
+        return t > h ? t - h : 0;
+    }
+
+    std::size_t capacity() const { return mask + 1; }
+
+private:
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    std::size_t mask = 0;
+
+    alignas(64) std::atomic<std::size_t> tail{ 0 };
+    alignas(64) std::size_t head = 0;           // consumer-owned
+    std::atomic<std::size_t> popped{ 0 };       // head, published for depth()
+};
@@ -0,0 +1,86 @@
+#include "MemoryAccount.hpp"
+
+void MemoryAccount::Counter::add(std::size_t bytes) {
+    std::size_t now = current.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    std::size_t seen = peak.load(std::memory_order_relaxed);
+    while (now > seen && !peak.compare_exchange_weak(seen, now, std::memory_order_relaxed)) {
+    }
+}
+
+MemoryAccount::MemoryAccount(std::string name, std::shared_ptr<MemoryAccount> p)
+    : label(std::move(name)), parent(std::move(p)) {
+}
+
+const std::shared_ptr<MemoryAccount>& MemoryAccount::process() {
+    // Never destroyed: items and buffers released during static destruction still reach it
+    static auto* root = new std::shared_ptr<MemoryAccount>(std::make_shared<MemoryAccount>("process", nullptr));
+    return *root;
+}
+
+std::pmr::memory_resource* MemoryAccount::resource(MemoryCategory category) {
+    static auto* resources = [] {
+        auto* r = new std::array<TrackingResource*, CATEGORIES>();
+        for (std::size_t c = 0; c < CATEGORIES; ++c)
+            (*r)[c] = new TrackingResource(process(), static_cast<MemoryCategory>(c));
+        return r;
+    }();
+    return (*resources)[static_cast<std::size_t>(category)];
+}
+
+const char* MemoryAccount::categoryName(MemoryCategory category) {
+    switch (category) {
+    case MemoryCategory::Items: return "items";
+    case MemoryCategory::History: return "history";
+    case MemoryCategory::Tags: return "tags";
+    case MemoryCategory::DeckIndex: return "deck index";
+    case MemoryCategory::TagWeights: return "tag weights";
+    case MemoryCategory::Duplicates: return "duplicate index";
+    case MemoryCategory::Crypto: return "crypto buffers";
+    case MemoryCategory::PageCache: return "page cache";
+    default: return "unknown";
+    }
+}
+
+void MemoryAccount::charge(MemoryCategory category, std::size_t bytes) {
+    for (MemoryAccount* a = this; a; a = a->parent.get()) {
+        a->counters[static_cast<std::size_t>(category)].add(bytes);
+        a->all.add(bytes);
+    }
+}
+
+void MemoryAccount::release(MemoryCategory category, std::size_t bytes) {
+    for (MemoryAccount* a = this; a; a = a->parent.get()) {
+        a->counters[static_cast<std::size_t>(category)].sub(bytes);
+        a->all.sub(bytes);
+    }
+}
+
+MemoryAccount::Usage MemoryAccount::usage(MemoryCategory category) const {
+    const Counter& c = counters[static_cast<std::size_t>(category)];
+    return { c.current.load(std::memory_order_relaxed), c.peak.load(std::memory_order_relaxed) };
+}
+
+MemoryAccount::Usage MemoryAccount::total() const {
+    return { all.current.load(std::memory_order_relaxed), all.peak.load(std::memory_order_relaxed) };
+}
+
+void MemoryAccount::resetPeaks() {
+    for (auto& c : counters) c.peak.store(c.current.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    all.peak.store(all.current.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+std::size_t heapBytes(const std::string& s) {
+    static const std::size_t inlineCapacity = std::string().capacity();
+    return s.capacity() > inlineCapacity ? s.capacity() + 1 : 0;
+}
+
+void* TrackingResource::do_allocate(std::size_t bytes, std::size_t align) {
+    void* p = upstream->allocate(bytes, align);
+    account->charge(category, bytes);
+    return p;
+}
+
+void TrackingResource::do_deallocate(void* p, std::size_t bytes, std::size_t align) {
+    upstream->deallocate(p, bytes, align);
+    account->release(category, bytes);
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <string>
+
+enum class MemoryCategory {
+    Items,      // Item objects and their ID, title and content strings
+    History,    // review history records
+    Tags,       // tag lists on items
+    DeckIndex,  // persistent deck tree nodes (shared between versions and the undo log), item slots
+    TagWeights, // TagManager::weights
+    Duplicates, // DuplicateIndex signatures and buckets
+    Crypto,     // ciphertext and plaintext scratch buffers (SecureBufferPool)
+    PageCache,  // PagedStore buffer pool frames
+    Count
+};
+
+// Current and peak bytes per category, for one deck or the whole process.
+// Charges made to an account are also made to its parent, so the process
+// account sees every deck. Counters are atomic; charging never blocks.
+//
+// Memory is charged where it is allocated through TrackingAllocator or a
+// TrackingResource (std::pmr), or explicitly for sizes an allocator cannot
+// see (heap owned by an item's strings and vectors, charged as a whole when
+// the item is shared into a deck and released when its last copy goes).
+class MemoryAccount {
+public:
+    struct Usage {
+        std::size_t current = 0;
+        std::size_t peak = 0;
+    };
+
+    explicit MemoryAccount(std::string name, std::shared_ptr<MemoryAccount> parent = process());
+    MemoryAccount(const MemoryAccount&) = delete;
+    MemoryAccount& operator=(const MemoryAccount&) = delete;
+
+    // Root account, alive for the whole program
+    static const std::shared_ptr<MemoryAccount>& process();
+
+    // pmr resource charging a category of the process account
+    static std::pmr::memory_resource* resource(MemoryCategory category);
+
+    static const char* categoryName(MemoryCategory category);
+
+    void charge(MemoryCategory category, std::size_t bytes);
+    void release(MemoryCategory category, std::size_t bytes);
+
+    Usage usage(MemoryCategory category) const;
+    Usage total() const;
+    const std::string& name() const { return label; }
+
+    // Start peaks again from the current values (e.g. per benchmark phase)
+    void resetPeaks();
+
+private:
+    static constexpr std::size_t CATEGORIES = static_cast<std::size_t>(MemoryCategory::Count);
+
+    struct Counter {
+        std::atomic<std::size_t> current{ 0 };
+        std::atomic<std::size_t> peak{ 0 };
+        void add(std::size_t bytes);
+        void sub(std::size_t bytes) { current.fetch_sub(bytes, std::memory_order_relaxed); }
+    };
+
+    std::string label;
+    std::shared_ptr<MemoryAccount> parent;
+    std::array<Counter, CATEGORIES> counters;
+    Counter all;
+};
+
+// Heap bytes a string owns beyond its own object (0 while it fits the small buffer)
+std::size_t heapBytes(const std::string& s);
+
+// Charges every allocation to one category of an account
+class TrackingResource : public std::pmr::memory_resource {
+public:
+    TrackingResource(std::shared_ptr<MemoryAccount> account, MemoryCategory category,
+        std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+        : account(std::move(account)), category(category), upstream(upstream) {
+    }
+
+private:
+    std::shared_ptr<MemoryAccount> account;
+    MemoryCategory category;
+    std::pmr::memory_resource* upstream;
+
+    void* do_allocate(std::size_t bytes, std::size_t align) override;
+    void do_deallocate(void* p, std::size_t bytes, std::size_t align) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
+
+// Standard allocator charging one category of an account, e.g. for allocate_shared
+template <class T>
+class TrackingAllocator {
+public:
+    using value_type = T;
+
+    TrackingAllocator(std::shared_ptr<MemoryAccount> account, MemoryCategory category)
+        : account(std::move(account)), category(category) {
+    }
+
+    template <class U>
+    TrackingAllocator(const TrackingAllocator<U>& other) : account(other.account), category(other.category) {}
+
+    T* allocate(std::size_t n) {
+        T* p = static_cast<T*>(::operator new(n * sizeof(T)));
+        account->charge(category, n * sizeof(T));
+        return p;
+    }
+
+    void deallocate(T* p, std::size_t n) {
+        ::operator delete(p);
+        account->release(category, n * sizeof(T));
+    }
+
+    template <class U>
+    bool operator==(const TrackingAllocator<U>& other) const { return account == other.account && category == other.category; }
+    template <class U>
+    bool operator!=(const TrackingAllocator<U>& other) const { return !(*this == other); }
+
+    std::shared_ptr<MemoryAccount> account;
+    MemoryCategory category;
+};
@@ -0,0 +1,187 @@
+#include "PersistentDeck.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+
+namespace {
+
+    // Charges the allocation holding an item like TrackingAllocator, and the
+    // heap owned by the item's strings and vectors from construction to
+    // destruction. Shared items are const, so those sizes cannot drift.
+    template <class T>
+    struct ItemAllocator : TrackingAllocator<T> {
+        using TrackingAllocator<T>::TrackingAllocator;
+        template <class U>
+        ItemAllocator(const ItemAllocator<U>& other) : TrackingAllocator<T>(other) {}
+
+        template <class U, class... Args>
+        void construct(U* p, Args&&... args) {
+            ::new (const_cast<void*>(static_cast<const volatile void*>(p))) U(std::forward<Args>(args)...);
+            if constexpr (std::is_same<std::remove_cv_t<U>, Item>::value) chargeContents(*p, true);
+        }
+
+        template <class U>
+        void destroy(U* p) {
+            if constexpr (std::is_same<std::remove_cv_t<U>, Item>::value) chargeContents(*p, false);
+            p->~U();
+        }
+
+        void chargeContents(const Item& it, bool charge) const {
+            std::size_t strings = heapBytes(it.id) + heapBytes(it.title) + heapBytes(it.content) + heapBytes(it.content_ref);
+            std::size_t history = it.history.capacity() * sizeof(ReviewRecord);
+            std::size_t tags = it.tags.capacity() * sizeof(std::string);
+            for (const auto& t : it.tags) tags += heapBytes(t);
+
+            auto apply = [&](MemoryCategory c, std::size_t bytes) {
+                if (bytes == 0) return;
+                if (charge) this->account->charge(c, bytes);
+                else this->account->release(c, bytes);
+            };
+            apply(MemoryCategory::Items, strings);
+            apply(MemoryCategory::History, history);
+            apply(MemoryCategory::Tags, tags);
+        }
+    };
+
+} // namespace
+
+PersistentDeck::ItemPtr PersistentDeck::share(Item item, const std::shared_ptr<MemoryAccount>& account) {
+    return std::allocate_shared<const Item>(ItemAllocator<Item>(account, MemoryCategory::Items), std::move(item));
+}
+
+PersistentDeck::NodePtr PersistentDeck::make(NodePtr left, ItemPtr item, NodePtr right) {
+    static const TrackingAllocator<Node> nodes(MemoryAccount::process(), MemoryCategory::DeckIndex);
+    std::size_t size = sizeOf(left) + sizeOf(right) + 1;
+    int height = std::max(heightOf(left), heightOf(right)) + 1;
+    return std::allocate_shared<const Node>(nodes, Node{ std::move(left), std::move(right), std::move(item), size, height });
+}
+
+// Join two subtrees whose heights differ by at most two around item
+PersistentDeck::NodePtr PersistentDeck::balance(NodePtr left, ItemPtr item, NodePtr right) {
+    int hl = heightOf(left);
+    int hr = heightOf(right);
+
+    if (hl > hr + 1) {
+        if (heightOf(left->left) >= heightOf(left->right))
+            return make(left->left, left->item, make(left->right, std::move(item), std::move(right)));
+        const Node& lr = *left->right;
+        return make(make(left->left, left->item, lr.left), lr.item, make(lr.right, std::move(item), std::move(right)));
+    }
+
+    if (hr > hl + 1) {
+        if (heightOf(right->right) >= heightOf(right->left))
+            return make(make(std::move(left), std::move(item), right->left), right->item, right->right);
+        const Node& rl = *right->left;
+        return make(make(std::move(left), std::move(item), rl.left), rl.item, make(rl.right, right->item, right->right));
+    }
+
+    return make(std::move(left), std::move(item), std::move(right));
+}
+
+PersistentDeck::NodePtr PersistentDeck::setAt(const NodePtr& n, std::size_t i, ItemPtr item) {
+    std::size_t ls = sizeOf(n->left);
+    if (i < ls) return make(setAt(n->left, i, std::move(item)), n->item, n->right);
+    if (i > ls) return make(n->left, n->item, setAt(n->right, i - ls - 1, std::move(item)));
+    return make(n->left, std::move(item), n->right);
+}
+
+// Updates in [first, last) all fall inside n, whose first position is base
+PersistentDeck::NodePtr PersistentDeck::setRange(const NodePtr& n, std::size_t base, const Update* first, const Update* last) {
+    if (first == last) return n;
+
+    std::size_t pos = base + sizeOf(n->left);
+    const Update* mid = std::lower_bound(first, last, pos,
+        [](const Update& u, std::size_t p) { return u.first < p; });
+    const Update* after = (mid != last && mid->first == pos) ? mid + 1 : mid;
+
+    return make(setRange(n->left, base, first, mid),
+        mid != after ? mid->second : n->item,
+        setRange(n->right, pos + 1, after, last));
+}
+
+PersistentDeck::NodePtr PersistentDeck::insertAt(const NodePtr& n, std::size_t i, ItemPtr item) {
+    if (!n) return make(nullptr, std::move(item), nullptr);
+
+    std::size_t ls = sizeOf(n->left);
+    if (i <= ls) return balance(insertAt(n->left, i, std::move(item)), n->item, n->right);
+    return balance(n->left, n->item, insertAt(n->right, i - ls - 1, std::move(item)));
+}
+
+PersistentDeck::NodePtr PersistentDeck::eraseFirst(const NodePtr& n, ItemPtr& first) {
+    if (!n->left) {
+        first = n->item;
+        return n->right;
+    }
+    return balance(eraseFirst(n->left, first), n->item, n->right);
+}
+
+PersistentDeck::NodePtr PersistentDeck::eraseAt(const NodePtr& n, std::size_t i) {
+    std::size_t ls = sizeOf(n->left);
+    if (i < ls) return balance(eraseAt(n->left, i), n->item, n->right);
+    if (i > ls) return balance(n->left, n->item, eraseAt(n->right, i - ls - 1));
+
+    if (!n->left) return n->right;
+    if (!n->right) return n->left;
+
+    ItemPtr successor;
+    NodePtr right = eraseFirst(n->right, successor);
+    return balance(n->left, std::move(successor), std::move(right));
+}
+
+PersistentDeck::NodePtr PersistentDeck::build(std::vector<ItemPtr>& items, std::size_t begin, std::size_t end) {
+    if (begin >= end) return nullptr;
+    std::size_t mid = begin + (end - begin) / 2;
+    NodePtr left = build(items, begin, mid);
+    NodePtr right = build(items, mid + 1, end);
+    return make(std::move(left), std::move(items[mid]), std::move(right));
+}
+
+PersistentDeck PersistentDeck::fromVector(std::vector<Item> items, const std::shared_ptr<MemoryAccount>& account) {
+    std::vector<ItemPtr> ptrs;
+    ptrs.reserve(items.size());
+    for (auto& it : items) ptrs.push_back(share(std::move(it), account));
+    return PersistentDeck(build(ptrs, 0, ptrs.size()));
+}
+
+std::vector<Item> PersistentDeck::toVector() const {
+    std::vector<Item> out;
+    out.reserve(size());
+    forEach([&](const Item& it) { out.push_back(it); });
+    return out;
+}
+
+PersistentDeck::ItemPtr PersistentDeck::ptr(std::size_t i) const {
+    if (i >= size()) throw std::out_of_range("PersistentDeck index out of range");
+
+    const Node* n = root.get();
+    while (true) {
+        std::size_t ls = sizeOf(n->left);
+        if (i < ls) n = n->left.get();
+        else if (i > ls) { i -= ls + 1; n = n->right.get(); }
+        else return n->item;
+    }
+}
+
+PersistentDeck PersistentDeck::set(std::size_t i, ItemPtr item) const {
+    if (i >= size()) throw std::out_of_range("PersistentDeck index out of range");
+    return PersistentDeck(setAt(root, i, std::move(item)));
+}
+
+PersistentDeck PersistentDeck::setMany(const std::vector<Update>& updates) const {
+    if (updates.empty()) return *this;
+    for (std::size_t k = 1; k < updates.size(); ++k)
+        if (updates[k].first <= updates[k - 1].first)
+            throw std::invalid_argument("PersistentDeck::setMany positions must be increasing");
+    if (updates.back().first >= size()) throw std::out_of_range("PersistentDeck index out of range");
+    return PersistentDeck(setRange(root, 0, updates.data(), updates.data() + updates.size()));
+}
+
+PersistentDeck PersistentDeck::insert(std::size_t i, ItemPtr item) const {
+    if (i > size()) throw std::out_of_range("PersistentDeck index out of range");
+    return PersistentDeck(insertAt(root, i, std::move(item)));
+}
+
+PersistentDeck PersistentDeck::erase(std::size_t i) const {
+    if (i >= size()) throw std::out_of_range("PersistentDeck index out of range");
+    return PersistentDeck(eraseAt(root, i));
+}
@@ -0,0 +1,138 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "Item.hpp"
+#include "MemoryAccount.hpp"
+
+// Immutable, structurally shared sequence of items (an AVL tree keyed by
+// position). set/insert/erase return a new deck in O(log n) that shares every
+// untouched node and item with this one, so keeping old versions costs only
+// the changed paths and a deck can be read from any thread without locking.
+//
+// Items shared into a deck are charged to a MemoryAccount (their own bytes
+// and what their strings and vectors own) until the last version holding them
+// goes; tree nodes are charged to the process account.
+class PersistentDeck {
+public:
+    using ItemPtr = std::shared_ptr<const Item>;
+
+    PersistentDeck() = default;
+
+    // Freeze item for use in decks, charged to account
+    static ItemPtr share(Item item, const std::shared_ptr<MemoryAccount>& account = MemoryAccount::process());
+
+    static PersistentDeck fromVector(std::vector<Item> items,
+        const std::shared_ptr<MemoryAccount>& account = MemoryAccount::process());
+    std::vector<Item> toVector() const;
+
+    std::size_t size() const { return sizeOf(root); }
+    bool empty() const { return !root; }
+
+    const Item& operator[](std::size_t i) const { return *ptr(i); }
+    ItemPtr ptr(std::size_t i) const;
+
+    PersistentDeck set(std::size_t i, ItemPtr item) const;
+    // Many replacements in one pass, O(k log(n/k)) for k updates. Positions
+    // must be strictly increasing.
+    using Update = std::pair<std::size_t, ItemPtr>;
+    PersistentDeck setMany(const std::vector<Update>& updates) const;
+    PersistentDeck insert(std::size_t i, ItemPtr item) const;
+    PersistentDeck erase(std::size_t i) const;
+
+    PersistentDeck set(std::size_t i, Item item) const { return set(i, share(std::move(item))); }
+    PersistentDeck pushBack(Item item) const { return insert(size(), share(std::move(item))); }
+
+    // In-order traversal: fn(const Item&)
+    template <class Fn>
+    void forEach(Fn&& fn) const { visit(root.get(), fn); }
+
+    // In-order traversal handing out the shared items: fn(const ItemPtr&)
+    template <class Fn>
+    void forEachPtr(Fn&& fn) const { visitPtr(root.get(), fn); }
+
+    // Positions [begin, end) in order: fn(std::size_t index, const Item&).
+    // O(log n + count), so parallel loops can give each chunk its own range.
+    template <class Fn>
+    void forEachIn(std::size_t begin, std::size_t end, Fn&& fn) const { visitRange(root.get(), 0, begin, end, fn); }
+
+    // First position whose item fails pred, for a pred that holds on a prefix
+    // of the deck (binary search down the tree, O(log n) calls)
+    template <class Pred>
+    std::size_t partitionPoint(Pred&& pred) const {
+        std::size_t base = 0;
+        const Node* n = root.get();
+        while (n) {
+            if (pred(*n->item)) {
+                base += sizeOf(n->left) + 1;
+                n = n->right.get();
+            }
+            else {
+                n = n->left.get();
+            }
+        }
+        return base;
+    }
+
+    // True if both decks are the same version (not merely equal contents)
+    bool sameVersion(const PersistentDeck& other) const { return root == other.root; }
+
+private:
+    struct Node;
+    using NodePtr = std::shared_ptr<const Node>;
+
+    struct Node {
+        NodePtr left;
+        NodePtr right;
+        ItemPtr item;
+        std::size_t size;
+        int height;
+    };
+
+    NodePtr root;
+
+    explicit PersistentDeck(NodePtr r) : root(std::move(r)) {}
+
+    static std::size_t sizeOf(const NodePtr& n) { return n ? n->size : 0; }
+    static int heightOf(const NodePtr& n) { return n ? n->height : 0; }
+
+    static NodePtr make(NodePtr left, ItemPtr item, NodePtr right);
+    static NodePtr balance(NodePtr left, ItemPtr item, NodePtr right);
+    static NodePtr setAt(const NodePtr& n, std::size_t i, ItemPtr item);
+    static NodePtr setRange(const NodePtr& n, std::size_t base, const Update* first, const Update* last);
+    static NodePtr insertAt(const NodePtr& n, std::size_t i, ItemPtr item);
+    static NodePtr eraseAt(const NodePtr& n, std::size_t i);
+    static NodePtr eraseFirst(const NodePtr& n, ItemPtr& first);
+    static NodePtr build(std::vector<ItemPtr>& items, std::size_t begin, std::size_t end);
+
+    template <class Fn>
+    static void visit(const Node* n, Fn& fn) {
+        while (n) {
+            visit(n->left.get(), fn);
+            fn(*n->item);
+            n = n->right.get();
+        }
+    }
+
+    template <class Fn>
+    static void visitPtr(const Node* n, Fn& fn) {
+        while (n) {
+            visitPtr(n->left.get(), fn);
+            fn(n->item);
+            n = n->right.get();
+        }
+    }
+
+    template <class Fn>
+    static void visitRange(const Node* n, std::size_t base, std::size_t lo, std::size_t hi, Fn& fn) {
+        while (n) {
+            std::size_t pos = base + sizeOf(n->left);
+            if (lo < pos) visitRange(n->left.get(), base, lo, hi, fn);
+            if (pos >= hi) return;
+            if (pos >= lo) fn(pos, *n->item);
+            base = pos + 1;
+            n = n->right.get();
+        }
+    }
+};
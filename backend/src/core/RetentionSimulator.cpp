@@ -0,0 +1,178 @@
+#include "RetentionSimulator.hpp"
+#include "Clock.hpp"
+#include "Scheduler.hpp"
+#include "../parallel/Parallel.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+#include <spdlog/spdlog.h>
+
+static constexpr std::time_t DAY = 24 * 60 * 60;
+
+double RetentionSimulator::Learner::recallProbability(double elapsedDays, double stability) const {
+    double t = std::max(0.0, elapsedDays);
+    double s = std::max(0.01, stability);
+    if (curve == Curve::Exponential) return std::pow(0.9, t / s);
+    return 1.0 / (1.0 + t / (9.0 * s));
+}
+
+namespace {
+
+    // What the learner actually knows about one card
+    struct Memory {
+        double stability = 0.0;
+        double ease = 1.0;        // per-card multiplier on growth (easier cards grow faster)
+        std::time_t lastSeen = 0;
+    };
+
+    struct SeedResult {
+        std::uint64_t reviews = 0;
+        std::uint64_t recalls = 0;
+        int peakPerDay = 0;
+        double recallSum = 0.0;   // recall probability summed over studied cards at the end
+        std::size_t cards = 0;
+        double retentionMin = 1.0;
+        double retentionMax = 0.0;
+        int seeds = 0;
+    };
+
+    ReviewQuality grade(const RetentionSimulator::Learner& l, bool recalled, double r) {
+        if (!recalled) return ReviewQuality::AGAIN;
+        if (r > l.easyAbove) return ReviewQuality::EASY;
+        if (r < l.hardBelow) return ReviewQuality::HARD;
+        return ReviewQuality::GOOD;
+    }
+
+    template <class Policy>
+    SeedResult simulateSeed(const SchedulerConfig& config, const RetentionSimulator::Options& opts,
+        std::uint64_t seed) {
+        const auto& learner = opts.learner;
+        std::mt19937_64 rng(seed);
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        std::lognormal_distribution<double> firstStability(std::log(learner.initialStability), learner.stabilitySpread);
+
+        VirtualClock clock(opts.start);
+        BasicScheduler<Policy> scheduler(nullptr, &config, nullptr, nullptr, &clock);
+
+        // Cards are never removed, so slot i holds the card whose memory is memory[i]
+        SlotMap<Item> cards;
+        std::vector<Memory> memory;
+        cards.reserve(static_cast<std::size_t>(std::max(0, opts.deckSize)));
+        memory.reserve(static_cast<std::size_t>(std::max(0, opts.deckSize)));
+
+        SeedResult out;
+        out.seeds = 1;
+
+        for (int day = 0; day < opts.days; ++day) {
+            clock.set(opts.start + day * DAY);
+
+            // Reviews first, then today's new cards (which are studied, not tested)
+            auto due = scheduler.getDueItems(cards);
+            if (opts.maxReviewsPerDay > 0 && due.size() > static_cast<std::size_t>(opts.maxReviewsPerDay))
+                due.resize(static_cast<std::size_t>(opts.maxReviewsPerDay));
+
+            for (SlotHandle card : due) {
+                Memory& m = memory[card.index];
+                double elapsed = static_cast<double>(clock.now() - m.lastSeen) / DAY;
+                double r = learner.recallProbability(elapsed, m.stability);
+                bool recalled = uniform(rng) < r;
+
+                if (recalled) {
+                    m.stability *= 1.0 + learner.growth * m.ease * std::exp(learner.spacingBonus * (1.0 - r));
+                    ++out.recalls;
+                }
+                else {
+                    m.stability = std::max(0.1, m.stability * learner.lapseFactor);
+                }
+                m.lastSeen = clock.now();
+
+                scheduler.review(*cards.get(card), grade(learner, recalled, r));
+                ++out.reviews;
+            }
+            out.peakPerDay = std::max(out.peakPerDay, static_cast<int>(due.size()));
+
+            for (int n = 0; n < opts.newPerDay && static_cast<int>(cards.size()) < opts.deckSize; ++n) {
+                SlotHandle card = cards.insert(Item("card", "", &clock));
+                Memory m;
+                m.stability = firstStability(rng);
+                m.ease = 0.5 + uniform(rng);
+                m.lastSeen = clock.now();
+                memory.push_back(m);
+                scheduler.review(*cards.get(card), ReviewQuality::GOOD);
+            }
+        }
+
+        std::time_t end = opts.start + opts.days * DAY;
+        for (const auto& m : memory)
+            out.recallSum += learner.recallProbability(static_cast<double>(end - m.lastSeen) / DAY, m.stability);
+        out.cards = memory.size();
+
+        double retention = out.reviews ? static_cast<double>(out.recalls) / out.reviews : 0.0;
+        out.retentionMin = out.retentionMax = retention;
+        return out;
+    }
+
+    SeedResult combine(SeedResult a, const SeedResult& b) {
+        if (b.seeds == 0) return a;
+        if (a.seeds == 0) return b;
+        a.reviews += b.reviews;
+        a.recalls += b.recalls;
+        a.peakPerDay = std::max(a.peakPerDay, b.peakPerDay);
+        a.recallSum += b.recallSum;
+        a.cards += b.cards;
+        a.retentionMin = std::min(a.retentionMin, b.retentionMin);
+        a.retentionMax = std::max(a.retentionMax, b.retentionMax);
+        a.seeds += b.seeds;
+        return a;
+    }
+
+    // Millions of reviews would otherwise each write an info line
+    struct QuietLog {
+        spdlog::level::level_enum previous = spdlog::get_level();
+        QuietLog() { if (previous < spdlog::level::warn) spdlog::set_level(spdlog::level::warn); }
+        ~QuietLog() { spdlog::set_level(previous); }
+    };
+
+} // namespace
+
+RetentionSimulator::Report RetentionSimulator::run(const SchedulerConfig& config, const Options& opts,
+    ThreadPool* pool) {
+    Report report;
+    if (opts.seeds <= 0 || opts.days <= 0) return report;
+
+    auto started = std::chrono::steady_clock::now();
+    SeedResult total;
+    {
+        QuietLog quiet;
+        auto one = [&](std::size_t lo, std::size_t hi) {
+            SeedResult acc;
+            for (std::size_t i = lo; i < hi; ++i) {
+                std::uint64_t seed = opts.firstSeed + i;
+                acc = combine(std::move(acc), config.algorithm == SchedulerAlgorithm::FSRS
+                    ? simulateSeed<FSRSPolicy>(config, opts, seed)
+                    : simulateSeed<SM2Policy>(config, opts, seed));
+            }
+            return acc;
+        };
+        total = parallelReduce(pool ? *pool : ThreadPool::shared(), 0, static_cast<std::size_t>(opts.seeds), 1,
+            SeedResult{}, one, combine);
+    }
+    report.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    report.seeds = total.seeds;
+    report.reviews = total.reviews;
+    report.recalls = total.recalls;
+    report.retention = total.reviews ? static_cast<double>(total.recalls) / total.reviews : 0.0;
+    report.retentionMin = total.retentionMin;
+    report.retentionMax = total.retentionMax;
+    report.reviewsPerDay = static_cast<double>(total.reviews) / (static_cast<double>(opts.days) * total.seeds);
+    report.peakReviewsPerDay = total.peakPerDay;
+    report.finalRecall = total.cards ? total.recallSum / total.cards : 0.0;
+    report.nsPerReview = total.reviews ? report.wallSeconds * 1e9 / total.reviews : 0.0;
+
+    spdlog::info("Simulated {} reviews over {} seeds x {} days: retention {:.3f}, {:.0f} ns/review",
+        report.reviews, report.seeds, opts.days, report.retention, report.nsPerReview);
+    return report;
+}
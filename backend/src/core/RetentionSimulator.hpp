@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <ctime>
+#include "SchedulerConfig.hpp"
+
+class ThreadPool;
+
+// Runs synthetic learners against the scheduler on a virtual clock, one
+// simulated deck per seed, seeds in parallel. Each card has a hidden memory
+// stability the scheduler never sees; whether a review is recalled is drawn
+// from the learner's forgetting curve, so retention and workload measure how
+// well the scheduler's model fits the "true" one. Results are reproducible:
+// a given seed always produces the same deck, and per-seed results are
+// combined in seed order regardless of thread count.
+class RetentionSimulator {
+public:
+    enum class Curve {
+        Exponential, // R = 0.9^(t/S)
+        PowerLaw     // R = (1 + t/(9S))^-1, the FSRS shape
+    };
+
+    // How the synthetic learner remembers
+    struct Learner {
+        Curve curve = Curve::PowerLaw;
+        double initialStability = 2.0;  // days to 90% recall after first study (median)
+        double stabilitySpread = 0.5;   // log-normal sigma of the above across cards
+        double growth = 1.6;            // stability gain per successful recall
+        double spacingBonus = 1.2;      // extra gain for recalling at low retrievability
+        double lapseFactor = 0.3;       // fraction of stability kept after forgetting
+        double easyAbove = 0.95;        // recalled with R above this -> EASY
+        double hardBelow = 0.7;         // recalled with R below this -> HARD
+
+        double recallProbability(double elapsedDays, double stability) const;
+    };
+
+    struct Options {
+        int days = 365;
+        int deckSize = 1000;
+        int newPerDay = 10;
+        int maxReviewsPerDay = 0;        // 0 = no cap; the rest wait until tomorrow
+        int seeds = 16;
+        std::uint64_t firstSeed = 1;
+        std::time_t start = 1700000000;  // fixed so runs compare across days
+        Learner learner;
+    };
+
+    struct Report {
+        int seeds = 0;
+        std::uint64_t reviews = 0;       // excludes the first study of each card
+        std::uint64_t recalls = 0;
+        double retention = 0.0;          // recalls / reviews
+        double retentionMin = 0.0;       // worst and best seed
+        double retentionMax = 0.0;
+        double reviewsPerDay = 0.0;      // mean per simulated deck
+        int peakReviewsPerDay = 0;
+        double finalRecall = 0.0;        // mean recall probability of studied cards on the last day
+        double wallSeconds = 0.0;
+        double nsPerReview = 0.0;        // wall time / simulated reviews
+    };
+
+    // pool = nullptr uses the shared pool
+    static Report run(const SchedulerConfig& config, const Options& opts, ThreadPool* pool = nullptr);
+};
@@ -0,0 +1,80 @@
+#include "ReviewForecast.hpp"
+#include <spdlog/spdlog.h>
+
+ReviewForecast::ReviewForecast(std::time_t now)
+    : origin(dayOf(now)) {
+}
+
+long ReviewForecast::dayOf(std::time_t t) {
+    // floor division so times before the epoch land on the right day
+    long q = static_cast<long>(t / DAY_SECONDS);
+    if (t % DAY_SECONDS < 0) --q;
+    return q;
+}
+
+void ReviewForecast::rebuild(const std::vector<Item>& items, std::time_t now) {
+    origin = dayOf(now);
+    buckets.clear();
+    overdue = 0;
+    farFuture = 0;
+    totalCount = 0;
+
+    for (const auto& it : items) add(it.next_review);
+
+    spdlog::debug("Review forecast rebuilt: {} items, {} day buckets", totalCount, buckets.size());
+}
+
+void ReviewForecast::add(std::time_t nextReview) {
+    adjust(nextReview, +1);
+}
+
+void ReviewForecast::remove(std::time_t nextReview) {
+    adjust(nextReview, -1);
+}
+
+void ReviewForecast::move(std::time_t from, std::time_t to) {
+    if (dayOf(from) == dayOf(to)) return;
+    adjust(from, -1);
+    adjust(to, +1);
+}
+
+void ReviewForecast::adjust(std::time_t nextReview, int delta) {
+    long offset = dayOf(nextReview) - origin;
+    totalCount += delta;
+
+    if (offset < 0) {
+        overdue += delta;
+        return;
+    }
+    if (offset >= MAX_SPAN_DAYS) {
+        farFuture += delta;
+        return;
+    }
+
+    size_t idx = static_cast<size_t>(offset);
+    if (idx >= buckets.size()) buckets.resize(idx + 1, 0);
+    buckets[idx] += delta;
+}
+
+void ReviewForecast::advanceTo(long today) {
+    // Fold days that have passed into the overdue count; amortized O(1) per day
+    while (origin < today) {
+        if (!buckets.empty()) {
+            overdue += buckets.front();
+            buckets.pop_front();
+        }
+        ++origin;
+    }
+}
+
+std::vector<int> ReviewForecast::dueCounts(std::time_t now, int days) {
+    if (days < 1) days = 1;
+    advanceTo(dayOf(now));
+
+    std::vector<int> counts(static_cast<size_t>(days), 0);
+    for (size_t i = 0; i < counts.size() && i < buckets.size(); ++i)
+        counts[i] = buckets[i];
+    counts[0] += static_cast<int>(overdue);
+
+    return counts;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <ctime>
+#include <deque>
+#include <vector>
+#include "Item.hpp"
+
+// Per-day histogram of Item::next_review, kept up to date incrementally by the
+// scheduler and the deck edits so workload queries never rescan the items.
+// Days are UTC calendar days; everything due before today counts as due today.
+class ReviewForecast {
+public:
+    static constexpr std::time_t DAY_SECONDS = 24 * 60 * 60;
+    static constexpr long MAX_SPAN_DAYS = 40000; // beyond the longest interval any policy produces
+
+    explicit ReviewForecast(std::time_t now = std::time(nullptr));
+
+    static long dayOf(std::time_t t);
+
+    void rebuild(const std::vector<Item>& items, std::time_t now = std::time(nullptr));
+
+    void add(std::time_t nextReview);
+    void remove(std::time_t nextReview);
+    void move(std::time_t from, std::time_t to);
+
+    // counts[0] = due today (including overdue), counts[i] = due i days from today. O(days).
+    std::vector<int> dueCounts(std::time_t now, int days);
+
+    std::size_t total() const { return static_cast<std::size_t>(totalCount); }
+
+private:
+    long origin;               // day index of buckets[0]; only moves forward
+    std::deque<int> buckets;   // dense per-day counts starting at origin
+    long overdue = 0;          // cards due before origin
+    long farFuture = 0;        // cards due beyond MAX_SPAN_DAYS from origin
+    long totalCount = 0;
+
+    void adjust(std::time_t nextReview, int delta);
+    void advanceTo(long today);
+};
@@ -0,0 +1,145 @@
+#include "ReviewPipeline.hpp"
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+ReviewPipeline::ReviewPipeline(DeckHistory& d, ApplyFn a, LoadFn l, PersistFn p, std::size_t capacity)
+    : deck(d), apply(std::move(a)), load(std::move(l)), persist(std::move(p)), queue(capacity),
+      started(std::chrono::steady_clock::now())
+{
+    applier = std::thread(&ReviewPipeline::run, this);
+}
+
+ReviewPipeline::~ReviewPipeline() {
+    stop();
+}
+
+std::future<ReviewOutcome> ReviewPipeline::submit(ReviewEvent event) {
+    auto pending = std::make_unique<Pending>();
+    pending->event = std::move(event);
+    std::future<ReviewOutcome> result = pending->done.get_future();
+
+    pushing.fetch_add(1, std::memory_order_acq_rel);
+    if (stopping.load(std::memory_order_acquire)) {
+        pushing.fetch_sub(1, std::memory_order_acq_rel);
+        pending->done.set_value(ReviewOutcome{});
+        return result;
+    }
+
+    // Backpressure: a full queue means the applier is behind, so give it the core
+    while (!queue.tryPush(pending)) std::this_thread::yield();
+    submitted.fetch_add(1, std::memory_order_relaxed);
+    pushing.fetch_sub(1, std::memory_order_acq_rel);
+
+    // Under the lock, so the applier cannot miss it between its check and its wait
+    {
+        std::lock_guard<std::mutex> lock(wakeLock);
+        wake.notify_one();
+    }
+    return result;
+}
+
+void ReviewPipeline::stop() {
+    if (stopping.exchange(true)) {
+        if (applier.joinable()) applier.join();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(wakeLock);
+        wake.notify_one();
+    }
+    if (applier.joinable()) applier.join();
+
+    Metrics m = metrics();
+    spdlog::info("Review pipeline stopped: {} applied, {} rejected in {} batches",
+        m.applied, m.rejected, m.batches);
+}
+
+void ReviewPipeline::run() {
+    std::vector<std::unique_ptr<Pending>> batch;
+    batch.reserve(MAX_BATCH);
+
+    while (true) {
+        std::unique_ptr<Pending> next;
+        while (batch.size() < MAX_BATCH && queue.tryPop(next)) batch.push_back(std::move(next));
+
+        if (!batch.empty()) {
+            applyBatch(batch);
+            batch.clear();
+            continue;
+        }
+
+        // Producers may still be mid-push when stop() is called, so only exit
+        // once none are and the queue is seen empty after the stop flag
+        if (stopping.load(std::memory_order_acquire) && pushing.load(std::memory_order_acquire) == 0
+            && queue.depth() == 0)
+            break;
+
+        // Producers notify under wakeLock, so a push after the last tryPop
+        // either shows in depth() here or wakes the wait
+        std::unique_lock<std::mutex> lock(wakeLock);
+        wake.wait(lock, [this] { return queue.depth() > 0 || stopping.load(std::memory_order_acquire); });
+    }
+}
+
+void ReviewPipeline::applyBatch(std::vector<std::unique_ptr<Pending>>& batch) {
+    std::vector<ReviewOutcome> outcomes(batch.size());
+    std::vector<ReviewEvent> appliedEvents;
+    appliedEvents.reserve(batch.size());
+
+    {
+        // One lock for the batch: the reviews and their journal entries become
+        // visible to a saving thread together
+        auto lock = deck.writeLock();
+
+        for (std::size_t b = 0; b < batch.size(); ++b) {
+            const ReviewEvent& ev = batch[b]->event;
+            DeckHistory::Handle h = deck.handleOf(ev.itemId);
+            auto cur = deck.get(h);
+            if (!cur) {
+                spdlog::warn("Review for unknown item '{}' dropped", ev.itemId);
+                continue;
+            }
+
+            Item item = *cur;
+            if (item.cold && (!load || !load(item))) {
+                spdlog::error("Could not load item '{}' for review", ev.itemId);
+                continue;
+            }
+
+            apply(item, ev.quality, ev.timestamp);
+            outcomes[b] = { true, false, item.interval, item.next_review };
+
+            auto tx = deck.edit("Review '" + item.title + "'");
+            tx.set(h, std::move(item));
+            appliedEvents.push_back(ev);
+        }
+
+        bool durable = !appliedEvents.empty() && (!persist || persist(appliedEvents));
+        if (!durable && !appliedEvents.empty())
+            spdlog::error("Failed to journal {} reviews", appliedEvents.size());
+        for (auto& o : outcomes) o.persisted = o.applied && durable && persist;
+    }
+
+    std::size_t appliedCount = appliedEvents.size();
+    applied.fetch_add(appliedCount, std::memory_order_relaxed);
+    rejected.fetch_add(batch.size() - appliedCount, std::memory_order_relaxed);
+    batches.fetch_add(1, std::memory_order_relaxed);
+    if (batch.size() > largestBatch.load(std::memory_order_relaxed))
+        largestBatch.store(batch.size(), std::memory_order_relaxed);
+
+    for (std::size_t b = 0; b < batch.size(); ++b) batch[b]->done.set_value(outcomes[b]);
+}
+
+ReviewPipeline::Metrics ReviewPipeline::metrics() const {
+    Metrics m;
+    m.submitted = submitted.load(std::memory_order_relaxed);
+    m.applied = applied.load(std::memory_order_relaxed);
+    m.rejected = rejected.load(std::memory_order_relaxed);
+    m.batches = batches.load(std::memory_order_relaxed);
+    m.largestBatch = largestBatch.load(std::memory_order_relaxed);
+    m.depth = queue.depth();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    m.appliedPerSecond = seconds > 0.0 ? static_cast<double>(m.applied) / seconds : 0.0;
+    return m;
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "DeckHistory.hpp"
+#include "MPSCQueue.hpp"
+#include "ReviewQuality.hpp"
+
+struct ReviewEvent {
+    std::string itemId;
+    ReviewQuality quality = ReviewQuality::GOOD;
+    std::time_t timestamp = 0;
+};
+
+struct ReviewOutcome {
+    bool applied = false;    // false if the item is gone or could not be decrypted
+    bool persisted = false;  // the batch holding this review reached the journal
+    int interval = 0;
+    std::time_t nextReview = 0;
+};
+
+// Funnels reviews from any number of producer threads into one applier thread,
+// the only place reviews touch the deck. Producers push onto a bounded
+// lock-free queue and get a future; the applier drains up to MAX_BATCH events
+// at a time, applies them under a single writer lock (one undo step per
+// review), hands the batch to the persistence hook, then completes the futures.
+class ReviewPipeline {
+public:
+    static constexpr std::size_t DEFAULT_CAPACITY = 4096;
+    static constexpr std::size_t MAX_BATCH = 256;
+
+    // Runs the scheduler on one item; forecast/stats updates happen in here
+    using ApplyFn = std::function<void(Item&, ReviewQuality, std::time_t)>;
+    // Decrypts a cold item before it is reviewed
+    using LoadFn = std::function<bool(Item&)>;
+    // Appends a batch of applied reviews durably; runs under the writer lock
+    using PersistFn = std::function<bool(const std::vector<ReviewEvent>&)>;
+
+    struct Metrics {
+        std::uint64_t submitted = 0;
+        std::uint64_t applied = 0;
+        std::uint64_t rejected = 0;
+        std::uint64_t batches = 0;
+        std::size_t largestBatch = 0;
+        std::size_t depth = 0;           // events waiting in the queue
+        double appliedPerSecond = 0.0;   // since the pipeline started
+    };
+
+    ReviewPipeline(DeckHistory& deck, ApplyFn apply, LoadFn load = nullptr, PersistFn persist = nullptr,
+        std::size_t capacity = DEFAULT_CAPACITY);
+    ReviewPipeline(const ReviewPipeline&) = delete;
+    ReviewPipeline& operator=(const ReviewPipeline&) = delete;
+    ~ReviewPipeline();
+
+    // Thread-safe. Waits (yielding) while the queue is full. After stop() the
+    // future is completed immediately with applied = false.
+    std::future<ReviewOutcome> submit(ReviewEvent event);
+
+    // Apply everything already queued, then join the applier
+    void stop();
+
+    Metrics metrics() const;
+
+private:
+    struct Pending {
+        ReviewEvent event;
+        std::promise<ReviewOutcome> done;
+    };
+
+    DeckHistory& deck;
+    ApplyFn apply;
+    LoadFn load;
+    PersistFn persist;
+
+    MPSCQueue<std::unique_ptr<Pending>> queue;
+    std::thread applier;
+    std::atomic<bool> stopping{ false };
+    std::atomic<int> pushing{ 0 }; // producers between the stop check and their push
+
+    // Applier sleeps here when the queue is empty
+    std::mutex wakeLock;
+    std::condition_variable wake;
+
+    std::atomic<std::uint64_t> submitted{ 0 };
+    std::atomic<std::uint64_t> applied{ 0 };
+    std::atomic<std::uint64_t> rejected{ 0 };
+    std::atomic<std::uint64_t> batches{ 0 };
+    std::atomic<std::size_t> largestBatch{ 0 };
+    std::chrono::steady_clock::time_point started;
+
+    void run();
+    void applyBatch(std::vector<std::unique_ptr<Pending>>& batch);
+};
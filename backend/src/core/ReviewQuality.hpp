@@ -0,0 +1,22 @@
+#pragma once
+#include <array>
+#include <cstddef>
+
+enum class ReviewQuality {
+    AGAIN = 0,
+    HARD = 1,
+    GOOD = 2,
+    EASY = 3
+};
+
+constexpr std::size_t REVIEW_QUALITY_COUNT = 4;
+
+template <class T>
+using QualityTable = std::array<T, REVIEW_QUALITY_COUNT>;
+
+// Map the 0..3 enum to SM-2 quality (1..5): fail, correct but hard, correct, very good
+constexpr QualityTable<int> SM2_QUALITY = { 1, 3, 4, 5 };
+
+constexpr int sm2Quality(ReviewQuality q) {
+    return SM2_QUALITY[static_cast<std::size_t>(q)];
+}
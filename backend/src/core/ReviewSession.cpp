@@ -0,0 +1,179 @@
+#include "ReviewSession.hpp"
+#include "ReviewForecast.hpp"
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+// How far ahead interleaving looks for a card that does not share a tag with the previous one
+static constexpr std::size_t SPREAD_LOOKAHEAD = 4;
+
+ReviewSession::ReviewSession(const SchedulerBase& s, std::size_t b)
+    : scheduler(s), batch(std::max<std::size_t>(1, b)) {
+}
+
+bool ReviewSession::isNew(const Item& item) {
+    if (!item.cold) return item.history.empty();
+    // A cold item's history is not loaded, but any first answer, AGAIN
+    // included, leaves a trace in the index fields: a pass counts, a failure
+    // lowers the SM-2 ease or gives FSRS a stability
+    static const double START_EASE = Item().ease_factor;
+    return item.review_count == 0 && item.lapses == 0 && item.stability <= 0.0 && item.ease_factor >= START_EASE;
+}
+
+int ReviewSession::newLeft() const {
+    return std::max(0, scheduler.settings().newPerDay - newTaken);
+}
+
+int ReviewSession::reviewsLeft() const {
+    return std::max(0, scheduler.settings().reviewsPerDay - reviewsTaken);
+}
+
+void ReviewSession::rollDay() {
+    long today = ReviewForecast::dayOf(scheduler.now());
+    if (today == day) return;
+
+    day = today;
+    newTaken = 0;
+    reviewsTaken = 0;
+    queue.clear();
+    picked.clear();
+    tagTaken.clear();
+}
+
+bool ReviewSession::quotaAllows(const Item& item) const {
+    const auto& quotas = scheduler.settings().tagQuotas;
+    if (quotas.empty()) return true;
+
+    for (const auto& tag : item.tags) {
+        auto q = quotas.find(tag);
+        if (q == quotas.end()) continue;
+        auto used = tagTaken.find(tag);
+        if (used != tagTaken.end() && used->second >= q->second) return false;
+    }
+    return true;
+}
+
+// Moves up to `want` of the highest-priority candidates that fit the tag quotas
+// into out, in priority order. Only the top slice is ever sorted; when quotas
+// reject part of it, the next slice (twice as large) is selected from the rest.
+void ReviewSession::select(std::vector<Candidate>& pool, std::size_t want, std::vector<Candidate>& out) {
+    auto before = [&](const Candidate& a, const Candidate& b) { return scheduler.reviewsBefore(*a.item, *b.item); };
+    bool quotas = !scheduler.settings().tagQuotas.empty();
+
+    auto first = pool.begin();
+    std::size_t slice = quotas ? want * 2 : want;
+    std::size_t taken = 0;
+
+    while (taken < want && first != pool.end()) {
+        auto last = first + static_cast<std::ptrdiff_t>(std::min<std::size_t>(slice, pool.end() - first));
+        if (last != pool.end()) std::nth_element(first, last, pool.end(), before);
+        std::sort(first, last, before);
+
+        for (; first != last && taken < want; ++first) {
+            if (!quotaAllows(*first->item)) continue;
+            for (const auto& tag : first->item->tags) ++tagTaken[tag];
+            out.push_back(*first);
+            ++taken;
+        }
+        slice *= 2;
+    }
+}
+
+// Spreads new cards evenly between reviews, then nudges apart neighbours that share a tag
+std::vector<ReviewSession::Candidate> ReviewSession::arrange(std::vector<Candidate>& reviews,
+    std::vector<Candidate>& fresh) const {
+    std::vector<Candidate> order;
+    order.reserve(reviews.size() + fresh.size());
+
+    if (!scheduler.settings().interleave) {
+        order = reviews;
+        order.insert(order.end(), fresh.begin(), fresh.end());
+        return order;
+    }
+
+    std::size_t total = reviews.size() + fresh.size();
+    std::size_t r = 0, n = 0;
+    for (std::size_t pos = 0; pos < total; ++pos) {
+        // New card j goes near position (j + 0.5) * total / fresh.size()
+        bool takeNew = n < fresh.size()
+            && (r == reviews.size() || (2 * n + 1) * total <= 2 * (pos + 1) * fresh.size());
+        order.push_back(takeNew ? fresh[n++] : reviews[r++]);
+    }
+
+    auto sharesTag = [](const Item& a, const Item& b) {
+        for (const auto& t : a.tags)
+            if (b.hasTag(t)) return true;
+        return false;
+    };
+    for (std::size_t i = 1; i < order.size(); ++i) {
+        if (!sharesTag(*order[i - 1].item, *order[i].item)) continue;
+        std::size_t end = std::min(order.size(), i + 1 + SPREAD_LOOKAHEAD);
+        for (std::size_t j = i + 1; j < end; ++j) {
+            if (sharesTag(*order[i - 1].item, *order[j].item)) continue;
+            std::rotate(order.begin() + static_cast<std::ptrdiff_t>(i), order.begin() + static_cast<std::ptrdiff_t>(j),
+                order.begin() + static_cast<std::ptrdiff_t>(j + 1));
+            break;
+        }
+    }
+    return order;
+}
+
+std::size_t ReviewSession::refill(const DeckHistory& history) {
+    rollDay();
+    if (queue.size() >= batch) return 0;
+
+    int newBudget = newLeft();
+    int reviewBudget = reviewsLeft();
+    if (newBudget == 0 && reviewBudget == 0) return 0;
+
+    std::time_t now = scheduler.now();
+    PersistentDeck deck = history.snapshot();
+    std::vector<Candidate> reviews, fresh;
+    deck.forEach([&](const Item& it) {
+        if (it.next_review <= now && !picked.count(it.id)) {
+            if (isNew(it)) { if (newBudget > 0) fresh.push_back({ &it }); }
+            else if (reviewBudget > 0) reviews.push_back({ &it });
+        }
+    });
+
+    // Split the batch in proportion to what is left of each budget
+    std::size_t want = batch - queue.size();
+    std::size_t newCap = std::min<std::size_t>(newBudget, fresh.size());
+    std::size_t reviewCap = std::min<std::size_t>(reviewBudget, reviews.size());
+    std::size_t newWant = newCap, reviewWant = reviewCap;
+    if (newCap + reviewCap > want) {
+        newWant = std::min(newCap, (want * newCap + newCap + reviewCap - 1) / (newCap + reviewCap));
+        reviewWant = std::min(reviewCap, want - newWant);
+        newWant = std::min(newCap, want - reviewWant);
+    }
+
+    std::vector<Candidate> pickedReviews, pickedNew;
+    select(reviews, reviewWant, pickedReviews);
+    select(fresh, newWant, pickedNew);
+
+    for (const auto& c : arrange(pickedReviews, pickedNew)) {
+        bool newCard = isNew(*c.item);
+        queue.push_back({ history.handleOf(c.item->id), c.item->id, newCard });
+        picked.insert(c.item->id);
+        if (newCard) ++newTaken;
+        else ++reviewsTaken;
+    }
+
+    std::size_t added = pickedReviews.size() + pickedNew.size();
+    spdlog::debug("Review session refilled with {} cards ({} new) from {} due", added, pickedNew.size(),
+        reviews.size() + fresh.size());
+    return added;
+}
+
+bool ReviewSession::next(const DeckHistory& deck, Card& card) {
+    rollDay();
+    if (queue.empty()) refill(deck);
+    if (queue.empty()) return false;
+
+    card = std::move(queue.front());
+    queue.pop_front();
+    return true;
+}
+
+void ReviewSession::putBack(const Card& card) {
+    queue.push_front(card);
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "Item.hpp"
+#include "DeckHistory.hpp"
+#include "PersistentDeck.hpp"
+#include "Scheduler.hpp"
+
+// A day's review session bounded by the limits in SchedulerConfig: at most
+// newPerDay never-reviewed cards and reviewsPerDay reviews, and at most the
+// configured quota of cards per tag. Cards are picked a batch at a time in the
+// scheduler's priority order (heavier tags first, then most overdue) using
+// nth_element, so a refill costs O(n + k log k) for n due cards and a batch
+// of k instead of sorting the whole backlog. With interleaving on, new cards
+// are spread evenly through each batch and cards sharing a tag are kept apart.
+//
+// Selection only reads index fields (tags, due date, review counts), so cold
+// items are never decrypted just to be ranked. Counters reset at UTC midnight.
+class ReviewSession {
+public:
+    static constexpr std::size_t DEFAULT_BATCH = 20;
+
+    struct Card {
+        DeckHistory::Handle handle; // valid while the card waits, however the deck shifts
+        std::string id;
+        bool isNew = false;
+    };
+
+    explicit ReviewSession(const SchedulerBase& scheduler, std::size_t batch = DEFAULT_BATCH);
+
+    // Never reviewed at all; a card failed on its first answer is no longer new
+    static bool isNew(const Item& item);
+
+    // Tops the queue up to a full batch from the due cards in deck; returns cards added
+    std::size_t refill(const DeckHistory& deck);
+
+    // Next card to review, refilling from deck when the queue is empty. False
+    // once nothing is due or today's limits are used up.
+    bool next(const DeckHistory& deck, Card& card);
+
+    // Return an unreviewed card to the front of the queue
+    void putBack(const Card& card);
+
+    std::size_t queued() const { return queue.size(); }
+    int newLeft() const;
+    int reviewsLeft() const;
+
+private:
+    struct Candidate {
+        const Item* item;
+    };
+
+    const SchedulerBase& scheduler;
+    std::size_t batch;
+
+    long day = -1;
+    int newTaken = 0;      // picked today, queued ones included
+    int reviewsTaken = 0;
+    std::deque<Card> queue;
+    std::unordered_set<std::string> picked;         // IDs picked today
+    std::unordered_map<std::string, int> tagTaken;  // quota use per tag today
+
+    void rollDay();
+    bool quotaAllows(const Item& item) const;
+    void select(std::vector<Candidate>& pool, std::size_t want, std::vector<Candidate>& out);
+    std::vector<Candidate> arrange(std::vector<Candidate>& reviews, std::vector<Candidate>& fresh) const;
+};
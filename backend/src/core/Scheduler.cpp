@@ -1,86 +1,65 @@
 #include "Scheduler.hpp"
+#include "../parallel/Parallel.hpp"
 #include <spdlog/spdlog.h>
 #include <cmath>
 #include <ctime>
 #include <algorithm>
+#include <iterator>
 
-// Map your 0..3 enum to SM-2 quality (1..5)
-static inline int mapToSM2Quality(ReviewQuality q) {
-    switch (q) {
-    case ReviewQuality::AGAIN: return 1; // fail
-    case ReviewQuality::HARD:  return 3; // correct but hard
-    case ReviewQuality::GOOD:  return 4; // correct
-    case ReviewQuality::EASY:  return 5; // very good
-    default:                   return 3;
-    }
-}
-
-void Scheduler::review(Item& item, ReviewQuality q) {
-    SM2Data& data = cards[item.id];
-
-    int smq = mapToSM2Quality(q);
+template class BasicScheduler<SM2Policy>;
+template class BasicScheduler<FSRSPolicy>;
 
-    // Update EF (SuperMemo-2 formula)
-    data.ef = data.ef + (0.1 - (5 - smq) * (0.08 + (5 - smq) * 0.02));
-    if (data.ef < 1.3) data.ef = 1.3;
-
-    int interval = 1;
-
-    if (smq < 3) {
-        // Failure or very poor recall
-        data.reps = 0;
-        interval = 1;
-    }
-    else {
-        data.reps += 1;
-        if (data.reps == 1) {
-            interval = 1;
-        }
-        else if (data.reps == 2) {
-            interval = 6;
-        }
-        else {
-            // Use last_interval (days) and EF
-            interval = std::max(1, static_cast<int>(std::round(data.last_interval * data.ef)));
-        }
-    }
+static const SchedulerConfig& defaultConfig() {
+    static const SchedulerConfig cfg;
+    return cfg;
+}
 
-    // Save last interval for next multiply
-    data.last_interval = interval;
+SchedulerBase::SchedulerBase(TagManager* tags, const SchedulerConfig* cfg, ReviewForecast* fc, DeckStats* st,
+    const Clock* clk)
+    : tagManager(tags), config(cfg ? cfg : &defaultConfig()), forecast(fc), stats(st),
+      clock(clk ? clk : &Clock::system()) {
+}
 
-    // Apply tag priority shortening
-    interval = applyTagPriority(item, interval);
+template <class Ptr>
+std::vector<SlotHandle> SchedulerBase::inReviewOrder(std::vector<std::pair<SlotHandle, Ptr>>& due) const {
+    std::sort(due.begin(), due.end(),
+        [&](const auto& a, const auto& b) { return reviewsBefore(*a.second, *b.second); });
 
-    // Persist in item
-    item.scheduleNext(interval);
+    std::vector<SlotHandle> out;
+    out.reserve(due.size());
+    for (const auto& d : due) out.push_back(d.first);
+    return out;
+}
 
-    // store history with SM-2 quality (1..5) to be explicit
-    item.history.push_back({ std::time(nullptr), smq, interval });
+std::vector<DeckHistory::Handle> SchedulerBase::getDueItems(const DeckHistory& deck) const {
+    // Shared pointers, so the items outlive a concurrent edit while they are sorted
+    std::vector<std::pair<SlotHandle, PersistentDeck::ItemPtr>> due;
+    std::time_t now = clock->now();
 
-    spdlog::info("SM2 Review '{}' | smq={} | interval={} | ef={:.3f} | reps={}",
-        item.title, smq, interval, data.ef, data.reps);
+    deck.forEachHandle([&](DeckHistory::Handle h, const PersistentDeck::ItemPtr& it) {
+        if (it->next_review <= now) due.emplace_back(h, it);
+    });
+    return inReviewOrder(due);
 }
 
-std::vector<Item*> Scheduler::getDueItems(std::vector<Item>& items) const {
-    std::vector<Item*> out;
-    std::time_t now = std::time(nullptr);
-
-    for (auto& it : items)
-        if (it.next_review <= now)
-            out.push_back(&it);
+std::vector<SlotHandle> SchedulerBase::getDueItems(const SlotMap<Item>& items) const {
+    std::vector<std::pair<SlotHandle, const Item*>> due;
+    std::time_t now = clock->now();
 
-    std::sort(out.begin(), out.end(),
-        [&](const Item* a, const Item* b) {
-            double wa = combinedTagWeight(*a);
-            double wb = combinedTagWeight(*b);
-            if (wa != wb) return wa > wb;
-            return a->next_review < b->next_review;
-        });
+    items.forEach([&](SlotHandle h, const Item& it) {
+        if (it.next_review <= now) due.emplace_back(h, &it);
+    });
+    return inReviewOrder(due);
+}
 
-    return out;
+bool SchedulerBase::reviewsBefore(const Item& a, const Item& b) const {
+    double wa = combinedTagWeight(a);
+    double wb = combinedTagWeight(b);
+    if (wa != wb) return wa > wb;
+    return a.next_review < b.next_review;
 }
 
-double Scheduler::combinedTagWeight(const Item& item) const {
+double SchedulerBase::combinedTagWeight(const Item& item) const {
     if (!tagManager || item.tags.empty()) return 1.0;
 
     double sum = 0.0;
@@ -94,15 +73,73 @@ double Scheduler::combinedTagWeight(const Item& item) const {
     return sum / static_cast<double>(count);
 }
 
-int Scheduler::applyTagPriority(const Item& item, int interval) const {
+int SchedulerBase::applyTagPriority(const Item& item, int interval) const {
     double avgWeight = combinedTagWeight(item);
-    if (avgWeight <= 1.0) return std::max(1, interval);
 
-    // Convert avg weight into a modest shortening factor
-    double factor = 1.0 + (avgWeight - 1.0) * 0.15;
-    if (factor < 1.0) factor = 1.0;
+    // Convert avg weight into a modest shortening factor (1.0 when no tag is weighted)
+    double factor = 1.0 + std::max(0.0, avgWeight - 1.0) * 0.15;
 
     int adjusted = static_cast<int>(std::round(static_cast<double>(interval) / factor));
-    adjusted = std::clamp(adjusted, 1, interval); // never lengthen; only shorten up to original
+    adjusted = std::clamp(adjusted, 1, std::max(1, interval)); // never lengthen; only shorten up to original
     return adjusted;
 }
+
+std::size_t SchedulerBase::rescheduleTag(DeckHistory& deck, const std::string& tag, BaseIntervalFn baseInterval) const {
+    using Moves = std::vector<PersistentDeck::Update>;
+    constexpr std::size_t GRAIN = 1024;
+
+    // Weights live in the tag manager; without one there is nothing to re-apply
+    if (!tagManager) return 0;
+
+    // The review applier holds this lock too, so weights and due dates stay put
+    auto lock = deck.writeLock();
+    PersistentDeck snap = deck.snapshot();
+
+    // The weight is inherited by every tag below this one, so the trie's
+    // subtree names exactly the items to visit
+    std::vector<std::size_t> positions;
+    for (const auto& id : tagManager->itemsUnder(tag)) {
+        std::size_t i = 0;
+        if (deck.indexOf(id, i)) positions.push_back(i);
+    }
+    if (positions.empty()) return 0;
+    std::sort(positions.begin(), positions.end());
+
+    // Only index fields are read, so cold items are rescheduled without decrypting them
+    Moves moves = parallelReduce(0, positions.size(), GRAIN, Moves{},
+        [&](std::size_t lo, std::size_t hi) {
+            Moves out;
+            for (std::size_t k = lo; k < hi; ++k) {
+                std::size_t i = positions[k];
+                const Item& it = snap[i];
+                if (it.review_count == 0 && it.lapses == 0) continue;
+                int base = baseInterval(it, *config);
+                if (base <= 0) continue;
+
+                int interval = applyTagPriority(it, base);
+                std::time_t due = it.last_review + static_cast<std::time_t>(interval) * 24 * 60 * 60;
+                if (due == it.next_review) continue;
+
+                Item moved = it;
+                moved.interval = interval;
+                moved.next_review = due;
+                out.emplace_back(i, PersistentDeck::share(std::move(moved), deck.memory()));
+            }
+            return out;
+        },
+        [](Moves a, Moves b) {
+            if (a.empty()) return b;
+            a.insert(a.end(), std::make_move_iterator(b.begin()), std::make_move_iterator(b.end()));
+            return a;
+        });
+    if (moves.empty()) return 0;
+
+    if (forecast)
+        for (const auto& m : moves) forecast->move(snap[m.first].next_review, m.second->next_review);
+
+    // Published as one version. Like the weight change itself, this is not an undo step.
+    deck.load(snap, snap.setMany(moves));
+
+    spdlog::info("Tag '{}' re-weighted: {} items re-scheduled", tag, moves.size());
+    return moves.size();
+}
@@ -1,40 +1,116 @@
 #pragma once
-#include <unordered_map>
 #include <string>
 #include <vector>
 #include <ctime>
 #include <algorithm>
 #include <cmath>
+#include <spdlog/spdlog.h>
 #include "TagManager.hpp"
 #include "Item.hpp"
+#include "ReviewQuality.hpp"
+#include "SchedulerConfig.hpp"
+#include "SchedulingPolicy.hpp"
+#include "ReviewForecast.hpp"
+#include "DeckStats.hpp"
+#include "PersistentDeck.hpp"
+#include "Clock.hpp"
+#include "DeckHistory.hpp"
+#include "SlotMap.hpp"
 
-enum class ReviewQuality {
-    AGAIN = 0,
-    HARD = 1,
-    GOOD = 2,
-    EASY = 3
-};
-
-class Scheduler {
+// Algorithm-independent parts of the scheduler: tag priority and due selection
+class SchedulerBase {
 public:
-    explicit Scheduler(TagManager* tags = nullptr)
-        : tagManager(tags) {
-    }
+    explicit SchedulerBase(TagManager* tags = nullptr, const SchedulerConfig* cfg = nullptr,
+        ReviewForecast* forecast = nullptr, DeckStats* stats = nullptr, const Clock* clock = nullptr);
 
-    void review(Item& item, ReviewQuality q);
-    std::vector<Item*> getDueItems(std::vector<Item>& items) const;
+    // Handles of due items, in review order; they stay valid as items come and go
+    std::vector<DeckHistory::Handle> getDueItems(const DeckHistory& deck) const;
+    std::vector<SlotHandle> getDueItems(const SlotMap<Item>& items) const;
 
-private:
-    struct SM2Data {
-        int reps = 0;
-        double ef = 2.5;
-        int last_interval = 1;
-    };
+    // Review order: heavier tags first, then longest overdue
+    bool reviewsBefore(const Item& a, const Item& b) const;
+
+    std::time_t now() const { return clock->now(); }
+    const SchedulerConfig& settings() const { return *config; }
+
+protected:
+    using BaseIntervalFn = int (*)(const Item&, const SchedulerConfig&);
 
     TagManager* tagManager;
-    std::unordered_map<std::string, SM2Data> cards;
+    const SchedulerConfig* config;
+    ReviewForecast* forecast; // optional, kept in step with next_review
+    DeckStats* stats;         // optional, updated with every review
+    const Clock* clock;       // "now" for due selection and unstamped reviews
 
     // Tag helpers
     double combinedTagWeight(const Item& item) const;
     int applyTagPriority(const Item& item, int interval) const;
+
+    std::size_t rescheduleTag(DeckHistory& deck, const std::string& tag, BaseIntervalFn baseInterval) const;
+
+private:
+    // Sorts (handle, item pointer) pairs into review order and keeps the handles
+    template <class Ptr>
+    std::vector<SlotHandle> inReviewOrder(std::vector<std::pair<SlotHandle, Ptr>>& due) const;
+};
+
+// Scheduler specialized on a SchedulingPolicy at compile time. The review path
+// has no virtual dispatch or algorithm switch and is inlined into callers,
+// so bulk re-scheduling loops compile down to straight-line code per card.
+template <class Policy>
+class BasicScheduler : public SchedulerBase {
+public:
+    using SchedulerBase::SchedulerBase;
+
+    void review(Item& item, ReviewQuality q) { review(item, q, clock->now()); }
+    // Review recorded at `now` (e.g. the time a queued review was submitted)
+    void review(Item& item, ReviewQuality q, std::time_t now);
+
+    // Call after the weight of `tag` changed: re-applies tag priority to the
+    // items carrying it or a tag below it, from their last review, instead of waiting for their
+    // next one. Only those items (found through the tag manager) are visited.
+    // Returns the number of items whose due date moved.
+    std::size_t rescheduleTag(DeckHistory& deck, const std::string& tag) const {
+        return SchedulerBase::rescheduleTag(deck, tag, &Policy::baseInterval);
+    }
 };
+
+using SM2Scheduler = BasicScheduler<SM2Policy>;
+using FSRSScheduler = BasicScheduler<FSRSPolicy>;
+
+template <class Policy>
+inline void BasicScheduler<Policy>::review(Item& item, ReviewQuality q, std::time_t now) {
+    std::time_t previousDue = item.next_review;
+    bool wasLearned = item.reps > 0 || item.review_count > 0;
+    DeckStats::ItemState before = DeckStats::stateOf(item);
+
+    int interval = Policy::nextInterval(item, q, *config, now);
+
+    // Outcome bookkeeping shared by all policies
+    if (q == ReviewQuality::AGAIN) {
+        item.streak = 0;
+        if (wasLearned) item.lapses++;
+        if (item.lapses >= LEECH_LAPSES) item.is_leech = true;
+    }
+    else {
+        item.review_count++;
+        item.streak++;
+    }
+
+    // Apply tag priority shortening
+    interval = applyTagPriority(item, interval);
+
+    // Persist in item
+    item.scheduleNext(interval, now);
+    if (forecast) forecast->move(previousDue, item.next_review);
+
+    // store history with SM-2 quality (1..5) to be explicit, whichever policy ran
+    int smq = sm2Quality(q);
+    item.history.push_back({ now, smq, interval });
+    if (stats) stats->onReview(item, before);
+
+    spdlog::info("{} Review '{}' | smq={} | interval={}", Policy::name, item.title, smq, interval);
+}
+
+extern template class BasicScheduler<SM2Policy>;
+extern template class BasicScheduler<FSRSPolicy>;
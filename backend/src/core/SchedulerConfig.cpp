@@ -0,0 +1,82 @@
+#include "SchedulerConfig.hpp"
+#include <algorithm>
+#include <sstream>
+#include "ViewStream.hpp"
+#include <spdlog/spdlog.h>
+
+const char* SchedulerConfig::algorithmName(SchedulerAlgorithm a) {
+    switch (a) {
+    case SchedulerAlgorithm::SM2:  return "sm2";
+    case SchedulerAlgorithm::FSRS: return "fsrs";
+    default:                       return "sm2";
+    }
+}
+
+std::string SchedulerConfig::serialize() const {
+    std::ostringstream oss;
+    oss.precision(17);
+    oss << "algorithm:" << algorithmName(algorithm) << "\n";
+    oss << "retention:" << desiredRetention << "\n";
+    oss << "weights:";
+    for (size_t i = 0; i < fsrsWeights.size(); ++i) {
+        if (i) oss << ",";
+        oss << fsrsWeights[i];
+    }
+    oss << "\n";
+    oss << "new_per_day:" << newPerDay << "\n";
+    oss << "reviews_per_day:" << reviewsPerDay << "\n";
+    oss << "interleave:" << (interleave ? 1 : 0) << "\n";
+    for (const auto& q : tagQuotas) oss << "quota:" << q.second << " " << q.first << "\n";
+    return oss.str();
+}
+
+void SchedulerConfig::deserialize(std::string_view data) {
+    *this = SchedulerConfig();
+    ViewStream iss(data);
+    std::string line;
+
+    while (std::getline(iss, line)) {
+        auto pos = line.find(':');
+        if (pos == std::string::npos) continue;
+
+        std::string key = line.substr(0, pos);
+        std::string val = line.substr(pos + 1);
+
+        try {
+            if (key == "algorithm") {
+                algorithm = (val == "fsrs") ? SchedulerAlgorithm::FSRS : SchedulerAlgorithm::SM2;
+            }
+            else if (key == "retention") {
+                double r = std::stod(val);
+                if (r > 0.0 && r < 1.0) desiredRetention = r;
+            }
+            else if (key == "weights") {
+                std::array<double, fsrs::PARAM_COUNT> w{};
+                std::istringstream wss(val);
+                std::string num;
+                size_t n = 0;
+                while (n < w.size() && std::getline(wss, num, ',')) w[n++] = std::stod(num);
+                if (n == w.size()) fsrsWeights = w;
+                else spdlog::warn("Ignoring FSRS weights with {} values (expected {})", n, w.size());
+            }
+            else if (key == "new_per_day") {
+                newPerDay = std::max(0, std::stoi(val));
+            }
+            else if (key == "reviews_per_day") {
+                reviewsPerDay = std::max(0, std::stoi(val));
+            }
+            else if (key == "interleave") {
+                interleave = std::stoi(val) != 0;
+            }
+            else if (key == "quota") {
+                // "<count> <tag>"; tags may contain spaces and colons
+                auto sp = val.find(' ');
+                if (sp == std::string::npos || sp + 1 >= val.size()) continue;
+                tagQuotas[val.substr(sp + 1)] = std::max(0, std::stoi(val.substr(0, sp)));
+            }
+        }
+        catch (...) {
+            continue;
+        }
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <array>
+#include <map>
+#include <string>
+#include <string_view>
+#include "FSRS.hpp"
+
+enum class SchedulerAlgorithm {
+    SM2 = 0,
+    FSRS = 1
+};
+
+// Per-user scheduler settings: which algorithm drives reviews and,
+// for FSRS, the (possibly user-fitted) model weights.
+class SchedulerConfig {
+public:
+    SchedulerAlgorithm algorithm = SchedulerAlgorithm::SM2;
+
+    std::array<double, fsrs::PARAM_COUNT> fsrsWeights = fsrs::DEFAULT_WEIGHTS;
+    double desiredRetention = 0.9;
+
+    // Review session limits (see ReviewSession)
+    int newPerDay = 20;
+    int reviewsPerDay = 200;
+    bool interleave = true;
+    std::map<std::string, int> tagQuotas; // tag -> most cards with that tag per day
+
+    static const char* algorithmName(SchedulerAlgorithm a);
+
+    std::string serialize() const;
+    void deserialize(std::string_view data);
+};
@@ -0,0 +1,199 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <spdlog/spdlog.h>
+#include "ReviewQuality.hpp"
+#include "SchedulerConfig.hpp"
+#include "FSRS.hpp"
+#include "Item.hpp"
+
+// Scheduling policies plugged into BasicScheduler at compile time.
+//
+// Card state lives in the Item itself (reps/ease_factor/base_interval for SM-2,
+// stability/difficulty for FSRS) so it is persisted with the deck. A policy provides:
+//   name                                 label for logs
+//   nextInterval(item, q, cfg, now)      update item state, return interval in days
+//   restoreFromHistory(item, cfg)        rebuild state from Item::history
+//   baseInterval(item, cfg)              interval of the last review before tag
+//                                        priority, or 0 if the state cannot tell
+
+namespace sm2 {
+
+// EF delta for SM-2 quality smq: 0.1 - (5 - q) * (0.08 + (5 - q) * 0.02)
+constexpr double efDelta(int smq) {
+    return 0.1 - (5 - smq) * (0.08 + (5 - smq) * 0.02);
+}
+
+constexpr QualityTable<double> makeEfDeltaTable() {
+    QualityTable<double> t{};
+    for (std::size_t i = 0; i < t.size(); ++i) t[i] = efDelta(SM2_QUALITY[i]);
+    return t;
+}
+
+constexpr QualityTable<bool> makePassTable() {
+    QualityTable<bool> t{};
+    for (std::size_t i = 0; i < t.size(); ++i) t[i] = SM2_QUALITY[i] >= 3;
+    return t;
+}
+
+constexpr QualityTable<double> EF_DELTA = makeEfDeltaTable();
+constexpr QualityTable<bool> PASSED = makePassTable();
+
+// Fixed intervals for reps 0 (just failed), 1 and 2; later reps multiply by EF
+constexpr std::array<int, 3> FIRST_INTERVALS = { 1, 1, 6 };
+
+constexpr double MIN_EF = 1.3;
+
+static_assert(EF_DELTA[0] < 0.0 && EF_DELTA[3] > 0.0, "SM-2 EF table must penalize AGAIN and reward EASY");
+
+} // namespace sm2
+
+constexpr int LEECH_LAPSES = 8;
+
+struct SM2Policy {
+    static constexpr const char* name = "SM2";
+
+    static int nextInterval(Item& item, ReviewQuality q, const SchedulerConfig&, std::time_t) {
+        const auto qi = static_cast<std::size_t>(q);
+
+        // Update EF (SuperMemo-2 formula, table-driven)
+        item.ease_factor = std::max(sm2::MIN_EF, item.ease_factor + sm2::EF_DELTA[qi]);
+
+        // Failure resets the repetition count; success advances it
+        item.reps = sm2::PASSED[qi] ? item.reps + 1 : 0;
+
+        // Use last base interval (days) and EF once past the fixed early steps
+        int grown = std::max(1, static_cast<int>(std::round(item.base_interval * item.ease_factor)));
+        int interval = item.reps < static_cast<int>(sm2::FIRST_INTERVALS.size())
+            ? sm2::FIRST_INTERVALS[item.reps] : grown;
+
+        // Save base interval for next multiply
+        item.base_interval = interval;
+
+        // FSRS state no longer reflects the latest review; rebuild it if FSRS takes over
+        item.stability = 0.0;
+
+        spdlog::debug("SM2 '{}' | smq={} | ef={:.3f} | reps={}", item.title, sm2Quality(q), item.ease_factor, item.reps);
+        return interval;
+    }
+
+    static int baseInterval(const Item& item, const SchedulerConfig&) {
+        return std::max(1, item.base_interval);
+    }
+
+    // Replay the SM-2 recurrence over the logged qualities (used for decks saved
+    // before scheduler state was persisted)
+    static void restoreFromHistory(Item& item, const SchedulerConfig&) {
+        item.reps = 0;
+        item.ease_factor = 2.5;
+        item.base_interval = 1;
+
+        for (const auto& r : item.history) {
+            int smq = std::clamp(r.quality, 0, 5);
+            item.ease_factor = std::max(sm2::MIN_EF, item.ease_factor + sm2::efDelta(smq));
+            item.reps = smq >= 3 ? item.reps + 1 : 0;
+            int grown = std::max(1, static_cast<int>(std::round(item.base_interval * item.ease_factor)));
+            item.base_interval = item.reps < static_cast<int>(sm2::FIRST_INTERVALS.size())
+                ? sm2::FIRST_INTERVALS[item.reps] : grown;
+        }
+    }
+};
+
+struct FSRSPolicy {
+    static constexpr const char* name = "FSRS";
+
+    static int nextInterval(Item& item, ReviewQuality q, const SchedulerConfig& cfg, std::time_t now) {
+        const auto& w = cfg.fsrsWeights;
+        int rating = static_cast<int>(q) + 1;
+
+        // Cards reviewed under SM-2 (or before FSRS state was stored) carry no state yet
+        if (item.stability <= 0.0 && !item.history.empty())
+            restoreFromHistory(item, cfg);
+
+        if (item.stability <= 0.0) {
+            // First review under FSRS
+            item.stability = fsrs::initStability(w, rating);
+            item.difficulty = fsrs::initDifficulty(w, rating);
+        }
+        else {
+            update(item, w, rating, std::max(0.0, std::difftime(now, item.last_review) / 86400.0));
+        }
+
+        spdlog::debug("FSRS '{}' | rating={} | S={:.3f} | D={:.3f}",
+            item.title, rating, item.stability, item.difficulty);
+        return fsrs::nextInterval(item.stability, cfg.desiredRetention);
+    }
+
+    // Stability is only ever changed by a review, so this is the interval it produced
+    static int baseInterval(const Item& item, const SchedulerConfig& cfg) {
+        return item.stability > 0.0 ? fsrs::nextInterval(item.stability, cfg.desiredRetention) : 0;
+    }
+
+    static void restoreFromHistory(Item& item, const SchedulerConfig& cfg) {
+        const auto& w = cfg.fsrsWeights;
+        item.stability = 0.0;
+        item.difficulty = 0.0;
+
+        for (size_t i = 0; i < item.history.size(); ++i) {
+            int rating = fsrs::ratingFromSM2Quality(item.history[i].quality);
+            if (i == 0) {
+                item.stability = fsrs::initStability(w, rating);
+                item.difficulty = fsrs::initDifficulty(w, rating);
+                continue;
+            }
+            double elapsed = std::max(0.0,
+                std::difftime(item.history[i].timestamp, item.history[i - 1].timestamp) / 86400.0);
+            update(item, w, rating, elapsed);
+        }
+    }
+
+private:
+    static void update(Item& item, const fsrs::Weights<double>& w, int rating, double elapsedDays) {
+        double r = fsrs::retrievability(elapsedDays, item.stability);
+        double d = item.difficulty;
+        item.difficulty = fsrs::nextDifficulty(w, d, rating);
+        item.stability = fsrs::nextStability(w, d, item.stability, r, rating);
+    }
+};
+
+// Review, lapse and streak counters as the reviews in item.history leave
+// them. Like a review, this only ever sets is_leech: a card once flagged stays
+// flagged.
+inline void recountFromHistory(Item& item) {
+    item.lapses = 0;
+    item.review_count = 0;
+    item.streak = 0;
+    for (const auto& r : item.history) {
+        if (r.quality < 3) {
+            item.streak = 0;
+            if (item.review_count > 0) item.lapses++;
+        }
+        else {
+            item.review_count++;
+            item.streak++;
+        }
+    }
+    if (item.lapses >= LEECH_LAPSES) item.is_leech = true;
+}
+
+// Scheduling state, counters and due date as the reviews in item.history
+// leave them, for histories that were combined rather than reviewed (a sync
+// merge, merged duplicates). Tag priority is already in the logged intervals.
+inline void replaySchedule(Item& item, const SchedulerConfig& cfg) {
+    SM2Policy::restoreFromHistory(item, cfg);
+    if (cfg.algorithm == SchedulerAlgorithm::FSRS) {
+        FSRSPolicy::restoreFromHistory(item, cfg);
+    }
+    else {
+        item.stability = 0.0;
+        item.difficulty = 0.0;
+    }
+    recountFromHistory(item);
+
+    if (item.history.empty()) return;
+    const auto& last = item.history.back();
+    item.interval = last.interval_after;
+    item.last_review = last.timestamp;
+    item.next_review = last.timestamp + static_cast<std::time_t>(last.interval_after) * 24 * 60 * 60;
+}
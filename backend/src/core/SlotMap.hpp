@@ -0,0 +1,132 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+// Handle to a SlotMap element: its slot plus the slot's generation when the
+// element went in. Erasing bumps the generation, so a stale handle is
+// detected instead of reaching whatever reuses the slot.
+struct SlotHandle {
+    static constexpr std::uint32_t NONE = UINT32_MAX;
+
+    std::uint32_t index = NONE;
+    std::uint32_t generation = 0;
+
+    bool valid() const { return index != NONE; }
+    bool operator==(const SlotHandle& other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const SlotHandle& other) const { return !(*this == other); }
+};
+
+struct SlotHandleHash {
+    std::size_t operator()(const SlotHandle& h) const {
+        return std::hash<std::uint64_t>()((static_cast<std::uint64_t>(h.index) << 32) | h.generation);
+    }
+};
+
+// Generational slot map: insert, erase and lookup by handle in O(1), and
+// handles that stay valid until their own element is erased, whatever else
+// is inserted or erased meanwhile. Elements are kept densely (erasing moves
+// the last element into the hole), so iteration is a contiguous scan in no
+// particular order; slots are reused through a free list.
+template <class T>
+class SlotMap {
+public:
+    explicit SlotMap(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : slots(resource), values(resource), owners(resource) {
+    }
+
+    SlotHandle insert(T value) {
+        std::uint32_t s;
+        if (freeHead != SlotHandle::NONE) {
+            s = freeHead;
+            freeHead = slots[s].position;
+        }
+        else {
+            s = static_cast<std::uint32_t>(slots.size());
+            slots.emplace_back();
+        }
+        slots[s].position = static_cast<std::uint32_t>(values.size());
+        slots[s].live = true;
+        values.push_back(std::move(value));
+        owners.push_back(s);
+        return { s, slots[s].generation };
+    }
+
+    // False for a stale handle
+    bool erase(SlotHandle h) {
+        if (!contains(h)) return false;
+        Slot& slot = slots[h.index];
+        std::uint32_t hole = slot.position;
+        std::uint32_t last = static_cast<std::uint32_t>(values.size() - 1);
+        if (hole != last) {
+            values[hole] = std::move(values[last]);
+            owners[hole] = owners[last];
+            slots[owners[hole]].position = hole;
+        }
+        values.pop_back();
+        owners.pop_back();
+
+        slot.live = false;
+        ++slot.generation;
+        slot.position = freeHead;
+        freeHead = h.index;
+        return true;
+    }
+
+    bool contains(SlotHandle h) const {
+        return h.index < slots.size() && slots[h.index].live && slots[h.index].generation == h.generation;
+    }
+
+    // Null for a stale handle
+    T* get(SlotHandle h) { return contains(h) ? &values[slots[h.index].position] : nullptr; }
+    const T* get(SlotHandle h) const { return contains(h) ? &values[slots[h.index].position] : nullptr; }
+
+    std::size_t size() const { return values.size(); }
+    bool empty() const { return values.empty(); }
+
+    void reserve(std::size_t n) {
+        values.reserve(n);
+        owners.reserve(n);
+        slots.reserve(n);
+    }
+
+    // Every outstanding handle becomes stale
+    void clear() {
+        for (std::uint32_t s : owners) {
+            slots[s].live = false;
+            ++slots[s].generation;
+            slots[s].position = freeHead;
+            freeHead = s;
+        }
+        values.clear();
+        owners.clear();
+    }
+
+    // fn(SlotHandle, T&) for every element
+    template <class Fn>
+    void forEach(Fn&& fn) {
+        for (std::size_t i = 0; i < values.size(); ++i) fn(handleAt(i), values[i]);
+    }
+
+    template <class Fn>
+    void forEach(Fn&& fn) const {
+        for (std::size_t i = 0; i < values.size(); ++i) fn(handleAt(i), values[i]);
+    }
+
+private:
+    struct Slot {
+        std::uint32_t generation = 0;
+        std::uint32_t position = 0; // into values while live, else the next free slot
+        bool live = false;
+    };
+
+    std::pmr::vector<Slot> slots;
+    std::pmr::vector<T> values;
+    std::pmr::vector<std::uint32_t> owners; // slot of each value
+    std::uint32_t freeHead = SlotHandle::NONE;
+
+    SlotHandle handleAt(std::size_t i) const { return { owners[i], slots[owners[i]].generation }; }
+};
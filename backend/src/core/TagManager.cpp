@@ -1,5 +1,6 @@
 #include "TagManager.hpp"
 #include <sstream>
+#include "ViewStream.hpp"
 
 std::string TagManager::serialize() const {
     std::ostringstream oss;
@@ -9,25 +10,73 @@ std::string TagManager::serialize() const {
     return oss.str();
 }
 
-void TagManager::deserialize(const std::string& data) {
-    weights.clear();
-    std::istringstream iss(data);
+void TagManager::deserialize(std::string_view data) {
+    clearWeights();
+    ViewStream iss(data);
     std::string line;
 
     while (std::getline(iss, line)) {
-        auto pos = line.find(':');
+        // Hierarchical tags contain "::", so the weight follows the last colon
+        auto pos = line.rfind(':');
         if (pos == std::string::npos) continue;
 
-        std::string key = line.substr(0, pos);
+        std::string key = TagTrie::normalize(line.substr(0, pos));
         std::string valStr = line.substr(pos + 1);
         if (key.empty()) continue;
 
         try {
             int val = std::stoi(valStr);
-            if (val >= 1) weights[key] = val;
+            if (val >= 1) {
+                weights[key] = val;
+                trie.setWeight(key, val);
+            }
         }
         catch (...) {
             continue;
         }
     }
 }
+
+void TagManager::rebuild(const std::vector<Item>& items) {
+    trie.clearItems();
+    for (const auto& it : items) trie.addItem(it.id, it.tags);
+    spdlog::debug("Tag trie rebuilt: {} tags over {} items", trie.tagCount(), items.size());
+}
+
+bool TagManager::renameSubtree(const std::string& from, const std::string& to,
+    std::vector<std::pair<std::string, std::string>>& renamed) {
+    std::string src = TagTrie::normalize(from);
+    std::string dst = TagTrie::normalize(to);
+    if (!trie.moveSubtree(src, dst, renamed)) {
+        spdlog::warn("Cannot move tag '{}' to '{}'", from, to);
+        return false;
+    }
+
+    std::vector<std::pair<std::string, int>> moved;
+    for (auto it = weights.begin(); it != weights.end();) {
+        if (!TagTrie::isUnder(it->first, src)) { ++it; continue; }
+        moved.emplace_back(TagTrie::rebase(it->first, src, dst), it->second);
+        it = weights.erase(it);
+    }
+    for (auto& p : moved) weights[p.first] = p.second;
+
+    spdlog::info("Tag '{}' moved to '{}' ({} tag(s) with items)", src, dst, renamed.size());
+    return true;
+}
+
+std::vector<std::pair<std::string, int>> TagManager::weightsUnder(const std::string& tag) const {
+    std::string name = TagTrie::normalize(tag);
+    std::vector<std::pair<std::string, int>> out;
+    for (const auto& w : weights)
+        if (TagTrie::isUnder(w.first, name)) out.emplace_back(w.first, w.second);
+    return out;
+}
+
+void TagManager::restoreWeightsUnder(const std::string& tag, const std::vector<std::pair<std::string, int>>& saved) {
+    std::string name = TagTrie::normalize(tag);
+    std::vector<std::string> current;
+    for (const auto& w : weights)
+        if (TagTrie::isUnder(w.first, name)) current.push_back(w.first);
+    for (const auto& t : current) removeWeight(t);
+    for (const auto& w : saved) setWeight(w.first, w.second);
+}
@@ -1,28 +1,72 @@
 #pragma once
+#include <memory_resource>
 #include <unordered_map>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 #include <spdlog/spdlog.h>
+#include "Item.hpp"
+#include "MemoryAccount.hpp"
+#include "TagTrie.hpp"
 
+// Tag weights plus the tag hierarchy of the loaded deck. Tags nest with "::"
+// (lang::es::verbs); a tag without a weight of its own inherits its nearest
+// weighted ancestor's, so weighting "lang::es" raises every tag below it.
 class TagManager {
 public:
-    std::unordered_map<std::string, int> weights;
+    // Explicitly set weights, as saved; inherited ones live in the trie
+    std::pmr::unordered_map<std::string, int> weights{ MemoryAccount::resource(MemoryCategory::TagWeights) };
 
     int getWeight(const std::string& tag) const {
-        auto it = weights.find(tag);
-        return it == weights.end() ? 1 : it->second;
+        return trie.weightOf(tag);
     }
 
     void setWeight(const std::string& tag, int weight) {
         if (weight < 1) weight = 1;
-        weights[tag] = weight;
-        spdlog::info("Tag '{}' weight set to {}", tag, weight);
+        std::string name = TagTrie::normalize(tag);
+        if (name.empty()) return;
+        weights[name] = weight;
+        trie.setWeight(name, weight);
+        spdlog::info("Tag '{}' weight set to {}", name, weight);
     }
 
     void removeWeight(const std::string& tag) {
-        weights.erase(tag);
-        spdlog::info("Tag '{}' weight removed", tag);
+        std::string name = TagTrie::normalize(tag);
+        weights.erase(name);
+        trie.clearWeight(name);
+        spdlog::info("Tag '{}' weight removed", name);
     }
 
+    void clearWeights() {
+        weights.clear();
+        trie.clearWeights();
+    }
+
+    // Keep the hierarchy in step with the deck (alongside DeckStats)
+    void addItem(const Item& item) { trie.addItem(item.id, item.tags); }
+    void removeItem(const Item& item) { trie.removeItem(item.id, item.tags); }
+    void rebuild(const std::vector<Item>& items);
+
+    // IDs of items tagged prefix or anything below it, without scanning the deck
+    std::vector<std::string> itemsUnder(const std::string& prefix) const { return trie.itemsUnder(prefix); }
+    std::size_t countUnder(const std::string& prefix) const { return trie.countUnder(prefix); }
+    std::vector<TagTrie::Entry> tagsUnder(const std::string& prefix = "") const { return trie.tagsUnder(prefix); }
+
+    // Moves a subtree of tags (weights and item postings) from `from` to `to`.
+    // renamed receives the (old, new) names of tags that items carry, which
+    // the caller then rewrites on the items themselves.
+    bool renameSubtree(const std::string& from, const std::string& to,
+        std::vector<std::pair<std::string, std::string>>& renamed);
+
+    // Explicit weights of `tag` and the tags below it, e.g. to undo a move
+    std::vector<std::pair<std::string, int>> weightsUnder(const std::string& tag) const;
+    // Replaces the explicit weights of `tag` and the tags below it with `saved`
+    void restoreWeightsUnder(const std::string& tag, const std::vector<std::pair<std::string, int>>& saved);
+
     std::string serialize() const;
-    void deserialize(const std::string& data);
+    void deserialize(std::string_view data);
+
+private:
+    TagTrie trie;
 };
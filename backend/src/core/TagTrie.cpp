@@ -0,0 +1,317 @@
+#include "TagTrie.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+std::vector<std::string> TagTrie::split(const std::string& tag) {
+    std::vector<std::string> out;
+    const std::size_t sepLen = std::strlen(SEPARATOR);
+    std::size_t start = 0;
+
+    while (start <= tag.size()) {
+        std::size_t end = tag.find(SEPARATOR, start);
+        if (end == std::string::npos) end = tag.size();
+
+        std::size_t b = start, e = end;
+        while (b < e && std::isspace(static_cast<unsigned char>(tag[b]))) ++b;
+        while (e > b && std::isspace(static_cast<unsigned char>(tag[e - 1]))) --e;
+        if (b < e) out.emplace_back(tag, b, e - b);
+
+        start = end + sepLen;
+    }
+    return out;
+}
+
+std::string TagTrie::join(const std::vector<std::string>& segments) {
+    std::string out;
+    for (const auto& s : segments) {
+        if (!out.empty()) out += SEPARATOR;
+        out += s;
+    }
+    return out;
+}
+
+bool TagTrie::isUnder(const std::string& tag, const std::string& prefix) {
+    if (prefix.empty()) return true;
+    if (tag.compare(0, prefix.size(), prefix) != 0) return false;
+    return tag.size() == prefix.size() || tag.compare(prefix.size(), std::strlen(SEPARATOR), SEPARATOR) == 0;
+}
+
+std::string TagTrie::rebase(const std::string& tag, const std::string& from, const std::string& to) {
+    return to + tag.substr(from.size());
+}
+
+TagTrie::TagTrie() {
+    nodes.emplace_back();
+    nodes[ROOT].live = true;
+}
+
+TagTrie::NodeId TagTrie::childOf(NodeId n, const std::string& segment) const {
+    const auto& kids = nodes[n].children;
+    auto it = std::lower_bound(kids.begin(), kids.end(), segment,
+        [&](NodeId c, const std::string& s) { return nodes[c].segment < s; });
+    return it != kids.end() && nodes[*it].segment == segment ? *it : NONE;
+}
+
+// Deepest existing node along segments; matched = how many segments it covers
+TagTrie::NodeId TagTrie::findSegments(const std::vector<std::string>& segments, std::size_t& matched) const {
+    NodeId n = ROOT;
+    for (matched = 0; matched < segments.size(); ++matched) {
+        NodeId c = childOf(n, segments[matched]);
+        if (c == NONE) break;
+        n = c;
+    }
+    return n;
+}
+
+TagTrie::NodeId TagTrie::find(const std::string& tag) const {
+    auto it = byTag.find(tag);
+    if (it != byTag.end()) return it->second;
+
+    std::string norm = normalize(tag);
+    if (norm.empty() || norm == tag) return NONE;
+    it = byTag.find(norm);
+    return it == byTag.end() ? NONE : it->second;
+}
+
+TagTrie::NodeId TagTrie::ensure(const std::string& tag) {
+    auto segments = split(tag);
+    if (segments.empty()) return NONE;
+
+    std::size_t matched = 0;
+    NodeId n = findSegments(segments, matched);
+    std::string name = join(std::vector<std::string>(segments.begin(), segments.begin() + matched));
+
+    for (; matched < segments.size(); ++matched) {
+        NodeId c;
+        if (!freeNodes.empty()) { c = freeNodes.back(); freeNodes.pop_back(); }
+        else { c = static_cast<NodeId>(nodes.size()); nodes.emplace_back(); }
+
+        Node& node = nodes[c];
+        node = Node{};
+        node.segment = segments[matched];
+        node.parent = n;
+        node.resolved = nodes[n].resolved;
+        node.live = true;
+
+        auto& kids = nodes[n].children;
+        auto pos = std::lower_bound(kids.begin(), kids.end(), node.segment,
+            [&](NodeId k, const std::string& s) { return nodes[k].segment < s; });
+        kids.insert(pos, c);
+
+        if (!name.empty()) name += SEPARATOR;
+        name += segments[matched];
+        byTag.emplace(name, c);
+        n = c;
+    }
+    return n;
+}
+
+std::string TagTrie::nameOf(NodeId n) const {
+    std::vector<std::string> segments;
+    for (; n != ROOT && n != NONE; n = nodes[n].parent) segments.push_back(nodes[n].segment);
+    std::reverse(segments.begin(), segments.end());
+    return join(segments);
+}
+
+void TagTrie::adjustCounts(NodeId n, long delta) {
+    for (; n != NONE; n = nodes[n].parent)
+        nodes[n].subtree = static_cast<std::size_t>(static_cast<long>(nodes[n].subtree) + delta);
+}
+
+// Recomputes inherited weights below n (n included) after its weight changed
+void TagTrie::resolve(NodeId n) {
+    std::vector<NodeId> stack{ n };
+    while (!stack.empty()) {
+        NodeId c = stack.back();
+        stack.pop_back();
+        Node& node = nodes[c];
+        int inherited = node.parent == NONE ? 1 : nodes[node.parent].resolved;
+        node.resolved = node.weight > 0 ? node.weight : inherited;
+        stack.insert(stack.end(), node.children.begin(), node.children.end());
+    }
+}
+
+// Drops n and then its ancestors while they carry nothing
+void TagTrie::prune(NodeId n) {
+    while (n != ROOT && n != NONE) {
+        Node& node = nodes[n];
+        if (!node.items.empty() || node.weight > 0 || !node.children.empty()) return;
+
+        NodeId parent = node.parent;
+        auto& kids = nodes[parent].children;
+        kids.erase(std::find(kids.begin(), kids.end(), n));
+        byTag.erase(nameOf(n));
+
+        node = Node{};
+        freeNodes.push_back(n);
+        n = parent;
+    }
+}
+
+void TagTrie::addItem(const std::string& id, const std::vector<std::string>& tags) {
+    for (const auto& t : tags) {
+        NodeId n = find(t);
+        if (n == NONE) n = ensure(t);
+        if (n == NONE) continue;
+        if (nodes[n].items.insert(id).second) adjustCounts(n, 1);
+    }
+}
+
+void TagTrie::removeItem(const std::string& id, const std::vector<std::string>& tags) {
+    for (const auto& t : tags) {
+        NodeId n = find(t);
+        if (n == NONE || nodes[n].items.erase(id) == 0) continue;
+        adjustCounts(n, -1);
+        prune(n);
+    }
+}
+
+void TagTrie::clearItems() {
+    std::vector<NodeId> all;
+    all.reserve(byTag.size());
+    for (const auto& p : byTag) all.push_back(p.second);
+
+    for (auto& node : nodes) {
+        node.items.clear();
+        node.subtree = 0;
+    }
+    for (NodeId n : all)
+        if (nodes[n].live) prune(n);
+}
+
+std::vector<std::string> TagTrie::itemsUnder(const std::string& prefix) const {
+    std::vector<std::string> out;
+    NodeId start = prefix.empty() ? ROOT : find(prefix);
+    if (start == NONE) return out;
+    out.reserve(nodes[start].subtree);
+
+    std::vector<NodeId> stack{ start };
+    while (!stack.empty()) {
+        const Node& node = nodes[stack.back()];
+        stack.pop_back();
+        out.insert(out.end(), node.items.begin(), node.items.end());
+        stack.insert(stack.end(), node.children.begin(), node.children.end());
+    }
+
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+    return out;
+}
+
+std::size_t TagTrie::countUnder(const std::string& prefix) const {
+    NodeId n = prefix.empty() ? ROOT : find(prefix);
+    return n == NONE ? 0 : nodes[n].subtree;
+}
+
+std::vector<TagTrie::Entry> TagTrie::tagsUnder(const std::string& prefix) const {
+    std::vector<Entry> out;
+    NodeId start = prefix.empty() ? ROOT : find(prefix);
+    if (start == NONE) return out;
+
+    struct Frame { NodeId n; std::string name; int depth; };
+    std::vector<Frame> stack;
+    if (start == ROOT) {
+        const auto& kids = nodes[ROOT].children;
+        for (auto it = kids.rbegin(); it != kids.rend(); ++it) stack.push_back({ *it, nodes[*it].segment, 0 });
+    }
+    else stack.push_back({ start, nameOf(start), 0 });
+
+    while (!stack.empty()) {
+        Frame f = std::move(stack.back());
+        stack.pop_back();
+        const Node& node = nodes[f.n];
+        out.push_back({ f.name, f.depth, node.items.size(), node.subtree, node.weight, node.resolved });
+
+        for (auto it = node.children.rbegin(); it != node.children.rend(); ++it)
+            stack.push_back({ *it, f.name + SEPARATOR + nodes[*it].segment, f.depth + 1 });
+    }
+    return out;
+}
+
+void TagTrie::setWeight(const std::string& tag, int weight) {
+    NodeId n = ensure(tag);
+    if (n == NONE) return;
+    nodes[n].weight = std::max(1, weight);
+    resolve(n);
+}
+
+void TagTrie::clearWeight(const std::string& tag) {
+    NodeId n = find(tag);
+    if (n == NONE || nodes[n].weight == 0) return;
+    nodes[n].weight = 0;
+    resolve(n);
+    prune(n);
+}
+
+void TagTrie::clearWeights() {
+    std::vector<NodeId> all;
+    all.reserve(byTag.size());
+    for (const auto& p : byTag) all.push_back(p.second);
+
+    for (auto& node : nodes) {
+        node.weight = 0;
+        node.resolved = 1;
+    }
+    for (NodeId n : all)
+        if (nodes[n].live) prune(n);
+}
+
+int TagTrie::weightOf(const std::string& tag) const {
+    auto it = byTag.find(tag);
+    if (it != byTag.end()) return nodes[it->second].resolved;
+
+    // Not a known tag: inherit from the deepest known ancestor
+    std::size_t matched = 0;
+    return nodes[findSegments(split(tag), matched)].resolved;
+}
+
+bool TagTrie::moveSubtree(const std::string& from, const std::string& to,
+    std::vector<std::pair<std::string, std::string>>& renamed) {
+    std::string src = normalize(from);
+    std::string dst = normalize(to);
+    NodeId top = src.empty() ? NONE : find(src);
+    if (top == NONE || dst.empty() || isUnder(dst, src)) return false;
+
+    struct Moved { std::string tag; std::unordered_set<std::string> items; int weight; };
+    std::vector<Moved> moved;
+    std::vector<std::pair<std::string, std::string>> names;
+    std::vector<NodeId> stack{ top };
+    while (!stack.empty()) {
+        NodeId n = stack.back();
+        stack.pop_back();
+        Node& node = nodes[n];
+        std::string name = nameOf(n);
+        moved.push_back({ rebase(name, src, dst), std::move(node.items), node.weight });
+        names.emplace_back(std::move(name), moved.back().tag);
+        stack.insert(stack.end(), node.children.begin(), node.children.end());
+    }
+
+    // Detach the whole subtree, then let its old ancestors go if nothing else holds them
+    NodeId parent = nodes[top].parent;
+    adjustCounts(parent, -static_cast<long>(nodes[top].subtree));
+    auto& kids = nodes[parent].children;
+    kids.erase(std::find(kids.begin(), kids.end(), top));
+    for (const auto& p : names) {
+        NodeId n = byTag.at(p.first);
+        byTag.erase(p.first);
+        nodes[n] = Node{};
+        freeNodes.push_back(n);
+    }
+    prune(parent);
+
+    for (std::size_t k = 0; k < moved.size(); ++k) {
+        NodeId n = ensure(moved[k].tag);
+        Node& node = nodes[n];
+        if (moved[k].weight > 0) node.weight = moved[k].weight;
+
+        long added = 0;
+        for (const auto& id : moved[k].items) added += node.items.insert(id).second ? 1 : 0;
+        adjustCounts(n, added);
+
+        if (!moved[k].items.empty()) renamed.push_back(std::move(names[k]));
+    }
+
+    resolve(byTag.at(dst));
+    return true;
+}
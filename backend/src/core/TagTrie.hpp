@@ -0,0 +1,102 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Hierarchical tags such as "lang::es::verbs", kept as a trie with one node
+// per "::" segment. Each node holds the IDs of items tagged with exactly that
+// name and a running count for its whole subtree, so "everything under
+// lang::es" touches only that subtree instead of scanning the deck.
+//
+// Weights inherit downwards: a tag without a weight of its own takes the
+// nearest ancestor's. The inherited value is stored on every node and only
+// recomputed for the affected subtree when a weight is set, removed or moved,
+// so a lookup during review ordering is a single hash probe.
+//
+// Nodes live in one vector and are reused after pruning; children are kept
+// sorted by segment. Not thread-safe: callers serialize mutations with reads.
+class TagTrie {
+public:
+    static constexpr const char* SEPARATOR = "::";
+
+    // "a:: b ::c" -> {"a", "b", "c"}; blank segments are dropped
+    static std::vector<std::string> split(const std::string& tag);
+    static std::string join(const std::vector<std::string>& segments);
+    static std::string normalize(const std::string& tag) { return join(split(tag)); }
+
+    // True when tag is prefix itself or lies below it (segment-wise, so "lang::e" is not under "lang::es")
+    static bool isUnder(const std::string& tag, const std::string& prefix);
+
+    // tag with its leading `from` replaced by `to`; tag must be under from
+    static std::string rebase(const std::string& tag, const std::string& from, const std::string& to);
+
+    TagTrie();
+
+    void addItem(const std::string& id, const std::vector<std::string>& tags);
+    void removeItem(const std::string& id, const std::vector<std::string>& tags);
+    void clearItems();
+
+    // IDs of items carrying prefix or any tag below it, sorted and without duplicates
+    std::vector<std::string> itemsUnder(const std::string& prefix) const;
+    // Tag assignments at or below prefix (an item with two tags in the subtree counts twice)
+    std::size_t countUnder(const std::string& prefix) const;
+
+    struct Entry {
+        std::string tag;
+        int depth = 0;            // segments below the queried prefix
+        std::size_t items = 0;    // tagged with exactly this name
+        std::size_t subtree = 0;  // tag assignments in the whole subtree
+        int weight = 0;           // own weight, 0 = inherited
+        int resolved = 1;
+    };
+    // Pre-order walk of the subtree at prefix ("" = everything), children in name order
+    std::vector<Entry> tagsUnder(const std::string& prefix = "") const;
+
+    void setWeight(const std::string& tag, int weight);
+    void clearWeight(const std::string& tag);
+    void clearWeights();
+    // Own weight, or the nearest ancestor's, or 1
+    int weightOf(const std::string& tag) const;
+
+    // Moves the subtree at from (items and weights) to to, merging into
+    // whatever is already there; moved weights win. Returns the renamed tags
+    // that carried items, as (old, new) pairs. Fails (returns false) when
+    // from does not exist or to lies inside it.
+    bool moveSubtree(const std::string& from, const std::string& to,
+        std::vector<std::pair<std::string, std::string>>& renamed);
+
+    std::size_t tagCount() const { return byTag.size(); }
+
+private:
+    using NodeId = std::uint32_t;
+    static constexpr NodeId ROOT = 0;
+    static constexpr NodeId NONE = static_cast<NodeId>(-1);
+
+    struct Node {
+        std::string segment;
+        NodeId parent = NONE;
+        std::vector<NodeId> children;           // sorted by segment
+        std::unordered_set<std::string> items;  // tagged with exactly this name
+        std::size_t subtree = 0;
+        int weight = 0;
+        int resolved = 1;
+        bool live = false;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<NodeId> freeNodes;
+    std::unordered_map<std::string, NodeId> byTag;  // full name -> node, every live node but the root
+
+    NodeId find(const std::string& tag) const;
+    NodeId findSegments(const std::vector<std::string>& segments, std::size_t& matched) const;
+    NodeId ensure(const std::string& tag);
+    NodeId childOf(NodeId n, const std::string& segment) const;
+    std::string nameOf(NodeId n) const;
+    void adjustCounts(NodeId n, long delta);
+    void resolve(NodeId n);
+    void prune(NodeId n);
+};
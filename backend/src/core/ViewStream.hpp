@@ -0,0 +1,19 @@
+#pragma once
+#include <istream>
+#include <streambuf>
+#include <string_view>
+
+// An istream over characters it does not own, for parsing a buffer in place
+// (std::istringstream would copy it). The characters must outlive the stream.
+class ViewStream : public std::istream {
+public:
+    explicit ViewStream(std::string_view text) : std::istream(nullptr), buf(text) { rdbuf(&buf); }
+
+private:
+    struct Buf : std::streambuf {
+        explicit Buf(std::string_view text) {
+            char* p = const_cast<char*>(text.data());
+            setg(p, p, p + text.size());
+        }
+    } buf;
+};
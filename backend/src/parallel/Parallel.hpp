@@ -0,0 +1,85 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "ThreadPool.hpp"
+
+// Loops over index ranges on a ThreadPool. The range is cut into chunks of
+// `grain` indices (0 = about four chunks per worker); the calling thread runs
+// the last chunk itself and then helps with the rest until all are done.
+//
+// Passing a TaskGroup lets the body cancel the loop: chunks that have not
+// started are skipped once the group is cancelled.
+
+namespace parallel {
+
+    inline std::size_t chunkSize(const ThreadPool& pool, std::size_t count, std::size_t grain) {
+        if (grain > 0) return grain;
+        std::size_t chunks = pool.size() * 4;
+        return std::max<std::size_t>(1, (count + chunks - 1) / chunks);
+    }
+
+} // namespace parallel
+
+// body(lo, hi) handles indices [lo, hi)
+template <class Body>
+void parallelFor(TaskGroup& group, std::size_t begin, std::size_t end, std::size_t grain, const Body& body) {
+    if (begin >= end) return;
+    std::size_t step = parallel::chunkSize(group.pool(), end - begin, grain);
+
+    std::size_t lo = begin;
+    for (; end - lo > step; lo += step) {
+        std::size_t hi = lo + step;
+        group.run([&body, lo, hi] { body(lo, hi); });
+    }
+    if (!group.isCancelled()) body(lo, end);
+    group.wait();
+}
+
+template <class Body>
+void parallelFor(ThreadPool& pool, std::size_t begin, std::size_t end, std::size_t grain, const Body& body) {
+    TaskGroup group(pool);
+    parallelFor(group, begin, end, grain, body);
+}
+
+template <class Body>
+void parallelFor(std::size_t begin, std::size_t end, std::size_t grain, const Body& body) {
+    parallelFor(ThreadPool::shared(), begin, end, grain, body);
+}
+
+// map(lo, hi) returns the partial result for [lo, hi); partials are combined
+// left to right in index order, so with a fixed grain the result does not
+// depend on the number of workers (matters for floating-point sums)
+template <class T, class Map, class Combine>
+T parallelReduce(TaskGroup& group, std::size_t begin, std::size_t end, std::size_t grain, T identity,
+    const Map& map, const Combine& combine) {
+    if (begin >= end) return identity;
+    std::size_t step = parallel::chunkSize(group.pool(), end - begin, grain);
+    std::size_t chunks = (end - begin + step - 1) / step;
+
+    std::vector<T> partials(chunks, identity);
+    parallelFor(group, 0, chunks, 1, [&](std::size_t c0, std::size_t c1) {
+        for (std::size_t c = c0; c < c1; ++c) {
+            std::size_t lo = begin + c * step;
+            partials[c] = map(lo, std::min(end, lo + step));
+        }
+    });
+
+    T result = std::move(identity);
+    for (auto& p : partials) result = combine(std::move(result), std::move(p));
+    return result;
+}
+
+template <class T, class Map, class Combine>
+T parallelReduce(ThreadPool& pool, std::size_t begin, std::size_t end, std::size_t grain, T identity,
+    const Map& map, const Combine& combine) {
+    TaskGroup group(pool);
+    return parallelReduce(group, begin, end, grain, std::move(identity), map, combine);
+}
+
+template <class T, class Map, class Combine>
+T parallelReduce(std::size_t begin, std::size_t end, std::size_t grain, T identity, const Map& map,
+    const Combine& combine) {
+    return parallelReduce(ThreadPool::shared(), begin, end, grain, std::move(identity), map, combine);
+}
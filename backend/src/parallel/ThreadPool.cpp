@@ -0,0 +1,180 @@
+#include "ThreadPool.hpp"
+#include <spdlog/spdlog.h>
+
+namespace {
+    // Which pool and deque the current thread works for, so nested submits
+    // land on the submitting worker's own deque
+    thread_local const ThreadPool* currentPool = nullptr;
+    thread_local std::size_t currentWorker = 0;
+}
+
+ThreadPool::ThreadPool(std::size_t threads) {
+    if (threads == 0) threads = defaultThreadCount();
+
+    queues.reserve(threads);
+    for (std::size_t i = 0; i < threads; ++i) queues.push_back(std::make_unique<Worker>());
+
+    workers.reserve(threads);
+    for (std::size_t i = 0; i < threads; ++i) workers.emplace_back(&ThreadPool::workerLoop, this, i);
+
+    spdlog::debug("Thread pool started with {} workers", threads);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(sleepLock);
+        stopping.store(true, std::memory_order_release);
+    }
+    wake.notify_all();
+    for (auto& t : workers) t.join();
+}
+
+std::size_t ThreadPool::defaultThreadCount() {
+    unsigned n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::submit(Task task) {
+    std::size_t target = (currentPool == this)
+        ? currentWorker
+        : nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+    // Counted before it is visible, so pending never drops below the real count
+    pending.fetch_add(1, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> guard(queues[target]->lock);
+        queues[target]->tasks.push_back(std::move(task));
+    }
+
+    // Taking the lock orders the increment before a sleeper's predicate check
+    { std::lock_guard<std::mutex> guard(sleepLock); }
+    wake.notify_one();
+}
+
+bool ThreadPool::popOwn(std::size_t self, Task& task) {
+    Worker& w = *queues[self];
+    std::lock_guard<std::mutex> guard(w.lock);
+    if (w.tasks.empty()) return false;
+    task = std::move(w.tasks.back());
+    w.tasks.pop_back();
+    return true;
+}
+
+bool ThreadPool::steal(std::size_t self, Task& task) {
+    for (std::size_t k = 1; k <= queues.size(); ++k) {
+        Worker& w = *queues[(self + k) % queues.size()];
+        std::lock_guard<std::mutex> guard(w.lock);
+        if (w.tasks.empty()) continue;
+        task = std::move(w.tasks.front());
+        w.tasks.pop_front();
+        return true;
+    }
+    return false;
+}
+
+bool ThreadPool::take(Task& task) {
+    if (pending.load(std::memory_order_acquire) == 0) return false;
+
+    bool found = false;
+    if (currentPool == this) {
+        found = popOwn(currentWorker, task);
+        if (!found && steal(currentWorker, task)) {
+            found = true;
+            stolen.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    else {
+        found = steal(nextQueue.load(std::memory_order_relaxed) % queues.size(), task);
+    }
+
+    if (found) pending.fetch_sub(1, std::memory_order_acq_rel);
+    return found;
+}
+
+void ThreadPool::execute(Task& task) {
+    task();
+    task = nullptr;
+    executed.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool ThreadPool::runPending() {
+    Task task;
+    if (!take(task)) return false;
+    execute(task);
+    return true;
+}
+
+void ThreadPool::workerLoop(std::size_t self) {
+    currentPool = this;
+    currentWorker = self;
+
+    Task task;
+    while (true) {
+        if (take(task)) {
+            execute(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> guard(sleepLock);
+        wake.wait(guard, [&] {
+            return stopping.load(std::memory_order_acquire) || pending.load(std::memory_order_acquire) > 0;
+        });
+        if (stopping.load(std::memory_order_acquire) && pending.load(std::memory_order_acquire) == 0) break;
+    }
+}
+
+ThreadPool::Metrics ThreadPool::metrics() const {
+    Metrics m;
+    m.executed = executed.load(std::memory_order_relaxed);
+    m.stolen = stolen.load(std::memory_order_relaxed);
+    return m;
+}
+
+TaskGroup::TaskGroup(ThreadPool& pool)
+    : owner(pool) {
+}
+
+TaskGroup::~TaskGroup() {
+    join();
+}
+
+void TaskGroup::run(std::function<void()> fn) {
+    if (isCancelled()) return;
+
+    outstanding.fetch_add(1, std::memory_order_acq_rel);
+    owner.submit([this, fn = std::move(fn)] {
+        if (!isCancelled()) {
+            try {
+                fn();
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> guard(errorLock);
+                if (!error) error = std::current_exception();
+                cancel();
+            }
+        }
+        // Last touch of the group: a waiter may destroy it right after this
+        outstanding.fetch_sub(1, std::memory_order_acq_rel);
+    });
+}
+
+void TaskGroup::join() {
+    while (outstanding.load(std::memory_order_acquire) > 0) {
+        if (!owner.runPending()) std::this_thread::yield();
+    }
+}
+
+void TaskGroup::wait() {
+    join();
+
+    std::exception_ptr failed;
+    {
+        std::lock_guard<std::mutex> guard(errorLock);
+        std::swap(failed, error);
+    }
+    if (failed) std::rethrow_exception(failed);
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing task scheduler shared by the backend libraries. Each worker
+// owns a deque: it pushes and pops its own tasks at the back (newest first,
+// so nested work stays cache-warm) and, when empty, steals the oldest task
+// from the front of another worker's deque. Tasks submitted from outside the
+// pool are spread round-robin over the deques.
+//
+// Threads that wait for work (TaskGroup::wait) run pending tasks instead of
+// blocking, so nested parallel loops cannot deadlock the pool.
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+
+    struct Metrics {
+        std::uint64_t executed = 0;
+        std::uint64_t stolen = 0; // taken from another worker's deque
+    };
+
+    // threads = 0 picks defaultThreadCount()
+    explicit ThreadPool(std::size_t threads = 0);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool();
+
+    // Hardware threads reported by the system, at least 1
+    static std::size_t defaultThreadCount();
+
+    // Process-wide pool sized by defaultThreadCount(), created on first use
+    static ThreadPool& shared();
+
+    std::size_t size() const { return workers.size(); }
+
+    // Tasks must not throw; use TaskGroup to get exceptions back
+    void submit(Task task);
+
+    // Runs one queued task on the calling thread. False if none was found.
+    bool runPending();
+
+    Metrics metrics() const;
+
+private:
+    struct Worker {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Worker>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<bool> stopping{ false };
+    std::atomic<std::size_t> pending{ 0 }; // queued but not yet started
+    std::atomic<std::size_t> nextQueue{ 0 };
+
+    std::mutex sleepLock;
+    std::condition_variable wake;
+
+    std::atomic<std::uint64_t> executed{ 0 };
+    std::atomic<std::uint64_t> stolen{ 0 };
+
+    void workerLoop(std::size_t self);
+    bool popOwn(std::size_t self, Task& task);
+    bool steal(std::size_t self, Task& task);
+    bool take(Task& task);
+    void execute(Task& task);
+};
+
+// A set of tasks that can be waited on and cancelled together. Cancelling
+// skips tasks that have not started yet; running tasks can poll
+// isCancelled() to stop early. The first exception thrown by a task cancels
+// the group and is rethrown by wait().
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool& pool = ThreadPool::shared());
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+    ~TaskGroup(); // waits, but swallows a pending exception
+
+    ThreadPool& pool() const { return owner; }
+
+    void run(std::function<void()> fn);
+    void wait();
+
+    void cancel() { cancelled.store(true, std::memory_order_release); }
+    bool isCancelled() const { return cancelled.load(std::memory_order_acquire); }
+
+private:
+    ThreadPool& owner;
+    std::atomic<std::size_t> outstanding{ 0 };
+    std::atomic<bool> cancelled{ false };
+    std::mutex errorLock;
+    std::exception_ptr error;
+
+    void join();
+};
@@ -0,0 +1,314 @@
+#include "BTree.hpp"
+#include <algorithm>
+#include <cstring>
+#include <spdlog/spdlog.h>
+
+// Page layout: type (1 = leaf, 2 = inner) | u16 count | u32 next leaf or first child,
+// then count entries: leaves u16 key length | key | u16 value length | value,
+// inner nodes u16 key length | key | u32 child holding keys >= key
+static constexpr unsigned char LEAF = 1;
+static constexpr unsigned char INNER = 2;
+static constexpr std::size_t NODE_HDR = 7;
+static_assert(3 * (4 + BTree::MAX_KEY + BTree::MAX_VALUE) <= PageFile::DATA_SIZE - NODE_HDR,
+    "a split must leave both halves within a page");
+
+static void putU16(unsigned char*& p, std::size_t v) {
+    p[0] = static_cast<unsigned char>(v);
+    p[1] = static_cast<unsigned char>(v >> 8);
+    p += 2;
+}
+
+static void putU32(unsigned char*& p, std::uint32_t v) {
+    for (int i = 0; i < 4; ++i) p[i] = static_cast<unsigned char>(v >> (8 * i));
+    p += 4;
+}
+
+static void putBytes(unsigned char*& p, const std::string& s) {
+    putU16(p, s.size());
+    std::memcpy(p, s.data(), s.size());
+    p += s.size();
+}
+
+// Bounds-checked reader over one page
+struct PageReader {
+    const unsigned char* p;
+    const unsigned char* end;
+
+    bool u16(std::size_t& v) {
+        if (end - p < 2) return false;
+        v = p[0] | (static_cast<std::size_t>(p[1]) << 8);
+        p += 2;
+        return true;
+    }
+    bool u32(std::uint32_t& v) {
+        if (end - p < 4) return false;
+        v = 0;
+        for (int i = 0; i < 4; ++i) v |= static_cast<std::uint32_t>(p[i]) << (8 * i);
+        p += 4;
+        return true;
+    }
+    bool bytes(std::string& s) {
+        std::size_t len = 0;
+        if (!u16(len) || static_cast<std::size_t>(end - p) < len) return false;
+        s.assign(reinterpret_cast<const char*>(p), len);
+        p += len;
+        return true;
+    }
+};
+
+BTree::BTree(BufferPool& p) : pool(p) {
+}
+
+bool BTree::load(PageFile::PageId id, Node& node) {
+    const unsigned char* page = pool.read(id);
+    if (!page) return false;
+
+    PageReader in{ page + 1, page + PageFile::DATA_SIZE };
+    std::size_t count = 0;
+    std::uint32_t link = 0;
+    if ((page[0] != LEAF && page[0] != INNER) || !in.u16(count) || !in.u32(link)) {
+        spdlog::error("Page {} is not a tree node", id);
+        return false;
+    }
+
+    node = Node{};
+    node.leaf = page[0] == LEAF;
+    node.keys.resize(count);
+    if (node.leaf) {
+        node.next = link;
+        node.values.resize(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            if (!in.bytes(node.keys[i]) || !in.bytes(node.values[i])) {
+                spdlog::error("Corrupt leaf page {}", id);
+                return false;
+            }
+        }
+    }
+    else {
+        node.children.resize(count + 1);
+        node.children[0] = link;
+        for (std::size_t i = 0; i < count; ++i) {
+            if (!in.bytes(node.keys[i]) || !in.u32(node.children[i + 1])) {
+                spdlog::error("Corrupt inner page {}", id);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool BTree::store(PageFile::PageId id, const Node& node) {
+    if (encodedSize(node) > PageFile::DATA_SIZE) {
+        spdlog::error("Tree node for page {} does not fit", id);
+        return false;
+    }
+    unsigned char* page = pool.write(id);
+    if (!page) return false;
+
+    std::memset(page, 0, PageFile::DATA_SIZE);
+    unsigned char* p = page;
+    *p++ = node.leaf ? LEAF : INNER;
+    putU16(p, node.keys.size());
+    putU32(p, node.leaf ? node.next : node.children[0]);
+    for (std::size_t i = 0; i < node.keys.size(); ++i) {
+        putBytes(p, node.keys[i]);
+        if (node.leaf) putBytes(p, node.values[i]);
+        else putU32(p, node.children[i + 1]);
+    }
+    return true;
+}
+
+std::size_t BTree::entrySize(const Node& node, std::size_t i) {
+    return node.leaf ? 4 + node.keys[i].size() + node.values[i].size() : 6 + node.keys[i].size();
+}
+
+std::size_t BTree::encodedSize(const Node& node) {
+    std::size_t size = NODE_HDR;
+    for (std::size_t i = 0; i < node.keys.size(); ++i) size += entrySize(node, i);
+    return size;
+}
+
+std::size_t BTree::childFor(const Node& node, const std::string& key) {
+    return static_cast<std::size_t>(std::upper_bound(node.keys.begin(), node.keys.end(), key) - node.keys.begin());
+}
+
+bool BTree::findLeaf(const std::string& key, PageFile::PageId& leaf, Node& node) {
+    leaf = pool.file().root();
+    if (leaf == PageFile::NO_PAGE) return false;
+    if (!load(leaf, node)) return false;
+    while (!node.leaf) {
+        leaf = node.children[childFor(node, key)];
+        if (!load(leaf, node)) return false;
+    }
+    return true;
+}
+
+bool BTree::get(const std::string& key, std::string& value, bool& found) {
+    found = false;
+    PageFile::PageId leaf;
+    Node node;
+    if (!findLeaf(key, leaf, node)) return pool.file().root() == PageFile::NO_PAGE;
+
+    auto it = std::lower_bound(node.keys.begin(), node.keys.end(), key);
+    if (it != node.keys.end() && *it == key) {
+        value = node.values[static_cast<std::size_t>(it - node.keys.begin())];
+        found = true;
+    }
+    return true;
+}
+
+// Moves entries from `at` on to a new page; at = 0 splits the node in half
+// by bytes. Falls back to halving if either side would not fit.
+bool BTree::splitNode(PageFile::PageId id, Node& node, Split& split, std::size_t at) {
+    std::size_t m = at;
+    if (m > 0) {
+        std::size_t left = NODE_HDR;
+        for (std::size_t i = 0; i < m; ++i) left += entrySize(node, i);
+        if (m >= node.keys.size() || left > PageFile::DATA_SIZE || encodedSize(node) - left + NODE_HDR > PageFile::DATA_SIZE)
+            m = 0;
+    }
+    if (m == 0) {
+        std::size_t half = (encodedSize(node) - NODE_HDR) / 2;
+        std::size_t bytes = 0;
+        while (m < node.keys.size() && (m == 0 || bytes + entrySize(node, m) <= half)) bytes += entrySize(node, m++);
+        if (!node.leaf && m == node.keys.size()) --m; // an inner node pushes one key up
+    }
+
+    Node right;
+    right.leaf = node.leaf;
+    if (node.leaf) {
+        right.keys.assign(node.keys.begin() + m, node.keys.end());
+        right.values.assign(node.values.begin() + m, node.values.end());
+        node.keys.resize(m);
+        node.values.resize(m);
+        split.separator = right.keys.front();
+    }
+    else {
+        split.separator = node.keys[m];
+        right.keys.assign(node.keys.begin() + m + 1, node.keys.end());
+        right.children.assign(node.children.begin() + m + 1, node.children.end());
+        node.keys.resize(m);
+        node.children.resize(m + 1);
+    }
+
+    split.right = pool.allocate();
+    if (node.leaf) {
+        right.next = node.next;
+        node.next = split.right;
+    }
+    split.happened = true;
+    if (lastLeaf == id && lastSlot >= m) {
+        lastLeaf = split.right;
+        lastSlot -= m;
+    }
+    return store(split.right, right) && store(id, node);
+}
+
+bool BTree::insert(PageFile::PageId id, const std::string& key, const std::string& value, Split& split) {
+    Node node;
+    if (!load(id, node)) return false;
+
+    // Where a full leaf is cut: right after the new key when it directly
+    // follows the previous insert, so keys arriving in order (a deck being
+    // saved) leave full pages behind instead of half-empty ones
+    std::size_t at = 0;
+    if (node.leaf) {
+        auto it = std::lower_bound(node.keys.begin(), node.keys.end(), key);
+        std::size_t i = static_cast<std::size_t>(it - node.keys.begin());
+        if (it != node.keys.end() && *it == key) {
+            if (node.values[i] == value) return true;
+            node.values[i] = value;
+        }
+        else {
+            node.keys.insert(it, key);
+            node.values.insert(node.values.begin() + static_cast<std::ptrdiff_t>(i), value);
+            if (lastLeaf == id && i == lastSlot + 1) at = i + 1 < node.keys.size() ? i + 1 : i;
+            lastLeaf = id;
+            lastSlot = i;
+        }
+    }
+    else {
+        std::size_t c = childFor(node, key);
+        Split below;
+        if (!insert(node.children[c], key, value, below)) return false;
+        if (!below.happened) return true;
+        node.keys.insert(node.keys.begin() + static_cast<std::ptrdiff_t>(c), below.separator);
+        node.children.insert(node.children.begin() + static_cast<std::ptrdiff_t>(c + 1), below.right);
+    }
+
+    if (encodedSize(node) <= PageFile::DATA_SIZE) return store(id, node);
+    return splitNode(id, node, split, at);
+}
+
+bool BTree::put(const std::string& key, const std::string& value) {
+    if (key.empty() || key.size() > MAX_KEY || value.size() > MAX_VALUE) {
+        spdlog::error("Tree entry too large ({} byte key, {} byte value)", key.size(), value.size());
+        return false;
+    }
+
+    PageFile& file = pool.file();
+    if (file.root() == PageFile::NO_PAGE) {
+        Node leaf;
+        leaf.keys.push_back(key);
+        leaf.values.push_back(value);
+        PageFile::PageId id = pool.allocate();
+        file.setRoot(id);
+        return store(id, leaf);
+    }
+
+    Split split;
+    if (!insert(file.root(), key, value, split)) return false;
+    if (!split.happened) return true;
+
+    // The root split: grow a level
+    Node root;
+    root.leaf = false;
+    root.keys.push_back(split.separator);
+    root.children = { file.root(), split.right };
+    PageFile::PageId id = pool.allocate();
+    file.setRoot(id);
+    return store(id, root);
+}
+
+bool BTree::erase(const std::string& key, bool& erased) {
+    erased = false;
+    PageFile::PageId leaf;
+    Node node;
+    if (!findLeaf(key, leaf, node)) return pool.file().root() == PageFile::NO_PAGE;
+
+    auto it = std::lower_bound(node.keys.begin(), node.keys.end(), key);
+    if (it == node.keys.end() || *it != key) return true;
+
+    std::size_t i = static_cast<std::size_t>(it - node.keys.begin());
+    node.keys.erase(it);
+    node.values.erase(node.values.begin() + static_cast<std::ptrdiff_t>(i));
+    erased = true;
+    return store(leaf, node);
+}
+
+bool BTree::scan(const std::string& from, const Visitor& visit) {
+    PageFile::PageId leaf;
+    Node node;
+    if (!findLeaf(from, leaf, node)) return pool.file().root() == PageFile::NO_PAGE;
+
+    std::size_t i = static_cast<std::size_t>(std::lower_bound(node.keys.begin(), node.keys.end(), from) - node.keys.begin());
+    while (true) {
+        for (; i < node.keys.size(); ++i)
+            if (!visit(node.keys[i], node.values[i])) return true;
+        if (node.next == PageFile::NO_PAGE) return true;
+        if (!load(node.next, node)) return false;
+        i = 0;
+    }
+}
+
+int BTree::height() {
+    PageFile::PageId id = pool.file().root();
+    int levels = 0;
+    Node node;
+    while (id != PageFile::NO_PAGE && load(id, node)) {
+        ++levels;
+        if (node.leaf) break;
+        id = node.children[0];
+    }
+    return levels;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+#include "BufferPool.hpp"
+
+// B+tree of byte-string keys and values on the pages of a BufferPool. Keys
+// are ordered bytewise; leaves are chained left to right for range scans. The
+// root lives in the page file's header.
+//
+// A node is decoded from its page, changed and encoded back into the same page,
+// so an update that still fits touches one page. Full nodes split in two by
+// bytes, or right after the new key when keys arrive in order. Deletes do not
+// merge underfull nodes (an emptied leaf stays in the chain and is reused by
+// later inserts into its key range). Changes reach the disk when the pool
+// commits.
+class BTree {
+public:
+    static constexpr std::size_t MAX_KEY = 128;
+    static constexpr std::size_t MAX_VALUE = 1200; // leaves a split room for any entry
+
+    // Called in key order; return false to stop
+    using Visitor = std::function<bool(const std::string& key, const std::string& value)>;
+
+    explicit BTree(BufferPool& pool);
+
+    // found is false (and the call succeeds) when the key is absent
+    bool get(const std::string& key, std::string& value, bool& found);
+    bool put(const std::string& key, const std::string& value);
+    bool erase(const std::string& key, bool& erased);
+
+    // Every entry with a key >= from, in order
+    bool scan(const std::string& from, const Visitor& visit);
+
+    // Levels from the root to the leaves (0 for an empty tree)
+    int height();
+
+private:
+    struct Node {
+        bool leaf = true;
+        PageFile::PageId next = PageFile::NO_PAGE; // leaves: the leaf to the right
+        std::vector<std::string> keys;
+        std::vector<std::string> values;           // leaves
+        std::vector<PageFile::PageId> children;    // inner nodes, one more than keys: child i+1 holds keys >= keys[i]
+    };
+
+    struct Split {
+        bool happened = false;
+        std::string separator;
+        PageFile::PageId right = PageFile::NO_PAGE;
+    };
+
+    BufferPool& pool;
+    PageFile::PageId lastLeaf = PageFile::NO_PAGE; // where the last new key went
+    std::size_t lastSlot = 0;
+
+    bool load(PageFile::PageId id, Node& node);
+    bool store(PageFile::PageId id, const Node& node);
+    static std::size_t encodedSize(const Node& node);
+    static std::size_t entrySize(const Node& node, std::size_t i);
+    static std::size_t childFor(const Node& node, const std::string& key);
+
+    bool insert(PageFile::PageId id, const std::string& key, const std::string& value, Split& split);
+    bool splitNode(PageFile::PageId id, Node& node, Split& split, std::size_t at);
+    bool findLeaf(const std::string& key, PageFile::PageId& leaf, Node& node);
+};
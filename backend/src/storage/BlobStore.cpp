@@ -0,0 +1,327 @@
+#include "BlobStore.hpp"
+#include "SealedSection.hpp"
+#include "../core/ViewStream.hpp"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <unordered_set>
+#include <sodium.h>
+#include <spdlog/spdlog.h>
+
+namespace fs = std::filesystem;
+
+static const char BLOB_HDR[] = "SRBLOB1\n";     // nonce, secretbox ciphertext
+static const char BLOB_HDR_V2[] = "SRBLOB2\n";  // cipher suite byte, sealed section
+static_assert(sizeof(BLOB_HDR) == sizeof(BLOB_HDR_V2), "blob headers must share a length");
+static const char KDF_CONTEXT[crypto_kdf_CONTEXTBYTES + 1] = "srblobs_";
+static constexpr std::size_t NAME_LEN = crypto_generichash_BYTES * 2;
+
+static bool isObjectName(const std::string& name) {
+    if (name.size() != NAME_LEN) return false;
+    for (char c : name)
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) return false;
+    return true;
+}
+
+BlobStore::~BlobStore() {
+    close();
+}
+
+void BlobStore::close() {
+    if (!encKey.empty()) sodium_memzero(encKey.data(), encKey.size());
+    if (!hashKey.empty()) sodium_memzero(hashKey.data(), hashKey.size());
+    encKey.clear();
+    hashKey.clear();
+    dir.clear();
+    written = reused = 0;
+}
+
+bool BlobStore::open(const std::string& directory, const std::vector<unsigned char>& key) {
+    close();
+
+    if (key.size() != crypto_kdf_KEYBYTES) {
+        spdlog::error("Invalid key size");
+        return false;
+    }
+
+    std::error_code ec;
+    fs::create_directories(directory, ec);
+    if (ec) {
+        spdlog::error("Failed to create blob directory '{}': {}", directory, ec.message());
+        return false;
+    }
+
+    // Separate subkeys for encryption and for naming objects
+    encKey.resize(crypto_secretbox_KEYBYTES);
+    hashKey.resize(crypto_generichash_KEYBYTES);
+    crypto_kdf_derive_from_key(encKey.data(), encKey.size(), 1, KDF_CONTEXT, key.data());
+    crypto_kdf_derive_from_key(hashKey.data(), hashKey.size(), 2, KDF_CONTEXT, key.data());
+
+    dir = directory;
+    spdlog::info("Opened blob store '{}'", dir);
+    return true;
+}
+
+std::string BlobStore::hashName(const char* data, std::size_t len) const {
+    unsigned char hash[crypto_generichash_BYTES];
+    crypto_generichash(hash, sizeof(hash), reinterpret_cast<const unsigned char*>(data), len,
+        hashKey.data(), hashKey.size());
+
+    char hex[NAME_LEN + 1];
+    sodium_bin2hex(hex, sizeof(hex), hash, sizeof(hash));
+    return std::string(hex, NAME_LEN);
+}
+
+std::string BlobStore::pathOf(const std::string& name) const {
+    return (fs::path(dir) / name).string();
+}
+
+bool BlobStore::putObject(std::string_view data, std::string& name) {
+    name = hashName(data.data(), data.size());
+    std::string path = pathOf(name);
+
+    std::error_code ec;
+    if (fs::exists(path, ec)) {
+        ++reused;
+        return true;
+    }
+
+    CipherSuite suite = preferredCipherSuite();
+    std::string object(BLOB_HDR_V2, sizeof(BLOB_HDR_V2) - 1);
+    object.push_back(static_cast<char>(suite));
+    if (!sealSection(data, encKey, object, suite)) return false;
+
+    // Write under a temporary name so a crash never leaves a truncated object behind
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            spdlog::error("Failed to open '{}' for encrypted write", tmp);
+            return false;
+        }
+        out.write(object.data(), static_cast<std::streamsize>(object.size()));
+        if (!out) {
+            spdlog::error("Failed to write blob object '{}'", tmp);
+            return false;
+        }
+    }
+
+    fs::rename(tmp, path, ec);
+    if (ec) {
+        spdlog::error("Failed to commit blob object '{}': {}", path, ec.message());
+        return false;
+    }
+
+    ++written;
+    return true;
+}
+
+bool BlobStore::readObject(const std::string& name, SecureString& plain) const {
+    if (!isObjectName(name)) {
+        spdlog::error("Invalid blob reference '{}'", name);
+        return false;
+    }
+
+    std::ifstream in(pathOf(name), std::ios::binary);
+    if (!in) {
+        spdlog::error("Blob object '{}' is missing", name);
+        return false;
+    }
+
+    char hdr[sizeof(BLOB_HDR) - 1];
+    in.read(hdr, sizeof(hdr));
+    if (in.gcount() == sizeof(hdr) && std::strncmp(hdr, BLOB_HDR_V2, sizeof(hdr)) == 0) {
+        char id = 0;
+        CipherSuite suite;
+        if (!in.get(id) || !cipherSuiteFromByte(static_cast<std::uint8_t>(id), suite)) return false;
+        if (!openSection(in, encKey, plain, suite)) return false;
+        return verifyName(name, plain);
+    }
+    if (in.gcount() != sizeof(hdr) || std::strncmp(hdr, BLOB_HDR, sizeof(hdr)) != 0) {
+        spdlog::error("Invalid blob header in '{}'", name);
+        return false;
+    }
+
+    unsigned char nonce[crypto_secretbox_NONCEBYTES];
+    in.read(reinterpret_cast<char*>(nonce), sizeof(nonce));
+    if (in.gcount() != sizeof(nonce)) {
+        spdlog::error("Failed to read nonce");
+        return false;
+    }
+
+    SecureBytes ciphertext(
+        (std::istreambuf_iterator<char>(in)),
+        std::istreambuf_iterator<char>(), secureResource());
+
+    if (ciphertext.size() < crypto_secretbox_MACBYTES) {
+        spdlog::error("Ciphertext too short");
+        return false;
+    }
+
+    plain.resize(ciphertext.size() - crypto_secretbox_MACBYTES);
+    if (crypto_secretbox_open_easy(reinterpret_cast<unsigned char*>(&plain[0]),
+        ciphertext.data(), ciphertext.size(), nonce, encKey.data()) != 0)
+    {
+        spdlog::error("Decryption failed");
+        return false;
+    }
+
+    return verifyName(name, plain);
+}
+
+// The MAC proves the object is ours; the name check proves it is the one asked for
+bool BlobStore::verifyName(const std::string& name, std::string_view plain) const {
+    if (hashName(plain.data(), plain.size()) != name) {
+        spdlog::error("Blob object '{}' does not match its hash", name);
+        return false;
+    }
+    return true;
+}
+
+bool BlobStore::put(const std::string& data, std::string& ref) {
+    if (!isOpen()) {
+        spdlog::error("Blob store is not open");
+        return false;
+    }
+
+    std::ostringstream manifest;
+    manifest << data.size() << "\n";
+
+    for (std::size_t off = 0; off < data.size(); off += CHUNK_SIZE) {
+        std::string name;
+        if (!putObject(data.substr(off, CHUNK_SIZE), name)) return false;
+        manifest << name << "\n";
+    }
+
+    return putObject(manifest.str(), ref);
+}
+
+bool BlobStore::readManifest(const std::string& ref, std::size_t& size, std::vector<std::string>& chunks) const {
+    SecureString plain(secureResource());
+    if (!readObject(ref, plain)) return false;
+
+    ViewStream iss(plain);
+    if (!(iss >> size)) {
+        spdlog::error("Corrupt blob manifest '{}'", ref);
+        return false;
+    }
+
+    chunks.clear();
+    std::string name;
+    while (iss >> name) {
+        if (!isObjectName(name)) {
+            spdlog::error("Corrupt blob manifest '{}'", ref);
+            return false;
+        }
+        chunks.push_back(name);
+    }
+    return true;
+}
+
+bool BlobStore::read(const std::string& ref, const Sink& sink) const {
+    if (!isOpen()) {
+        spdlog::error("Blob store is not open");
+        return false;
+    }
+
+    std::size_t size = 0;
+    std::vector<std::string> chunks;
+    if (!readManifest(ref, size, chunks)) return false;
+
+    // One chunk in memory at a time
+    std::size_t total = 0;
+    SecureString chunk(secureResource());
+    for (const auto& name : chunks) {
+        if (!readObject(name, chunk)) return false;
+        total += chunk.size();
+        if (!sink(chunk.data(), chunk.size())) return true;
+    }
+
+    if (total != size) {
+        spdlog::error("Blob '{}' has {} bytes, manifest says {}", ref, total, size);
+        return false;
+    }
+    return true;
+}
+
+bool BlobStore::readAll(const std::string& ref, std::string& out) const {
+    out.clear();
+    return read(ref, [&](const char* data, std::size_t len) {
+        out.append(data, len);
+        return true;
+    });
+}
+
+bool BlobStore::copyTo(const std::string& ref, BlobStore& dest, std::string& destRef) const {
+    if (!isOpen() || !dest.isOpen()) {
+        spdlog::error("Blob store is not open");
+        return false;
+    }
+
+    std::ostringstream manifest;
+    bool ok = true;
+    std::size_t size = 0;
+    bool read = this->read(ref, [&](const char* data, std::size_t len) {
+        std::string name;
+        ok = dest.putObject(std::string_view(data, len), name);
+        manifest << name << "\n";
+        size += len;
+        return ok;
+    });
+    if (!read || !ok) return false;
+
+    return dest.putObject(std::to_string(size) + "\n" + manifest.str(), destRef);
+}
+
+bool BlobStore::externalize(std::vector<Item>& items) {
+    if (!isOpen()) return true; // everything stays inline
+
+    bool ok = true;
+    for (auto& it : items) {
+        if (it.cold) continue;
+        if (it.content.size() <= INLINE_LIMIT) {
+            if (!it.content.empty()) it.content_ref.clear();
+            continue;
+        }
+
+        std::string ref;
+        if (put(it.content, ref)) it.content_ref = ref;
+        else ok = false;
+    }
+
+    spdlog::info("Blob store: {} objects written, {} reused", written, reused);
+    return ok;
+}
+
+std::size_t BlobStore::collect(const std::vector<Item>& items) {
+    if (!isOpen()) return 0;
+
+    std::unordered_set<std::string> live;
+    for (const auto& it : items) {
+        if (it.content_ref.empty() || live.count(it.content_ref)) continue;
+
+        std::size_t size = 0;
+        std::vector<std::string> chunks;
+        if (!readManifest(it.content_ref, size, chunks)) {
+            spdlog::warn("Skipping blob collection: manifest '{}' unreadable", it.content_ref);
+            return 0;
+        }
+        live.insert(it.content_ref);
+        live.insert(chunks.begin(), chunks.end());
+    }
+
+    std::size_t removed = 0;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(dir, ec)) {
+        if (!entry.is_regular_file()) continue;
+        std::string name = entry.path().filename().string();
+        if (live.count(name)) continue;
+
+        std::error_code rmErr;
+        if (fs::remove(entry.path(), rmErr)) ++removed;
+    }
+
+    spdlog::info("Blob store: removed {} unreferenced objects", removed);
+    return removed;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../core/Item.hpp"
+#include "SecureBufferPool.hpp"
+
+// Content-addressed, encrypted object store for large item content.
+//
+// Data is split into CHUNK_SIZE chunks; each chunk is stored once, in a file
+// named by its keyed BLAKE2b hash, so identical chunks across items and saves
+// are written once. A blob is a manifest object listing its chunks, and the
+// manifest's hash is the reference kept on the item. Hashes are keyed with a
+// subkey of the session key, so file names reveal nothing about the content.
+class BlobStore {
+public:
+    static constexpr std::size_t CHUNK_SIZE = 64 * 1024;
+    static constexpr std::size_t INLINE_LIMIT = 4 * 1024; // content up to this size stays in the deck file
+
+    using Sink = std::function<bool(const char* data, std::size_t len)>;
+
+    BlobStore() = default;
+    BlobStore(const BlobStore&) = delete;
+    BlobStore& operator=(const BlobStore&) = delete;
+    ~BlobStore();
+
+    bool open(const std::string& directory, const std::vector<unsigned char>& key);
+    bool isOpen() const { return !encKey.empty(); }
+    void close();
+
+    // Store data and return the reference to its manifest
+    bool put(const std::string& data, std::string& ref);
+
+    // Stream a blob's chunks to sink in order; stops early if sink returns false
+    bool read(const std::string& ref, const Sink& sink) const;
+    bool readAll(const std::string& ref, std::string& out) const;
+
+    // Store a blob of this store in another (opened with a different key)
+    // one chunk at a time, returning its reference there
+    bool copyTo(const std::string& ref, BlobStore& dest, std::string& destRef) const;
+
+    // Move large content of loaded items out of line (sets content_ref), and
+    // clear the reference of items whose content is small enough to stay inline
+    bool externalize(std::vector<Item>& items);
+
+    // Delete objects not reachable from any item's content_ref. Nothing is
+    // deleted if a referenced manifest cannot be read.
+    std::size_t collect(const std::vector<Item>& items);
+
+    std::size_t objectsWritten() const { return written; }
+    std::size_t objectsReused() const { return reused; }
+
+private:
+    std::string dir;
+    std::vector<unsigned char> encKey;
+    std::vector<unsigned char> hashKey;
+    std::size_t written = 0;
+    std::size_t reused = 0;
+
+    std::string hashName(const char* data, std::size_t len) const;
+    bool verifyName(const std::string& name, std::string_view plain) const;
+    std::string pathOf(const std::string& name) const;
+
+    // Write one encrypted object unless a file with that name already exists
+    bool putObject(std::string_view data, std::string& name);
+    bool readObject(const std::string& name, SecureString& plain) const;
+    bool readManifest(const std::string& ref, std::size_t& size, std::vector<std::string>& chunks) const;
+};
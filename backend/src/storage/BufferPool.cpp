@@ -0,0 +1,111 @@
+#include "BufferPool.hpp"
+#include "../core/MemoryAccount.hpp"
+#include <algorithm>
+#include <sodium.h>
+#include <spdlog/spdlog.h>
+#include <vector>
+
+BufferPool::BufferPool(PageFile& f, std::size_t cap)
+    : pages(f), capacity(std::max<std::size_t>(8, cap)) {
+}
+
+BufferPool::Frame* BufferPool::fetch(PageFile::PageId id) {
+    auto it = frames.find(id);
+    if (it != frames.end()) {
+        ++hits;
+        if (!it->second.dirty) lru.splice(lru.begin(), lru, it->second.lru);
+        return &it->second;
+    }
+
+    ++misses;
+    Frame frame{ std::pmr::vector<unsigned char>(PageFile::DATA_SIZE, 0, MemoryAccount::resource(MemoryCategory::PageCache)), {}, false };
+    if (!pages.read(id, frame.data.data())) return nullptr;
+
+    evict(capacity - 1);
+    lru.push_front(id);
+    frame.lru = lru.begin();
+    return &frames.emplace(id, std::move(frame)).first->second;
+}
+
+// Oldest clean pages go first; changed pages are not in the list and wait for the commit
+void BufferPool::evict(std::size_t limit) {
+    while (frames.size() > limit && !lru.empty()) {
+        auto f = frames.find(lru.back());
+        sodium_memzero(f->second.data.data(), f->second.data.size());
+        frames.erase(f);
+        lru.pop_back();
+        ++evictions;
+    }
+}
+
+const unsigned char* BufferPool::read(PageFile::PageId id) {
+    Frame* f = fetch(id);
+    return f ? f->data.data() : nullptr;
+}
+
+unsigned char* BufferPool::write(PageFile::PageId id) {
+    Frame* f = fetch(id);
+    if (!f) return nullptr;
+    if (!f->dirty) {
+        lru.erase(f->lru);
+        f->dirty = true;
+        ++dirtyCount;
+    }
+    return f->data.data();
+}
+
+PageFile::PageId BufferPool::allocate() {
+    PageFile::PageId id = pages.allocate();
+    evict(capacity - 1);
+    Frame frame{ std::pmr::vector<unsigned char>(PageFile::DATA_SIZE, 0, MemoryAccount::resource(MemoryCategory::PageCache)), {}, true };
+    frames.emplace(id, std::move(frame));
+    ++dirtyCount;
+    return id;
+}
+
+bool BufferPool::commit() {
+    std::vector<std::pair<PageFile::PageId, const unsigned char*>> changed;
+    changed.reserve(dirtyCount);
+    for (const auto& f : frames)
+        if (f.second.dirty) changed.emplace_back(f.first, f.second.data.data());
+    // Ascending page order keeps the in-place writes sequential
+    std::sort(changed.begin(), changed.end());
+
+    if (!pages.commit(changed)) return false;
+    for (auto& f : frames) {
+        if (!f.second.dirty) continue;
+        f.second.dirty = false;
+        lru.push_front(f.first);
+        f.second.lru = lru.begin();
+    }
+    dirtyCount = 0;
+    evict(capacity);
+    return true;
+}
+
+void BufferPool::rollback() {
+    for (auto it = frames.begin(); it != frames.end();) {
+        if (!it->second.dirty) { ++it; continue; }
+        sodium_memzero(it->second.data.data(), it->second.data.size());
+        it = frames.erase(it);
+    }
+    dirtyCount = 0;
+    pages.rollback();
+}
+
+void BufferPool::clear() {
+    if (dirtyCount > 0) spdlog::warn("Dropping {} uncommitted pages", dirtyCount);
+    for (auto& f : frames) sodium_memzero(f.second.data.data(), f.second.data.size());
+    frames.clear();
+    lru.clear();
+    dirtyCount = 0;
+}
+
+void BufferPool::setCapacity(std::size_t cap) {
+    capacity = std::max<std::size_t>(8, cap);
+    evict(capacity);
+}
+
+BufferPool::Stats BufferPool::stats() const {
+    return { hits, misses, evictions, frames.size(), dirtyCount };
+}
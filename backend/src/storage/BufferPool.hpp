@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <list>
+#include <memory_resource>
+#include <unordered_map>
+#include "PageFile.hpp"
+
+// Decrypted page cache in front of a PageFile, evicting the least recently
+// used page once more than `capacity` are held.
+//
+// Changed pages stay in memory until commit() writes them all through the
+// file's log, and are never evicted before that (no-steal), so a half-done
+// tree update cannot reach the disk. A large transaction may therefore hold
+// more than `capacity` pages until it commits. Frames are charged to
+// MemoryCategory::PageCache. Not thread-safe; PagedStore serializes access.
+class BufferPool {
+public:
+    static constexpr std::size_t DEFAULT_CAPACITY = 2048; // 8 MiB of pages
+
+    struct Stats {
+        std::size_t hits = 0;
+        std::size_t misses = 0;
+        std::size_t evictions = 0;
+        std::size_t cached = 0;
+        std::size_t dirty = 0;
+    };
+
+    explicit BufferPool(PageFile& file, std::size_t capacity = DEFAULT_CAPACITY);
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // Page contents (PageFile::DATA_SIZE bytes), valid until the next call
+    // into the pool; nullptr if the page cannot be read
+    const unsigned char* read(PageFile::PageId id);
+    // Same, for changing the page in place; it is written at the next commit
+    unsigned char* write(PageFile::PageId id);
+    // A new zeroed page, already marked changed
+    PageFile::PageId allocate();
+
+    bool commit();
+    // Drop every uncommitted change
+    void rollback();
+    // Drop every cached page (nothing may be uncommitted)
+    void clear();
+
+    PageFile& file() { return pages; }
+    Stats stats() const;
+    void setCapacity(std::size_t capacity);
+
+private:
+    struct Frame {
+        std::pmr::vector<unsigned char> data;
+        std::list<PageFile::PageId>::iterator lru; // only while clean
+        bool dirty = false;
+    };
+
+    PageFile& pages;
+    std::size_t capacity;
+    std::unordered_map<PageFile::PageId, Frame> frames;
+    std::list<PageFile::PageId> lru; // clean pages, most recent first
+    std::size_t dirtyCount = 0;
+    std::size_t hits = 0;
+    std::size_t misses = 0;
+    std::size_t evictions = 0;
+
+    Frame* fetch(PageFile::PageId id);
+    void evict(std::size_t limit);
+};
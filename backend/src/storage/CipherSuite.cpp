@@ -0,0 +1,89 @@
+#include "CipherSuite.hpp"
+#include <sodium.h>
+#include <spdlog/spdlog.h>
+
+static_assert(crypto_secretbox_KEYBYTES == crypto_aead_xchacha20poly1305_ietf_KEYBYTES
+    && crypto_secretbox_KEYBYTES == crypto_aead_aes256gcm_KEYBYTES, "suites must share the session key");
+
+const char* cipherSuiteName(CipherSuite suite) {
+    switch (suite) {
+    case CipherSuite::XSalsa20Poly1305: return "XSalsa20-Poly1305";
+    case CipherSuite::XChaCha20Poly1305: return "XChaCha20-Poly1305";
+    case CipherSuite::Aes256Gcm: return "AES-256-GCM";
+    }
+    return "unknown";
+}
+
+bool cipherSuiteAvailable(CipherSuite suite) {
+    if (suite == CipherSuite::Aes256Gcm) return crypto_aead_aes256gcm_is_available() == 1;
+    return true;
+}
+
+bool cipherSuiteFromByte(std::uint8_t id, CipherSuite& suite) {
+    if (id > static_cast<std::uint8_t>(CipherSuite::Aes256Gcm)) {
+        spdlog::error("Unknown cipher suite {}", id);
+        return false;
+    }
+    suite = static_cast<CipherSuite>(id);
+    if (!cipherSuiteAvailable(suite)) {
+        spdlog::error("File is encrypted with {}, which this CPU does not support", cipherSuiteName(suite));
+        return false;
+    }
+    return true;
+}
+
+CipherSuite preferredCipherSuite() {
+    return cipherSuiteAvailable(CipherSuite::Aes256Gcm) ? CipherSuite::Aes256Gcm : CipherSuite::XChaCha20Poly1305;
+}
+
+std::size_t cipherNonceBytes(CipherSuite suite) {
+    switch (suite) {
+    case CipherSuite::XChaCha20Poly1305: return crypto_aead_xchacha20poly1305_ietf_NPUBBYTES;
+    case CipherSuite::Aes256Gcm: return crypto_aead_aes256gcm_NPUBBYTES;
+    default: return crypto_secretbox_NONCEBYTES;
+    }
+}
+
+std::size_t cipherTagBytes(CipherSuite suite) {
+    switch (suite) {
+    case CipherSuite::XChaCha20Poly1305: return crypto_aead_xchacha20poly1305_ietf_ABYTES;
+    case CipherSuite::Aes256Gcm: return crypto_aead_aes256gcm_ABYTES;
+    default: return crypto_secretbox_MACBYTES;
+    }
+}
+
+std::size_t cipherKeyBytes() {
+    return crypto_secretbox_KEYBYTES;
+}
+
+bool cipherSeal(CipherSuite suite, unsigned char* out, const unsigned char* plain, std::size_t len,
+    const unsigned char* nonce, const std::vector<unsigned char>& key) {
+    if (key.size() != cipherKeyBytes()) return false;
+
+    switch (suite) {
+    case CipherSuite::XChaCha20Poly1305:
+        return crypto_aead_xchacha20poly1305_ietf_encrypt(out, nullptr, plain, len, nullptr, 0, nullptr,
+            nonce, key.data()) == 0;
+    case CipherSuite::Aes256Gcm:
+        return cipherSuiteAvailable(suite)
+            && crypto_aead_aes256gcm_encrypt(out, nullptr, plain, len, nullptr, 0, nullptr, nonce, key.data()) == 0;
+    default:
+        return crypto_secretbox_easy(out, plain, len, nonce, key.data()) == 0;
+    }
+}
+
+bool cipherOpen(CipherSuite suite, unsigned char* out, const unsigned char* cipher, std::size_t clen,
+    const unsigned char* nonce, const std::vector<unsigned char>& key) {
+    if (key.size() != cipherKeyBytes() || clen < cipherTagBytes(suite)) return false;
+
+    switch (suite) {
+    case CipherSuite::XChaCha20Poly1305:
+        return crypto_aead_xchacha20poly1305_ietf_decrypt(out, nullptr, nullptr, cipher, clen, nullptr, 0,
+            nonce, key.data()) == 0;
+    case CipherSuite::Aes256Gcm:
+        return cipherSuiteAvailable(suite)
+            && crypto_aead_aes256gcm_decrypt(out, nullptr, nullptr, cipher, clen, nullptr, 0, nonce, key.data()) == 0;
+    default:
+        return crypto_secretbox_open_easy(out, cipher, clen, nonce, key.data()) == 0;
+    }
+}
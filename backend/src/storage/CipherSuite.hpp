@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Authenticated ciphers a sealed file may use, recorded as one byte in its
+// header. XSalsa20-Poly1305 (crypto_secretbox) is what every file used before
+// the header carried a suite and is still read; new files get the fastest
+// suite this CPU supports. All suites take the same 32-byte key.
+enum class CipherSuite : std::uint8_t {
+    XSalsa20Poly1305 = 0,
+    XChaCha20Poly1305 = 1,
+    Aes256Gcm = 2 // needs AES-NI and CLMUL (libsodium has no software fallback)
+};
+
+const char* cipherSuiteName(CipherSuite suite);
+
+// Known id that can be used on this machine; false for unknown ids
+bool cipherSuiteFromByte(std::uint8_t id, CipherSuite& suite);
+bool cipherSuiteAvailable(CipherSuite suite);
+
+// AES-256-GCM where the CPU accelerates it, XChaCha20-Poly1305 otherwise.
+// Requires sodium_init().
+CipherSuite preferredCipherSuite();
+
+std::size_t cipherNonceBytes(CipherSuite suite);
+std::size_t cipherTagBytes(CipherSuite suite);
+std::size_t cipherKeyBytes();
+
+// out must hold len + cipherTagBytes(suite) bytes
+bool cipherSeal(CipherSuite suite, unsigned char* out, const unsigned char* plain, std::size_t len,
+    const unsigned char* nonce, const std::vector<unsigned char>& key);
+
+// out must hold clen - cipherTagBytes(suite) bytes; false if the tag does not verify
+bool cipherOpen(CipherSuite suite, unsigned char* out, const unsigned char* cipher, std::size_t clen,
+    const unsigned char* nonce, const std::vector<unsigned char>& key);
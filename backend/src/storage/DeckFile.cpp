@@ -0,0 +1,281 @@
+#include "DeckFile.hpp"
+#include "Storage.hpp"
+#include "BlobStore.hpp"
+#include "SealedSection.hpp"
+#include "../core/ViewStream.hpp"
+#include "../parallel/Parallel.hpp"
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <sodium.h>
+#include <spdlog/spdlog.h>
+
+static const char ITEMS_HDR_V3[] = "SRDATA3\n";
+static const char ITEMS_HDR_V4[] = "SRDATA4\n"; // index also carries content_ref
+static const char ITEMS_HDR_V5[] = "SRDATA5\n"; // followed by the cipher suite byte
+static constexpr std::size_t HDR_LEN = sizeof(ITEMS_HDR_V3) - 1;
+static_assert(sizeof(ITEMS_HDR_V3) == sizeof(ITEMS_HDR_V4) && sizeof(ITEMS_HDR_V4) == sizeof(ITEMS_HDR_V5),
+    "item headers must share a length");
+
+static void splitTags(const std::string& line, std::vector<std::string>& tags) {
+    tags.clear();
+    std::istringstream tss(line);
+    std::string tag;
+    while (std::getline(tss, tag, ',')) {
+        while (!tag.empty() && std::isspace((unsigned char)tag.front())) tag.erase(tag.begin());
+        while (!tag.empty() && std::isspace((unsigned char)tag.back())) tag.pop_back();
+        if (!tag.empty()) tags.push_back(tag);
+    }
+}
+
+int DeckFile::formatOf(const char* hdr, std::size_t len) {
+    if (len < HDR_LEN) return 0;
+    if (std::strncmp(hdr, ITEMS_HDR_V5, HDR_LEN) == 0) return 5;
+    if (std::strncmp(hdr, ITEMS_HDR_V4, HDR_LEN) == 0) return 4;
+    if (std::strncmp(hdr, ITEMS_HDR_V3, HDR_LEN) == 0) return 3;
+    return 0;
+}
+
+DeckFile::~DeckFile() {
+    close();
+}
+
+void DeckFile::close() {
+    std::lock_guard<std::mutex> guard(lock);
+    closeLocked();
+}
+
+void DeckFile::closeLocked() {
+    if (!key.empty()) {
+        sodium_memzero(key.data(), key.size());
+        key.clear();
+    }
+    path.clear();
+    suite = CipherSuite::XSalsa20Poly1305;
+    blobs = nullptr;
+    blocks.clear();
+    blockOf.clear();
+    decoded.clear();
+}
+
+bool DeckFile::open(std::vector<Item>& items, const std::string& filename, const std::vector<unsigned char>& k,
+    const BlobStore* blobStore)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    closeLocked();
+    items.clear();
+
+    if (k.size() != crypto_secretbox_KEYBYTES) {
+        spdlog::error("Invalid key size");
+        return false;
+    }
+
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) {
+        spdlog::warn("Item file '{}' not found; treating as empty", filename);
+        return true;
+    }
+
+    char hdr[HDR_LEN];
+    in.read(hdr, sizeof(hdr));
+    int version = formatOf(hdr, static_cast<std::size_t>(in.gcount()));
+    if (version == 0) {
+        // Older single-section layouts have no index to open lazily
+        in.close();
+        return Storage::loadItems(items, filename, k);
+    }
+
+    CipherSuite fileSuite = CipherSuite::XSalsa20Poly1305;
+    std::uint64_t hdrLen = HDR_LEN;
+    if (version >= 5) {
+        char id = 0;
+        if (!in.get(id) || !cipherSuiteFromByte(static_cast<std::uint8_t>(id), fileSuite)) return false;
+        ++hdrLen;
+    }
+
+    SecureString plain(secureResource());
+    if (!openSection(in, k, plain, fileSuite)) return false;
+    std::uint64_t bodyStart = hdrLen + sealedSectionPrefix(fileSuite) + (plain.size() + cipherTagBytes(fileSuite));
+
+    ViewStream iss(plain);
+    std::size_t blockCount = 0;
+    if (!(iss >> blockCount)) {
+        spdlog::error("Corrupt deck index");
+        return false;
+    }
+
+    std::uint64_t offset = bodyStart;
+    for (std::size_t b = 0; b < blockCount; ++b) {
+        Block blk;
+        if (!(iss >> blk.length)) {
+            spdlog::error("Corrupt deck index");
+            return false;
+        }
+        blk.offset = offset;
+        offset += blk.length;
+        blocks.push_back(blk);
+    }
+    std::string sep;
+    std::getline(iss, sep);
+
+    while (true) {
+        Item it;
+        if (!std::getline(iss, it.id)) break;
+        if (!std::getline(iss, it.title)) break;
+
+        std::string tags_line;
+        if (!std::getline(iss, tags_line)) break;
+        splitTags(tags_line, it.tags);
+        if (version >= 4 && !std::getline(iss, it.content_ref)) break;
+
+        std::uint32_t block = 0;
+        if (!(iss >> it.interval >> it.ease_factor >> it.last_review >> it.next_review)) break;
+        if (!(iss >> it.reps >> it.base_interval >> it.stability >> it.difficulty)) break;
+        if (!(iss >> it.lapses >> it.is_leech >> it.review_count >> it.streak)) break;
+        if (!(iss >> block) || block >= blocks.size()) break;
+
+        std::getline(iss, sep);
+        std::getline(iss, sep); // "---"
+
+        it.cold = true;
+        blockOf[it.id] = block;
+        items.push_back(std::move(it));
+    }
+
+    path = filename;
+    key = k;
+    suite = fileSuite;
+    blobs = blobStore;
+
+    spdlog::info("Opened deck index: {} items in {} cold blocks ({})", items.size(), blocks.size(),
+        cipherSuiteName(suite));
+    return true;
+}
+
+bool DeckFile::readBlock(std::uint32_t b, std::vector<std::pair<std::string, ColdPayload>>& out) const {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        spdlog::error("Deck file '{}' disappeared", path);
+        return false;
+    }
+    in.seekg(static_cast<std::streamoff>(blocks[b].offset));
+
+    SecureString plain(secureResource());
+    if (!openSection(in, key, plain, suite)) return false;
+
+    ViewStream iss(plain);
+    while (true) {
+        std::string id;
+        if (!std::getline(iss, id)) break;
+
+        ColdPayload payload;
+        std::getline(iss, payload.content);
+
+        std::size_t hist_count = 0;
+        if (!(iss >> hist_count)) break;
+        payload.history.reserve(hist_count);
+        for (std::size_t i = 0; i < hist_count; ++i) {
+            ReviewRecord r;
+            if (!(iss >> r.timestamp >> r.quality >> r.interval_after)) break;
+            payload.history.push_back(r);
+        }
+
+        std::string sep;
+        std::getline(iss, sep);
+        std::getline(iss, sep); // "---"
+
+        out.emplace_back(std::move(id), std::move(payload));
+    }
+    return true;
+}
+
+void DeckFile::claimBlock(std::uint32_t b, std::vector<std::pair<std::string, ColdPayload>>& payloads) {
+    for (auto& p : payloads) decoded[p.first] = std::move(p.second);
+    blocks[b].decrypted = true;
+    spdlog::debug("Decrypted deck block {} of {}", b + 1, blocks.size());
+}
+
+bool DeckFile::decryptBlock(std::uint32_t b) {
+    if (blocks[b].decrypted) return true;
+
+    std::vector<std::pair<std::string, ColdPayload>> payloads;
+    if (!readBlock(b, payloads)) return false;
+    claimBlock(b, payloads);
+    return true;
+}
+
+bool DeckFile::ensureLoaded(Item& item) {
+    if (!item.cold) return true;
+    std::lock_guard<std::mutex> guard(lock);
+    return ensureLoadedLocked(item);
+}
+
+bool DeckFile::ensureLoadedLocked(Item& item) {
+
+    auto found = decoded.find(item.id);
+    if (found == decoded.end()) {
+        auto blk = blockOf.find(item.id);
+        if (blk == blockOf.end() || !decryptBlock(blk->second)) return false;
+        found = decoded.find(item.id);
+        if (found == decoded.end()) {
+            spdlog::error("Item '{}' missing from its deck block", item.id);
+            return false;
+        }
+    }
+
+    if (!item.content_ref.empty() && blobs) {
+        if (!blobs->readAll(item.content_ref, found->second.content)) return false;
+    }
+
+    item.content = std::move(found->second.content);
+    item.history = std::move(found->second.history);
+    item.cold = false;
+    decoded.erase(found);
+    return true;
+}
+
+bool DeckFile::loadAll(std::vector<Item>& items) {
+    std::lock_guard<std::mutex> guard(lock);
+
+    // Blocks are independent sections, so decrypt every one still needed on
+    // the shared pool; handing payloads to items stays on this thread
+    std::vector<std::uint32_t> needed;
+    std::vector<char> queued(blocks.size(), 0);
+    for (const auto& it : items) {
+        if (!it.cold || decoded.count(it.id)) continue;
+        auto blk = blockOf.find(it.id);
+        if (blk == blockOf.end() || blocks[blk->second].decrypted || queued[blk->second]) continue;
+        queued[blk->second] = 1;
+        needed.push_back(blk->second);
+    }
+
+    std::vector<std::vector<std::pair<std::string, ColdPayload>>> payloads(needed.size());
+    std::vector<char> read(needed.size(), 0);
+    parallelFor(0, needed.size(), 1, [&](std::size_t lo, std::size_t hi) {
+        for (std::size_t i = lo; i < hi; ++i) read[i] = readBlock(needed[i], payloads[i]) ? 1 : 0;
+    });
+    for (std::size_t i = 0; i < needed.size(); ++i)
+        if (read[i]) claimBlock(needed[i], payloads[i]);
+
+    bool ok = true;
+    for (auto& it : items)
+        if (it.cold && !ensureLoadedLocked(it)) ok = false;
+    return ok;
+}
+
+std::size_t DeckFile::blockCount() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return blocks.size();
+}
+
+CipherSuite DeckFile::cipherSuite() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return suite;
+}
+
+std::size_t DeckFile::decryptedBlocks() const {
+    std::lock_guard<std::mutex> guard(lock);
+    std::size_t n = 0;
+    for (const auto& b : blocks) n += b.decrypted ? 1 : 0;
+    return n;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "../core/Item.hpp"
+#include "CipherSuite.hpp"
+
+class BlobStore;
+
+// Reader for the per-user item files kept before the shared page store; they
+// are only opened to import them (PagedDeck::importFiles) and never written.
+//
+// Layout v5 ("SRDATA5" and a cipher suite byte): a small encrypted index
+// section holding each item's ID, title, tags, content reference and
+// scheduling fields, followed by independently encrypted blocks with the
+// content and history of ITEMS_PER_BLOCK items. v4 is the same sealed with
+// XSalsa20-Poly1305 and no suite byte; v3 also lacks content references.
+// Content kept in a BlobStore is empty in its block.
+//
+// open() decrypts only the index and marks items cold; a block is decrypted the
+// first time one of its items is needed, so the time to reach the menu does not
+// grow with content or history size. Loading is safe from several threads.
+class DeckFile {
+public:
+    static constexpr std::size_t ITEMS_PER_BLOCK = 256;
+
+    DeckFile() = default;
+    DeckFile(const DeckFile&) = delete;
+    DeckFile& operator=(const DeckFile&) = delete;
+    ~DeckFile();
+
+    // Indexed format version for an item file header, or 0 if it is not indexed
+    static int formatOf(const char* hdr, std::size_t len);
+
+    // Opens any item file version. v1/v2 files are loaded fully; v3+ loads the
+    // index only. Out-of-line content is fetched from blobs when items load.
+    bool open(std::vector<Item>& items, const std::string& filename, const std::vector<unsigned char>& key,
+        const BlobStore* blobs = nullptr);
+
+    // Decrypt the block holding item's content and history (no-op for warm items)
+    bool ensureLoaded(Item& item);
+    // Remaining blocks are decrypted in parallel on the shared thread pool
+    bool loadAll(std::vector<Item>& items);
+
+    std::size_t blockCount() const;
+    std::size_t decryptedBlocks() const;
+    CipherSuite cipherSuite() const;
+
+    // Forget the file and wipe the cached key
+    void close();
+
+private:
+    struct Block {
+        std::uint64_t offset = 0;
+        std::uint64_t length = 0;
+        bool decrypted = false;
+    };
+
+    struct ColdPayload {
+        std::string content;
+        std::vector<ReviewRecord> history;
+    };
+
+    mutable std::mutex lock;
+    std::string path;
+    std::vector<unsigned char> key;
+    CipherSuite suite = CipherSuite::XSalsa20Poly1305;
+    const BlobStore* blobs = nullptr;
+    std::vector<Block> blocks;
+    std::unordered_map<std::string, std::uint32_t> blockOf;
+    std::unordered_map<std::string, ColdPayload> decoded; // decrypted but not yet claimed
+
+    bool readBlock(std::uint32_t b, std::vector<std::pair<std::string, ColdPayload>>& out) const;
+    void claimBlock(std::uint32_t b, std::vector<std::pair<std::string, ColdPayload>>& payloads);
+    bool decryptBlock(std::uint32_t b);
+    bool ensureLoadedLocked(Item& item);
+    void closeLocked();
+};
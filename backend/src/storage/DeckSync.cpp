@@ -0,0 +1,724 @@
+#include "DeckSync.hpp"
+#include "BlobStore.hpp"
+#include "PagedDeck.hpp"
+#include "SealedSection.hpp"
+#include "../core/SchedulingPolicy.hpp"
+#include "../core/ViewStream.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+#include <sodium.h>
+#include <spdlog/spdlog.h>
+
+namespace fs = std::filesystem;
+
+// Records kept beside the deck (PagedDeck uses 'i', 'p', 's' and 'c')
+static constexpr char ITEM_STATE = 'm';
+static constexpr char REPLICA_STATE = 'y';
+static const char REPLICA[] = "replica";
+static const char WEIGHTS[] = "weights";
+
+// Delta file: header, cipher suite byte, one sealed section
+static const char DELTA_HDR[] = "SRSYNC1\n";
+static constexpr std::size_t HDR_LEN = sizeof(DELTA_HDR) - 1;
+static const char DELTA_EXT[] = ".delta";
+static const char PARAMS_FILE[] = "sync.params";
+
+namespace {
+
+// Lamport time (kept at or above the wall clock in ms) and the replica that wrote it
+struct Stamp {
+    std::uint64_t time = 0;
+    std::string replica;
+
+    bool empty() const { return time == 0; }
+    bool operator<(const Stamp& o) const { return time != o.time ? time < o.time : replica < o.replica; }
+};
+
+// Last-writer-wins element of a tag set or of the tag weights
+struct Element {
+    Stamp stamp;
+    bool present = false;
+    int weight = 0; // tag weights only
+};
+using ElementSet = std::map<std::string, Element>;
+
+// What this replica knows about one item
+struct ItemState {
+    std::uint64_t seq = 0;     // this replica's change count when the entry last changed
+    Stamp touched;             // latest change of any kind
+    Stamp deleted;
+    Stamp fields;              // title and content
+    std::string fieldDigest;   // title and content as last seen here
+    std::string historyDigest; // history as last seen here
+    ElementSet tags;
+
+    bool alive() const { return !(touched < deleted); }
+};
+
+struct Replica {
+    std::string id;
+    std::uint64_t clock = 0;
+    std::uint64_t seq = 0;
+    std::map<std::string, std::uint64_t> applied; // peer -> its seq merged here
+
+    Stamp next() {
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        clock = std::max<std::uint64_t>(clock + 1, static_cast<std::uint64_t>(ms));
+        return Stamp{ clock, id };
+    }
+    // Later local stamps must order after everything seen
+    void observe(const Stamp& s) { clock = std::max(clock, s.time); }
+};
+
+struct ItemDelta {
+    std::string id;
+    ItemState state;
+    // Only for live items
+    std::string title;
+    std::string content;
+    std::vector<ReviewRecord> history;
+};
+
+// The changes of one replica numbered (fromSeq, toSeq]
+struct Delta {
+    std::string replica;
+    std::uint64_t fromSeq = 0;
+    std::uint64_t toSeq = 0;
+    std::map<std::string, std::uint64_t> applied;
+    ElementSet weights;
+    std::vector<ItemDelta> items;
+};
+
+} // namespace
+
+static std::string toHex(const unsigned char* bin, std::size_t len) {
+    std::string hex(2 * len + 1, '\0');
+    sodium_bin2hex(&hex[0], hex.size(), bin, len);
+    hex.pop_back();
+    return hex;
+}
+
+static std::string fieldDigestOf(const Item& it) {
+    unsigned char out[16];
+    crypto_generichash_state st;
+    crypto_generichash_init(&st, nullptr, 0, sizeof(out));
+    // Title with its terminator, so the split between title and content counts
+    crypto_generichash_update(&st, reinterpret_cast<const unsigned char*>(it.title.c_str()), it.title.size() + 1);
+    crypto_generichash_update(&st, reinterpret_cast<const unsigned char*>(it.content.data()), it.content.size());
+    crypto_generichash_final(&st, out, sizeof(out));
+    return toHex(out, sizeof(out));
+}
+
+static std::string historyDigestOf(const Item& it) {
+    unsigned char out[16];
+    crypto_generichash_state st;
+    crypto_generichash_init(&st, nullptr, 0, sizeof(out));
+    for (const auto& r : it.history) {
+        const std::int64_t fields[3] = { static_cast<std::int64_t>(r.timestamp), r.quality, r.interval_after };
+        crypto_generichash_update(&st, reinterpret_cast<const unsigned char*>(fields), sizeof(fields));
+    }
+    crypto_generichash_final(&st, out, sizeof(out));
+    return toHex(out, sizeof(out));
+}
+
+static void writeStamp(std::ostream& out, const Stamp& s) {
+    out << s.time << " " << (s.replica.empty() ? "-" : s.replica);
+}
+
+static bool readStamp(std::istream& in, Stamp& s) {
+    if (!(in >> s.time >> s.replica)) return false;
+    if (s.replica == "-") s.replica.clear();
+    return true;
+}
+
+static void writeStamps(std::ostream& out, const ItemState& s) {
+    writeStamp(out, s.touched);
+    out << " ";
+    writeStamp(out, s.deleted);
+    out << " ";
+    writeStamp(out, s.fields);
+    out << "\n";
+}
+
+static bool readStamps(std::istream& in, ItemState& s) {
+    return readStamp(in, s.touched) && readStamp(in, s.deleted) && readStamp(in, s.fields);
+}
+
+// One element per line, name last since tags may contain spaces
+static void writeElements(std::ostream& out, const ElementSet& set) {
+    out << set.size() << "\n";
+    for (const auto& e : set) {
+        writeStamp(out, e.second.stamp);
+        out << " " << e.second.present << " " << e.second.weight << " " << e.first << "\n";
+    }
+}
+
+static bool readElements(std::istream& in, ElementSet& set) {
+    std::size_t n = 0;
+    if (!(in >> n)) return false;
+    set.clear();
+    for (std::size_t i = 0; i < n; ++i) {
+        Element e;
+        std::string name;
+        if (!readStamp(in, e.stamp) || !(in >> e.present >> e.weight) || in.get() != ' ' || !std::getline(in, name))
+            return false;
+        set[name] = e;
+    }
+    return true;
+}
+
+static void writeApplied(std::ostream& out, const std::map<std::string, std::uint64_t>& applied) {
+    out << applied.size() << "\n";
+    for (const auto& a : applied) out << a.first << " " << a.second << "\n";
+}
+
+static bool readApplied(std::istream& in, std::map<std::string, std::uint64_t>& applied) {
+    std::size_t n = 0;
+    if (!(in >> n)) return false;
+    applied.clear();
+    for (std::size_t i = 0; i < n; ++i) {
+        std::string replica;
+        std::uint64_t seq = 0;
+        if (!(in >> replica >> seq)) return false;
+        applied[replica] = seq;
+    }
+    return true;
+}
+
+static std::string stateRecord(const ItemState& s) {
+    std::ostringstream oss;
+    oss << s.seq << "\n";
+    writeStamps(oss, s);
+    oss << (s.fieldDigest.empty() ? "-" : s.fieldDigest) << " "
+        << (s.historyDigest.empty() ? "-" : s.historyDigest) << "\n";
+    writeElements(oss, s.tags);
+    return oss.str();
+}
+
+static bool parseState(std::string_view plain, ItemState& s) {
+    ViewStream in(plain);
+    if (!(in >> s.seq) || !readStamps(in, s) || !(in >> s.fieldDigest >> s.historyDigest)) return false;
+    if (s.fieldDigest == "-") s.fieldDigest.clear();
+    if (s.historyDigest == "-") s.historyDigest.clear();
+    return readElements(in, s.tags);
+}
+
+static std::string replicaRecord(const Replica& r) {
+    std::ostringstream oss;
+    oss << r.id << "\n" << r.clock << " " << r.seq << "\n";
+    writeApplied(oss, r.applied);
+    return oss.str();
+}
+
+static bool parseReplica(std::string_view plain, Replica& r) {
+    ViewStream in(plain);
+    return (in >> r.id >> r.clock >> r.seq) && readApplied(in, r.applied);
+}
+
+static std::string weightsRecord(const ElementSet& weights) {
+    std::ostringstream oss;
+    writeElements(oss, weights);
+    return oss.str();
+}
+
+// Title and content are length-prefixed, so they may hold anything
+static std::string deltaRecord(const Delta& d) {
+    std::ostringstream oss;
+    oss << d.replica << "\n" << d.fromSeq << " " << d.toSeq << "\n";
+    writeApplied(oss, d.applied);
+    writeElements(oss, d.weights);
+    oss << d.items.size() << "\n";
+    for (const auto& it : d.items) {
+        oss << it.id << "\n";
+        writeStamps(oss, it.state);
+        writeElements(oss, it.state.tags);
+        oss << it.title.size() << " " << it.content.size() << "\n" << it.title << it.content
+            << it.history.size() << "\n";
+        for (const auto& r : it.history)
+            oss << r.timestamp << " " << r.quality << " " << r.interval_after << "\n";
+    }
+    return oss.str();
+}
+
+static bool parseDelta(std::string_view plain, Delta& d) {
+    ViewStream in(plain);
+    std::size_t count = 0;
+    if (!(in >> d.replica >> d.fromSeq >> d.toSeq) || !readApplied(in, d.applied) || !readElements(in, d.weights)
+        || !(in >> count))
+        return false;
+
+    d.items.clear();
+    for (std::size_t i = 0; i < count; ++i) {
+        ItemDelta it;
+        std::size_t titleLen = 0, contentLen = 0, historyLen = 0;
+        if (!(in >> it.id) || !readStamps(in, it.state) || !readElements(in, it.state.tags)
+            || !(in >> titleLen >> contentLen) || in.get() != '\n')
+            return false;
+        if (titleLen > plain.size() || contentLen > plain.size()) return false;
+        it.title.resize(titleLen);
+        it.content.resize(contentLen);
+        if (!in.read(&it.title[0], static_cast<std::streamsize>(titleLen))
+            || !in.read(&it.content[0], static_cast<std::streamsize>(contentLen)) || !(in >> historyLen))
+            return false;
+        for (std::size_t h = 0; h < historyLen; ++h) {
+            ReviewRecord r;
+            if (!(in >> r.timestamp >> r.quality >> r.interval_after)) return false;
+            it.history.push_back(r);
+        }
+        d.items.push_back(std::move(it));
+    }
+    return true;
+}
+
+static bool readDelta(const std::string& file, const std::vector<unsigned char>& key, Delta& d) {
+    std::ifstream in(file, std::ios::binary);
+    char hdr[HDR_LEN + 1];
+    CipherSuite suite;
+    if (!in.read(hdr, sizeof(hdr)) || std::memcmp(hdr, DELTA_HDR, HDR_LEN) != 0
+        || !cipherSuiteFromByte(static_cast<std::uint8_t>(hdr[HDR_LEN]), suite)) {
+        spdlog::warn("'{}' is not a sync delta this build can read", file);
+        return false;
+    }
+
+    SecureString plain(secureResource());
+    if (!openSection(in, key, plain, suite)) {
+        spdlog::warn("Cannot decrypt '{}' (another deck, or a different passphrase)", file);
+        return false;
+    }
+    if (!parseDelta(plain, d)) {
+        spdlog::warn("Corrupt sync delta '{}'", file);
+        return false;
+    }
+    return true;
+}
+
+static bool writeDelta(const std::string& file, const std::vector<unsigned char>& key, const Delta& d,
+    std::size_t& bytes) {
+    CipherSuite suite = preferredCipherSuite();
+    std::string out(DELTA_HDR, HDR_LEN);
+    out.push_back(static_cast<char>(suite));
+
+    std::string plain = deltaRecord(d);
+    bool sealed = sealSection(plain, key, out, suite);
+    sodium_memzero(&plain[0], plain.size());
+    if (!sealed) return false;
+
+    std::string tmp = file + ".tmp";
+    {
+        std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+        f.write(out.data(), static_cast<std::streamsize>(out.size()));
+        if (!f.flush()) {
+            spdlog::error("Failed to write sync delta '{}'", tmp);
+            return false;
+        }
+    }
+    std::error_code ec;
+    fs::rename(tmp, file, ec);
+    if (ec) {
+        spdlog::error("Failed to replace sync delta '{}': {}", file, ec.message());
+        return false;
+    }
+    bytes = out.size();
+    return true;
+}
+
+static bool loadState(PagedStore& store, const std::string& tenant, const std::vector<unsigned char>& key,
+    Replica& self, std::unordered_map<std::string, ItemState>& states, ElementSet& weights) {
+    SecureString plain(secureResource());
+    bool found = false;
+    if (!store.get(tenant, REPLICA_STATE, REPLICA, key, plain, found)) return false;
+    if (found && !parseReplica(plain, self)) {
+        spdlog::error("Corrupt sync state");
+        return false;
+    }
+    if (!store.get(tenant, REPLICA_STATE, WEIGHTS, key, plain, found)) return false;
+    if (found) {
+        ViewStream in(plain);
+        if (!readElements(in, weights)) {
+            spdlog::error("Corrupt sync state for tag weights");
+            return false;
+        }
+    }
+    return store.scan(tenant, ITEM_STATE, key, [&](const std::string& id, std::string_view p) {
+        if (parseState(p, states[id])) return true;
+        spdlog::error("Corrupt sync state for item '{}'", id);
+        return false;
+    });
+}
+
+// Stamp whatever changed in item since its state was last updated; item is
+// null if the item is gone. True if the state changed.
+static bool observeItem(const Item* item, ItemState& state, Replica& self) {
+    Stamp now;
+    auto stamp = [&]() -> const Stamp& {
+        if (now.empty()) now = self.next();
+        return now;
+    };
+
+    if (!item) {
+        // Gone before any sync saw it, or already deleted
+        if (state.touched.empty() || !state.alive()) return false;
+        state.deleted = stamp();
+    }
+    else {
+        std::string fields = fieldDigestOf(*item);
+        std::string history = historyDigestOf(*item);
+        if (fields != state.fieldDigest) {
+            state.fields = stamp();
+            state.fieldDigest = std::move(fields);
+        }
+        if (history != state.historyDigest) {
+            stamp();
+            state.historyDigest = std::move(history);
+        }
+        for (const auto& t : item->tags) {
+            auto& e = state.tags[t];
+            if (!e.present) e = Element{ stamp(), true, 0 };
+        }
+        for (auto& e : state.tags) {
+            if (e.second.present && !item->hasTag(e.first)) e.second = Element{ stamp(), false, 0 };
+        }
+        // Present again after a merged deletion (e.g. undone)
+        if (!state.alive()) stamp();
+        if (now.empty()) return false;
+        state.touched = now;
+    }
+    state.seq = ++self.seq;
+    return true;
+}
+
+static bool observeWeights(const TagManager& mgr, ElementSet& weights, Replica& self) {
+    Stamp now;
+    auto stamp = [&]() -> const Stamp& {
+        if (now.empty()) now = self.next();
+        return now;
+    };
+    for (const auto& w : mgr.weights) {
+        auto& e = weights[w.first];
+        if (!e.present || e.weight != w.second) e = Element{ stamp(), true, w.second };
+    }
+    for (auto& e : weights) {
+        if (e.second.present && !mgr.weights.count(e.first)) e.second = Element{ stamp(), false, 0 };
+    }
+    return !now.empty();
+}
+
+// Last writer wins per element; true if any element changed
+static bool mergeElements(ElementSet& into, const ElementSet& from, Replica& self) {
+    bool changed = false;
+    for (const auto& e : from) {
+        self.observe(e.second.stamp);
+        auto& mine = into[e.first];
+        if (mine.stamp < e.second.stamp) {
+            mine = e.second;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// Surviving tags keep their order on the item; new ones follow
+static void applyTags(Item& item, const ElementSet& tags) {
+    std::vector<std::string> result;
+    for (const auto& t : item.tags) {
+        auto e = tags.find(t);
+        if (e == tags.end() || e->second.present) result.push_back(t);
+    }
+    for (const auto& e : tags) {
+        if (e.second.present && std::find(result.begin(), result.end(), e.first) == result.end())
+            result.push_back(e.first);
+    }
+    item.tags = std::move(result);
+}
+
+// Keyed hash of a fixed string, kept in the parameters to recognise the passphrase
+static std::string keyCheckOf(const std::vector<unsigned char>& key) {
+    static const char label[] = "deck sync key check";
+    unsigned char out[16];
+    crypto_generichash(out, sizeof(out), reinterpret_cast<const unsigned char*>(label), sizeof(label) - 1,
+        key.data(), key.size());
+    return toHex(out, sizeof(out));
+}
+
+bool DeckSync::folderKey(const std::string& folder, const std::string& passphrase, std::vector<unsigned char>& key) {
+    std::string file = (fs::path(folder) / PARAMS_FILE).string();
+    unsigned char salt[crypto_pwhash_SALTBYTES];
+    unsigned long long ops = crypto_pwhash_OPSLIMIT_INTERACTIVE;
+    std::size_t mem = crypto_pwhash_MEMLIMIT_INTERACTIVE;
+    std::string check;
+
+    std::ifstream in(file);
+    bool created = !in;
+    if (!created) {
+        std::string hex;
+        std::size_t len = 0;
+        if (!(in >> hex >> ops >> mem >> check)
+            || sodium_hex2bin(salt, sizeof(salt), hex.c_str(), hex.size(), nullptr, &len, nullptr) != 0
+            || len != sizeof(salt)) {
+            spdlog::error("Invalid sync parameters in '{}'", file);
+            return false;
+        }
+    }
+    else {
+        randombytes_buf(salt, sizeof(salt));
+    }
+
+    key.assign(cipherKeyBytes(), 0);
+    if (crypto_pwhash(key.data(), key.size(), passphrase.c_str(), static_cast<unsigned long long>(passphrase.size()),
+        salt, ops, mem, crypto_pwhash_ALG_DEFAULT) != 0) {
+        spdlog::error("Sync key derivation failed (out of memory?)");
+        key.clear();
+        return false;
+    }
+
+    // A wrong passphrase would otherwise replace this copy's delta with one no peer can read
+    if (!created && check != keyCheckOf(key)) {
+        spdlog::error("Wrong passphrase for sync folder '{}'", folder);
+        sodium_memzero(key.data(), key.size());
+        key.clear();
+        return false;
+    }
+    if (created) {
+        std::ofstream out(file, std::ios::trunc);
+        out << toHex(salt, sizeof(salt)) << "\n" << ops << " " << mem << "\n" << keyCheckOf(key) << "\n";
+        if (!out.flush()) {
+            spdlog::error("Failed to write '{}'", file);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool DeckSync::sync(PagedStore& store, const std::string& username, std::uint32_t generation,
+    const std::vector<unsigned char>& key, BlobStore* blobs, const SchedulerConfig& cfg,
+    const std::string& folder, const std::vector<unsigned char>& folderKey, Result& result) {
+    result = Result();
+    std::error_code ec;
+    if (!fs::is_directory(folder, ec)) {
+        spdlog::error("Sync folder '{}' does not exist", folder);
+        return false;
+    }
+
+    PagedDeck deck(store);
+    std::vector<Item> items;
+    if (!deck.open(items, username, key, blobs, generation)) return false;
+    const std::string tenant = store.tenantOf(username, generation);
+
+    Replica self;
+    std::unordered_map<std::string, ItemState> states;
+    ElementSet weights;
+    if (!loadState(store, tenant, key, self, states, weights)) return false;
+    bool first = self.id.empty();
+    if (first) {
+        unsigned char id[8];
+        randombytes_buf(id, sizeof(id));
+        self.id = toHex(id, sizeof(id));
+    }
+
+    std::unordered_map<std::string, std::size_t> position;
+    for (std::size_t i = 0; i < items.size(); ++i) position[items[i].id] = i;
+    std::unordered_set<std::string> dirty; // states to write back
+
+    // Local changes since the last sync; the first sync takes in the whole deck
+    std::vector<std::string> changed;
+    if (first) {
+        for (const auto& it : items) changed.push_back(it.id);
+    }
+    else if (!deck.changedItems(changed)) {
+        return false;
+    }
+    for (const auto& id : changed) {
+        auto p = position.find(id);
+        Item* item = p == position.end() ? nullptr : &items[p->second];
+        if (item && !deck.ensureLoaded(*item)) return false;
+        if (observeItem(item, states[id], self)) dirty.insert(id);
+    }
+
+    TagManager mgr;
+    if (!deck.loadTagWeights(mgr)) return false;
+    observeWeights(mgr, weights, self);
+
+    // Merge every peer delta with something new
+    std::unordered_set<std::string> gone;       // items to remove from the deck
+    std::map<std::string, std::uint64_t> acked; // peer -> our seq it has merged
+    bool weightsMerged = false;
+    bool deckChanged = false;
+
+    auto mergeItem = [&](const ItemDelta& in) {
+        ItemState& state = states[in.id];
+        self.observe(in.state.touched);
+        self.observe(in.state.deleted);
+        self.observe(in.state.fields);
+
+        auto p = position.find(in.id);
+        Item* item = p == position.end() ? nullptr : &items[p->second];
+        if (item && !deck.ensureLoaded(*item)) return false;
+        bool wasAlive = item && !gone.count(in.id);
+
+        // A deleted entry carries no fields, so it cannot win them
+        bool fieldsWin = in.state.alive() && state.fields < in.state.fields;
+        bool advanced = fieldsWin || state.touched < in.state.touched || state.deleted < in.state.deleted;
+        if (fieldsWin) state.fields = in.state.fields;
+        if (state.touched < in.state.touched) state.touched = in.state.touched;
+        if (state.deleted < in.state.deleted) state.deleted = in.state.deleted;
+        if (mergeElements(state.tags, in.state.tags, self)) advanced = true;
+
+        bool itemChanged = false;
+        if (!state.alive()) {
+            if (wasAlive) {
+                gone.insert(in.id);
+                itemChanged = true;
+            }
+        }
+        else if (item || in.state.alive()) {
+            if (!item) {
+                Item fresh;
+                fresh.id = in.id;
+                fresh.title = in.title;
+                fresh.content = in.content;
+                fresh.last_review = std::time(nullptr);
+                fresh.next_review = fresh.last_review + 24 * 60 * 60;
+                position[in.id] = items.size();
+                items.push_back(std::move(fresh));
+                item = &items.back();
+                itemChanged = true;
+            }
+            else if (!wasAlive) {
+                gone.erase(in.id);
+                itemChanged = true;
+            }
+            if (fieldsWin && (item->title != in.title || item->content != in.content)) {
+                item->title = in.title;
+                item->content = in.content;
+                itemChanged = true;
+            }
+            if (item->mergeHistory(in.history)) {
+                replaySchedule(*item, cfg);
+                itemChanged = true;
+            }
+            std::vector<std::string> before = item->tags;
+            applyTags(*item, state.tags);
+            if (item->tags != before) itemChanged = true;
+
+            state.fieldDigest = fieldDigestOf(*item);
+            state.historyDigest = historyDigestOf(*item);
+        }
+
+        if (advanced || itemChanged) {
+            state.seq = ++self.seq;
+            dirty.insert(in.id);
+        }
+        if (itemChanged) {
+            ++result.changed;
+            deckChanged = true;
+        }
+        return true;
+    };
+
+    for (const auto& entry : fs::directory_iterator(folder, ec)) {
+        const fs::path& file = entry.path();
+        if (file.extension() != DELTA_EXT || file.stem() == self.id) continue;
+
+        Delta d;
+        if (!readDelta(file.string(), folderKey, d) || d.replica == self.id) continue;
+        auto ack = d.applied.find(self.id);
+        acked[d.replica] = ack == d.applied.end() ? 0 : ack->second;
+
+        std::uint64_t& applied = self.applied[d.replica];
+        if (d.toSeq <= applied) continue;
+        ++result.peers;
+        if (mergeElements(weights, d.weights, self)) weightsMerged = true;
+        for (const auto& in : d.items) {
+            if (!mergeItem(in)) return false;
+            ++result.received;
+        }
+        // After a gap (changes of the peer never merged here) the mark stays,
+        // so the peer's next delta starts from it again
+        if (d.fromSeq <= applied) applied = d.toSeq;
+    }
+    if (ec) spdlog::warn("Could not list sync folder '{}': {}", folder, ec.message());
+
+    if (!gone.empty()) {
+        items.erase(std::remove_if(items.begin(), items.end(), [&](const Item& it) { return gone.count(it.id) > 0; }),
+            items.end());
+        position.clear();
+        for (std::size_t i = 0; i < items.size(); ++i) position[items[i].id] = i;
+    }
+    if (deckChanged) {
+        if (blobs && !blobs->externalize(items)) return false;
+        if (!deck.save(items)) return false;
+        if (blobs) blobs->collect(items);
+    }
+    if (weightsMerged) {
+        for (const auto& e : weights) {
+            auto w = mgr.weights.find(e.first);
+            if (e.second.present && (w == mgr.weights.end() || w->second != e.second.weight))
+                mgr.setWeight(e.first, e.second.weight);
+            else if (!e.second.present && w != mgr.weights.end())
+                mgr.removeWeight(e.first);
+        }
+        if (!deck.saveTagWeights(mgr)) return false;
+    }
+
+    // The state goes in before the delta leaves: a delta must never promise
+    // sequence numbers this replica could hand out again
+    {
+        auto tx = store.transaction();
+        bool ok = true;
+        for (const auto& id : dirty) ok = ok && store.put(tenant, ITEM_STATE, id, stateRecord(states[id]), key);
+        ok = ok && store.put(tenant, REPLICA_STATE, REPLICA, replicaRecord(self), key)
+            && store.put(tenant, REPLICA_STATE, WEIGHTS, weightsRecord(weights), key) && store.commit();
+        if (!ok) {
+            store.rollback();
+            spdlog::error("Failed to save the sync state");
+            return false;
+        }
+    }
+    // Every marked item is accounted for now, the merge's own saves included
+    std::vector<std::string> marked;
+    if (deck.changedItems(marked)) deck.clearChanged(marked);
+
+    // Everything past what the least up-to-date peer has merged
+    std::uint64_t since = acked.empty() ? 0 : std::numeric_limits<std::uint64_t>::max();
+    for (const auto& a : acked) since = std::min(since, a.second);
+
+    Delta out;
+    out.replica = self.id;
+    out.fromSeq = since;
+    out.toSeq = self.seq;
+    out.applied = self.applied;
+    out.weights = weights;
+    for (const auto& s : states) {
+        if (s.second.seq <= since) continue;
+        ItemDelta d;
+        d.id = s.first;
+        d.state = s.second;
+        if (s.second.alive()) {
+            auto p = position.find(s.first);
+            if (p == position.end()) continue;
+            Item& item = items[p->second];
+            if (!deck.ensureLoaded(item)) return false;
+            d.title = item.title;
+            d.content = item.content;
+            d.history = item.history;
+        }
+        out.items.push_back(std::move(d));
+    }
+
+    std::string file = (fs::path(folder) / (self.id + DELTA_EXT)).string();
+    if (!writeDelta(file, folderKey, out, result.deltaBytes)) return false;
+    result.sent = out.items.size();
+
+    spdlog::info("Synced deck of '{}' as replica {}: {} entries from {} peers, {} items changed, {} sent ({} bytes)",
+        username, self.id, result.received, result.peers, result.changed, result.sent, result.deltaBytes);
+    return true;
+}
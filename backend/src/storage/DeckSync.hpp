@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../core/SchedulerConfig.hpp"
+#include "PagedStore.hpp"
+
+class BlobStore;
+
+// Merges copies of one user's deck kept on different machines, through a
+// folder every copy can reach (a synced directory, a USB stick).
+//
+// Each copy (replica) keeps, beside the deck in the store, what it last saw
+// of every item, and the deck merges as a set of CRDTs:
+//   - title and content are one last-writer-wins register per item;
+//   - tags, and the deck's tag weights, are sets of last-writer-wins
+//     elements, so a tag added on one copy and another removed on the other
+//     both survive;
+//   - the review history is a grow-only set of ReviewRecords per item ID,
+//     merged by union; scheduling state is then replayed from the merged
+//     history, never copied;
+//   - a deletion wins over changes made before it and loses to later ones.
+// Changes are stamped with a Lamport clock and the replica ID, so every copy
+// picks the same winners whatever order deltas arrive in, and merging one
+// twice changes nothing.
+//
+// sync() finds local changes from the items PagedDeck::save marked, merges
+// the delta of every other copy in the folder, then writes its own delta
+// ("<replica>.delta"): only the items changed since the oldest change its
+// peers have acknowledged in their own deltas (a version vector), sealed with
+// a key derived from a passphrase every copy shares. Two copies agree after
+// each has synced once after the other.
+class DeckSync {
+public:
+    struct Result {
+        std::size_t peers = 0;    // peer deltas with something new
+        std::size_t received = 0; // item entries merged from them
+        std::size_t changed = 0;  // local items created, updated or deleted by the merge
+        std::size_t sent = 0;     // item entries in the delta written
+        std::size_t deltaBytes = 0;
+    };
+
+    // Key for a sync folder's deltas. The salt, Argon2id cost and a check
+    // value for the passphrase are kept in "sync.params" in the folder,
+    // created by the first copy to sync there. False for a wrong passphrase.
+    static bool folderKey(const std::string& folder, const std::string& passphrase, std::vector<unsigned char>& key);
+
+    // Sync the deck saved in the store (nothing may have it open for writing).
+    // cfg picks the algorithm whose state is replayed for merged histories.
+    static bool sync(PagedStore& store, const std::string& username, std::uint32_t generation,
+        const std::vector<unsigned char>& key, BlobStore* blobs, const SchedulerConfig& cfg,
+        const std::string& folder, const std::vector<unsigned char>& folderKey, Result& result);
+};
@@ -0,0 +1,143 @@
+#include "KeyRotation.hpp"
+#include "BlobStore.hpp"
+#include "PagedDeck.hpp"
+#include "ReviewJournal.hpp"
+#include "../parallel/Parallel.hpp"
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <sodium.h>
+#include <spdlog/spdlog.h>
+
+namespace fs = std::filesystem;
+
+KeyRotation::Job::~Job() {
+    if (!fromKey.empty()) sodium_memzero(fromKey.data(), fromKey.size());
+    if (!toKey.empty()) sodium_memzero(toKey.data(), toKey.size());
+}
+
+const char* KeyRotation::stageName(Stage stage) {
+    switch (stage) {
+    case Stage::Preparing:  return "preparing";
+    case Stage::Deck:       return "deck";
+    case Stage::Journal:    return "journal";
+    case Stage::Committing: return "committing";
+    case Stage::Cleanup:    return "cleanup";
+    case Stage::Done:       return "done";
+    case Stage::Failed:     return "failed";
+    default:                return "unknown";
+    }
+}
+
+bool KeyRotation::cleanup(PagedStore& store, const std::string& username, std::uint32_t generation,
+    const Location& location) {
+    bool ok = store.eraseTenant(store.tenantOf(username, generation));
+
+    std::error_code ec;
+    if (!location.blobDir.empty()) fs::remove_all(location.blobDir, ec);
+    if (ec) {
+        spdlog::warn("Failed to remove '{}': {}", location.blobDir, ec.message());
+        ok = false;
+    }
+    if (!location.journal.empty()) ReviewJournal::remove(location.journal);
+    for (const auto& file : location.legacy) fs::remove(file, ec);
+    return ok;
+}
+
+// Imports the user's pre-store files under the old key, if they were never imported
+static bool importLegacy(PagedStore& store, const KeyRotation::Job& job, const BlobStore& blobs) {
+    const auto& legacy = job.from.legacy;
+    std::error_code ec;
+    if (legacy.size() < 3 || !fs::exists(legacy[0], ec)) return true;
+    if (store.hasTenant(store.tenantOf(job.username, job.fromGeneration))) return true;
+
+    PagedDeck deck(store);
+    std::vector<Item> items;
+    return deck.open(items, job.username, job.fromKey, &blobs, job.fromGeneration)
+        && deck.importFiles(legacy[0], legacy[1], legacy[2]);
+}
+
+bool KeyRotation::rotate(PagedStore& store, Job& job, const ProgressFn& progress) {
+    Progress state;
+    state.username = job.username;
+    auto report = [&](Stage stage) {
+        state.stage = stage;
+        if (progress) progress(state);
+    };
+    auto fail = [&]() {
+        report(Stage::Failed);
+        return false;
+    };
+
+    report(Stage::Preparing);
+    if (job.prepare && !job.prepare(job)) return fail();
+    if (job.fromKey.empty() || job.toKey.empty() || job.fromGeneration == job.toGeneration
+        || job.from.blobDir == job.to.blobDir || job.from.journal == job.to.journal) {
+        spdlog::error("Invalid key rotation for '{}'", job.username);
+        return fail();
+    }
+
+    // Whatever an earlier attempt left of the new generation
+    auto discard = [&]() { cleanup(store, job.username, job.toGeneration, Location{ job.to.blobDir, job.to.journal, {} }); };
+    discard();
+
+    BlobStore fromBlobs, toBlobs;
+    if (!fromBlobs.open(job.from.blobDir, job.fromKey) || !toBlobs.open(job.to.blobDir, job.toKey)
+        || !importLegacy(store, job, fromBlobs)) {
+        discard();
+        return fail();
+    }
+
+    state.total = store.recordCount(store.tenantOf(job.username, job.fromGeneration));
+    report(Stage::Deck);
+    bool ok = PagedDeck::rekey(store, job.username, job.fromGeneration, job.fromKey, job.toGeneration, job.toKey,
+        &fromBlobs, &toBlobs, [&](std::size_t done) {
+            state.done = done;
+            report(Stage::Deck);
+        });
+
+    if (ok) {
+        report(Stage::Journal);
+        ok = ReviewJournal::rekey(job.from.journal, job.fromKey, job.to.journal, job.toKey);
+    }
+    if (ok) {
+        report(Stage::Committing);
+        ok = job.commit && job.commit(job);
+    }
+    fromBlobs.close();
+    toBlobs.close();
+    if (!ok) {
+        discard();
+        spdlog::error("Key rotation for '{}' failed; the old key stays in use", job.username);
+        return fail();
+    }
+
+    report(Stage::Cleanup);
+    if (!cleanup(store, job.username, job.fromGeneration, job.from))
+        spdlog::warn("Old data of '{}' was not fully removed; it is retried at the next login", job.username);
+
+    spdlog::info("Rotated the key of '{}' to generation {}", job.username, job.toGeneration);
+    report(Stage::Done);
+    return true;
+}
+
+KeyRotation::Result KeyRotation::rotateAll(PagedStore& store, std::vector<Job>& jobs, std::size_t threads,
+    const ProgressFn& progress) {
+    Result result;
+    std::mutex lock;
+    auto start = std::chrono::steady_clock::now();
+
+    ThreadPool pool(threads);
+    parallelFor(pool, 0, jobs.size(), 1, [&](std::size_t lo, std::size_t hi) {
+        for (std::size_t i = lo; i < hi; ++i) {
+            bool ok = rotate(store, jobs[i], progress);
+            std::lock_guard<std::mutex> guard(lock);
+            if (ok) ++result.rotated;
+            else result.failed.push_back(jobs[i].username);
+        }
+    });
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    spdlog::info("Rotated {} of {} keys in {:.2f} s", result.rotated, jobs.size(), result.seconds);
+    return result;
+}
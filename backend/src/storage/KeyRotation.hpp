@@ -0,0 +1,87 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "PagedStore.hpp"
+
+// Moves users' stored data from one session key to the next, after a password
+// change or to rotate a key on its own.
+//
+// Everything is re-encrypted into the next key generation beside the old one,
+// never in place: deck records in bounded batches (PagedDeck::rekey), blobs a
+// chunk at a time, the review journal a section at a time. Until the job's
+// commit step switches the user record to the new key, the old password keeps
+// working, and a failed or interrupted rotation only leaves new-generation
+// data behind, which the next attempt clears first. After the commit the old
+// generation is deleted; if that is cut short, cleanup() at the user's next
+// login finishes it.
+class KeyRotation {
+public:
+    enum class Stage {
+        Preparing,
+        Deck,
+        Journal,
+        Committing,
+        Cleanup,
+        Done,
+        Failed
+    };
+
+    struct Progress {
+        std::string username;
+        Stage stage = Stage::Preparing;
+        std::size_t done = 0;  // deck records re-encrypted so far
+        std::size_t total = 0; // deck records to re-encrypt
+    };
+    using ProgressFn = std::function<void(const Progress&)>;
+
+    // Where one key generation of a user's files lives
+    struct Location {
+        std::string blobDir;
+        std::string journal;
+        // Per-user files from before the shared store (items, tag weights,
+        // scheduler, in that order). Imported before rotating if the user has
+        // nothing in the store yet, and deleted with the generation.
+        std::vector<std::string> legacy;
+    };
+
+    struct Job {
+        std::string username;
+        std::uint32_t fromGeneration = 0;
+        std::uint32_t toGeneration = 0;
+        std::vector<unsigned char> fromKey;
+        std::vector<unsigned char> toKey;
+        Location from;
+        Location to;
+
+        // Runs first, on the worker, for setup too slow to do serially
+        // (deriving keys); may fill in the fields above
+        std::function<bool(Job&)> prepare;
+        // Makes the new key current (saves the user record); nothing can be
+        // undone after it succeeds
+        std::function<bool(const Job&)> commit;
+
+        ~Job();
+    };
+
+    struct Result {
+        std::size_t rotated = 0;
+        std::vector<std::string> failed;
+        double seconds = 0.0;
+    };
+
+    static bool rotate(PagedStore& store, Job& job, const ProgressFn& progress = nullptr);
+
+    // Rotate many users on `threads` workers (0 = one per hardware thread).
+    // Progress may be reported from several threads at once.
+    static Result rotateAll(PagedStore& store, std::vector<Job>& jobs, std::size_t threads = 0,
+        const ProgressFn& progress = nullptr);
+
+    // Delete whatever is left of a superseded generation
+    static bool cleanup(PagedStore& store, const std::string& username, std::uint32_t generation,
+        const Location& location);
+
+    static const char* stageName(Stage stage);
+};
@@ -0,0 +1,363 @@
+#include "PageFile.hpp"
+#include <cstring>
+#include <filesystem>
+#include <sodium.h>
+#include <spdlog/spdlog.h>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <share.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+static const char PAGE_HDR[] = "SRPAGE1\n";     // cipher suite byte, nonce, sealed meta
+static const char WAL_HDR[] = "SRWAL01\n";      // page count, (page number, sealed page)*, header page
+static const char WAL_END[] = "SRWALOK\n";      // written last: the log is complete
+static constexpr std::size_t HDR_LEN = sizeof(PAGE_HDR) - 1;
+static constexpr std::size_t META_LEN = 8;      // root, page count
+static constexpr std::size_t MAX_NONCE = 24;
+static constexpr std::size_t MAX_TAG = 16;
+static_assert(sizeof(WAL_HDR) == sizeof(PAGE_HDR) && sizeof(WAL_END) == sizeof(PAGE_HDR), "headers must share a length");
+static_assert(PageFile::PAYLOAD_SIZE + MAX_NONCE + MAX_TAG <= PageFile::PAGE_SIZE, "sealed page must fit a page");
+
+static void putU32(unsigned char* p, std::uint32_t v) {
+    for (int i = 0; i < 4; ++i) p[i] = static_cast<unsigned char>(v >> (8 * i));
+}
+
+static std::uint32_t getU32(const unsigned char* p) {
+    std::uint32_t v = 0;
+    for (int i = 0; i < 4; ++i) v |= static_cast<std::uint32_t>(p[i]) << (8 * i);
+    return v;
+}
+
+// A descriptor holding an exclusive lock on path, or -1 if someone else holds it
+static int lockExclusive(const std::string& path) {
+#ifdef _WIN32
+    // Denying all sharing is the lock
+    int fd = -1;
+    if (_sopen_s(&fd, path.c_str(), _O_RDWR | _O_CREAT | _O_BINARY, _SH_DENYRW, _S_IREAD | _S_IWRITE) != 0) return -1;
+    return fd;
+#else
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) return -1;
+    if (::flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+#endif
+}
+
+static void unlock(int fd) {
+#ifdef _WIN32
+    _close(fd);
+#else
+    ::close(fd);
+#endif
+}
+
+// Flush what has been written to path (already flushed from any stream) to the disk
+static bool syncFile(const std::string& path) {
+#ifdef _WIN32
+    int fd = -1;
+    if (_sopen_s(&fd, path.c_str(), _O_RDWR | _O_BINARY, _SH_DENYNO, 0) != 0) return false;
+    bool ok = _commit(fd) == 0;
+    _close(fd);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+#endif
+    return ok;
+}
+
+// Make a file created or removed in path's directory survive a crash. NTFS
+// journals directory entries itself, so there is nothing to do on Windows.
+static bool syncDirOf(const std::string& path) {
+#ifdef _WIN32
+    (void)path;
+    return true;
+#else
+    fs::path dir = fs::path(path).parent_path();
+    return syncFile(dir.empty() ? std::string(".") : dir.string());
+#endif
+}
+
+PageFile::~PageFile() {
+    close();
+}
+
+void PageFile::close() {
+    if (file.is_open()) file.close();
+    if (lockFd >= 0) {
+        unlock(lockFd);
+        lockFd = -1;
+    }
+    if (!key.empty()) {
+        sodium_memzero(key.data(), key.size());
+        key.clear();
+    }
+    filePath.clear();
+    rootPage = committedRoot = NO_PAGE;
+    pages = committedPages = 1;
+}
+
+bool PageFile::lock(const std::string& path) {
+    close();
+    filePath = path;
+    lockFd = lockExclusive(lockPath());
+    if (lockFd < 0) {
+        spdlog::error("Page file '{}' is in use by another process", path);
+        filePath.clear();
+        return false;
+    }
+    return true;
+}
+
+bool PageFile::open(const std::string& path, const std::vector<unsigned char>& k, CipherSuite newSuite) {
+    // Held before anything is read, so creation and WAL replay happen once
+    if ((lockFd < 0 || filePath != path || file.is_open()) && !lock(path)) return false;
+    if (k.size() != cipherKeyBytes()) {
+        spdlog::error("Invalid key size");
+        close();
+        return false;
+    }
+    key = k;
+
+    std::error_code ec;
+    if (!fs::exists(path, ec)) {
+        // An empty file is just a header; its first commit is the usual WAL dance
+        if (!cipherSuiteAvailable(newSuite)) {
+            spdlog::error("{} is not available on this CPU", cipherSuiteName(newSuite));
+            close();
+            return false;
+        }
+        suite = newSuite;
+        std::vector<unsigned char> hdr(PAGE_SIZE, 0);
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out || !sealHeader(hdr.data())) {
+            spdlog::error("Failed to create page file '{}'", path);
+            close();
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(hdr.data()), static_cast<std::streamsize>(hdr.size()));
+        out.close();
+        if (!out || !syncFile(path) || !syncDirOf(path)) {
+            spdlog::error("Failed to create page file '{}'", path);
+            close();
+            return false;
+        }
+        spdlog::info("Created page file '{}' ({})", path, cipherSuiteName(suite));
+    }
+
+    file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+    if (!file) {
+        spdlog::error("Failed to open page file '{}'", path);
+        return false;
+    }
+    if (fs::exists(walPath(), ec) && !replayWal()) {
+        close();
+        return false;
+    }
+
+    if (!readHeader(suite, rootPage, pages)) {
+        spdlog::error("Page file '{}' has a bad header", path);
+        close();
+        return false;
+    }
+    committedRoot = rootPage;
+    committedPages = pages;
+
+    spdlog::info("Opened page file '{}': {} pages, root {} ({})", path, pages, rootPage, cipherSuiteName(suite));
+    return true;
+}
+
+bool PageFile::sealHeader(unsigned char* out) const {
+    std::memset(out, 0, PAGE_SIZE);
+    std::memcpy(out, PAGE_HDR, HDR_LEN);
+    out[HDR_LEN] = static_cast<unsigned char>(suite);
+
+    unsigned char* nonce = out + HDR_LEN + 1;
+    randombytes_buf(nonce, cipherNonceBytes(suite));
+    unsigned char meta[META_LEN];
+    putU32(meta, rootPage);
+    putU32(meta + 4, pages);
+    return cipherSeal(suite, nonce + cipherNonceBytes(suite), meta, sizeof(meta), nonce, key);
+}
+
+bool PageFile::openHeader(const unsigned char* in, CipherSuite& fileSuite, PageId& root, PageId& count) const {
+    if (std::memcmp(in, PAGE_HDR, HDR_LEN) != 0) return false;
+    if (!cipherSuiteFromByte(in[HDR_LEN], fileSuite)) return false;
+
+    const unsigned char* nonce = in + HDR_LEN + 1;
+    unsigned char meta[META_LEN];
+    if (!cipherOpen(fileSuite, meta, nonce + cipherNonceBytes(fileSuite), META_LEN + cipherTagBytes(fileSuite), nonce, key)) {
+        spdlog::error("Page file header failed to decrypt (wrong key?)");
+        return false;
+    }
+
+    root = getU32(meta);
+    count = getU32(meta + 4);
+    return count >= 1 && root < count;
+}
+
+bool PageFile::readHeader(CipherSuite& fileSuite, PageId& root, PageId& count) {
+    unsigned char raw[PAGE_SIZE];
+    file.clear();
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(raw), sizeof(raw));
+    return file.gcount() == static_cast<std::streamsize>(sizeof(raw)) && openHeader(raw, fileSuite, root, count);
+}
+
+bool PageFile::sealPage(PageId id, const unsigned char* data, unsigned char* out) const {
+    unsigned char plain[PAYLOAD_SIZE];
+    putU32(plain, id);
+    std::memcpy(plain + sizeof(PageId), data, DATA_SIZE);
+
+    std::memset(out, 0, PAGE_SIZE);
+    randombytes_buf(out, cipherNonceBytes(suite));
+    bool ok = cipherSeal(suite, out + cipherNonceBytes(suite), plain, sizeof(plain), out, key);
+    sodium_memzero(plain, sizeof(plain));
+    return ok;
+}
+
+bool PageFile::read(PageId id, unsigned char* data) {
+    if (id == NO_PAGE || id >= committedPages) {
+        spdlog::error("Page {} is outside the file ({} pages)", id, committedPages);
+        return false;
+    }
+
+    unsigned char raw[PAGE_SIZE];
+    file.clear();
+    file.seekg(static_cast<std::streamoff>(id) * static_cast<std::streamoff>(PAGE_SIZE));
+    file.read(reinterpret_cast<char*>(raw), sizeof(raw));
+    if (file.gcount() != static_cast<std::streamsize>(sizeof(raw))) {
+        spdlog::error("Short read of page {}", id);
+        return false;
+    }
+
+    unsigned char plain[PAYLOAD_SIZE];
+    std::size_t nonceLen = cipherNonceBytes(suite);
+    if (!cipherOpen(suite, plain, raw + nonceLen, PAYLOAD_SIZE + cipherTagBytes(suite), raw, key)) {
+        spdlog::error("Page {} failed to decrypt", id);
+        return false;
+    }
+    if (getU32(plain) != id) {
+        spdlog::error("Page {} holds page {}", id, getU32(plain));
+        return false;
+    }
+    std::memcpy(data, plain + sizeof(PageId), DATA_SIZE);
+    sodium_memzero(plain, sizeof(plain));
+    return true;
+}
+
+bool PageFile::writeAt(std::uint64_t offset, const unsigned char* data, std::size_t len) {
+    file.clear();
+    file.seekp(static_cast<std::streamoff>(offset));
+    file.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(len));
+    return static_cast<bool>(file);
+}
+
+bool PageFile::commit(const std::vector<std::pair<PageId, const unsigned char*>>& changed) {
+    // Nobody else may write the file while the lock is held, so a header that
+    // moved since the last commit means it was changed behind the lock's back;
+    // pages written now could overwrite someone else's
+    CipherSuite onDisk;
+    PageId root = NO_PAGE, count = 0;
+    if (!readHeader(onDisk, root, count) || onDisk != suite || root != committedRoot || count != committedPages) {
+        spdlog::error("Page file '{}' changed since it was opened; not committing", filePath);
+        return false;
+    }
+
+    // The whole log is built before anything touches the page file
+    std::vector<unsigned char> log(HDR_LEN + 4 + changed.size() * (4 + PAGE_SIZE) + PAGE_SIZE + HDR_LEN);
+    unsigned char* p = log.data();
+    std::memcpy(p, WAL_HDR, HDR_LEN);
+    putU32(p + HDR_LEN, static_cast<std::uint32_t>(changed.size()));
+    p += HDR_LEN + 4;
+    for (const auto& c : changed) {
+        putU32(p, c.first);
+        if (!sealPage(c.first, c.second, p + 4)) return false;
+        p += 4 + PAGE_SIZE;
+    }
+    if (!sealHeader(p)) return false;
+    unsigned char* header = p;
+    std::memcpy(p + PAGE_SIZE, WAL_END, HDR_LEN);
+
+    {
+        std::ofstream wal(walPath(), std::ios::binary | std::ios::trunc);
+        wal.write(reinterpret_cast<const char*>(log.data()), static_cast<std::streamsize>(log.size()));
+        wal.flush();
+        if (!wal) {
+            spdlog::error("Failed to write '{}'", walPath());
+            return false;
+        }
+    }
+    // The log, and its name, must be on disk before the first page is overwritten
+    std::error_code ec;
+    if (!syncFile(walPath()) || !syncDirOf(walPath())) {
+        spdlog::error("Failed to sync '{}'", walPath());
+        fs::remove(walPath(), ec);
+        return false;
+    }
+
+    const unsigned char* page = log.data() + HDR_LEN + 4;
+    for (std::size_t i = 0; i < changed.size(); ++i, page += 4 + PAGE_SIZE) {
+        if (!writeAt(static_cast<std::uint64_t>(getU32(page)) * PAGE_SIZE, page + 4, PAGE_SIZE)) {
+            spdlog::error("Page write failed; '{}' will be replayed on next open", walPath());
+            return false;
+        }
+    }
+    // ...and the pages before the log that could restore them is dropped
+    if (!writeAt(0, header, PAGE_SIZE) || !file.flush() || !syncFile(filePath)) {
+        spdlog::error("Header write failed; '{}' will be replayed on next open", walPath());
+        return false;
+    }
+
+    fs::remove(walPath(), ec);
+    committedRoot = rootPage;
+    committedPages = pages;
+    spdlog::debug("Committed {} pages to '{}'", changed.size(), filePath);
+    return true;
+}
+
+void PageFile::rollback() {
+    rootPage = committedRoot;
+    pages = committedPages;
+}
+
+// Copies a complete log into place; an incomplete one is a commit that never happened
+bool PageFile::replayWal() {
+    std::ifstream in(walPath(), std::ios::binary);
+    std::vector<unsigned char> log((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+
+    std::error_code ec;
+    std::size_t count = log.size() >= HDR_LEN + 4 ? getU32(log.data() + HDR_LEN) : 0;
+    std::size_t expected = HDR_LEN + 4 + count * (4 + PAGE_SIZE) + PAGE_SIZE + HDR_LEN;
+    if (log.size() < HDR_LEN + 4 || std::memcmp(log.data(), WAL_HDR, HDR_LEN) != 0 || log.size() != expected
+        || std::memcmp(log.data() + log.size() - HDR_LEN, WAL_END, HDR_LEN) != 0) {
+        spdlog::warn("Discarding incomplete page log '{}'", walPath());
+        fs::remove(walPath(), ec);
+        return true;
+    }
+
+    const unsigned char* page = log.data() + HDR_LEN + 4;
+    for (std::size_t i = 0; i < count; ++i, page += 4 + PAGE_SIZE)
+        if (!writeAt(static_cast<std::uint64_t>(getU32(page)) * PAGE_SIZE, page + 4, PAGE_SIZE)) return false;
+    if (!writeAt(0, page, PAGE_SIZE) || !file.flush() || !syncFile(filePath)) {
+        spdlog::error("Failed to replay page log '{}'", walPath());
+        return false;
+    }
+
+    fs::remove(walPath(), ec);
+    spdlog::warn("Replayed {} pages from an interrupted commit", count);
+    return true;
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "CipherSuite.hpp"
+
+// A single file of fixed-size sealed pages, the container under PagedStore.
+//
+// Page 0 is the header: "SRPAGE1\n", the cipher suite byte and a sealed meta
+// record (root page, page count). Every other page is nonce | ciphertext,
+// sealed with the key passed to open(); the plaintext starts with the page's
+// own number, so a page copied to another slot fails to open. The sealing is
+// only as secret as that key (PagedStore keeps it next to the file). Pages are
+// PAGE_SIZE on disk and carry DATA_SIZE bytes for the caller.
+//
+// Commits go through a side file ("<path>-wal") holding the sealed images of
+// every changed page and the new header. They are copied in place only once
+// that file is complete and synced to disk, the page file is synced before the
+// log is dropped, and a complete log left behind by a crash is replayed on
+// open, so a commit lands whole or not at all.
+//
+// An open file holds an exclusive lock on "<path>-lock" until close(), so a
+// second process (or a second PageFile) fails to open it rather than caching
+// pages another writer is changing. Not thread-safe.
+class PageFile {
+public:
+    using PageId = std::uint32_t;
+    static constexpr std::size_t PAGE_SIZE = 4096;
+    static constexpr std::size_t PAYLOAD_SIZE = PAGE_SIZE - 24 - 16; // room for the largest nonce and tag
+    static constexpr std::size_t DATA_SIZE = PAYLOAD_SIZE - sizeof(PageId);
+    static constexpr PageId NO_PAGE = 0; // the header is never a data page
+
+    PageFile() = default;
+    PageFile(const PageFile&) = delete;
+    PageFile& operator=(const PageFile&) = delete;
+    ~PageFile();
+
+    // Takes the lock on path without opening it, for setup that must happen
+    // under it (PagedStore creates the volume key this way). open() takes it
+    // itself when it is not already held for the same path.
+    bool lock(const std::string& path);
+
+    // Opens path, creating an empty file sealed with suite if there is none.
+    // Pages are rewritten in place for the life of the file, far more often
+    // than sections are sealed elsewhere, so the default is the suite whose
+    // random nonces never need counting.
+    bool open(const std::string& path, const std::vector<unsigned char>& key,
+        CipherSuite suite = CipherSuite::XChaCha20Poly1305);
+    bool isOpen() const { return file.is_open(); }
+    void close();
+
+    // Decrypt page id into data (DATA_SIZE bytes)
+    bool read(PageId id, unsigned char* data);
+
+    // A fresh page number; it only becomes part of the file with the next commit
+    PageId allocate() { return pages++; }
+
+    // Write pages (DATA_SIZE bytes each) and the header atomically
+    bool commit(const std::vector<std::pair<PageId, const unsigned char*>>& changed);
+    // Forget allocations and root changes since the last commit
+    void rollback();
+
+    PageId root() const { return rootPage; }
+    void setRoot(PageId id) { rootPage = id; }
+    std::size_t pageCount() const { return pages; }
+    CipherSuite cipherSuite() const { return suite; }
+    const std::string& path() const { return filePath; }
+
+private:
+    std::fstream file;
+    int lockFd = -1;
+    std::string filePath;
+    std::vector<unsigned char> key;
+    CipherSuite suite = CipherSuite::XChaCha20Poly1305;
+    PageId rootPage = NO_PAGE;
+    PageId pages = 1;
+    PageId committedRoot = NO_PAGE;
+    PageId committedPages = 1;
+
+    std::string walPath() const { return filePath + "-wal"; }
+    std::string lockPath() const { return filePath + "-lock"; }
+    bool sealPage(PageId id, const unsigned char* data, unsigned char* out) const;
+    bool sealHeader(unsigned char* out) const;
+    bool openHeader(const unsigned char* in, CipherSuite& fileSuite, PageId& root, PageId& count) const;
+    bool readHeader(CipherSuite& fileSuite, PageId& root, PageId& count);
+    bool writeAt(std::uint64_t offset, const unsigned char* data, std::size_t len);
+    bool replayWal();
+};
@@ -0,0 +1,422 @@
+#include "PagedDeck.hpp"
+#include "BlobStore.hpp"
+#include "DeckFile.hpp"
+#include "Storage.hpp"
+#include "../core/ViewStream.hpp"
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <sodium.h>
+#include <spdlog/spdlog.h>
+
+// Record kinds within a tenant
+static constexpr char INDEX = 'i';
+static constexpr char PAYLOAD = 'p';
+static constexpr char SETTINGS = 's';
+static constexpr char CHANGED = 'c'; // empty marker per item saved or removed, for DeckSync
+static const char TAG_WEIGHTS[] = "tag-weights";
+static const char SCHEDULER[] = "scheduler";
+
+static void splitTags(const std::string& line, std::vector<std::string>& tags) {
+    tags.clear();
+    std::istringstream tss(line);
+    std::string tag;
+    while (std::getline(tss, tag, ',')) {
+        while (!tag.empty() && std::isspace((unsigned char)tag.front())) tag.erase(tag.begin());
+        while (!tag.empty() && std::isspace((unsigned char)tag.back())) tag.pop_back();
+        if (!tag.empty()) tags.push_back(tag);
+    }
+}
+
+static std::string indexRecord(const Item& it) {
+    std::ostringstream oss;
+    oss.precision(std::numeric_limits<double>::max_digits10);
+    oss << it.title << "\n"
+        << it.tagsAsLine() << "\n"
+        << it.content_ref << "\n"
+        << it.interval << "\n"
+        << it.ease_factor << "\n"
+        << it.last_review << "\n"
+        << it.next_review << "\n"
+        << it.reps << "\n"
+        << it.base_interval << "\n"
+        << it.stability << "\n"
+        << it.difficulty << "\n"
+        << it.lapses << "\n"
+        << it.is_leech << "\n"
+        << it.review_count << "\n"
+        << it.streak << "\n";
+    return oss.str();
+}
+
+static bool parseIndex(std::string_view plain, Item& it) {
+    ViewStream iss(plain);
+    std::string tagsLine;
+    if (!std::getline(iss, it.title) || !std::getline(iss, tagsLine) || !std::getline(iss, it.content_ref)) return false;
+    splitTags(tagsLine, it.tags);
+    return static_cast<bool>(iss >> it.interval >> it.ease_factor >> it.last_review >> it.next_review
+        >> it.reps >> it.base_interval >> it.stability >> it.difficulty
+        >> it.lapses >> it.is_leech >> it.review_count >> it.streak);
+}
+
+// Content is length-prefixed, so it may hold newlines; out-of-line content is only referenced from the index
+static std::string payloadRecord(const Item& it) {
+    std::ostringstream oss;
+    if (it.content_ref.empty()) oss << it.content.size() << "\n" << it.content;
+    else oss << "0\n";
+    oss << it.history.size() << "\n";
+    for (const auto& r : it.history)
+        oss << r.timestamp << " " << r.quality << " " << r.interval_after << "\n";
+    return oss.str();
+}
+
+static bool parsePayload(std::string_view plain, std::string& content, std::vector<ReviewRecord>& history) {
+    ViewStream iss(plain);
+    std::size_t len = 0, count = 0;
+    if (!(iss >> len) || iss.get() != '\n') return false;
+    content.resize(len);
+    if (!iss.read(&content[0], static_cast<std::streamsize>(len))) return false;
+    if (!(iss >> count)) return false;
+
+    history.clear();
+    history.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        ReviewRecord r;
+        if (!(iss >> r.timestamp >> r.quality >> r.interval_after)) return false;
+        history.push_back(r);
+    }
+    return true;
+}
+
+PagedDeck::PagedDeck(PagedStore& s) : store(s) {
+}
+
+PagedDeck::~PagedDeck() {
+    close();
+}
+
+void PagedDeck::close() {
+    std::lock_guard<std::mutex> guard(lock);
+    closeLocked();
+}
+
+void PagedDeck::closeLocked() {
+    if (!key.empty()) {
+        sodium_memzero(key.data(), key.size());
+        key.clear();
+    }
+    tenant.clear();
+    blobs = nullptr;
+    indexDigest.clear();
+    payloadDigest.clear();
+    writes = 0;
+}
+
+PagedDeck::Digest PagedDeck::digestOf(std::string_view plain) {
+    Digest d;
+    crypto_generichash(d.data(), d.size(), reinterpret_cast<const unsigned char*>(plain.data()), plain.size(), nullptr, 0);
+    return d;
+}
+
+bool PagedDeck::open(std::vector<Item>& items, const std::string& username, const std::vector<unsigned char>& k,
+    const BlobStore* blobStore, std::uint32_t generation) {
+    std::lock_guard<std::mutex> guard(lock);
+    closeLocked();
+    items.clear();
+
+    if (k.size() != cipherKeyBytes()) {
+        spdlog::error("Invalid key size");
+        return false;
+    }
+    if (!store.isOpen()) {
+        spdlog::error("Deck store is not open");
+        return false;
+    }
+
+    tenant = store.tenantOf(username, generation);
+    key = k;
+    blobs = blobStore;
+
+    bool ok = store.scan(tenant, INDEX, key, [&](const std::string& id, std::string_view plain) {
+        Item it;
+        it.id = id;
+        if (!parseIndex(plain, it)) {
+            spdlog::error("Corrupt index record for item '{}'", id);
+            return false;
+        }
+        it.cold = true;
+        indexDigest[id] = digestOf(plain);
+        items.push_back(std::move(it));
+        return true;
+    });
+    if (!ok) {
+        items.clear();
+        closeLocked();
+        return false;
+    }
+
+    spdlog::info("Opened deck of {} items from the page store", items.size());
+    return true;
+}
+
+bool PagedDeck::exists() {
+    std::lock_guard<std::mutex> guard(lock);
+    return !tenant.empty() && store.hasTenant(tenant);
+}
+
+bool PagedDeck::ensureLoaded(Item& item) {
+    if (!item.cold) return true;
+    std::lock_guard<std::mutex> guard(lock);
+    return ensureLoadedLocked(item);
+}
+
+bool PagedDeck::ensureLoadedLocked(Item& item) {
+    SecureString plain(secureResource());
+    bool found = false;
+    if (!store.get(tenant, PAYLOAD, item.id, key, plain, found)) return false;
+    if (!found) {
+        spdlog::error("Item '{}' has no stored content", item.id);
+        return false;
+    }
+
+    std::string content;
+    std::vector<ReviewRecord> history;
+    if (!parsePayload(plain, content, history)) {
+        spdlog::error("Corrupt content record for item '{}'", item.id);
+        return false;
+    }
+    if (!item.content_ref.empty() && blobs) {
+        if (!blobs->readAll(item.content_ref, content)) return false;
+    }
+
+    payloadDigest[item.id] = digestOf(plain);
+    item.content = std::move(content);
+    item.history = std::move(history);
+    item.cold = false;
+    return true;
+}
+
+bool PagedDeck::loadAll(std::vector<Item>& items) {
+    std::lock_guard<std::mutex> guard(lock);
+    bool ok = true;
+    for (auto& it : items)
+        if (it.cold && !ensureLoadedLocked(it)) ok = false;
+    return ok;
+}
+
+bool PagedDeck::putRecord(char kind, const std::string& name, const std::string& plain,
+    std::unordered_map<std::string, Digest>& seen, std::size_t& written) {
+    Digest d = digestOf(plain);
+    auto it = seen.find(name);
+    if (it != seen.end() && it->second == d) return true;
+    if (!store.put(tenant, kind, name, plain, key)) return false;
+    seen[name] = d;
+    ++written;
+    return true;
+}
+
+bool PagedDeck::save(const std::vector<Item>& items) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (tenant.empty()) {
+        spdlog::error("No deck is open");
+        return false;
+    }
+
+    auto tx = store.transaction();
+    auto oldIndex = indexDigest;
+    auto oldPayload = payloadDigest;
+    auto fail = [&]() {
+        store.rollback();
+        indexDigest = std::move(oldIndex);
+        payloadDigest = std::move(oldPayload);
+        return false;
+    };
+
+    std::size_t written = 0;
+    std::unordered_map<std::string, char> live;
+    live.reserve(items.size());
+    // One kind at a time and by ID, so new records reach the tree in key order
+    std::vector<const Item*> byId;
+    byId.reserve(items.size());
+    for (const auto& it : items) byId.push_back(&it);
+    std::sort(byId.begin(), byId.end(), [](const Item* a, const Item* b) { return a->id < b->id; });
+
+    // live: 1 for items whose records changed
+    for (const Item* it : byId) {
+        std::size_t before = written;
+        if (!putRecord(INDEX, it->id, indexRecord(*it), indexDigest, written)) return fail();
+        live.emplace(it->id, written != before);
+    }
+    for (const Item* it : byId) {
+        // A cold item's payload is whatever the store already holds
+        std::size_t before = written;
+        if (!it->cold && !putRecord(PAYLOAD, it->id, payloadRecord(*it), payloadDigest, written)) return fail();
+        if (written != before) live[it->id] = 1;
+    }
+
+    std::vector<std::string> changed;
+    for (const auto& l : live)
+        if (l.second) changed.push_back(l.first);
+    std::vector<std::string> removed;
+    for (const auto& d : indexDigest)
+        if (!live.count(d.first)) removed.push_back(d.first);
+    for (const auto& id : removed) {
+        if (!store.erase(tenant, INDEX, id) || !store.erase(tenant, PAYLOAD, id)) return fail();
+        indexDigest.erase(id);
+        payloadDigest.erase(id);
+        changed.push_back(id);
+        ++written;
+    }
+    for (const auto& id : changed)
+        if (!store.put(tenant, CHANGED, id, "", key)) return fail();
+
+    if (!store.commit()) return fail();
+    writes = written;
+    spdlog::info("Saved deck of {} items to the page store ({} records changed)", items.size(), written);
+    return true;
+}
+
+bool PagedDeck::rekey(PagedStore& store, const std::string& username, std::uint32_t fromGeneration,
+    const std::vector<unsigned char>& fromKey, std::uint32_t toGeneration, const std::vector<unsigned char>& toKey,
+    const BlobStore* fromBlobs, BlobStore* toBlobs, const PagedStore::Progress& progress) {
+    std::unordered_map<std::string, std::string> copied; // blob references, old to new
+
+    // Blob names are keyed with the session key, so the content reference on
+    // the third line of an index record changes with it
+    auto transform = [&](char kind, const std::string& id, SecureString& plain) {
+        if (kind != INDEX) return true;
+        std::size_t a = plain.find('\n');
+        std::size_t b = a == SecureString::npos ? a : plain.find('\n', a + 1);
+        std::size_t c = b == SecureString::npos ? b : plain.find('\n', b + 1);
+        if (c == SecureString::npos) {
+            spdlog::error("Corrupt index record for item '{}'", id);
+            return false;
+        }
+
+        std::string ref(plain.data() + b + 1, c - b - 1);
+        if (ref.empty()) return true;
+        auto it = copied.find(ref);
+        if (it == copied.end()) {
+            std::string newRef;
+            if (!fromBlobs || !toBlobs || !fromBlobs->copyTo(ref, *toBlobs, newRef)) {
+                spdlog::error("Failed to copy the content of item '{}'", id);
+                return false;
+            }
+            it = copied.emplace(ref, newRef).first;
+        }
+        plain.replace(b + 1, c - b - 1, it->second);
+        return true;
+    };
+
+    std::string from = store.tenantOf(username, fromGeneration);
+    std::string to = store.tenantOf(username, toGeneration);
+    if (!store.copyTenant(from, fromKey, to, toKey, transform, progress)) return false;
+
+    spdlog::info("Re-encrypted the deck of '{}' for key generation {} ({} blobs copied)", username, toGeneration,
+        copied.size());
+    return true;
+}
+
+bool PagedDeck::changedItems(std::vector<std::string>& ids) {
+    std::lock_guard<std::mutex> guard(lock);
+    ids.clear();
+    if (tenant.empty()) return false;
+    return store.scan(tenant, CHANGED, key, [&](const std::string& id, std::string_view) {
+        ids.push_back(id);
+        return true;
+    });
+}
+
+bool PagedDeck::clearChanged(const std::vector<std::string>& ids) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto tx = store.transaction();
+    for (const auto& id : ids) {
+        if (tenant.empty() || !store.erase(tenant, CHANGED, id)) {
+            store.rollback();
+            return false;
+        }
+    }
+    return store.commit();
+}
+
+std::size_t PagedDeck::lastSaveWrites() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return writes;
+}
+
+bool PagedDeck::saveTagWeights(const TagManager& mgr) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto tx = store.transaction();
+    if (tenant.empty() || !store.put(tenant, SETTINGS, TAG_WEIGHTS, mgr.serialize(), key) || !store.commit()) {
+        store.rollback();
+        spdlog::error("Failed to save tag weights");
+        return false;
+    }
+    return true;
+}
+
+bool PagedDeck::loadTagWeights(TagManager& mgr) {
+    std::lock_guard<std::mutex> guard(lock);
+    mgr.clearWeights();
+
+    SecureString plain(secureResource());
+    bool found = false;
+    if (tenant.empty() || !store.get(tenant, SETTINGS, TAG_WEIGHTS, key, plain, found)) return false;
+    if (found) mgr.deserialize(plain);
+    spdlog::info("Loaded {} tag weights", mgr.weights.size());
+    return true;
+}
+
+bool PagedDeck::saveSchedulerConfig(const SchedulerConfig& cfg) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto tx = store.transaction();
+    if (tenant.empty() || !store.put(tenant, SETTINGS, SCHEDULER, cfg.serialize(), key) || !store.commit()) {
+        store.rollback();
+        spdlog::error("Failed to save scheduler settings");
+        return false;
+    }
+    return true;
+}
+
+bool PagedDeck::loadSchedulerConfig(SchedulerConfig& cfg) {
+    std::lock_guard<std::mutex> guard(lock);
+    cfg = SchedulerConfig();
+
+    SecureString plain(secureResource());
+    bool found = false;
+    if (tenant.empty() || !store.get(tenant, SETTINGS, SCHEDULER, key, plain, found)) return false;
+    if (found) cfg.deserialize(plain);
+    return true;
+}
+
+bool PagedDeck::importFiles(const std::string& itemFile, const std::string& tagFile, const std::string& schedFile) {
+    if (!std::ifstream(itemFile, std::ios::binary)) return false;
+
+    std::vector<unsigned char> k;
+    const BlobStore* blobStore;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        k = key;
+        blobStore = blobs;
+    }
+
+    std::vector<Item> items;
+    DeckFile legacy;
+    bool ok = legacy.open(items, itemFile, k, blobStore) && legacy.loadAll(items);
+    legacy.close();
+
+    TagManager weights;
+    SchedulerConfig cfg;
+    ok = ok && Storage::loadTagWeights(weights, tagFile, k) && Storage::loadSchedulerConfig(cfg, schedFile, k);
+    sodium_memzero(k.data(), k.size());
+    if (!ok) {
+        spdlog::error("Could not read '{}' for import", itemFile);
+        return false;
+    }
+
+    if (!save(items) || !saveTagWeights(weights) || !saveSchedulerConfig(cfg)) return false;
+
+    spdlog::info("Imported {} items from '{}' into the page store; the old files can be removed", items.size(), itemFile);
+    return true;
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "../core/Item.hpp"
+#include "../core/SchedulerConfig.hpp"
+#include "../core/TagManager.hpp"
+#include "PagedStore.hpp"
+
+class BlobStore;
+
+// One user's deck inside a PagedStore. Each item is two records: its index
+// fields (title, tags, content reference, scheduling state) and its payload
+// (content and history). open() scans only the index records, so items start
+// cold and a payload is read the first time the item is needed, the same
+// contract as DeckFile. Items come back in ID order, which is creation order.
+//
+// save() rewrites only the records whose bytes changed since they were last
+// read or written and erases those of removed items, so saving after a review
+// touches a few pages rather than rewriting the deck. Cold items are never
+// loaded to be saved. Each item saved with changes, or removed, is also
+// marked changed until clearChanged(), so DeckSync can find what changed
+// without reading the whole deck. Safe to call from several threads.
+class PagedDeck {
+public:
+    explicit PagedDeck(PagedStore& store);
+    PagedDeck(const PagedDeck&) = delete;
+    PagedDeck& operator=(const PagedDeck&) = delete;
+    ~PagedDeck();
+
+    // generation is the user's key generation (User::key_generation)
+    bool open(std::vector<Item>& items, const std::string& username, const std::vector<unsigned char>& key,
+        const BlobStore* blobs = nullptr, std::uint32_t generation = 0);
+    // Whether the store holds anything for the user opened
+    bool exists();
+
+    bool ensureLoaded(Item& item);
+    bool loadAll(std::vector<Item>& items);
+
+    bool save(const std::vector<Item>& items);
+
+    bool saveTagWeights(const TagManager& mgr);
+    bool loadTagWeights(TagManager& mgr);
+    bool saveSchedulerConfig(const SchedulerConfig& cfg);
+    bool loadSchedulerConfig(SchedulerConfig& cfg);
+
+    // Copy a deck kept in the per-user files into the store. The files are
+    // left in place. False if there is no item file or the copy failed.
+    bool importFiles(const std::string& itemFile, const std::string& tagFile, const std::string& schedFile);
+
+    // Re-seal a user's whole deck from one key generation to the next, in
+    // bounded batches (PagedStore::copyTenant). Out-of-line content is copied
+    // from fromBlobs to toBlobs and the index records point at the copies. The
+    // old generation is left for the caller to erase once the new key is in use.
+    static bool rekey(PagedStore& store, const std::string& username, std::uint32_t fromGeneration,
+        const std::vector<unsigned char>& fromKey, std::uint32_t toGeneration, const std::vector<unsigned char>& toKey,
+        const BlobStore* fromBlobs, BlobStore* toBlobs, const PagedStore::Progress& progress = nullptr);
+
+    // IDs of items saved with changes or removed since they were last cleared
+    bool changedItems(std::vector<std::string>& ids);
+    bool clearChanged(const std::vector<std::string>& ids);
+
+    // Records written and erased by the last save
+    std::size_t lastSaveWrites() const;
+
+    // Forget the user and wipe the cached key
+    void close();
+
+private:
+    using Digest = std::array<unsigned char, 16>;
+
+    PagedStore& store;
+    mutable std::mutex lock;
+    std::string tenant;
+    std::vector<unsigned char> key;
+    const BlobStore* blobs = nullptr;
+    std::unordered_map<std::string, Digest> indexDigest;   // every stored item
+    std::unordered_map<std::string, Digest> payloadDigest; // payloads read or written since open
+    std::size_t writes = 0;
+
+    static Digest digestOf(std::string_view plain);
+    bool ensureLoadedLocked(Item& item);
+    bool putRecord(char kind, const std::string& name, const std::string& plain,
+        std::unordered_map<std::string, Digest>& seen, std::size_t& written);
+    void closeLocked();
+};
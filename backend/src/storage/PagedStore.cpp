@@ -0,0 +1,423 @@
+#include "PagedStore.hpp"
+#include "SealedSection.hpp"
+#include <filesystem>
+#include <fstream>
+#include "../core/ViewStream.hpp"
+#include <sodium.h>
+#include <spdlog/spdlog.h>
+
+namespace fs = std::filesystem;
+
+static const char KDF_CONTEXT[crypto_kdf_CONTEXTBYTES + 1] = "srpages_";
+static constexpr std::size_t CHUNK_SUFFIX = 3; // '\0' and a big-endian u16, so chunks sort in order
+
+static std::string keyFileFor(const std::string& path) {
+    return path + ".key";
+}
+
+// The volume key, created with the store. It is kept in the clear beside the
+// store, so it keys integrity checks, not secrecy (see PagedStore.hpp).
+static bool loadVolumeKey(const std::string& path, std::vector<unsigned char>& key) {
+    key.assign(crypto_kdf_KEYBYTES, 0);
+    std::string keyFile = keyFileFor(path);
+
+    std::error_code ec;
+    if (!fs::exists(keyFile, ec)) {
+        if (fs::exists(path, ec)) {
+            spdlog::error("Store '{}' exists but its key file '{}' is missing", path, keyFile);
+            return false;
+        }
+        randombytes_buf(key.data(), key.size());
+        std::ofstream out(keyFile, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(key.data()), static_cast<std::streamsize>(key.size()));
+        if (!out) {
+            spdlog::error("Failed to write key file '{}'", keyFile);
+            return false;
+        }
+        fs::permissions(keyFile, fs::perms::owner_read | fs::perms::owner_write, ec);
+        return true;
+    }
+
+    std::ifstream in(keyFile, std::ios::binary);
+    in.read(reinterpret_cast<char*>(key.data()), static_cast<std::streamsize>(key.size()));
+    if (in.gcount() != static_cast<std::streamsize>(key.size())) {
+        spdlog::error("Key file '{}' is truncated", keyFile);
+        return false;
+    }
+    return true;
+}
+
+PagedStore::~PagedStore() {
+    close();
+}
+
+bool PagedStore::open(const std::string& path, std::size_t cachePages) {
+    auto guard = transaction();
+    close();
+
+    // Another process creating the store at the same time would write a key of its own
+    std::vector<unsigned char> volumeKey;
+    if (!file.lock(path)) return false;
+    if (!loadVolumeKey(path, volumeKey)) {
+        close();
+        return false;
+    }
+
+    // Separate subkeys for sealing pages and for naming tenants
+    std::vector<unsigned char> pageKey(cipherKeyBytes());
+    tenantKey.resize(crypto_generichash_KEYBYTES);
+    crypto_kdf_derive_from_key(pageKey.data(), pageKey.size(), 1, KDF_CONTEXT, volumeKey.data());
+    crypto_kdf_derive_from_key(tenantKey.data(), tenantKey.size(), 2, KDF_CONTEXT, volumeKey.data());
+    sodium_memzero(volumeKey.data(), volumeKey.size());
+
+    bool ok = file.open(path, pageKey);
+    sodium_memzero(pageKey.data(), pageKey.size());
+    if (!ok) {
+        close();
+        return false;
+    }
+
+    pool = std::make_unique<BufferPool>(file, cachePages);
+    tree = std::make_unique<BTree>(*pool);
+    return true;
+}
+
+bool PagedStore::isOpen() const {
+    auto guard = transaction();
+    return tree != nullptr;
+}
+
+void PagedStore::close() {
+    auto guard = transaction();
+    if (pool) pool->rollback();
+    tree.reset();
+    pool.reset();
+    file.close();
+    if (!tenantKey.empty()) sodium_memzero(tenantKey.data(), tenantKey.size());
+    tenantKey.clear();
+}
+
+std::string PagedStore::tenantOf(const std::string& username, std::uint32_t generation) const {
+    auto guard = transaction();
+    std::string input = username;
+    if (generation > 0) {
+        input += '\0';
+        input += std::to_string(generation);
+    }
+    unsigned char hash[TENANT_BYTES];
+    crypto_generichash(hash, sizeof(hash), reinterpret_cast<const unsigned char*>(input.data()), input.size(),
+        tenantKey.data(), tenantKey.size());
+    return std::string(reinterpret_cast<const char*>(hash), sizeof(hash));
+}
+
+std::string PagedStore::prefixOf(const std::string& tenant, char kind, const std::string& name) {
+    std::string prefix;
+    prefix.reserve(tenant.size() + 1 + name.size());
+    prefix += tenant;
+    prefix += kind;
+    prefix += name;
+    return prefix;
+}
+
+std::string PagedStore::chunkKey(const std::string& prefix, std::size_t chunk) {
+    std::string key = prefix;
+    key += '\0';
+    key += static_cast<char>((chunk >> 8) & 0xff);
+    key += static_cast<char>(chunk & 0xff);
+    return key;
+}
+
+// Record = suite byte | sealed section of (prefix | plain); the prefix inside
+// the ciphertext pins the record to the key it was written under
+bool PagedStore::seal(const std::string& prefix, std::string_view plain, const std::vector<unsigned char>& key,
+    std::string& out) {
+    SecureString record(secureResource());
+    record.reserve(prefix.size() + plain.size());
+    record += prefix;
+    record += plain;
+
+    CipherSuite suite = preferredCipherSuite();
+    out.assign(1, static_cast<char>(suite));
+    return sealSection(record, key, out, suite);
+}
+
+bool PagedStore::unseal(const std::string& prefix, std::string_view sealed, const std::vector<unsigned char>& key,
+    SecureString& plain) {
+    CipherSuite suite;
+    if (sealed.empty() || !cipherSuiteFromByte(static_cast<std::uint8_t>(sealed[0]), suite)) return false;
+
+    ViewStream in(sealed.substr(1));
+    if (!openSection(in, key, plain, suite)) return false;
+    if (plain.compare(0, prefix.size(), prefix) != 0) {
+        spdlog::error("Record does not belong under its key");
+        return false;
+    }
+    plain.erase(0, prefix.size());
+    return true;
+}
+
+bool PagedStore::readChunks(const std::string& prefix, SecureString& sealed, bool& found) {
+    sealed.clear();
+    found = false;
+    std::string first = chunkKey(prefix, 0);
+    std::size_t next = 0;
+    bool ok = tree->scan(first, [&](const std::string& k, const std::string& v) {
+        if (k.size() != prefix.size() + CHUNK_SUFFIX || k.compare(0, prefix.size() + 1, first, 0, prefix.size() + 1) != 0)
+            return false;
+        if (k != chunkKey(prefix, next)) return false;
+        sealed += v;
+        ++next;
+        return true;
+    });
+    found = next > 0;
+    return ok;
+}
+
+bool PagedStore::eraseChunks(const std::string& prefix, std::size_t from) {
+    std::vector<std::string> stale;
+    std::string first = chunkKey(prefix, from);
+    bool ok = tree->scan(first, [&](const std::string& k, const std::string&) {
+        if (k.size() != prefix.size() + CHUNK_SUFFIX || k.compare(0, prefix.size() + 1, first, 0, prefix.size() + 1) != 0)
+            return false;
+        stale.push_back(k);
+        return true;
+    });
+
+    for (const auto& k : stale) {
+        bool erased = false;
+        ok = tree->erase(k, erased) && ok;
+    }
+    return ok;
+}
+
+bool PagedStore::put(const std::string& tenant, char kind, const std::string& name, std::string_view plain,
+    const std::vector<unsigned char>& key) {
+    auto guard = transaction();
+    if (!tree) return false;
+    std::string prefix = prefixOf(tenant, kind, name);
+    if (name.find('\0') != std::string::npos || prefix.size() + CHUNK_SUFFIX > BTree::MAX_KEY) {
+        spdlog::error("Record name '{}' cannot be stored", name);
+        return false;
+    }
+
+    std::string sealed;
+    if (!seal(prefix, plain, key, sealed)) return false;
+    return putSealed(prefix, name, sealed);
+}
+
+bool PagedStore::putSealed(const std::string& prefix, const std::string& name, const std::string& sealed) {
+    std::size_t chunks = (sealed.size() + BTree::MAX_VALUE - 1) / BTree::MAX_VALUE;
+    if (chunks > 0xffff) {
+        spdlog::error("Record '{}' is too large ({} bytes sealed)", name, sealed.size());
+        return false;
+    }
+    for (std::size_t c = 0; c < chunks; ++c) {
+        if (!tree->put(chunkKey(prefix, c), sealed.substr(c * BTree::MAX_VALUE, BTree::MAX_VALUE))) return false;
+    }
+    return eraseChunks(prefix, chunks);
+}
+
+bool PagedStore::get(const std::string& tenant, char kind, const std::string& name, const std::vector<unsigned char>& key,
+    SecureString& plain, bool& found) {
+    auto guard = transaction();
+    found = false;
+    if (!tree) return false;
+
+    std::string prefix = prefixOf(tenant, kind, name);
+    SecureString sealed(secureResource());
+    if (!readChunks(prefix, sealed, found)) return false;
+    if (!found) return true;
+    return unseal(prefix, sealed, key, plain);
+}
+
+bool PagedStore::erase(const std::string& tenant, char kind, const std::string& name) {
+    auto guard = transaction();
+    if (!tree) return false;
+    return eraseChunks(prefixOf(tenant, kind, name), 0);
+}
+
+bool PagedStore::scan(const std::string& tenant, char kind, const std::vector<unsigned char>& key, const Visitor& visit) {
+    auto guard = transaction();
+    if (!tree) return false;
+
+    const std::string range = prefixOf(tenant, kind, "");
+    std::string name;
+    SecureString sealed(secureResource()), plain(secureResource());
+    bool pending = false, ok = true;
+
+    // Chunks of one record are adjacent; a record is handed out when the next one starts
+    auto flush = [&]() {
+        if (!pending) return true;
+        pending = false;
+        if (!unseal(range + name, sealed, key, plain)) {
+            ok = false;
+            return false;
+        }
+        return visit(name, plain);
+    };
+
+    bool walked = tree->scan(range, [&](const std::string& k, const std::string& v) {
+        if (k.compare(0, range.size(), range) != 0 || k.size() < range.size() + CHUNK_SUFFIX) return false;
+        std::string n = k.substr(range.size(), k.size() - range.size() - CHUNK_SUFFIX);
+        if (!pending || n != name) {
+            if (!flush()) return false;
+            name = std::move(n);
+            sealed.clear();
+            pending = true;
+        }
+        sealed += v;
+        return true;
+    });
+    if (walked && ok) flush();
+    return walked && ok;
+}
+
+bool PagedStore::hasTenant(const std::string& tenant) {
+    auto guard = transaction();
+    if (!tree) return false;
+    bool any = false;
+    tree->scan(tenant, [&](const std::string& k, const std::string&) {
+        any = k.compare(0, tenant.size(), tenant) == 0;
+        return false;
+    });
+    return any;
+}
+
+std::size_t PagedStore::recordCount(const std::string& tenant) {
+    auto guard = transaction();
+    if (!tree) return 0;
+    std::size_t count = 0;
+    tree->scan(tenant, [&](const std::string& k, const std::string&) {
+        if (k.compare(0, tenant.size(), tenant) != 0) return false;
+        // One first chunk per record
+        if (k.size() >= tenant.size() + 1 + CHUNK_SUFFIX && k.compare(k.size() - CHUNK_SUFFIX, CHUNK_SUFFIX,
+            std::string(CHUNK_SUFFIX, '\0')) == 0)
+            ++count;
+        return true;
+    });
+    return count;
+}
+
+bool PagedStore::copyTenant(const std::string& from, const std::vector<unsigned char>& fromKey, const std::string& to,
+    const std::vector<unsigned char>& toKey, const Transform& transform, const Progress& progress, std::size_t batch) {
+    if (from.size() != TENANT_BYTES || to.size() != TENANT_BYTES || from == to) {
+        spdlog::error("Invalid tenants for a copy");
+        return false;
+    }
+    if (batch == 0) batch = COPY_BATCH;
+
+    struct Record {
+        char kind;
+        std::string name;
+        SecureString sealed;
+    };
+
+    std::string resume = from;
+    std::size_t copied = 0;
+    bool more = true;
+    while (more) {
+        // Read a batch of whole records under the lock...
+        std::vector<Record> records;
+        more = false;
+        {
+            auto guard = transaction();
+            if (!tree) return false;
+            bool ok = tree->scan(resume, [&](const std::string& k, const std::string& v) {
+                if (k.compare(0, from.size(), from) != 0 || k.size() < from.size() + 1 + CHUNK_SUFFIX) return false;
+                char kind = k[from.size()];
+                std::string name = k.substr(from.size() + 1, k.size() - from.size() - 1 - CHUNK_SUFFIX);
+                if (records.empty() || records.back().kind != kind || records.back().name != name) {
+                    if (records.size() == batch) {
+                        resume = k;
+                        more = true;
+                        return false;
+                    }
+                    records.push_back(Record{ kind, std::move(name), SecureString(secureResource()) });
+                }
+                records.back().sealed += v;
+                return true;
+            });
+            if (!ok) return false;
+        }
+
+        // ...re-seal them without it...
+        std::vector<std::string> resealed(records.size());
+        SecureString plain(secureResource());
+        for (std::size_t i = 0; i < records.size(); ++i) {
+            const Record& r = records[i];
+            if (!unseal(prefixOf(from, r.kind, r.name), r.sealed, fromKey, plain)) {
+                spdlog::error("Cannot read record '{}' to copy it", r.name);
+                return false;
+            }
+            if (transform && !transform(r.kind, r.name, plain)) return false;
+            if (!seal(prefixOf(to, r.kind, r.name), plain, toKey, resealed[i])) return false;
+        }
+
+        // ...and write them as one commit
+        {
+            auto guard = transaction();
+            if (!tree) return false;
+            for (std::size_t i = 0; i < records.size(); ++i) {
+                if (!putSealed(prefixOf(to, records[i].kind, records[i].name), records[i].name, resealed[i])) {
+                    pool->rollback();
+                    return false;
+                }
+            }
+            if (!commit()) return false;
+        }
+        copied += records.size();
+        if (progress && !records.empty()) progress(copied);
+    }
+    return true;
+}
+
+bool PagedStore::eraseTenant(const std::string& tenant, std::size_t batch) {
+    if (tenant.size() != TENANT_BYTES) return false;
+    if (batch == 0) batch = COPY_BATCH;
+
+    while (true) {
+        auto guard = transaction();
+        if (!tree) return false;
+        std::vector<std::string> keys;
+        bool ok = tree->scan(tenant, [&](const std::string& k, const std::string&) {
+            if (k.compare(0, tenant.size(), tenant) != 0 || keys.size() == batch) return false;
+            keys.push_back(k);
+            return true;
+        });
+        if (!ok) return false;
+        if (keys.empty()) return true;
+
+        for (const auto& k : keys) {
+            bool erased = false;
+            if (!tree->erase(k, erased)) {
+                pool->rollback();
+                return false;
+            }
+        }
+        if (!commit()) return false;
+    }
+}
+
+bool PagedStore::commit() {
+    auto guard = transaction();
+    if (!pool) return false;
+    if (pool->stats().dirty == 0) return true;
+    if (pool->commit()) return true;
+    pool->rollback();
+    return false;
+}
+
+void PagedStore::rollback() {
+    auto guard = transaction();
+    if (pool) pool->rollback();
+}
+
+PagedStore::Stats PagedStore::stats() const {
+    auto guard = transaction();
+    Stats s;
+    if (!tree) return s;
+    s.pages = file.pageCount();
+    s.height = tree->height();
+    s.cache = pool->stats();
+    return s;
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "BTree.hpp"
+#include "BufferPool.hpp"
+#include "PageFile.hpp"
+#include "SecureBufferPool.hpp"
+
+// One file holding the records of every user: a B+tree over sealed pages
+// (PageFile) behind an LRU page cache (BufferPool).
+//
+// Records are keyed by (tenant, kind, name). The tenant is a keyed hash of the
+// username, and a user's records sit next to each other: listing one deck is
+// a range scan however many users share the file. Each record is sealed with
+// the owner's session key before it goes into a page, together with its own
+// key, so tenants cannot read or swap each other's records even though pages
+// are shared. Records larger than a tree value are stored as numbered chunks.
+// Plaintext passes through SecureBufferPool buffers only.
+//
+// That per-record sealing is the only thing keeping a user's data secret.
+// Pages and tenant hashes are keyed from a volume key kept in "<path>.key",
+// created with the store and stored beside it in the clear, so whoever copies
+// the directory can open every page: page sealing is an integrity check
+// against corruption and misplaced pages, not encryption. Such a copy shows
+// the record keys (record names, i.e. item IDs, which begin with their
+// creation time), record sizes and counts, and a guessed username can be
+// matched to its tenant hash.
+//
+// Changes are staged in the cache and made durable by commit(); until
+// then they can be dropped with rollback(). Calls are serialized internally;
+// hold transaction() across several calls to keep them together. Only one
+// process has the store open at a time (see PageFile).
+class PagedStore {
+public:
+    static constexpr std::size_t TENANT_BYTES = 16;
+    static constexpr std::size_t COPY_BATCH = 256; // records per commit when copying a tenant
+
+    // Called in name order; return false to stop. plain is only valid during the call.
+    using Visitor = std::function<bool(const std::string& name, std::string_view plain)>;
+    // May rewrite a record's plaintext while a tenant is copied
+    using Transform = std::function<bool(char kind, const std::string& name, SecureString& plain)>;
+    // Records copied so far
+    using Progress = std::function<void(std::size_t records)>;
+
+    struct Stats {
+        std::size_t pages = 0;
+        int height = 0;
+        BufferPool::Stats cache;
+    };
+
+    PagedStore() = default;
+    PagedStore(const PagedStore&) = delete;
+    PagedStore& operator=(const PagedStore&) = delete;
+    ~PagedStore();
+
+    bool open(const std::string& path, std::size_t cachePages = BufferPool::DEFAULT_CAPACITY);
+    bool isOpen() const;
+    void close();
+
+    std::unique_lock<std::recursive_mutex> transaction() const { return std::unique_lock<std::recursive_mutex>(lock); }
+
+    // Each key generation of a user is a separate tenant, so data re-encrypted
+    // under a new key never overwrites what the current key still reads
+    std::string tenantOf(const std::string& username, std::uint32_t generation = 0) const;
+
+    bool put(const std::string& tenant, char kind, const std::string& name, std::string_view plain,
+        const std::vector<unsigned char>& key);
+    // found is false (and the call succeeds) when there is no such record
+    bool get(const std::string& tenant, char kind, const std::string& name, const std::vector<unsigned char>& key,
+        SecureString& plain, bool& found);
+    bool erase(const std::string& tenant, char kind, const std::string& name);
+    // Every record of one kind for a tenant
+    bool scan(const std::string& tenant, char kind, const std::vector<unsigned char>& key, const Visitor& visit);
+    // Whether the tenant has any record at all
+    bool hasTenant(const std::string& tenant);
+    std::size_t recordCount(const std::string& tenant);
+
+    // Re-seal every record of one tenant under another tenant and key,
+    // committing every `batch` records so memory stays bounded however large
+    // the deck. Records are decrypted and re-encrypted outside the store's
+    // lock, so copies for different users run in parallel. The target should
+    // start empty; the source is left as it was.
+    bool copyTenant(const std::string& from, const std::vector<unsigned char>& fromKey, const std::string& to,
+        const std::vector<unsigned char>& toKey, const Transform& transform = nullptr,
+        const Progress& progress = nullptr, std::size_t batch = COPY_BATCH);
+    // Erase every record of a tenant, committing every `batch` records
+    bool eraseTenant(const std::string& tenant, std::size_t batch = COPY_BATCH);
+
+    bool commit();
+    void rollback();
+
+    Stats stats() const;
+
+private:
+    mutable std::recursive_mutex lock;
+    PageFile file;
+    std::unique_ptr<BufferPool> pool;
+    std::unique_ptr<BTree> tree;
+    std::vector<unsigned char> tenantKey;
+
+    static std::string prefixOf(const std::string& tenant, char kind, const std::string& name);
+    static std::string chunkKey(const std::string& prefix, std::size_t chunk);
+    bool readChunks(const std::string& prefix, SecureString& sealed, bool& found);
+    bool eraseChunks(const std::string& prefix, std::size_t from);
+    bool putSealed(const std::string& prefix, const std::string& name, const std::string& sealed);
+    static bool seal(const std::string& prefix, std::string_view plain, const std::vector<unsigned char>& key,
+        std::string& out);
+    static bool unseal(const std::string& prefix, std::string_view sealed, const std::vector<unsigned char>& key,
+        SecureString& plain);
+};
@@ -0,0 +1,187 @@
+#include "ReviewJournal.hpp"
+#include "SealedSection.hpp"
+#include "../core/ViewStream.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <sodium.h>
+#include <spdlog/spdlog.h>
+
+static const char JOURNAL_HDR[] = "SRJRNL1\n";
+static constexpr std::size_t HDR_LEN = sizeof(JOURNAL_HDR) - 1;
+
+ReviewJournal::~ReviewJournal() {
+    close();
+}
+
+void ReviewJournal::close() {
+    if (!key.empty()) {
+        sodium_memzero(key.data(), key.size());
+        key.clear();
+    }
+    path.clear();
+}
+
+bool ReviewJournal::open(const std::string& filename, const std::vector<unsigned char>& k) {
+    close();
+    if (k.size() != crypto_secretbox_KEYBYTES) {
+        spdlog::error("Invalid key size");
+        return false;
+    }
+    path = filename;
+    key = k;
+    return true;
+}
+
+bool ReviewJournal::append(const std::vector<ReviewEvent>& events) {
+    if (path.empty()) {
+        spdlog::error("Review journal is not open");
+        return false;
+    }
+    if (events.empty()) return true;
+
+    std::ostringstream oss;
+    for (const auto& ev : events)
+        oss << ev.itemId << " " << static_cast<int>(ev.quality) << " " << ev.timestamp << "\n";
+
+    std::string section;
+    if (!sealSection(oss.str(), key, section)) return false;
+
+    std::ofstream out(path, std::ios::binary | std::ios::app);
+    if (!out) {
+        spdlog::error("Failed to open '{}' for journal append", path);
+        return false;
+    }
+    out.seekp(0, std::ios::end);
+    if (out.tellp() == std::streampos(0)) out.write(JOURNAL_HDR, HDR_LEN);
+    out.write(section.data(), static_cast<std::streamsize>(section.size()));
+    out.flush();
+    return static_cast<bool>(out);
+}
+
+bool ReviewJournal::readFile(const std::string& file, std::vector<ReviewEvent>& events) const {
+    std::ifstream in(file, std::ios::binary);
+    if (!in) return true; // nothing journaled
+
+    char hdr[HDR_LEN];
+    in.read(hdr, sizeof(hdr));
+    if (in.gcount() == 0) return true;
+    if (in.gcount() != sizeof(hdr) || std::strncmp(hdr, JOURNAL_HDR, sizeof(hdr)) != 0) {
+        spdlog::error("Invalid journal header in '{}'", file);
+        return false;
+    }
+
+    while (in.peek() != std::char_traits<char>::eof()) {
+        SecureString plain(secureResource());
+        if (!openSection(in, key, plain)) {
+            // A crash mid-append leaves a torn last section; everything before it is intact
+            spdlog::warn("Ignoring unreadable tail of journal '{}'", file);
+            break;
+        }
+
+        ViewStream iss(plain);
+        ReviewEvent ev;
+        int q = 0;
+        while (iss >> ev.itemId >> q >> ev.timestamp) {
+            if (q < 0 || q >= static_cast<int>(REVIEW_QUALITY_COUNT)) continue;
+            ev.quality = static_cast<ReviewQuality>(q);
+            events.push_back(ev);
+        }
+    }
+    return true;
+}
+
+bool ReviewJournal::readAll(std::vector<ReviewEvent>& events) const {
+    events.clear();
+    if (path.empty()) return false;
+    return readFile(checkpointPath(), events) && readFile(path, events);
+}
+
+bool ReviewJournal::beginCheckpoint() {
+    if (path.empty()) return false;
+
+    std::ifstream cur(path, std::ios::binary);
+    if (!cur) return true; // nothing since the last save
+
+    std::ifstream prev(checkpointPath(), std::ios::binary);
+    if (!prev) {
+        cur.close();
+        if (std::rename(path.c_str(), checkpointPath().c_str()) != 0) {
+            spdlog::error("Failed to checkpoint journal '{}'", path);
+            return false;
+        }
+        return true;
+    }
+    prev.close();
+
+    // An earlier save failed and its entries are still set aside; keep them in order
+    cur.seekg(static_cast<std::streamoff>(HDR_LEN));
+    std::string rest((std::istreambuf_iterator<char>(cur)), std::istreambuf_iterator<char>());
+    cur.close();
+
+    std::ofstream out(checkpointPath(), std::ios::binary | std::ios::app);
+    out.write(rest.data(), static_cast<std::streamsize>(rest.size()));
+    if (!out) {
+        spdlog::error("Failed to checkpoint journal '{}'", path);
+        return false;
+    }
+    out.close();
+    std::remove(path.c_str());
+    return true;
+}
+
+void ReviewJournal::endCheckpoint(bool saved) {
+    if (path.empty() || !saved) return;
+    std::remove(checkpointPath().c_str());
+}
+
+bool ReviewJournal::rekeyFile(const std::string& from, const std::vector<unsigned char>& fromKey, const std::string& to,
+    const std::vector<unsigned char>& toKey) {
+    std::ifstream in(from, std::ios::binary);
+    if (!in) return true; // nothing journaled
+
+    char hdr[HDR_LEN];
+    in.read(hdr, sizeof(hdr));
+    if (in.gcount() == 0) return true;
+    if (in.gcount() != sizeof(hdr) || std::strncmp(hdr, JOURNAL_HDR, sizeof(hdr)) != 0) {
+        spdlog::error("Invalid journal header in '{}'", from);
+        return false;
+    }
+
+    std::string tmp = to + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out.write(JOURNAL_HDR, HDR_LEN);
+
+        SecureString plain(secureResource());
+        std::string section;
+        while (out && in.peek() != std::char_traits<char>::eof()) {
+            // A torn tail is unreadable for replay too; it is dropped here as well
+            if (!openSection(in, fromKey, plain)) break;
+            section.clear();
+            if (!sealSection(plain, toKey, section)) return false;
+            out.write(section.data(), static_cast<std::streamsize>(section.size()));
+        }
+        if (!out.flush()) {
+            spdlog::error("Failed to write journal '{}'", tmp);
+            return false;
+        }
+    }
+
+    if (std::rename(tmp.c_str(), to.c_str()) != 0) {
+        spdlog::error("Failed to replace journal '{}'", to);
+        return false;
+    }
+    return true;
+}
+
+bool ReviewJournal::rekey(const std::string& from, const std::vector<unsigned char>& fromKey, const std::string& to,
+    const std::vector<unsigned char>& toKey) {
+    return rekeyFile(checkpointOf(from), fromKey, checkpointOf(to), toKey) && rekeyFile(from, fromKey, to, toKey);
+}
+
+void ReviewJournal::remove(const std::string& filename) {
+    std::remove(checkpointOf(filename).c_str());
+    std::remove(filename.c_str());
+}
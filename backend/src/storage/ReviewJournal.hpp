@@ -0,0 +1,49 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "../core/ReviewPipeline.hpp"
+
+// Append-only encrypted log of reviews applied since the last full save
+// ("SRJRNL1" header, then one sealed section per appended batch). Replaying it
+// on top of the saved deck restores reviews made after that save.
+//
+// A save first moves the current entries aside (beginCheckpoint) while the
+// deck snapshot is taken, so reviews applied during a background save land
+// in a fresh journal; endCheckpoint drops the moved entries once the save
+// has succeeded, or keeps them for replay if it failed.
+class ReviewJournal {
+public:
+    ReviewJournal() = default;
+    ReviewJournal(const ReviewJournal&) = delete;
+    ReviewJournal& operator=(const ReviewJournal&) = delete;
+    ~ReviewJournal();
+
+    bool open(const std::string& filename, const std::vector<unsigned char>& key);
+    void close();
+
+    bool append(const std::vector<ReviewEvent>& events);
+
+    // Every journaled event, oldest first (checkpointed entries included)
+    bool readAll(std::vector<ReviewEvent>& events) const;
+
+    bool beginCheckpoint();
+    void endCheckpoint(bool saved);
+
+    // Re-encrypt a journal (and any entries set aside by a checkpoint) under
+    // a new path and key, one section at a time; each file appears whole or
+    // not at all. The old files are left in place.
+    static bool rekey(const std::string& from, const std::vector<unsigned char>& fromKey, const std::string& to,
+        const std::vector<unsigned char>& toKey);
+    // Delete a journal and its checkpoint
+    static void remove(const std::string& filename);
+
+private:
+    std::string path;
+    std::vector<unsigned char> key;
+
+    static std::string checkpointOf(const std::string& file) { return file + ".saving"; }
+    std::string checkpointPath() const { return checkpointOf(path); }
+    static bool rekeyFile(const std::string& from, const std::vector<unsigned char>& fromKey, const std::string& to,
+        const std::vector<unsigned char>& toKey);
+    bool readFile(const std::string& file, std::vector<ReviewEvent>& events) const;
+};
@@ -0,0 +1,68 @@
+#include "SealedSection.hpp"
+#include <cstdint>
+#include <sodium.h>
+#include <spdlog/spdlog.h>
+
+std::size_t sealedSectionPrefix(CipherSuite suite) {
+    return cipherNonceBytes(suite) + 8;
+}
+
+bool sealSection(std::string_view plain, const std::vector<unsigned char>& key, std::string& out,
+    CipherSuite suite) {
+    std::size_t nonceLen = cipherNonceBytes(suite);
+    std::size_t clen = plain.size() + cipherTagBytes(suite);
+
+    // Encrypt straight into out: nonce | length | ciphertext
+    std::size_t start = out.size();
+    out.resize(start + nonceLen + 8 + clen);
+    auto* frame = reinterpret_cast<unsigned char*>(&out[start]);
+
+    randombytes_buf(frame, nonceLen);
+    for (int i = 0; i < 8; ++i) frame[nonceLen + i] = static_cast<unsigned char>(static_cast<std::uint64_t>(clen) >> (8 * i));
+
+    if (!cipherSeal(suite, frame + nonceLen + 8,
+        reinterpret_cast<const unsigned char*>(plain.data()), plain.size(), frame, key))
+    {
+        out.resize(start);
+        spdlog::error("Encryption failed");
+        return false;
+    }
+    return true;
+}
+
+static bool readSectionPrefix(std::istream& in, CipherSuite suite, unsigned char* nonce, std::uint64_t& clen) {
+    in.read(reinterpret_cast<char*>(nonce), static_cast<std::streamsize>(cipherNonceBytes(suite)));
+    unsigned char len[8];
+    in.read(reinterpret_cast<char*>(len), sizeof(len));
+    if (!in) return false;
+
+    clen = 0;
+    for (int i = 0; i < 8; ++i) clen |= static_cast<std::uint64_t>(len[i]) << (8 * i);
+    return clen >= cipherTagBytes(suite);
+}
+
+static_assert(crypto_secretbox_NONCEBYTES >= crypto_aead_xchacha20poly1305_ietf_NPUBBYTES
+    && crypto_secretbox_NONCEBYTES >= crypto_aead_aes256gcm_NPUBBYTES, "nonce buffer must fit every suite");
+
+bool openSection(std::istream& in, const std::vector<unsigned char>& key, SecureString& plain, CipherSuite suite) {
+    unsigned char nonce[crypto_secretbox_NONCEBYTES];
+    std::uint64_t clen = 0;
+    if (!readSectionPrefix(in, suite, nonce, clen)) {
+        spdlog::error("Truncated section header");
+        return false;
+    }
+
+    SecureBytes ciphertext(clen, secureResource());
+    in.read(reinterpret_cast<char*>(ciphertext.data()), static_cast<std::streamsize>(clen));
+    if (static_cast<std::uint64_t>(in.gcount()) != clen) {
+        spdlog::error("Truncated section");
+        return false;
+    }
+
+    plain.resize(clen - cipherTagBytes(suite));
+    if (!cipherOpen(suite, reinterpret_cast<unsigned char*>(&plain[0]), ciphertext.data(), clen, nonce, key)) {
+        spdlog::error("Decryption failed");
+        return false;
+    }
+    return true;
+}
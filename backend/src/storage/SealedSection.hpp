@@ -0,0 +1,26 @@
+#pragma once
+#include <cstddef>
+#include <istream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "CipherSuite.hpp"
+#include "SecureBufferPool.hpp"
+
+// Self-delimiting encrypted section used by the multi-section file formats:
+// nonce | u64 little-endian ciphertext length | ciphertext
+// The suite is not stored per section; files record it once in their header.
+// Nonces are random, which for AES-256-GCM's 96-bit nonce stays safe for far
+// more sections than one key will ever seal here.
+
+// Bytes in front of the ciphertext
+std::size_t sealedSectionPrefix(CipherSuite suite = CipherSuite::XSalsa20Poly1305);
+
+// Encrypt plain with key and append the framed section to out
+bool sealSection(std::string_view plain, const std::vector<unsigned char>& key, std::string& out,
+    CipherSuite suite = CipherSuite::XSalsa20Poly1305);
+
+// Read and decrypt the section at the stream's position; plain should come
+// from secureResource() and is only valid if this succeeds
+bool openSection(std::istream& in, const std::vector<unsigned char>& key, SecureString& plain,
+    CipherSuite suite = CipherSuite::XSalsa20Poly1305);
@@ -0,0 +1,91 @@
+#include "SecureBufferPool.hpp"
+#include "../core/MemoryAccount.hpp"
+#include <new>
+#include <sodium.h>
+
+SecureBufferPool::SecureBufferPool(std::size_t limit) : idleLimit(limit) {
+    std::size_t classes = 0;
+    while ((MIN_BLOCK << classes) <= MAX_POOLED) ++classes;
+    idleBlocks.resize(classes);
+}
+
+SecureBufferPool::~SecureBufferPool() {
+    trim();
+}
+
+SecureBufferPool& SecureBufferPool::shared() {
+    // Never destroyed: buffers released during static destruction still reach it
+    static auto* pool = new SecureBufferPool();
+    return *pool;
+}
+
+std::size_t SecureBufferPool::classOf(std::size_t bytes) {
+    std::size_t c = 0;
+    while ((MIN_BLOCK << c) < bytes) ++c;
+    return c;
+}
+
+SecureBufferPool::Stats SecureBufferPool::stats() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return counts;
+}
+
+void SecureBufferPool::trim() {
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto& blocks : idleBlocks) {
+        for (void* p : blocks) sodium_free(p);
+        blocks.clear();
+    }
+    counts.idle = 0;
+}
+
+// sodium_malloc puts a block against the guard page after it, so its address
+// is only as aligned as its size; power-of-two sizes of at least MIN_BLOCK
+// cover any alignment a container asks for
+void* SecureBufferPool::do_allocate(std::size_t bytes, std::size_t align) {
+    std::size_t c = classOf(bytes < align ? align : bytes);
+    std::size_t size = MIN_BLOCK << c;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        counts.inUse += size;
+        if (c < idleBlocks.size() && !idleBlocks[c].empty()) {
+            void* p = idleBlocks[c].back();
+            idleBlocks[c].pop_back();
+            counts.idle -= size;
+            ++counts.reuses;
+            return p;
+        }
+        ++counts.allocations;
+    }
+
+    void* p = sodium_malloc(size);
+    if (!p) {
+        std::lock_guard<std::mutex> guard(lock);
+        counts.inUse -= size;
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void SecureBufferPool::do_deallocate(void* p, std::size_t bytes, std::size_t align) {
+    std::size_t c = classOf(bytes < align ? align : bytes);
+    std::size_t size = MIN_BLOCK << c;
+    // Only the bytes handed out can have been written
+    sodium_memzero(p, bytes);
+
+    std::unique_lock<std::mutex> guard(lock);
+    counts.inUse -= size;
+    if (c < idleBlocks.size() && counts.idle + size <= idleLimit) {
+        idleBlocks[c].push_back(p);
+        counts.idle += size;
+        return;
+    }
+    guard.unlock();
+    sodium_free(p);
+}
+
+std::pmr::memory_resource* secureResource() {
+    static auto* resource = new TrackingResource(MemoryAccount::process(), MemoryCategory::Crypto,
+        &SecureBufferPool::shared());
+    return resource;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <memory_resource>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Memory for ciphertext and decrypted plaintext on the load and save paths.
+//
+// Blocks come from sodium_malloc, so each sits between guard pages and is
+// mlocked to keep it out of swap, and every block is wiped with
+// sodium_memzero when it is released. Block sizes are powers of two, so a
+// buffer that keeps growing does so geometrically, and released blocks are
+// kept by size and handed out again: loading or saving a deck reuses the
+// previous call's buffers instead of mapping new ones. Idle blocks beyond
+// `idleLimit` bytes, and blocks too large to be worth keeping, are freed.
+// Thread-safe.
+class SecureBufferPool : public std::pmr::memory_resource {
+public:
+    static constexpr std::size_t MIN_BLOCK = 256;
+    static constexpr std::size_t MAX_POOLED = std::size_t(64) << 20;
+    static constexpr std::size_t DEFAULT_IDLE_LIMIT = std::size_t(32) << 20;
+
+    struct Stats {
+        std::size_t allocations = 0; // blocks mapped with sodium_malloc
+        std::size_t reuses = 0;      // requests served from an idle block
+        std::size_t inUse = 0;       // bytes in blocks handed out
+        std::size_t idle = 0;        // bytes in blocks waiting for reuse
+    };
+
+    explicit SecureBufferPool(std::size_t idleLimit = DEFAULT_IDLE_LIMIT);
+    SecureBufferPool(const SecureBufferPool&) = delete;
+    SecureBufferPool& operator=(const SecureBufferPool&) = delete;
+    ~SecureBufferPool() override;
+
+    // Process-wide pool, alive for the whole program
+    static SecureBufferPool& shared();
+
+    Stats stats() const;
+    // Free every idle block
+    void trim();
+
+private:
+    mutable std::mutex lock;
+    std::size_t idleLimit;
+    std::vector<std::vector<void*>> idleBlocks; // by size class: MIN_BLOCK << i
+    Stats counts;
+
+    static std::size_t classOf(std::size_t bytes);
+
+    void* do_allocate(std::size_t bytes, std::size_t align) override;
+    void do_deallocate(void* p, std::size_t bytes, std::size_t align) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
+
+// The shared pool, charged to MemoryCategory::Crypto
+std::pmr::memory_resource* secureResource();
+
+// Buffers for secrets; construct them with secureResource()
+using SecureString = std::pmr::string;
+using SecureBytes = std::pmr::vector<unsigned char>;
@@ -1,26 +1,110 @@
 #include "Storage.hpp"
+#include "DeckFile.hpp"
+#include "SealedSection.hpp"
+#include "../core/ViewStream.hpp"
+#include <filesystem>
 #include <fstream>
 #include <sstream>
 #include <cstring>
 #include <sodium.h>
+#include "../core/SchedulingPolicy.hpp"
 #include <spdlog/spdlog.h>
 
 static const char MAGIC_HDR[] = "SRDATA1\n";
+static const char ITEMS_HDR_V2[] = "SRDATA2\n"; // items with IDs and scheduler state
+static_assert(sizeof(MAGIC_HDR) == sizeof(ITEMS_HDR_V2), "item headers must share a length");
+static const char SEALED_HDR[] = "SRSEAL1\n"; // single-section file: cipher suite byte, then one sealed section
+static_assert(sizeof(MAGIC_HDR) == sizeof(SEALED_HDR), "file headers must share a length");
+
+// Pre-suite layout after the header: nonce, then secretbox ciphertext up to EOF
+static bool openLegacyBody(std::istream& in, const std::vector<unsigned char>& key, SecureString& plain) {
+    unsigned char nonce[crypto_secretbox_NONCEBYTES];
+    in.read(reinterpret_cast<char*>(nonce), sizeof(nonce));
+    if (in.gcount() != sizeof(nonce)) {
+        spdlog::error("Failed to read nonce");
+        return false;
+    }
+
+    SecureBytes ciphertext(
+        (std::istreambuf_iterator<char>(in)),
+        std::istreambuf_iterator<char>(), secureResource());
+
+    if (ciphertext.size() < crypto_secretbox_MACBYTES) {
+        spdlog::error("Ciphertext too short");
+        return false;
+    }
+
+    plain.resize(ciphertext.size() - crypto_secretbox_MACBYTES);
+    if (!cipherOpen(CipherSuite::XSalsa20Poly1305, reinterpret_cast<unsigned char*>(&plain[0]),
+        ciphertext.data(), ciphertext.size(), nonce, key))
+    {
+        spdlog::error("Decryption failed");
+        return false;
+    }
+    return true;
+}
+
+// Reads either layout; found is false (and the call succeeds) when there is no file yet
+static bool readSealedFile(SecureString& plain, const std::string& filename,
+    const std::vector<unsigned char>& key, const char* what, bool& found) {
+    found = false;
+    if (key.size() != crypto_secretbox_KEYBYTES) {
+        spdlog::error("Invalid key size");
+        return false;
+    }
+
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) return true;
+    found = true;
+
+    char hdr[sizeof(SEALED_HDR) - 1];
+    in.read(hdr, sizeof(hdr));
+    if (in.gcount() == sizeof(hdr) && std::strncmp(hdr, MAGIC_HDR, sizeof(hdr)) == 0)
+        return openLegacyBody(in, key, plain);
+
+    if (in.gcount() != sizeof(hdr) || std::strncmp(hdr, SEALED_HDR, sizeof(hdr)) != 0) {
+        spdlog::error("Invalid {} header", what);
+        return false;
+    }
+
+    char id = 0;
+    CipherSuite suite;
+    if (!in.get(id) || !cipherSuiteFromByte(static_cast<std::uint8_t>(id), suite)) return false;
+    return openSection(in, key, plain, suite);
+}
 
 bool Storage::saveUsers(const std::vector<User>& users, const std::string& filename) {
     spdlog::info("Saving {} users to '{}'", users.size(), filename);
-    std::ofstream out(filename, std::ios::trunc);
-    if (!out) {
-        spdlog::error("Failed to open '{}' for writing user data", filename);
-        return false;
+
+    // Replaced in one rename: a key change takes effect exactly when its user record does
+    std::string tmp = filename + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        if (!out) {
+            spdlog::error("Failed to open '{}' for writing user data", tmp);
+            return false;
+        }
+
+        for (const auto& u : users) {
+            out << u.username << "\n"
+                << u.password_hash << "\n"
+                << u.enc_salt << "\n"
+                << u.created_at << "\n"
+                << "kdf:" << u.key_cost.opslimit << " " << u.key_cost.memlimit << "\n"
+                << "gen:" << u.key_generation << "\n"
+                << "---\n";
+        }
+        if (!out.flush()) {
+            spdlog::error("Failed to write user data to '{}'", tmp);
+            return false;
+        }
     }
 
-    for (const auto& u : users) {
-        out << u.username << "\n"
-            << u.password_hash << "\n"
-            << u.enc_salt << "\n"
-            << u.created_at << "\n"
-            << "---\n";
+    std::error_code ec;
+    std::filesystem::rename(tmp, filename, ec);
+    if (ec) {
+        spdlog::error("Failed to replace '{}': {}", filename, ec.message());
+        return false;
     }
     return true;
 }
@@ -42,9 +126,20 @@ bool Storage::loadUsers(std::vector<User>& users, const std::string& filename) {
         if (!std::getline(in, u.enc_salt)) break;
         if (!(in >> u.created_at)) break;
 
-        std::string sep;
-        std::getline(in, sep);
-        std::getline(in, sep);
+        // Optional "key:value" lines up to the separator; users saved before
+        // one was written keep its default (interactive cost, generation 0)
+        std::string line;
+        std::getline(in, line);
+        while (std::getline(in, line) && line != "---") {
+            std::istringstream kss(line.substr(line.find(':') + 1));
+            if (line.compare(0, 4, "kdf:") == 0) {
+                PasswordPolicy cost;
+                if (kss >> cost.opslimit >> cost.memlimit) u.key_cost = cost;
+            }
+            else if (line.compare(0, 4, "gen:") == 0) {
+                kss >> u.key_generation;
+            }
+        }
         users.push_back(u);
     }
 
@@ -52,37 +147,21 @@ bool Storage::loadUsers(std::vector<User>& users, const std::string& filename) {
     return true;
 }
 
-static std::string serializeItemsPlain(const std::vector<Item>& items) {
-    std::ostringstream oss;
-
-    for (const auto& it : items) {
-        oss << it.title << "\n"
-            << it.content << "\n"
-            << it.tagsAsLine() << "\n"
-            << it.interval << "\n"
-            << it.ease_factor << "\n"
-            << it.last_review << "\n"
-            << it.next_review << "\n";
-
-        oss << it.history.size() << "\n";
-        for (const auto& r : it.history) {
-            oss << r.timestamp << " "
-                << r.quality << " "
-                << r.interval_after << "\n";
-        }
-
-        oss << "---\n";
-    }
-
-    return oss.str();
+// Version 1 decks stored neither IDs nor scheduler state; rebuild them so the
+// first review after upgrading doesn't treat every card as new
+static void migrateV1Item(Item& it) {
+    it.id = Item::generateID();
+    SM2Policy::restoreFromHistory(it, SchedulerConfig());
+    recountFromHistory(it);
 }
 
-static bool parsePlainToItems(const std::string& plain, std::vector<Item>& items) {
-    std::istringstream iss(plain);
+static bool parsePlainToItems(std::string_view plain, std::vector<Item>& items, int version) {
+    ViewStream iss(plain);
     items.clear();
 
     while (true) {
         Item it;
+        if (version >= 2 && !std::getline(iss, it.id)) break;
         if (!std::getline(iss, it.title)) break;
         std::getline(iss, it.content);
 
@@ -103,6 +182,11 @@ static bool parsePlainToItems(const std::string& plain, std::vector<Item>& items
         if (!(iss >> it.last_review)) break;
         if (!(iss >> it.next_review)) break;
 
+        if (version >= 2) {
+            if (!(iss >> it.reps >> it.base_interval >> it.stability >> it.difficulty)) break;
+            if (!(iss >> it.lapses >> it.is_leech >> it.review_count >> it.streak)) break;
+        }
+
         size_t hist_count = 0;
         if (!(iss >> hist_count)) break;
 
@@ -117,45 +201,15 @@ static bool parsePlainToItems(const std::string& plain, std::vector<Item>& items
             it.history.push_back(r);
         }
 
+        // "---" separator
         std::getline(iss, sep);
-        std::getline(iss, sep);
-
-        items.push_back(it);
-    }
-
-    return true;
-}
 
-bool Storage::saveItems(const std::vector<Item>& items, const std::string& filename, const std::vector<unsigned char>& key) {
-    spdlog::info("Saving {} encrypted items to '{}'", items.size(), filename);
-    if (key.size() != crypto_secretbox_KEYBYTES) {
-        spdlog::error("Invalid key size");
-        return false;
-    }
+        if (version < 2) migrateV1Item(it);
+        else if (it.id.empty()) it.id = Item::generateID();
 
-    std::string plain = serializeItemsPlain(items);
-    const unsigned char* p = reinterpret_cast<const unsigned char*>(plain.data());
-    unsigned long long plen = plain.size();
-
-    std::vector<unsigned char> ciphertext(plen + crypto_secretbox_MACBYTES);
-
-    unsigned char nonce[crypto_secretbox_NONCEBYTES];
-    randombytes_buf(nonce, sizeof(nonce));
-
-    if (crypto_secretbox_easy(ciphertext.data(), p, plen, nonce, key.data()) != 0) {
-        spdlog::error("Encryption failed");
-        return false;
-    }
-
-    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
-    if (!out) {
-        spdlog::error("Failed to open '{}' for encrypted write", filename);
-        return false;
+        items.push_back(it);
     }
 
-    out.write(MAGIC_HDR, sizeof(MAGIC_HDR) - 1);
-    out.write(reinterpret_cast<const char*>(nonce), sizeof(nonce));
-    out.write(reinterpret_cast<const char*>(ciphertext.data()), ciphertext.size());
     return true;
 }
 
@@ -176,124 +230,63 @@ bool Storage::loadItems(std::vector<Item>& items, const std::string& filename, c
 
     char hdr[sizeof(MAGIC_HDR) - 1];
     in.read(hdr, sizeof(hdr));
-    if (in.gcount() != sizeof(hdr) || std::strncmp(hdr, MAGIC_HDR, sizeof(hdr)) != 0) {
+    if (in.gcount() != sizeof(hdr)) {
         spdlog::error("Invalid magic header");
         return false;
     }
 
-    unsigned char nonce[crypto_secretbox_NONCEBYTES];
-    in.read(reinterpret_cast<char*>(nonce), sizeof(nonce));
-    if (in.gcount() != sizeof(nonce)) {
-        spdlog::error("Failed to read nonce");
-        return false;
-    }
-
-    std::vector<unsigned char> ciphertext(
-        (std::istreambuf_iterator<char>(in)),
-        std::istreambuf_iterator<char>());
-
-    if (ciphertext.size() < crypto_secretbox_MACBYTES) {
-        spdlog::error("Ciphertext too short");
-        return false;
-    }
-
-    std::vector<unsigned char> plain(ciphertext.size() - crypto_secretbox_MACBYTES);
-    if (crypto_secretbox_open_easy(plain.data(), ciphertext.data(), ciphertext.size(), nonce, key.data()) != 0) {
-        spdlog::error("Decryption failed");
-        return false;
-    }
-
-    std::string plain_str(reinterpret_cast<char*>(plain.data()), plain.size());
-    parsePlainToItems(plain_str, items);
-
-    spdlog::info("Loaded {} items", items.size());
-    return true;
-}
-
-bool Storage::saveTagWeights(const TagManager& mgr, const std::string& filename, const std::vector<unsigned char>& key) {
-    spdlog::info("Saving tag weights to '{}'", filename);
-
-    if (key.size() != crypto_secretbox_KEYBYTES) {
-        spdlog::error("Invalid key size");
-        return false;
+    if (DeckFile::formatOf(hdr, sizeof(hdr)) != 0) {
+        in.close();
+        DeckFile deck;
+        return deck.open(items, filename, key) && deck.loadAll(items);
     }
 
-    std::string plain = mgr.serialize();
-    const unsigned char* p = reinterpret_cast<const unsigned char*>(plain.data());
-    unsigned long long plen = plain.size();
-
-    std::vector<unsigned char> ciphertext(plen + crypto_secretbox_MACBYTES);
-
-    unsigned char nonce[crypto_secretbox_NONCEBYTES];
-    randombytes_buf(nonce, sizeof(nonce));
-
-    if (crypto_secretbox_easy(ciphertext.data(), p, plen, nonce, key.data()) != 0) {
-        spdlog::error("crypto_secretbox_easy failed");
+    int version = 0;
+    if (std::strncmp(hdr, ITEMS_HDR_V2, sizeof(hdr)) == 0) version = 2;
+    else if (std::strncmp(hdr, MAGIC_HDR, sizeof(hdr)) == 0) version = 1;
+    else {
+        spdlog::error("Invalid magic header");
         return false;
     }
 
-    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
-    if (!out) {
-        spdlog::error("Failed to write tag weights");
-        return false;
-    }
+    SecureString plain(secureResource());
+    if (!openLegacyBody(in, key, plain)) return false;
+    parsePlainToItems(plain, items, version);
 
-    out.write(MAGIC_HDR, sizeof(MAGIC_HDR) - 1);
-    out.write(reinterpret_cast<const char*>(nonce), sizeof(nonce));
-    out.write(reinterpret_cast<const char*>(ciphertext.data()), ciphertext.size());
+    spdlog::info("Loaded {} items (format v{})", items.size(), version);
     return true;
 }
 
 bool Storage::loadTagWeights(TagManager& mgr, const std::string& filename, const std::vector<unsigned char>& key) {
     spdlog::info("Loading tag weights from '{}'", filename);
-    mgr.weights.clear();
+    mgr.clearWeights();
 
-    if (key.size() != crypto_secretbox_KEYBYTES) {
-        spdlog::error("Invalid key size");
-        return false;
-    }
-
-    std::ifstream in(filename, std::ios::binary);
-    if (!in) {
+    SecureString plain(secureResource());
+    bool found = false;
+    if (!readSealedFile(plain, filename, key, "tag weight", found)) return false;
+    if (!found) {
         spdlog::warn("Tag weight file '{}' not found; using defaults", filename);
         return true;
     }
+    mgr.deserialize(plain);
 
-    char hdr[sizeof(MAGIC_HDR) - 1];
-    in.read(hdr, sizeof(hdr));
-    if (in.gcount() != sizeof(hdr) || std::strncmp(hdr, MAGIC_HDR, sizeof(hdr)) != 0) {
-        spdlog::error("Invalid tag weight header");
-        return false;
-    }
-
-    unsigned char nonce[crypto_secretbox_NONCEBYTES];
-    in.read(reinterpret_cast<char*>(nonce), sizeof(nonce));
-    if (in.gcount() != sizeof(nonce)) {
-        spdlog::error("Failed to read nonce");
-        return false;
-    }
-
-    std::vector<unsigned char> ciphertext(
-        (std::istreambuf_iterator<char>(in)),
-        std::istreambuf_iterator<char>());
-
-    if (ciphertext.size() < crypto_secretbox_MACBYTES) {
-        spdlog::error("Ciphertext too short");
-        return false;
-    }
+    spdlog::info("Loaded {} tag weights", mgr.weights.size());
+    return true;
+}
 
-    unsigned long long clen = ciphertext.size();
-    unsigned long long plen = clen - crypto_secretbox_MACBYTES;
-    std::vector<unsigned char> plain(plen);
+bool Storage::loadSchedulerConfig(SchedulerConfig& cfg, const std::string& filename, const std::vector<unsigned char>& key) {
+    spdlog::info("Loading scheduler config from '{}'", filename);
+    cfg = SchedulerConfig();
 
-    if (crypto_secretbox_open_easy(plain.data(), ciphertext.data(), clen, nonce, key.data()) != 0) {
-        spdlog::error("Decryption failed");
-        return false;
+    SecureString plain(secureResource());
+    bool found = false;
+    if (!readSealedFile(plain, filename, key, "scheduler config", found)) return false;
+    if (!found) {
+        spdlog::warn("Scheduler config '{}' not found; using defaults", filename);
+        return true;
     }
+    cfg.deserialize(plain);
 
-    std::string plain_str(reinterpret_cast<const char*>(plain.data()), plain.size());
-    mgr.deserialize(plain_str);
-
-    spdlog::info("Loaded {} tag weights", mgr.weights.size());
+    spdlog::info("Scheduler config loaded: algorithm={}", SchedulerConfig::algorithmName(cfg.algorithm));
     return true;
 }
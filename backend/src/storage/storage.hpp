@@ -4,15 +4,16 @@
 #include "../core/Item.hpp"
 #include "../auth/User.hpp"
 #include "../core/TagManager.hpp"
+#include "../core/SchedulerConfig.hpp"
 
 class Storage {
 public:
     static bool saveUsers(const std::vector<User>& users, const std::string& filename);
     static bool loadUsers(std::vector<User>& users, const std::string& filename);
 
-    static bool saveItems(const std::vector<Item>& items, const std::string& filename, const std::vector<unsigned char>& key);
+    // Per-user deck files from before the shared store. They are only read,
+    // by PagedDeck::importFiles; decks are saved through PagedDeck.
     static bool loadItems(std::vector<Item>& items, const std::string& filename, const std::vector<unsigned char>& key);
-
-    static bool saveTagWeights(const TagManager& mgr, const std::string& filename, const std::vector<unsigned char>& key);
     static bool loadTagWeights(TagManager& mgr, const std::string& filename, const std::vector<unsigned char>& key);
+    static bool loadSchedulerConfig(SchedulerConfig& cfg, const std::string& filename, const std::vector<unsigned char>& key);
 };
@@ -0,0 +1,163 @@
+// Checks for the work-stealing pool and the loops built on it: stealing,
+// range coverage, reduction order, cancellation and exception propagation.
+//
+//   cmake ... && ctest -R parallel
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "parallel/Parallel.hpp"
+
+namespace {
+
+    int failures = 0;
+
+    void check(bool ok, const char* what) {
+        if (ok) return;
+        ++failures;
+        std::fprintf(stderr, "FAILED: %s\n", what);
+    }
+
+    // Children spawned inside one task land on that worker's deque; the other
+    // workers can only get at them by stealing
+    void testWorkStealing() {
+        ThreadPool pool(4);
+        std::atomic<int> ran{ 0 };
+        std::mutex idsLock;
+        std::set<std::thread::id> ids;
+
+        TaskGroup outer(pool);
+        outer.run([&] {
+            TaskGroup inner(pool);
+            for (int i = 0; i < 64; ++i)
+                inner.run([&] {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    {
+                        std::lock_guard<std::mutex> guard(idsLock);
+                        ids.insert(std::this_thread::get_id());
+                    }
+                    ran.fetch_add(1);
+                });
+            inner.wait();
+        });
+        outer.wait();
+
+        check(ran.load() == 64, "every nested task runs");
+        check(pool.metrics().stolen > 0, "idle workers steal nested tasks");
+        check(ids.size() > 1, "nested tasks spread over several workers");
+    }
+
+    void testForCoversRange() {
+        ThreadPool pool(4);
+        for (std::size_t grain : { std::size_t(0), std::size_t(1), std::size_t(7), std::size_t(5000) }) {
+            const std::size_t begin = 13, end = 10007;
+            std::vector<std::atomic<int>> hits(end);
+            parallelFor(pool, begin, end, grain, [&](std::size_t lo, std::size_t hi) {
+                for (std::size_t i = lo; i < hi; ++i) hits[i].fetch_add(1);
+            });
+
+            bool once = true;
+            for (std::size_t i = 0; i < end; ++i) once = once && hits[i].load() == (i >= begin ? 1 : 0);
+            check(once, "parallelFor visits each index of the range exactly once");
+        }
+
+        int calls = 0;
+        parallelFor(pool, 5, 5, 0, [&](std::size_t, std::size_t) { ++calls; });
+        check(calls == 0, "parallelFor over an empty range does nothing");
+    }
+
+    // String concatenation is not commutative, so any chunk out of order shows
+    void testReduceInIndexOrder() {
+        const std::size_t n = 2000;
+        std::string expected;
+        for (std::size_t i = 0; i < n; ++i) expected += static_cast<char>('a' + i % 26);
+
+        for (std::size_t threads : { std::size_t(1), std::size_t(3), std::size_t(8) }) {
+            ThreadPool pool(threads);
+            std::string joined = parallelReduce(pool, 0, n, 17, std::string(),
+                [](std::size_t lo, std::size_t hi) {
+                    std::string s;
+                    for (std::size_t i = lo; i < hi; ++i) s += static_cast<char>('a' + i % 26);
+                    return s;
+                },
+                [](std::string a, std::string b) { return a + b; });
+            check(joined == expected, "parallelReduce combines partials in index order");
+        }
+
+        ThreadPool pool(2);
+        int empty = parallelReduce(pool, 3, 3, 0, 42, [](std::size_t, std::size_t) { return 0; },
+            [](int a, int b) { return a + b; });
+        check(empty == 42, "parallelReduce over an empty range returns the identity");
+    }
+
+    void testCancellation() {
+        ThreadPool pool(4);
+        const std::size_t n = 1 << 20, grain = 256;
+        std::atomic<std::size_t> chunks{ 0 };
+
+        TaskGroup group(pool);
+        parallelFor(group, 0, n, grain, [&](std::size_t lo, std::size_t) {
+            chunks.fetch_add(1);
+            if (lo == 0) group.cancel();
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        });
+
+        check(group.isCancelled(), "cancel() marks the group");
+        check(chunks.load() < n / grain, "chunks not yet started are skipped after cancel()");
+
+        std::atomic<int> ran{ 0 };
+        group.run([&] { ran.fetch_add(1); });
+        group.wait();
+        check(ran.load() == 0, "a cancelled group runs no new tasks");
+    }
+
+    void testExceptions() {
+        ThreadPool pool(4);
+        bool caught = false;
+        try {
+            TaskGroup group(pool);
+            for (int i = 0; i < 32; ++i)
+                group.run([i] {
+                    if (i == 5) throw std::runtime_error("task 5");
+                });
+            group.wait();
+        }
+        catch (const std::runtime_error& e) {
+            caught = std::string(e.what()) == "task 5";
+        }
+        check(caught, "a task's exception comes back out of wait()");
+
+        caught = false;
+        try {
+            parallelFor(pool, 0, 1000, 10, [](std::size_t lo, std::size_t) {
+                if (lo == 500) throw std::logic_error("chunk");
+            });
+        }
+        catch (const std::logic_error&) {
+            caught = true;
+        }
+        check(caught, "parallelFor rethrows an exception from a chunk");
+
+        // The pool keeps working afterwards
+        std::atomic<int> ran{ 0 };
+        parallelFor(pool, 0, 100, 1, [&](std::size_t lo, std::size_t hi) { ran.fetch_add(static_cast<int>(hi - lo)); });
+        check(ran.load() == 100, "the pool runs later loops after an exception");
+    }
+
+} // namespace
+
+int main() {
+    testWorkStealing();
+    testForCoversRange();
+    testReduceInIndexOrder();
+    testCancellation();
+    testExceptions();
+
+    if (failures == 0) std::printf("all parallel checks passed\n");
+    return failures == 0 ? 0 : 1;
+}